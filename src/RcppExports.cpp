@@ -62,6 +62,27 @@ BEGIN_RCPP
     return R_NilValue;
 END_RCPP
 }
+// gc_set_archive_cache_dir
+void gc_set_archive_cache_dir(std::string dir);
+RcppExport SEXP _gdalcubes_gc_set_archive_cache_dir(SEXP dirSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type dir(dirSEXP);
+    gc_set_archive_cache_dir(dir);
+    return R_NilValue;
+END_RCPP
+}
+// gc_set_remote_cache
+void gc_set_remote_cache(std::string dir, double size_mb);
+RcppExport SEXP _gdalcubes_gc_set_remote_cache(SEXP dirSEXP, SEXP size_mbSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type dir(dirSEXP);
+    Rcpp::traits::input_parameter< double >::type size_mb(size_mbSEXP);
+    gc_set_remote_cache(dir, size_mb);
+    return R_NilValue;
+END_RCPP
+}
 // gc_gdalversion
 std::string gc_gdalversion();
 RcppExport SEXP _gdalcubes_gc_gdalversion() {
@@ -243,6 +264,43 @@ BEGIN_RCPP
     return R_NilValue;
 END_RCPP
 }
+// gc_compute_footprints
+void gc_compute_footprints(SEXP pin, int max_size);
+RcppExport SEXP _gdalcubes_gc_compute_footprints(SEXP pinSEXP, SEXP max_sizeSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type pin(pinSEXP);
+    Rcpp::traits::input_parameter< int >::type max_size(max_sizeSEXP);
+    gc_compute_footprints(pin, max_size);
+    return R_NilValue;
+END_RCPP
+}
+// gc_partition_image_collection
+SEXP gc_partition_image_collection(SEXP pin, std::string manifest, std::string time_unit, double tile_size);
+RcppExport SEXP _gdalcubes_gc_partition_image_collection(SEXP pinSEXP, SEXP manifestSEXP, SEXP time_unitSEXP, SEXP tile_sizeSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type pin(pinSEXP);
+    Rcpp::traits::input_parameter< std::string >::type manifest(manifestSEXP);
+    Rcpp::traits::input_parameter< std::string >::type time_unit(time_unitSEXP);
+    Rcpp::traits::input_parameter< double >::type tile_size(tile_sizeSEXP);
+    rcpp_result_gen = Rcpp::wrap(gc_partition_image_collection(pin, manifest, time_unit, tile_size));
+    return rcpp_result_gen;
+END_RCPP
+}
+// gc_create_sharded_image_collection
+SEXP gc_create_sharded_image_collection(std::vector<std::string> shards, std::string manifest);
+RcppExport SEXP _gdalcubes_gc_create_sharded_image_collection(SEXP shardsSEXP, SEXP manifestSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::vector<std::string> >::type shards(shardsSEXP);
+    Rcpp::traits::input_parameter< std::string >::type manifest(manifestSEXP);
+    rcpp_result_gen = Rcpp::wrap(gc_create_sharded_image_collection(shards, manifest));
+    return rcpp_result_gen;
+END_RCPP
+}
 // gc_list_collection_formats
 SEXP gc_list_collection_formats();
 RcppExport SEXP _gdalcubes_gc_list_collection_formats() {
@@ -278,6 +336,18 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// gc_set_image_md_filter
+void gc_set_image_md_filter(SEXP pin, std::vector<std::string> filter, std::string order);
+RcppExport SEXP _gdalcubes_gc_set_image_md_filter(SEXP pinSEXP, SEXP filterSEXP, SEXP orderSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type pin(pinSEXP);
+    Rcpp::traits::input_parameter< std::vector<std::string> >::type filter(filterSEXP);
+    Rcpp::traits::input_parameter< std::string >::type order(orderSEXP);
+    gc_set_image_md_filter(pin, filter, order);
+    return R_NilValue;
+END_RCPP
+}
 // gc_create_ncdf_cube
 SEXP gc_create_ncdf_cube(std::string path, Rcpp::IntegerVector chunk_sizes, bool auto_unpack);
 RcppExport SEXP _gdalcubes_gc_create_ncdf_cube(SEXP pathSEXP, SEXP chunk_sizesSEXP, SEXP auto_unpackSEXP) {
@@ -445,6 +515,37 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// gc_create_window_space_cube_reduce
+SEXP gc_create_window_space_cube_reduce(SEXP pin, std::vector<int> window, std::vector<std::string> reducers, std::vector<std::string> bands, std::string pad, double pad_fill);
+RcppExport SEXP _gdalcubes_gc_create_window_space_cube_reduce(SEXP pinSEXP, SEXP windowSEXP, SEXP reducersSEXP, SEXP bandsSEXP, SEXP padSEXP, SEXP pad_fillSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type pin(pinSEXP);
+    Rcpp::traits::input_parameter< std::vector<int> >::type window(windowSEXP);
+    Rcpp::traits::input_parameter< std::vector<std::string> >::type reducers(reducersSEXP);
+    Rcpp::traits::input_parameter< std::vector<std::string> >::type bands(bandsSEXP);
+    Rcpp::traits::input_parameter< std::string >::type pad(padSEXP);
+    Rcpp::traits::input_parameter< double >::type pad_fill(pad_fillSEXP);
+    rcpp_result_gen = Rcpp::wrap(gc_create_window_space_cube_reduce(pin, window, reducers, bands, pad, pad_fill));
+    return rcpp_result_gen;
+END_RCPP
+}
+// gc_create_window_space_cube_kernel
+SEXP gc_create_window_space_cube_kernel(SEXP pin, std::vector<int> window, std::vector<double> kernel, std::string pad, double pad_fill);
+RcppExport SEXP _gdalcubes_gc_create_window_space_cube_kernel(SEXP pinSEXP, SEXP windowSEXP, SEXP kernelSEXP, SEXP padSEXP, SEXP pad_fillSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type pin(pinSEXP);
+    Rcpp::traits::input_parameter< std::vector<int> >::type window(windowSEXP);
+    Rcpp::traits::input_parameter< std::vector<double> >::type kernel(kernelSEXP);
+    Rcpp::traits::input_parameter< std::string >::type pad(padSEXP);
+    Rcpp::traits::input_parameter< double >::type pad_fill(pad_fillSEXP);
+    rcpp_result_gen = Rcpp::wrap(gc_create_window_space_cube_kernel(pin, window, kernel, pad, pad_fill));
+    return rcpp_result_gen;
+END_RCPP
+}
 // gc_create_join_bands_cube
 SEXP gc_create_join_bands_cube(Rcpp::List pin_list, std::vector<std::string> cube_names);
 RcppExport SEXP _gdalcubes_gc_create_join_bands_cube(SEXP pin_listSEXP, SEXP cube_namesSEXP) {
@@ -525,6 +626,48 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// gc_create_apply_time_cube
+SEXP gc_create_apply_time_cube(SEXP pin, std::vector<std::string> ops, std::vector<std::string> bands, std::vector<int> lags, std::vector<std::string> names);
+RcppExport SEXP _gdalcubes_gc_create_apply_time_cube(SEXP pinSEXP, SEXP opsSEXP, SEXP bandsSEXP, SEXP lagsSEXP, SEXP namesSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type pin(pinSEXP);
+    Rcpp::traits::input_parameter< std::vector<std::string> >::type ops(opsSEXP);
+    Rcpp::traits::input_parameter< std::vector<std::string> >::type bands(bandsSEXP);
+    Rcpp::traits::input_parameter< std::vector<int> >::type lags(lagsSEXP);
+    Rcpp::traits::input_parameter< std::vector<std::string> >::type names(namesSEXP);
+    rcpp_result_gen = Rcpp::wrap(gc_create_apply_time_cube(pin, ops, bands, lags, names));
+    return rcpp_result_gen;
+END_RCPP
+}
+// gc_create_kernel_plugin_cube
+SEXP gc_create_kernel_plugin_cube(SEXP pin, std::string plugin, std::string mode, std::string args);
+RcppExport SEXP _gdalcubes_gc_create_kernel_plugin_cube(SEXP pinSEXP, SEXP pluginSEXP, SEXP modeSEXP, SEXP argsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type pin(pinSEXP);
+    Rcpp::traits::input_parameter< std::string >::type plugin(pluginSEXP);
+    Rcpp::traits::input_parameter< std::string >::type mode(modeSEXP);
+    Rcpp::traits::input_parameter< std::string >::type args(argsSEXP);
+    rcpp_result_gen = Rcpp::wrap(gc_create_kernel_plugin_cube(pin, plugin, mode, args));
+    return rcpp_result_gen;
+END_RCPP
+}
+// gc_create_predict_pixel_cube
+SEXP gc_create_predict_pixel_cube(SEXP pin, std::string model, bool probabilities);
+RcppExport SEXP _gdalcubes_gc_create_predict_pixel_cube(SEXP pinSEXP, SEXP modelSEXP, SEXP probabilitiesSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type pin(pinSEXP);
+    Rcpp::traits::input_parameter< std::string >::type model(modelSEXP);
+    Rcpp::traits::input_parameter< bool >::type probabilities(probabilitiesSEXP);
+    rcpp_result_gen = Rcpp::wrap(gc_create_predict_pixel_cube(pin, model, probabilities));
+    return rcpp_result_gen;
+END_RCPP
+}
 // gc_create_filter_predicate_cube
 SEXP gc_create_filter_predicate_cube(SEXP pin, std::string pred);
 RcppExport SEXP _gdalcubes_gc_create_filter_predicate_cube(SEXP pinSEXP, SEXP predSEXP) {
@@ -778,6 +921,28 @@ BEGIN_RCPP
     return R_NilValue;
 END_RCPP
 }
+// gc_set_prefetch
+void gc_set_prefetch(int depth, double memory_max_mb);
+RcppExport SEXP _gdalcubes_gc_set_prefetch(SEXP depthSEXP, SEXP memory_max_mbSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< int >::type depth(depthSEXP);
+    Rcpp::traits::input_parameter< double >::type memory_max_mb(memory_max_mbSEXP);
+    gc_set_prefetch(depth, memory_max_mb);
+    return R_NilValue;
+END_RCPP
+}
+// gc_set_budgets
+void gc_set_budgets(int threads, double memory_mb);
+RcppExport SEXP _gdalcubes_gc_set_budgets(SEXP threadsSEXP, SEXP memory_mbSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< double >::type memory_mb(memory_mbSEXP);
+    gc_set_budgets(threads, memory_mb);
+    return R_NilValue;
+END_RCPP
+}
 // gc_detect_cores
 int gc_detect_cores();
 RcppExport SEXP _gdalcubes_gc_detect_cores() {
@@ -820,6 +985,8 @@ static const R_CallMethodDef CallEntries[] = {
     {"_gdalcubes_gc_gdalformats", (DL_FUNC) &_gdalcubes_gc_gdalformats, 0},
     {"_gdalcubes_gc_set_gdal_config", (DL_FUNC) &_gdalcubes_gc_set_gdal_config, 2},
     {"_gdalcubes_gc_set_streamining_dir", (DL_FUNC) &_gdalcubes_gc_set_streamining_dir, 1},
+    {"_gdalcubes_gc_set_archive_cache_dir", (DL_FUNC) &_gdalcubes_gc_set_archive_cache_dir, 1},
+    {"_gdalcubes_gc_set_remote_cache", (DL_FUNC) &_gdalcubes_gc_set_remote_cache, 2},
     {"_gdalcubes_gc_gdalversion", (DL_FUNC) &_gdalcubes_gc_gdalversion, 0},
     {"_gdalcubes_gc_gdal_has_geos", (DL_FUNC) &_gdalcubes_gc_gdal_has_geos, 0},
     {"_gdalcubes_gc_add_format_dir", (DL_FUNC) &_gdalcubes_gc_add_format_dir, 1},
@@ -836,9 +1003,13 @@ static const R_CallMethodDef CallEntries[] = {
     {"_gdalcubes_gc_create_image_collection_from_format", (DL_FUNC) &_gdalcubes_gc_create_image_collection_from_format, 4},
     {"_gdalcubes_gc_create_image_collection_from_datetime", (DL_FUNC) &_gdalcubes_gc_create_image_collection_from_datetime, 6},
     {"_gdalcubes_gc_add_images", (DL_FUNC) &_gdalcubes_gc_add_images, 4},
+    {"_gdalcubes_gc_compute_footprints", (DL_FUNC) &_gdalcubes_gc_compute_footprints, 2},
+    {"_gdalcubes_gc_partition_image_collection", (DL_FUNC) &_gdalcubes_gc_partition_image_collection, 4},
+    {"_gdalcubes_gc_create_sharded_image_collection", (DL_FUNC) &_gdalcubes_gc_create_sharded_image_collection, 2},
     {"_gdalcubes_gc_list_collection_formats", (DL_FUNC) &_gdalcubes_gc_list_collection_formats, 0},
     {"_gdalcubes_gc_create_view", (DL_FUNC) &_gdalcubes_gc_create_view, 1},
     {"_gdalcubes_gc_create_image_collection_cube", (DL_FUNC) &_gdalcubes_gc_create_image_collection_cube, 4},
+    {"_gdalcubes_gc_set_image_md_filter", (DL_FUNC) &_gdalcubes_gc_set_image_md_filter, 3},
     {"_gdalcubes_gc_create_ncdf_cube", (DL_FUNC) &_gdalcubes_gc_create_ncdf_cube, 3},
     {"_gdalcubes_gc_create_dummy_cube", (DL_FUNC) &_gdalcubes_gc_create_dummy_cube, 4},
     {"_gdalcubes_gc_create_empty_cube", (DL_FUNC) &_gdalcubes_gc_create_empty_cube, 3},
@@ -852,12 +1023,17 @@ static const R_CallMethodDef CallEntries[] = {
     {"_gdalcubes_gc_create_reduce_space_cube", (DL_FUNC) &_gdalcubes_gc_create_reduce_space_cube, 3},
     {"_gdalcubes_gc_create_window_time_cube_reduce", (DL_FUNC) &_gdalcubes_gc_create_window_time_cube_reduce, 4},
     {"_gdalcubes_gc_create_window_time_cube_kernel", (DL_FUNC) &_gdalcubes_gc_create_window_time_cube_kernel, 3},
+    {"_gdalcubes_gc_create_window_space_cube_reduce", (DL_FUNC) &_gdalcubes_gc_create_window_space_cube_reduce, 6},
+    {"_gdalcubes_gc_create_window_space_cube_kernel", (DL_FUNC) &_gdalcubes_gc_create_window_space_cube_kernel, 5},
     {"_gdalcubes_gc_create_join_bands_cube", (DL_FUNC) &_gdalcubes_gc_create_join_bands_cube, 2},
     {"_gdalcubes_gc_create_select_bands_cube", (DL_FUNC) &_gdalcubes_gc_create_select_bands_cube, 2},
     {"_gdalcubes_gc_create_select_time_cube", (DL_FUNC) &_gdalcubes_gc_create_select_time_cube, 2},
     {"_gdalcubes_gc_create_apply_pixel_cube", (DL_FUNC) &_gdalcubes_gc_create_apply_pixel_cube, 4},
     {"_gdalcubes_gc_create_stream_apply_pixel_cube", (DL_FUNC) &_gdalcubes_gc_create_stream_apply_pixel_cube, 5},
     {"_gdalcubes_gc_create_stream_apply_time_cube", (DL_FUNC) &_gdalcubes_gc_create_stream_apply_time_cube, 5},
+    {"_gdalcubes_gc_create_apply_time_cube", (DL_FUNC) &_gdalcubes_gc_create_apply_time_cube, 5},
+    {"_gdalcubes_gc_create_kernel_plugin_cube", (DL_FUNC) &_gdalcubes_gc_create_kernel_plugin_cube, 4},
+    {"_gdalcubes_gc_create_predict_pixel_cube", (DL_FUNC) &_gdalcubes_gc_create_predict_pixel_cube, 3},
     {"_gdalcubes_gc_create_filter_predicate_cube", (DL_FUNC) &_gdalcubes_gc_create_filter_predicate_cube, 2},
     {"_gdalcubes_gc_create_filter_geom_cube", (DL_FUNC) &_gdalcubes_gc_create_filter_geom_cube, 3},
     {"_gdalcubes_gc_set_err_handler", (DL_FUNC) &_gdalcubes_gc_set_err_handler, 2},
@@ -877,6 +1053,8 @@ static const R_CallMethodDef CallEntries[] = {
     {"_gdalcubes_gc_set_process_execution", (DL_FUNC) &_gdalcubes_gc_set_process_execution, 6},
     {"_gdalcubes_gc_set_progress", (DL_FUNC) &_gdalcubes_gc_set_progress, 1},
     {"_gdalcubes_gc_set_use_overviews", (DL_FUNC) &_gdalcubes_gc_set_use_overviews, 1},
+    {"_gdalcubes_gc_set_prefetch", (DL_FUNC) &_gdalcubes_gc_set_prefetch, 2},
+    {"_gdalcubes_gc_set_budgets", (DL_FUNC) &_gdalcubes_gc_set_budgets, 2},
     {"_gdalcubes_gc_detect_cores", (DL_FUNC) &_gdalcubes_gc_detect_cores, 0},
     {"_gdalcubes_gc_simple_hash", (DL_FUNC) &_gdalcubes_gc_simple_hash, 1},
     {"_gdalcubes_gc_create_stac_collection", (DL_FUNC) &_gdalcubes_gc_create_stac_collection, 5},
@@ -260,6 +260,17 @@ void gc_set_streamining_dir(std::string dir) {
   config::instance()->set_streaming_dir(dir);
 }
 
+// [[Rcpp::export]]
+void gc_set_archive_cache_dir(std::string dir) {
+  config::instance()->set_archive_cache_dir(dir);
+}
+
+// [[Rcpp::export]]
+void gc_set_remote_cache(std::string dir, double size_mb) {
+  config::instance()->set_remote_cache_dir(dir);
+  config::instance()->set_remote_cache_max((uint64_t)(size_mb * 1024 * 1024));
+}
+
 
 // [[Rcpp::export]]
 std::string gc_gdalversion() {
@@ -785,6 +796,42 @@ void gc_add_images(SEXP pin, std::vector<std::string> files, bool unroll_archive
   }
 }
 
+// [[Rcpp::export]]
+void gc_compute_footprints(SEXP pin, int max_size) {
+  try {
+    Rcpp::XPtr<std::shared_ptr<image_collection>> aa = Rcpp::as<Rcpp::XPtr<std::shared_ptr<image_collection>>>(pin);
+    image_collection_ops::compute_footprints(*aa, config::instance()->get_default_chunk_processor()->max_threads(), max_size);
+  }
+  catch (std::string s) {
+    Rcpp::stop(s);
+  }
+}
+
+// [[Rcpp::export]]
+SEXP gc_partition_image_collection(SEXP pin, std::string manifest, std::string time_unit, double tile_size) {
+  try {
+    Rcpp::XPtr<std::shared_ptr<image_collection>> aa = Rcpp::as<Rcpp::XPtr<std::shared_ptr<image_collection>>>(pin);
+    std::shared_ptr<image_collection>* x = new std::shared_ptr<image_collection>((*aa)->partition(manifest, time_unit, tile_size));
+    Rcpp::XPtr< std::shared_ptr<image_collection> > p(x, true) ;
+    return p;
+  }
+  catch (std::string s) {
+    Rcpp::stop(s);
+  }
+}
+
+// [[Rcpp::export]]
+SEXP gc_create_sharded_image_collection(std::vector<std::string> shards, std::string manifest) {
+  try {
+    std::shared_ptr<image_collection>* x = new std::shared_ptr<image_collection>(image_collection::create_sharded(manifest, shards));
+    Rcpp::XPtr< std::shared_ptr<image_collection> > p(x, true) ;
+    return p;
+  }
+  catch (std::string s) {
+    Rcpp::stop(s);
+  }
+}
+
 // [[Rcpp::export]]
 SEXP gc_list_collection_formats() {
   try {
@@ -843,6 +890,30 @@ SEXP gc_create_view(SEXP v) {
 }
 
 
+std::shared_ptr<image_mask> image_mask_from_list(Rcpp::List mask) {
+  if (mask.containsElementNamed("masks") && mask["masks"] != R_NilValue) {
+    std::vector<std::shared_ptr<image_mask>> masks;
+    Rcpp::List l = Rcpp::as<Rcpp::List>(mask["masks"]);
+    for (uint16_t i = 0; i < l.size(); ++i) {
+      masks.push_back(image_mask_from_list(Rcpp::as<Rcpp::List>(l[i])));
+    }
+    std::string op = Rcpp::as<std::string>(mask["op"]);
+    return std::make_shared<mask_combination>(op == "and" ? mask_combination::op::AND : mask_combination::op::OR, masks);
+  }
+  
+  bool invert = mask["invert"];
+  std::vector<uint8_t> bits;
+  if (mask["bits"] != R_NilValue)
+    bits =  Rcpp::as<std::vector<uint8_t>>(mask["bits"]);
+  if (mask.containsElementNamed("values") && mask["values"] != R_NilValue) {
+    std::vector<double> values = Rcpp::as<std::vector<double>>(mask["values"]);
+    return std::make_shared<value_mask>(std::unordered_set<double>(values.begin(), values.end()), invert, bits);
+  }
+  double min = mask["min"];
+  double max = mask["max"];
+  return std::make_shared<range_mask>(min, max, invert, bits);
+}
+
 // [[Rcpp::export]]
 SEXP gc_create_image_collection_cube(SEXP pin, Rcpp::IntegerVector chunk_sizes, SEXP mask, SEXP v = R_NilValue) {
 
@@ -862,23 +933,7 @@ SEXP gc_create_image_collection_cube(SEXP pin, Rcpp::IntegerVector chunk_sizes,
     
     if (mask != R_NilValue) {
       std::string band_name = Rcpp::as<Rcpp::List>(mask)["band"]; 
-      bool invert = Rcpp::as<Rcpp::List>(mask)["invert"];
-      
-      if (Rcpp::as<Rcpp::List>(mask).containsElementNamed("values") && Rcpp::as<Rcpp::List>(mask)["values"] != R_NilValue) {
-        std::vector<double> values = Rcpp::as<std::vector<double>>(Rcpp::as<Rcpp::List>(mask)["values"]);
-        std::vector<uint8_t> bits;
-        if (Rcpp::as<Rcpp::List>(mask)["bits"] != R_NilValue)
-          bits =  Rcpp::as<std::vector<uint8_t>>(Rcpp::as<Rcpp::List>(mask)["bits"]);
-        (*x)->set_mask(band_name, std::make_shared<value_mask>(std::unordered_set<double>(values.begin(), values.end()), invert, bits));
-      }
-      else {
-        double min = Rcpp::as<Rcpp::List>(mask)["min"];
-        double max = Rcpp::as<Rcpp::List>(mask)["max"];
-        std::vector<uint8_t> bits;
-        if (Rcpp::as<Rcpp::List>(mask)["bits"] != R_NilValue)
-          bits =  Rcpp::as<std::vector<uint8_t>>(Rcpp::as<Rcpp::List>(mask)["bits"]);
-        (*x)->set_mask(band_name, std::make_shared<range_mask>(min, max, invert, bits));
-      }
+      (*x)->set_mask(band_name, image_mask_from_list(Rcpp::as<Rcpp::List>(mask)));
     }
     
     Rcpp::XPtr< std::shared_ptr<image_collection_cube> > p(x, true) ;
@@ -893,6 +948,22 @@ SEXP gc_create_image_collection_cube(SEXP pin, Rcpp::IntegerVector chunk_sizes,
   
 }
 
+// [[Rcpp::export]]
+void gc_set_image_md_filter(SEXP pin, std::vector<std::string> filter, std::string order) {
+  try {
+    Rcpp::XPtr<std::shared_ptr<image_collection_cube>> aa = Rcpp::as<Rcpp::XPtr<std::shared_ptr<image_collection_cube>>>(pin);
+    std::vector<image_collection::image_md_predicate> predicates;
+    for (uint16_t i = 0; i < filter.size(); ++i) {
+      predicates.push_back(image_collection::image_md_predicate::from_string(filter[i]));
+    }
+    (*aa)->set_image_md_filter(predicates);
+    (*aa)->set_image_md_order(order);
+  }
+  catch (std::string s) {
+    Rcpp::stop(s);
+  }
+}
+
 
 // [[Rcpp::export]]
 SEXP gc_create_ncdf_cube(std::string path, Rcpp::IntegerVector chunk_sizes, bool auto_unpack) {
@@ -1135,6 +1206,44 @@ SEXP gc_create_window_time_cube_kernel(SEXP pin, std::vector<int> window, std::v
 }
 
 
+// [[Rcpp::export]]
+SEXP gc_create_window_space_cube_reduce(SEXP pin, std::vector<int> window, std::vector<std::string> reducers, std::vector<std::string> bands, std::string pad, double pad_fill) {
+  try {
+    Rcpp::XPtr< std::shared_ptr<cube> > aa = Rcpp::as<Rcpp::XPtr<std::shared_ptr<cube>>>(pin);
+    
+    std::vector<std::pair<std::string, std::string>> reducer_bands;
+    for (uint16_t i=0; i<reducers.size(); ++i) {
+      // assuming reducers.size() == bands.size(), this is checked in R code calling this function
+      reducer_bands.push_back(std::make_pair(reducers[i], bands[i]));
+    }
+    
+    std::shared_ptr<window_space_cube>* x = new std::shared_ptr<window_space_cube>(window_space_cube::create(*aa, reducer_bands, window[0], window[1], pad, pad_fill));
+    Rcpp::XPtr< std::shared_ptr<window_space_cube> > p(x, true) ;
+    
+    return p;
+    
+  }
+  catch (std::string s) {
+    Rcpp::stop(s);
+  }
+}
+
+// [[Rcpp::export]]
+SEXP gc_create_window_space_cube_kernel(SEXP pin, std::vector<int> window, std::vector<double> kernel, std::string pad, double pad_fill) {
+  try {
+    Rcpp::XPtr< std::shared_ptr<cube> > aa = Rcpp::as<Rcpp::XPtr<std::shared_ptr<cube>>>(pin);
+    
+    std::shared_ptr<window_space_cube>* x = new std::shared_ptr<window_space_cube>(window_space_cube::create(*aa, kernel, window[0], window[1], pad, pad_fill));
+    Rcpp::XPtr< std::shared_ptr<window_space_cube> > p(x, true) ;
+    return p;
+    
+  }
+  catch (std::string s) {
+    Rcpp::stop(s);
+  }
+}
+
+
 // [[Rcpp::export]]
 SEXP gc_create_join_bands_cube(Rcpp::List pin_list,  std::vector<std::string> cube_names) {
   try {
@@ -1233,6 +1342,53 @@ SEXP gc_create_stream_apply_time_cube(SEXP pin, std::string cmd, uint16_t nbands
 
 
 
+// [[Rcpp::export]]
+SEXP gc_create_apply_time_cube(SEXP pin, std::vector<std::string> ops, std::vector<std::string> bands, std::vector<int> lags, std::vector<std::string> names) {
+  try {
+    Rcpp::XPtr< std::shared_ptr<cube> > aa = Rcpp::as<Rcpp::XPtr<std::shared_ptr<cube>>>(pin);
+    
+    std::vector<std::pair<std::string, std::string>> op_bands;
+    for (uint16_t i=0; i<ops.size(); ++i) {
+      // assuming ops.size() == bands.size(), this is checked in R code calling this function
+      op_bands.push_back(std::make_pair(ops[i], bands[i]));
+    }
+    std::vector<int32_t> lags32(lags.begin(), lags.end());
+    
+    std::shared_ptr<apply_time_cube>* x = new std::shared_ptr<apply_time_cube>(apply_time_cube::create(*aa, op_bands, lags32, names));
+    Rcpp::XPtr< std::shared_ptr<apply_time_cube> > p(x, true) ;
+    return p;
+  }
+  catch (std::string s) {
+    Rcpp::stop(s);
+  }
+}
+
+// [[Rcpp::export]]
+SEXP gc_create_kernel_plugin_cube(SEXP pin, std::string plugin, std::string mode, std::string args) {
+  try {
+    Rcpp::XPtr< std::shared_ptr<cube> > aa = Rcpp::as<Rcpp::XPtr<std::shared_ptr<cube>>>(pin);
+    std::shared_ptr<kernel_plugin_cube>* x = new std::shared_ptr<kernel_plugin_cube>(kernel_plugin_cube::create(*aa, plugin, mode, args));
+    Rcpp::XPtr< std::shared_ptr<kernel_plugin_cube> > p(x, true) ;
+    return p;
+  }
+  catch (std::string s) {
+    Rcpp::stop(s);
+  }
+}
+
+// [[Rcpp::export]]
+SEXP gc_create_predict_pixel_cube(SEXP pin, std::string model, bool probabilities) {
+  try {
+    Rcpp::XPtr< std::shared_ptr<cube> > aa = Rcpp::as<Rcpp::XPtr<std::shared_ptr<cube>>>(pin);
+    std::shared_ptr<predict_pixel_cube>* x = new std::shared_ptr<predict_pixel_cube>(predict_pixel_cube::create(*aa, model, probabilities));
+    Rcpp::XPtr< std::shared_ptr<predict_pixel_cube> > p(x, true) ;
+    return p;
+  }
+  catch (std::string s) {
+    Rcpp::stop(s);
+  }
+}
+
 // [[Rcpp::export]]
 SEXP gc_create_filter_predicate_cube(SEXP pin, std::string pred) {
   try {
@@ -1424,7 +1580,9 @@ SEXP gc_create_simple_cube(std::vector<std::string> files,std::vector<std::strin
     std::shared_ptr<simple_cube>* x = new std::shared_ptr<simple_cube>( simple_cube::create(files, datetime_values,
                                                                                             bands, band_names,
                                                                                             dx, dy));
-    (*x)->set_chunk_size(chunk_sizes[0], chunk_sizes[1], chunk_sizes[2]);
+    if (chunk_sizes.size() == 3) {
+      (*x)->set_chunk_size(chunk_sizes[0], chunk_sizes[1], chunk_sizes[2]);
+    }
     Rcpp::XPtr< std::shared_ptr<simple_cube> > p(x, true) ;
     return p;
   }
@@ -1687,6 +1845,18 @@ void gc_set_use_overviews(bool use_overviews) {
   config::instance()->set_gdal_use_overviews(use_overviews);
 }
 
+// [[Rcpp::export]]
+void gc_set_prefetch(int depth, double memory_max_mb) {
+  config::instance()->set_prefetch_depth(depth);
+  config::instance()->set_prefetch_memory_max((uint64_t)(memory_max_mb * 1024 * 1024));
+}
+
+// [[Rcpp::export]]
+void gc_set_budgets(int threads, double memory_mb) {
+  config::instance()->set_thread_budget(threads);
+  config::instance()->set_memory_budget((uint64_t)(memory_mb * 1024 * 1024));
+}
+
 // [[Rcpp::export]]
 int gc_detect_cores() {
   return std::thread::hardware_concurrency();
@@ -1705,48 +1875,38 @@ void gc_create_stac_collection(Rcpp::DataFrame bands, Rcpp::DataFrame images, Rc
     //std::shared_ptr<image_collection>* x = new std::shared_ptr<image_collection>();
     std::shared_ptr<image_collection> x = image_collection::create();
     
-    x->transaction_start();
+    // columns are converted once and inserted in bulk with prepared statements, indexes are built at the end
+    x->bulk_insert_start();
     
-    Rcpp::CharacterVector band_name =  bands["name"];
-    Rcpp::IntegerVector band_id = bands["id"];
-    for (int32_t i=0; i<bands.nrows(); ++i) {
-      x->insert_band(band_id[i], Rcpp::as<std::string>(band_name[i])); // TODO add further data if available
-    }
+    x->insert_bands(Rcpp::as<std::vector<uint32_t>>(bands["id"]), Rcpp::as<std::vector<std::string>>(bands["name"])); // TODO add further data if available
 
-    Rcpp::IntegerVector image_id = images["id"];
-    Rcpp::CharacterVector image_name = images["name"];
-    Rcpp::NumericVector image_left = images["left"];
-    Rcpp::NumericVector image_top = images["top"];
-    Rcpp::NumericVector image_bottom =images["bottom"];
-    Rcpp::NumericVector image_right =images["right"];
-    Rcpp::CharacterVector image_datetime = images["datetime"];
-    Rcpp::CharacterVector image_proj = images["proj"];
-    for (int32_t i=0; i<images.nrows(); ++i) {
-      x->insert_image(image_id[i], Rcpp::as<std::string>(image_name[i]), image_left[i], image_top[i],
-                         image_bottom[i], image_right[i], Rcpp::as<std::string>(image_datetime[i]), Rcpp::as<std::string>(image_proj[i]));
-    }
+    x->insert_images(Rcpp::as<std::vector<uint32_t>>(images["id"]),
+                     Rcpp::as<std::vector<std::string>>(images["name"]),
+                     Rcpp::as<std::vector<double>>(images["left"]),
+                     Rcpp::as<std::vector<double>>(images["top"]),
+                     Rcpp::as<std::vector<double>>(images["bottom"]),
+                     Rcpp::as<std::vector<double>>(images["right"]),
+                     Rcpp::as<std::vector<std::string>>(images["datetime"]),
+                     Rcpp::as<std::vector<std::string>>(images["proj"]));
 
-    Rcpp::IntegerVector gdalrefs_image_id = gdalrefs["image_id"];
-    Rcpp::IntegerVector gdalrefs_band_id = gdalrefs["band_id"];
-    Rcpp::CharacterVector gdalrefs_descriptor = gdalrefs["descriptor"];
-    Rcpp::IntegerVector gdalrefs_band_num = gdalrefs["band_num"];
-    for (int32_t i=0; i<gdalrefs.nrows(); ++i) {
-      x->insert_dataset(gdalrefs_image_id[i],gdalrefs_band_id[i], Rcpp::as<std::string>(gdalrefs_descriptor[i]), gdalrefs_band_num[i]);
+    if (images.containsElementNamed("footprint")) {
+      x->insert_image_footprints(Rcpp::as<std::vector<uint32_t>>(images["id"]),
+                                 Rcpp::as<std::vector<std::string>>(images["footprint"]));
     }
-    
+
+    x->insert_datasets(Rcpp::as<std::vector<uint32_t>>(gdalrefs["image_id"]),
+                       Rcpp::as<std::vector<uint32_t>>(gdalrefs["band_id"]),
+                       Rcpp::as<std::vector<std::string>>(gdalrefs["descriptor"]),
+                       Rcpp::as<std::vector<uint32_t>>(gdalrefs["band_num"]));
     
     if (image_md.nrows() > 0) {
-      for (int32_t i=0; i<image_md.nrows(); ++i) {
-        Rcpp::IntegerVector image_md_image_id = image_md["image_id"];
-        Rcpp::CharacterVector image_md_key = image_md["key"];
-        Rcpp::CharacterVector image_md_value = image_md["value"];
-        
-        x->insert_image_md(image_md_image_id[i], Rcpp::as<std::string>(image_md_key[i]), Rcpp::as<std::string>(image_md_value[i]));
-      }
+      x->insert_image_md(Rcpp::as<std::vector<uint32_t>>(image_md["image_id"]),
+                         Rcpp::as<std::vector<std::string>>(image_md["key"]),
+                         Rcpp::as<std::vector<std::string>>(image_md["value"]));
     }
     
     // TODO: add collection, image, and band metadata
-    x->transaction_end();
+    x->bulk_insert_end();
     
     x->write(outfile);
   }
@@ -23,6 +23,8 @@
 */
 #include "aggregate_time.h"
 
+#include "image_collection_cube.h"
+
 
 
 struct aggregator_time_slice_singleband {
@@ -280,6 +282,107 @@ struct sd_aggregtor_time_slice_singleband : public var_aggregtor_time_slice_sing
 
 namespace gdalcubes {
 
+std::shared_ptr<cube> aggregate_time_cube::rewrite_as_view() {
+    std::shared_ptr<image_collection_cube> icc = std::dynamic_pointer_cast<image_collection_cube>(_in_cube);
+    if (!icc) {
+        return nullptr;
+    }
+
+    aggregation::aggregation_type agg_in = icc->view()->aggregation_method();
+    aggregation::aggregation_type agg_out;
+    if (_in_func == "min") {
+        agg_out = aggregation::aggregation_type::AGG_MIN;
+    } else if (_in_func == "max") {
+        agg_out = aggregation::aggregation_type::AGG_MAX;
+    } else if (_in_func == "mean") {
+        agg_out = aggregation::aggregation_type::AGG_MEAN;
+    } else if (_in_func == "median") {
+        agg_out = aggregation::aggregation_type::AGG_MEDIAN;
+    } else if (_in_func == "count") {
+        agg_out = aggregation::aggregation_type::AGG_VALUE_COUNT;
+    } else {
+        return nullptr;  // sum, prod, var, and sd have no counterpart in data cube views
+    }
+
+    // min and max of cells that contain the min / max of images equal the min / max of all images, all
+    // other combinations are only equivalent if cells of the input cube contain at most one image per pixel
+    bool need_single_images = !(agg_in == agg_out && (agg_out == aggregation::aggregation_type::AGG_MIN || agg_out == aggregation::aggregation_type::AGG_MAX));
+    if (need_single_images && (agg_in == aggregation::aggregation_type::AGG_IMAGE_COUNT || agg_in == aggregation::aggregation_type::AGG_VALUE_COUNT)) {
+        return nullptr;
+    }
+
+    // time cells of the result must be composed of complete input cells, i.e., all boundaries must align and
+    // the first and last boundaries must be identical
+    std::shared_ptr<cube_view> vin = icc->view();
+    cube_view v = *vin;
+    v.set_t_axis(vin->t0(), vin->t1(), _dt);
+    v.aggregation_method() = agg_out;
+    if (v.nt() != _st_ref->nt() || v.nt() > vin->nt()) {
+        return nullptr;
+    }
+    for (uint32_t it = 0; it <= v.nt(); ++it) {
+        datetime t = v.datetime_at_index(it);
+        if (t != _st_ref->datetime_at_index(it)) {
+            return nullptr;
+        }
+        t.unit(vin->dt_unit());
+        if (t < vin->t0()) {
+            return nullptr;
+        }
+        uint32_t i = vin->index_at_datetime(t);
+        if (vin->datetime_at_index(i) != t) {
+            return nullptr;
+        }
+        if ((it == 0 && i != 0) || (it == v.nt() && i != vin->nt())) {
+            return nullptr;
+        }
+    }
+
+    if (need_single_images) {
+        bounds_st extent;
+        extent.s.left = vin->left();
+        extent.s.right = vin->right();
+        extent.s.bottom = vin->bottom();
+        extent.s.top = vin->top();
+        extent.t0 = vin->datetime_at_index(0);
+        extent.t1 = vin->datetime_at_index(vin->nt());
+        std::vector<image_collection::find_range_st_row> datasets = icc->collection()->find_range_st(extent, vin->srs(), std::vector<std::string>(), std::vector<std::string>{"gdalrefs.image_id"},
+                                                                                                  icc->image_md_filter(), icc->image_md_order());
+
+        // WGS84 bounding boxes of images per input time cell
+        duration dt_in = vin->dt();
+        std::map<int32_t, std::vector<bounds_2d<double>>> cells;
+        for (uint32_t i = 0; i < datasets.size(); ++i) {
+            if (i > 0 && datasets[i].image_id == datasets[i - 1].image_id) continue;
+            datetime t = datetime::from_string(datasets[i].datetime);
+            t.unit(vin->dt_unit());
+            int32_t it = (t - extent.t0) / dt_in;
+            if (it < 0 || it >= (int32_t)vin->nt()) continue;
+            bounds_2d<double> b;
+            b.left = datasets[i].left;
+            b.right = datasets[i].right;
+            b.bottom = datasets[i].bottom;
+            b.top = datasets[i].top;
+            std::vector<bounds_2d<double>> &c = cells[it];
+            for (uint32_t k = 0; k < c.size(); ++k) {
+                if (bounds_2d<double>::intersects(b, c[k])) {
+                    GCBS_DEBUG("aggregate_time_cube: cells of the input cube contain overlapping images, aggregation cannot be computed while reading images");
+                    return nullptr;
+                }
+            }
+            c.push_back(b);
+        }
+    }
+
+    std::shared_ptr<image_collection_cube> out = icc->with_view(v);
+    out->set_chunk_size(_chunk_size[0], _chunk_size[1], _chunk_size[2]);
+    if (out->bands().count() != _bands.count()) {
+        return nullptr;
+    }
+    GCBS_DEBUG("aggregate_time_cube: images are aggregated directly to time cells with duration " + _dt.to_string());
+    return out;
+}
+
 std::shared_ptr<chunk_data> aggregate_time_cube::read_chunk(chunkid_t id) {
     GCBS_TRACE("aggregate_time_cube::read_chunk(" + std::to_string(id) + ")");
     std::shared_ptr<chunk_data> out = std::make_shared<chunk_data>();
@@ -289,6 +392,26 @@ std::shared_ptr<chunk_data> aggregate_time_cube::read_chunk(chunkid_t id) {
 
     coords_nd<uint32_t, 3> size_tyx = chunk_size(id);
     coords_nd<uint32_t, 4> size_btyx = {uint32_t(_bands.count()), size_tyx[0], size_tyx[1], size_tyx[2]};
+
+    std::call_once(_view_cube_once, [this]() {
+        _view_cube = rewrite_as_view();
+    });
+    if (_view_cube) {
+        out = _view_cube->read_chunk(id);
+        if (_in_func == "count") {
+            // counts are zero instead of NAN if there is no data
+            if (out->empty()) {
+                out->size(size_btyx);
+                out->buf(std::calloc(size_btyx[0] * size_btyx[1] * size_btyx[2] * size_btyx[3], sizeof(double)));
+            } else {
+                double *begin = (double *)out->buf();
+                double *end = ((double *)out->buf()) + size_btyx[0] * size_btyx[1] * size_btyx[2] * size_btyx[3];
+                std::replace_if(begin, end, [](double v) { return std::isnan(v); }, 0.0);
+            }
+        }
+        return out;
+    }
+
     out->size(size_btyx);
 
     // Fill buffers accordingly
@@ -358,17 +481,12 @@ std::shared_ptr<chunk_data> aggregate_time_cube::read_chunk(chunkid_t id) {
         }
         else if (cube_stref::type_string(_in_cube->st_reference()) == "cube_stref_labeled_time") {
             auto p = std::dynamic_pointer_cast<cube_stref_labeled_time>(_in_cube->st_reference());
-            while (p->datetime_at_index(first) < t_cur) {
-                ++first;
-            }
-            if (p->datetime_at_index(first) >= t_next) {
+            std::pair<uint32_t, uint32_t> range = p->index_range(t_cur, t_next);
+            if (range.first == range.second) {
                 continue; // labeled time axis of input cube as a gap larger than new time duration of cells
             }
-            last = first;
-            while (p->datetime_at_index(last) < t_next) {
-                ++last;
-            }
-            --last;
+            first = range.first;
+            last = range.second - 1;
         }
         if (last < first) {
             // TODO: exception or empty time slice if labeled time axis?!
@@ -81,7 +81,7 @@ class aggregate_time_cube : public cube {
    public:
     aggregate_time_cube(std::shared_ptr<cube> in, std::string dt, std::string func = "mean") : cube(),_in_cube(in),
                                                                                                _in_func(func), _in_dt(dt),
-                                                                                               _dt() {
+                                                                                               _dt(), _view_cube(), _view_cube_once() {
 
 
         if (!(func == "min" ||
@@ -175,12 +175,24 @@ class aggregate_time_cube : public cube {
         return out;
     }
 
+    /**
+     * @brief Try to express this cube as an image collection cube with the temporal resolution of this cube
+     * @details If the input cube is an image_collection_cube and the aggregation can be computed equivalently while
+     * reading images (aligned time cells and an aggregation method of the data cube view with the same result), images
+     * are aggregated directly to the coarser time cells without building the finer input chunks.
+     * @return an equivalent cube, or nullptr if the aggregation cannot be rewritten
+     */
+    std::shared_ptr<cube> rewrite_as_view();
+
    private:
     std::shared_ptr<cube> _in_cube;
     std::string _in_func;
     std::string _in_dt;
 
     duration _dt;
+
+    std::shared_ptr<cube> _view_cube;
+    std::once_flag _view_cube_once;
 };
 }  // namespace gdalcubes
 
@@ -0,0 +1,225 @@
+/*
+    MIT License
+
+    Copyright (c) 2023 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#include "apply_time.h"
+
+#include <algorithm>
+
+#include "thread_pool.h"
+
+namespace gdalcubes {
+
+apply_time_cube::apply_time_cube(std::shared_ptr<cube> in, std::vector<std::pair<std::string, std::string>> op_bands,
+                                 std::vector<int32_t> lags, std::vector<std::string> names)
+    : cube(in->st_reference()->copy()), _in_cube(in), _op_bands(op_bands), _lags(lags), _names(names), _band_idx_in() {  // it is important to duplicate st reference here, otherwise changes will affect input cube as well
+    _chunk_size[0] = _in_cube->size_t();
+    _chunk_size[1] = _in_cube->chunk_size()[1];
+    _chunk_size[2] = _in_cube->chunk_size()[2];
+
+    if (_lags.empty()) {
+        _lags = std::vector<int32_t>(op_bands.size(), 1);
+    }
+    if (_lags.size() != op_bands.size()) {
+        GCBS_ERROR("size of lags is different to the number of operations");
+        throw std::string("ERROR in apply_time_cube::apply_time_cube(): size of lags is different to the number of operations");
+    }
+    if (!_names.empty() && _names.size() != op_bands.size()) {
+        GCBS_ERROR("size of names is different to the number of operations");
+        throw std::string("ERROR in apply_time_cube::apply_time_cube(): size of names is different to the number of operations");
+    }
+
+    for (uint16_t i = 0; i < op_bands.size(); ++i) {
+        std::string opstr = op_bands[i].first;
+        std::string bandstr = op_bands[i].second;
+        if (opstr != "cumsum" && opstr != "lag" && opstr != "diff" && opstr != "interpolate") {
+            GCBS_ERROR("Unknown time series operation '" + opstr + "'");
+            throw std::string("ERROR in apply_time_cube::apply_time_cube(): Unknown time series operation '" + opstr + "'");
+        }
+        if (opstr == "diff" && _lags[i] < 1) {
+            GCBS_ERROR("Lag of diff operation must be positive");
+            throw std::string("ERROR in apply_time_cube::apply_time_cube(): Lag of diff operation must be positive");
+        }
+        if (!in->bands().has(bandstr)) {
+            GCBS_ERROR("Input data cube has no band '" + bandstr + "'");
+            throw std::string("ERROR in apply_time_cube::apply_time_cube(): Input data cube has no band '" + bandstr + "'");
+        }
+
+        band b = in->bands().get(bandstr);
+        if (!_names.empty()) {
+            b.name = _names[i];
+        } else if ((opstr == "lag" || opstr == "diff") && _lags[i] != 1) {
+            b.name = b.name + "_" + (_lags[i] < 0 ? "lead" + std::to_string(-_lags[i]) : opstr + std::to_string(_lags[i]));
+        } else {
+            b.name = b.name + "_" + opstr;
+        }
+        if (_bands.has(b.name)) {
+            GCBS_ERROR("Duplicate output band '" + b.name + "'");
+            throw std::string("ERROR in apply_time_cube::apply_time_cube(): Duplicate output band '" + b.name + "'");
+        }
+        if (opstr == "cumsum" || opstr == "diff") {
+            // offsets do not add up / cancel out
+            b.offset = 0;
+        }
+        _bands.add(b);
+        _band_idx_in.push_back(in->bands().get_index(bandstr));
+    }
+}
+
+/*
+ * Operations on single time series x with n elements, results are written to y
+ */
+static void ts_cumsum(const double *x, uint32_t n, double *y) {
+    double s = 0;
+    for (uint32_t i = 0; i < n; ++i) {
+        if (std::isnan(x[i])) {
+            y[i] = NAN;
+        } else {
+            s += x[i];
+            y[i] = s;
+        }
+    }
+}
+
+static void ts_lag(const double *x, uint32_t n, int32_t k, double *y) {
+    for (int64_t i = 0; i < int64_t(n); ++i) {
+        int64_t j = i - k;
+        y[i] = (j >= 0 && j < int64_t(n)) ? x[j] : NAN;
+    }
+}
+
+static void ts_diff(const double *x, uint32_t n, int32_t k, double *y) {
+    uint32_t m = std::min(n, uint32_t(k));
+    std::fill(y, y + m, NAN);
+    for (uint32_t i = m; i < n; ++i) {
+        y[i] = x[i] - x[i - k];
+    }
+}
+
+static void ts_interpolate(const double *x, uint32_t n, const double *t, double *y) {
+    int64_t prev = -1;
+    for (uint32_t i = 0; i < n; ++i) {
+        if (std::isnan(x[i])) {
+            y[i] = NAN;
+            continue;
+        }
+        y[i] = x[i];
+        if (prev >= 0 && i - prev > 1) {
+            double slope = (x[i] - x[prev]) / (t[i] - t[prev]);
+            for (uint32_t j = prev + 1; j < i; ++j) {
+                y[j] = x[prev] + slope * (t[j] - t[prev]);
+            }
+        }
+        prev = i;
+    }
+}
+
+std::shared_ptr<chunk_data> apply_time_cube::read_chunk(chunkid_t id) {
+    GCBS_TRACE("apply_time_cube::read_chunk(" + std::to_string(id) + ")");
+    std::shared_ptr<chunk_data> out = std::make_shared<chunk_data>();
+    if (id >= count_chunks())
+        return out;  // chunk is outside of the view, we don't need to read anything.
+
+    coords_nd<uint32_t, 3> size_tyx = chunk_size(id);
+    uint32_t nt = size_tyx[0];
+    uint32_t nxy = size_tyx[1] * size_tyx[2];
+
+    std::vector<uint16_t> bands_in(_band_idx_in);
+    std::sort(bands_in.begin(), bands_in.end());
+    bands_in.erase(std::unique(bands_in.begin(), bands_in.end()), bands_in.end());
+    std::vector<int32_t> series_idx(_in_cube->size_bands(), -1);
+    for (uint16_t i = 0; i < bands_in.size(); ++i) {
+        series_idx[bands_in[i]] = i;
+    }
+
+    // read complete time series, time series of pixels are contiguous in the buffer
+    std::vector<double> series;
+    bool empty = true;
+    uint32_t ichunk = 0;
+    for (chunkid_t i = id; i < _in_cube->count_chunks(); i += _in_cube->count_chunks_x() * _in_cube->count_chunks_y()) {
+        std::shared_ptr<chunk_data> x = _in_cube->read_chunk(i);
+        if (!x->empty()) {
+            if (empty) {
+                series.assign(uint64_t(bands_in.size()) * nxy * nt, NAN);
+                empty = false;
+            }
+            uint32_t it0 = ichunk * _in_cube->chunk_size()[0];
+            for (uint16_t ib = 0; ib < bands_in.size(); ++ib) {
+                for (uint32_t it = 0; it < x->size()[1]; ++it) {
+                    const double *src = ((double *)x->buf()) + (uint64_t(bands_in[ib]) * x->size()[1] + it) * nxy;
+                    double *dst = series.data() + uint64_t(ib) * nxy * nt + it0 + it;
+                    for (uint32_t ixy = 0; ixy < nxy; ++ixy) {
+                        dst[uint64_t(ixy) * nt] = src[ixy];
+                    }
+                }
+            }
+        }
+        ++ichunk;
+    }
+    if (empty) {
+        return out;
+    }
+
+    std::vector<double> t(nt);
+    for (uint32_t it = 0; it < nt; ++it) {
+        t[it] = _st_ref->datetime_at_index(it).epoch_time();
+    }
+
+    coords_nd<uint32_t, 4> size_btyx = {uint32_t(_bands.count()), nt, size_tyx[1], size_tyx[2]};
+    out->size(size_btyx);
+    out->buf(std::calloc(size_btyx[0] * size_btyx[1] * size_btyx[2] * size_btyx[3], sizeof(double)));
+    double *obuf = (double *)out->buf();
+
+    const uint32_t block = 256;
+    thread_pool::instance()->parallel_for((nxy + block - 1) / block, [&](uint32_t iblock) {
+        std::vector<double> y(nt);
+        for (uint32_t ixy = iblock * block; ixy < std::min(nxy, (iblock + 1) * block); ++ixy) {
+            for (uint16_t ib = 0; ib < _bands.count(); ++ib) {
+                const double *x = series.data() + (uint64_t(series_idx[_band_idx_in[ib]]) * nxy + ixy) * nt;
+                const std::string &op = _op_bands[ib].first;
+                if (op == "cumsum") {
+                    ts_cumsum(x, nt, y.data());
+                } else if (op == "lag") {
+                    ts_lag(x, nt, _lags[ib], y.data());
+                } else if (op == "diff") {
+                    ts_diff(x, nt, _lags[ib], y.data());
+                } else {
+                    ts_interpolate(x, nt, t.data(), y.data());
+                }
+                double *dst = obuf + uint64_t(ib) * nt * nxy + ixy;
+                for (uint32_t it = 0; it < nt; ++it) {
+                    dst[uint64_t(it) * nxy] = y[it];
+                }
+            }
+        }
+    });
+
+    // check if chunk is completely NAN and if yes, return empty chunk
+    if (out->all_nan()) {
+        out = std::make_shared<chunk_data>();
+    }
+    return out;
+}
+
+}  // namespace gdalcubes
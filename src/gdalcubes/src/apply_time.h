@@ -0,0 +1,102 @@
+/*
+    MIT License
+
+    Copyright (c) 2023 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#ifndef APPLY_TIME_H
+#define APPLY_TIME_H
+
+#include "cube.h"
+
+namespace gdalcubes {
+
+/**
+ * @brief A data cube that applies built-in operations on pixel time series
+ *
+ * In contrast to stream_apply_time_cube, no external process is involved. Chunks of the output cube contain complete
+ * time series. Input chunks are rearranged such that time series of pixels are contiguous in memory and
+ * pixels are processed in parallel.
+ *
+ * Available operations are
+ * - "cumsum": cumulative sum, NAN values are skipped and remain NAN,
+ * - "lag": value k time steps before (k may be negative, i.e. values after the current time),
+ * - "diff": difference to the value k time steps before,
+ * - "interpolate": linear interpolation of NAN values between observations, using the dates of time slices.
+ */
+class apply_time_cube : public cube {
+   public:
+    /**
+     * @brief Create a data cube that applies built-in operations on pixel time series
+     * @note This static creation method should preferably be used instead of the constructors as
+     * the constructors will not set connections between cubes properly.
+     * @param in input data cube
+     * @param op_bands pairs of operation name and input band name, one output band for each pair
+     * @param lags number of time steps for "lag" and "diff" operations, either empty (defaults to 1) or of the same size as op_bands
+     * @param names output band names, either empty (names are derived from the operation and the input band) or of the same size as op_bands
+     * @return a shared pointer to the created data cube instance
+     */
+    static std::shared_ptr<apply_time_cube>
+    create(std::shared_ptr<cube> in, std::vector<std::pair<std::string, std::string>> op_bands,
+           std::vector<int32_t> lags = std::vector<int32_t>(), std::vector<std::string> names = std::vector<std::string>()) {
+        std::shared_ptr<apply_time_cube> out = std::make_shared<apply_time_cube>(in, op_bands, lags, names);
+        in->add_child_cube(out);
+        out->add_parent_cube(in);
+        return out;
+    }
+
+   public:
+    apply_time_cube(std::shared_ptr<cube> in, std::vector<std::pair<std::string, std::string>> op_bands,
+                    std::vector<int32_t> lags = std::vector<int32_t>(), std::vector<std::string> names = std::vector<std::string>());
+
+   public:
+    ~apply_time_cube() {}
+
+    std::shared_ptr<chunk_data> read_chunk(chunkid_t id) override;
+
+    json11::Json make_constructible_json() override {
+        json11::Json::object out;
+        out["cube_type"] = "apply_time";
+        json11::Json::array ob;
+        for (uint16_t i = 0; i < _op_bands.size(); ++i) {
+            ob.push_back(json11::Json::array({_op_bands[i].first, _op_bands[i].second}));
+        }
+        out["op_bands"] = ob;
+        out["lags"] = std::vector<int>(_lags.begin(), _lags.end());
+        out["names"] = _names;
+        out["in_cube"] = _in_cube->make_constructible_json();
+        return out;
+    }
+
+   private:
+    std::shared_ptr<cube> _in_cube;
+    std::vector<std::pair<std::string, std::string>> _op_bands;
+    std::vector<int32_t> _lags;
+    std::vector<std::string> _names;
+
+    // input band of each output band
+    std::vector<uint16_t> _band_idx_in;
+};
+
+}  // namespace gdalcubes
+
+#endif  // APPLY_TIME_H
@@ -24,10 +24,14 @@
 
 #include "collection_format.h"
 
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
 #include <fstream>
 #include <sstream>
 
 #include "filesystem.h"
+#include "thread_pool.h"
 
 namespace gdalcubes {
 
@@ -82,4 +86,174 @@ void collection_format::load_string(std::string jsonstr) {
     _j = json11::Json::parse(jsonstr, err);
 }
 
-}  // namespace gdalcubes
\ No newline at end of file
+// Index of the first character after a character class starting at p[i] == '['
+static size_t skip_char_class(const std::string& p, size_t i) {
+    size_t j = i + 1;
+    if (j < p.size() && p[j] == '^') ++j;
+    if (j < p.size() && p[j] == ']') ++j;  // leading ] is a literal
+    while (j < p.size() && p[j] != ']') {
+        if (p[j] == '\\') ++j;
+        ++j;
+    }
+    return j + 1;
+}
+
+std::vector<std::string> collection_format_matcher::required_literals(std::string p) {
+    std::vector<std::string> out;
+    if (p.find("(?i") != std::string::npos) {
+        return out;  // case-insensitive matching
+    }
+    std::string cur;
+    auto flush = [&out, &cur]() {
+        if (!cur.empty()) out.push_back(cur);
+        cur.clear();
+    };
+
+    size_t n = p.size();
+    size_t i = 0;
+    while (i < n) {
+        char c = p[i];
+        bool is_literal = false;
+        size_t next = i + 1;
+        if (c == '\\') {
+            if (i + 1 >= n) break;
+            char e = p[i + 1];
+            next = i + 2;
+            if (!std::isalnum((unsigned char)e)) {
+                is_literal = true;  // escaped special character
+                c = e;
+            } else if (e == 'Q') {
+                // quoted sequence, not evaluated
+                size_t j = p.find("\\E", next);
+                next = (j == std::string::npos) ? n : j + 2;
+            } else if (next < n && (p[next] == '{' || p[next] == '<') && std::string("xopPgkN").find(e) != std::string::npos) {
+                size_t j = p.find(p[next] == '{' ? '}' : '>', next);
+                next = (j == std::string::npos) ? n : j + 1;
+            } else if (e == 'x') {
+                while (next < n && next < i + 4 && std::isxdigit((unsigned char)p[next])) ++next;
+            } else if (std::isdigit((unsigned char)e) || e == 'g') {
+                while (next < n && std::isdigit((unsigned char)p[next])) ++next;
+            } else if (e == 'c' || e == 'p' || e == 'P') {
+                ++next;
+            }
+        } else if (c == '[') {
+            next = skip_char_class(p, i);
+        } else if (c == '(') {
+            int depth = 0;
+            size_t j = i;
+            while (j < n) {
+                if (p[j] == '\\') {
+                    j += 2;
+                    continue;
+                }
+                if (p[j] == '[') {
+                    j = skip_char_class(p, j);
+                    continue;
+                }
+                if (p[j] == '(') ++depth;
+                if (p[j] == ')' && --depth == 0) break;
+                ++j;
+            }
+            next = j + 1;
+        } else if (c == '|') {
+            return std::vector<std::string>();  // alternatives at the top level
+        } else if (c != '.' && c != '^' && c != '$' && c != ')') {
+            is_literal = true;
+        }
+
+        // quantifier of the current atom
+        bool optional = false;
+        bool repeated = false;
+        if (next < n) {
+            if (p[next] == '*' || p[next] == '?') {
+                optional = true;
+                ++next;
+            } else if (p[next] == '+') {
+                repeated = true;
+                ++next;
+            } else if (p[next] == '{') {
+                size_t j = p.find('}', next);
+                std::string q = (j == std::string::npos) ? "" : p.substr(next + 1, j - next - 1);
+                if (!q.empty() && q.find_first_not_of("0123456789,") == std::string::npos && std::isdigit((unsigned char)q[0])) {
+                    optional = std::atoi(q.c_str()) == 0;
+                    repeated = true;
+                    next = j + 1;
+                }
+            }
+            if ((optional || repeated) && next < n && (p[next] == '?' || p[next] == '+')) {
+                ++next;  // lazy or possessive quantifier
+            }
+        }
+
+        if (is_literal && !optional) {
+            cur += c;
+            if (repeated) flush();
+        } else {
+            flush();
+        }
+        i = next;
+    }
+    flush();
+    return out;
+}
+
+bool collection_format_matcher::pattern::may_match(const std::string& path) const {
+    for (uint16_t i = 0; i < literals.size(); ++i) {
+        if (path.find(literals[i]) == std::string::npos) {
+            return false;
+        }
+    }
+    return true;
+}
+
+collection_format_matcher::collection_format_matcher(collection_format& format) : _global(format.json()["pattern"].string_value()),
+                                                                                  _images(format.json()["images"]["pattern"].string_value()),
+                                                                                  _datetime(format.json()["datetime"]["pattern"].string_value()),
+                                                                                  _bands() {
+    for (auto it = format.json()["bands"].object_items().begin(); it != format.json()["bands"].object_items().end(); ++it) {
+        _bands.push_back(pattern(it->second["pattern"].string_value()));
+    }
+}
+
+collection_format_matcher::result collection_format_matcher::match(const std::string& path) const {
+    result r;
+    r.global = _global.empty || (_global.may_match(path) && boost::regex_match(path, _global.regex));
+    r.image = false;
+    r.datetime = false;
+    if (!r.global) {
+        return r;
+    }
+
+    boost::smatch res;
+    if (_images.may_match(path) && boost::regex_match(path, res, _images.regex)) {
+        r.image = true;
+        r.image_name = res[1].str();
+    }
+    if (_datetime.may_match(path) && boost::regex_match(path, res, _datetime.regex)) {
+        r.datetime = true;
+        r.datetime_str = res[1].str();
+    }
+    for (uint16_t i = 0; i < _bands.size(); ++i) {
+        if (_bands[i].may_match(path) && boost::regex_match(path, _bands[i].regex)) {
+            r.bands.push_back(i);
+        }
+    }
+    return r;
+}
+
+std::vector<collection_format_matcher::result> collection_format_matcher::match(const std::vector<std::string>& paths, uint16_t nthreads) const {
+    std::vector<result> out(paths.size());
+    const uint32_t batch_size = 1024;
+    uint32_t nbatches = (paths.size() + batch_size - 1) / batch_size;
+    thread_pool::instance()->parallel_for(
+        nbatches, [this, &paths, &out, batch_size](uint32_t b) {
+            uint32_t end = std::min(uint32_t(paths.size()), (b + 1) * batch_size);
+            for (uint32_t i = b * batch_size; i < end; ++i) {
+                out[i] = match(paths[i]);
+            }
+        },
+        nthreads);
+    return out;
+}
+
+}  // namespace gdalcubes
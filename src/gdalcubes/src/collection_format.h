@@ -25,7 +25,9 @@
 #ifndef COLLECTION_FORMAT_H
 #define COLLECTION_FORMAT_H
 
+#include <boost/regex.hpp>
 #include <string>
+#include <vector>
 
 #include "config.h"
 #include "external/json11/json11.hpp"
@@ -73,6 +75,69 @@ class collection_format {
     json11::Json _j;
 };
 
+/**
+ * Precompiled regular expressions of a collection format to classify many file paths at once.
+ *
+ * Each pattern is compiled once. Literal substrings that any full match of a pattern must contain are extracted from
+ * the pattern and checked before running the regular expression, such that most paths that do not match
+ * (e.g. the patterns of all other bands) are rejected with a simple substring search. Lists of paths are matched
+ * in parallel batches.
+ */
+class collection_format_matcher {
+   public:
+    /**
+     * Results of matching a single path against all patterns of a collection format
+     */
+    struct result {
+        bool global;               // matches the global pattern, true if the format has no global pattern
+        bool image;                // matches the image composition rule
+        std::string image_name;    // first capture group of the image pattern
+        bool datetime;             // matches the datetime rule
+        std::string datetime_str;  // first capture group of the datetime pattern
+        std::vector<uint16_t> bands;  // indexes of matching bands (in the order of the format's bands object), ascending
+    };
+
+    collection_format_matcher(collection_format& format);
+
+    /**
+     * Match a single path against all patterns, band, image, and datetime patterns are only evaluated
+     * if the path matches the global pattern.
+     */
+    result match(const std::string& path) const;
+
+    /**
+     * Match a list of paths in parallel batches
+     * @param paths list of paths
+     * @param nthreads maximum number of threads, 0 uses the default size of the thread pool
+     */
+    std::vector<result> match(const std::vector<std::string>& paths, uint16_t nthreads = 0) const;
+
+    /**
+     * @brief Extract literal substrings that every full match of a regular expression must contain
+     *
+     * The extraction is conservative, patterns with alternatives at the top level, case-insensitive flags, or
+     * unsupported constructs result in fewer (or no) literals.
+     * @param pattern regular expression in Perl syntax
+     * @return list of literal substrings
+     */
+    static std::vector<std::string> required_literals(std::string pattern);
+
+   private:
+    struct pattern {
+        pattern(std::string p) : empty(p.empty()), regex(p), literals(required_literals(p)) {}
+        bool empty;
+        boost::regex regex;
+        std::vector<std::string> literals;
+
+        bool may_match(const std::string& path) const;
+    };
+
+    pattern _global;
+    pattern _images;
+    pattern _datetime;
+    std::vector<pattern> _bands;
+};
+
 }  // namespace gdalcubes
 
 #endif  //COLLECTION_FORMAT_H
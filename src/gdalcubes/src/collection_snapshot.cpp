@@ -0,0 +1,426 @@
+/*
+    MIT License
+
+    Copyright (c) 2023 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#include "collection_snapshot.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+
+namespace gdalcubes {
+
+static const char SNAPSHOT_MAGIC[8] = {'G', 'C', 'B', 'S', 'S', 'N', 'A', 'P'};
+static const uint64_t SNAPSHOT_VERSION = 2;
+
+// All records have sizes of multiples of 8 bytes, such that all sections are aligned if the buffer is 8-byte aligned,
+// which is the case for the memory of std::vector<char> that the file is read into. The string table comes last and
+// also contains binary footprints, which are read byte-wise.
+
+struct collection_snapshot::header {
+    char magic[8];
+    uint64_t version;
+    uint64_t n_bands;
+    uint64_t n_images;
+    uint64_t n_gdalrefs;
+    uint64_t n_footprints;
+    uint64_t strings_size;
+    uint64_t image_md_filter;  // string offsets
+    uint64_t image_md_order;
+    uint64_t order_by;
+};
+
+struct collection_snapshot::band_record {
+    uint64_t name;
+    uint64_t unit;
+    uint64_t nodata;
+    double offset;
+    double scale;
+    uint32_t id;
+    int32_t type;
+    uint32_t image_count;
+    uint32_t reserved;
+};
+
+struct collection_snapshot::image_record {
+    double left;
+    double top;
+    double bottom;
+    double right;
+    uint64_t name;
+    uint64_t datetime;
+    uint64_t srs;
+    uint64_t md_order_value;
+    uint64_t footprint;       // string offset of WKB
+    uint64_t footprint_size;  // 0 if the image has no footprint
+    char t[24];               // %Y-%m-%dT%H:%M:%S, null-terminated
+    uint32_t id;
+    uint32_t first_gdalref;
+    uint32_t n_gdalrefs;
+    uint32_t md_order_null;
+};
+
+struct collection_snapshot::gdalref_record {
+    uint64_t descriptor;
+    uint32_t band;  // index in bands section
+    uint32_t band_num;
+};
+
+// Helper to build the string table, identical strings are stored only once
+class snapshot_strings {
+   public:
+    uint64_t add(const std::string& s) {
+        auto it = _offsets.find(s);
+        if (it != _offsets.end()) return it->second;
+        uint64_t off = _data.size();
+        _data.insert(_data.end(), s.begin(), s.end());
+        _data.push_back('\0');
+        _offsets[s] = off;
+        return off;
+    }
+    const std::vector<char>& data() {
+        return _data;
+    }
+
+   private:
+    std::vector<char> _data;
+    std::unordered_map<std::string, uint64_t> _offsets;
+};
+
+static std::string snapshot_md_filter_string(const std::vector<image_collection::image_md_predicate>& image_md_filter) {
+    std::string out;
+    for (uint16_t i = 0; i < image_md_filter.size(); ++i) {
+        if (i > 0) out += ";";
+        out += image_md_filter[i].to_string();
+    }
+    return out;
+}
+
+void collection_snapshot::write(std::string filename, const std::vector<image_collection::bands_row>& bands,
+                                const std::vector<image_collection::find_range_st_row>& rows,
+                                const std::unordered_map<uint32_t, std::string>& footprints,
+                                const std::vector<image_collection::image_md_predicate>& image_md_filter, std::string image_md_order,
+                                std::vector<std::string> order_by) {
+    snapshot_strings strings;
+
+    std::vector<band_record> b(bands.size());
+    std::unordered_map<std::string, uint32_t> band_index;
+    for (uint32_t i = 0; i < bands.size(); ++i) {
+        std::memset(&b[i], 0, sizeof(band_record));
+        b[i].name = strings.add(bands[i].name);
+        b[i].unit = strings.add(bands[i].unit);
+        b[i].nodata = strings.add(bands[i].nodata);
+        b[i].offset = bands[i].offset;
+        b[i].scale = bands[i].scale;
+        b[i].id = bands[i].id;
+        b[i].type = (int32_t)bands[i].type;
+        b[i].image_count = bands[i].image_count;
+        band_index[bands[i].name] = i;
+    }
+
+    std::vector<image_record> img;
+    std::vector<gdalref_record> ref(rows.size());
+    uint64_t n_footprints = 0;
+    for (uint32_t i = 0; i < rows.size(); ++i) {
+        if (img.empty() || img.back().id != rows[i].image_id) {
+            image_record r;
+            std::memset(&r, 0, sizeof(image_record));
+            r.left = rows[i].left;
+            r.top = rows[i].top;
+            r.bottom = rows[i].bottom;
+            r.right = rows[i].right;
+            r.name = strings.add(rows[i].image_name);
+            r.datetime = strings.add(rows[i].datetime);
+            r.srs = strings.add(rows[i].srs);
+            r.md_order_value = strings.add(rows[i].md_order_value);
+            std::string t = datetime::from_string(rows[i].datetime).to_string(datetime_unit::SECOND);
+            std::strncpy(r.t, t.c_str(), sizeof(r.t) - 1);
+            r.id = rows[i].image_id;
+            r.first_gdalref = i;
+            r.n_gdalrefs = 0;
+            r.md_order_null = rows[i].md_order_null ? 1 : 0;
+            auto fp = footprints.find(rows[i].image_id);
+            if (fp != footprints.end() && !fp->second.empty()) {
+                r.footprint = strings.add(fp->second);
+                r.footprint_size = fp->second.size();
+                ++n_footprints;
+            }
+            img.push_back(r);
+        }
+        img.back().n_gdalrefs++;
+
+        auto it = band_index.find(rows[i].band_name);
+        if (it == band_index.end()) {
+            throw std::string("ERROR in collection_snapshot::write(): unknown band '" + rows[i].band_name + "'");
+        }
+        ref[i].descriptor = strings.add(rows[i].descriptor);
+        ref[i].band = it->second;
+        ref[i].band_num = rows[i].band_num;
+    }
+
+    std::vector<uint32_t> time_index(img.size());
+    for (uint32_t i = 0; i < img.size(); ++i) time_index[i] = i;
+    std::stable_sort(time_index.begin(), time_index.end(), [&img](uint32_t a, uint32_t b) {
+        return std::strcmp(img[a].t, img[b].t) < 0;
+    });
+    if (time_index.size() % 2 == 1) time_index.push_back(0);  // padding
+
+    std::string order_by_str;
+    for (uint16_t i = 0; i < order_by.size(); ++i) {
+        if (i > 0) order_by_str += ",";
+        order_by_str += order_by[i];
+    }
+
+    header h;
+    std::memset(&h, 0, sizeof(header));
+    std::memcpy(h.magic, SNAPSHOT_MAGIC, 8);
+    h.version = SNAPSHOT_VERSION;
+    h.n_bands = b.size();
+    h.n_images = img.size();
+    h.n_gdalrefs = ref.size();
+    h.n_footprints = n_footprints;
+    h.image_md_filter = strings.add(snapshot_md_filter_string(image_md_filter));
+    h.image_md_order = strings.add(image_md_order);
+    h.order_by = strings.add(order_by_str);
+    h.strings_size = strings.data().size();
+
+    std::ofstream out(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        throw std::string("ERROR in collection_snapshot::write(): cannot create file '" + filename + "'");
+    }
+    out.write((const char*)&h, sizeof(header));
+    if (!b.empty()) out.write((const char*)b.data(), b.size() * sizeof(band_record));
+    if (!img.empty()) out.write((const char*)img.data(), img.size() * sizeof(image_record));
+    if (!time_index.empty()) out.write((const char*)time_index.data(), time_index.size() * sizeof(uint32_t));
+    if (!ref.empty()) out.write((const char*)ref.data(), ref.size() * sizeof(gdalref_record));
+    out.write(strings.data().data(), strings.data().size());
+    out.close();
+    if (out.fail()) {
+        throw std::string("ERROR in collection_snapshot::write(): failed to write file '" + filename + "'");
+    }
+}
+
+bool collection_snapshot::is_snapshot(std::string filename) {
+    std::ifstream in(filename, std::ios::in | std::ios::binary);
+    if (!in.is_open()) return false;
+    char magic[8];
+    in.read(magic, 8);
+    return in.gcount() == 8 && std::memcmp(magic, SNAPSHOT_MAGIC, 8) == 0;
+}
+
+collection_snapshot::collection_snapshot(std::string filename) : _buf(), _header(nullptr), _bands(nullptr), _images(nullptr), _time_index(nullptr), _gdalrefs(nullptr), _strings(nullptr) {
+    std::ifstream in(filename, std::ios::in | std::ios::binary | std::ios::ate);
+    if (!in.is_open()) {
+        throw std::string("ERROR in collection_snapshot::collection_snapshot(): cannot open file '" + filename + "'");
+    }
+    std::streamsize size = in.tellg();
+    in.seekg(0, std::ios::beg);
+    if (size < (std::streamsize)sizeof(header)) {
+        throw std::string("ERROR in collection_snapshot::collection_snapshot(): '" + filename + "' is not a valid collection snapshot");
+    }
+
+    // read the whole file at once, all records are then used in place
+    _buf.resize(size);
+    in.read(_buf.data(), size);
+    if (in.gcount() != size) {
+        throw std::string("ERROR in collection_snapshot::collection_snapshot(): failed to read file '" + filename + "'");
+    }
+
+    _header = (const header*)_buf.data();
+    if (std::memcmp(_header->magic, SNAPSHOT_MAGIC, 8) != 0 || _header->version != SNAPSHOT_VERSION) {
+        throw std::string("ERROR in collection_snapshot::collection_snapshot(): '" + filename + "' is not a valid collection snapshot or has been created by a different version");
+    }
+    uint64_t n_time_index = _header->n_images + (_header->n_images % 2);
+    uint64_t expected_size = sizeof(header) + _header->n_bands * sizeof(band_record) + _header->n_images * sizeof(image_record) +
+                             n_time_index * sizeof(uint32_t) + _header->n_gdalrefs * sizeof(gdalref_record) + _header->strings_size;
+    if (expected_size != (uint64_t)size) {
+        throw std::string("ERROR in collection_snapshot::collection_snapshot(): collection snapshot '" + filename + "' is corrupt");
+    }
+
+    const char* p = _buf.data() + sizeof(header);
+    _bands = (const band_record*)p;
+    p += _header->n_bands * sizeof(band_record);
+    _images = (const image_record*)p;
+    p += _header->n_images * sizeof(image_record);
+    _time_index = (const uint32_t*)p;
+    p += n_time_index * sizeof(uint32_t);
+    _gdalrefs = (const gdalref_record*)p;
+    p += _header->n_gdalrefs * sizeof(gdalref_record);
+    _strings = p;
+}
+
+std::vector<image_collection::find_range_st_row> collection_snapshot::find_range_st(bounds_2d<double> range, std::string t0, std::string t1,
+                                                                                    std::vector<std::string> bands,
+                                                                                    const std::vector<image_collection::image_md_predicate>& image_md_filter,
+                                                                                    std::string image_md_order, const OGRGeometry* range_poly) {
+    if (snapshot_md_filter_string(image_md_filter) != str(_header->image_md_filter) || image_md_order != str(_header->image_md_order)) {
+        throw std::string("ERROR in collection_snapshot::find_range_st(): collection snapshot has been created with different image metadata predicates or order");
+    }
+
+    std::vector<bool> use_band(_header->n_bands, bands.empty());
+    for (uint16_t i = 0; i < bands.size(); ++i) {
+        for (uint32_t ib = 0; ib < _header->n_bands; ++ib) {
+            if (bands[i] == str(_bands[ib].name)) use_band[ib] = true;
+        }
+    }
+
+    // binary search for the first image with datetime >= t0
+    const uint32_t* first = std::lower_bound(_time_index, _time_index + _header->n_images, t0, [this](uint32_t i, const std::string& t) {
+        return std::strcmp(_images[i].t, t.c_str()) < 0;
+    });
+    std::vector<uint32_t> img;
+    for (const uint32_t* it = first; it != _time_index + _header->n_images; ++it) {
+        const image_record& r = _images[*it];
+        if (std::strcmp(r.t, t1.c_str()) > 0) break;
+        if (r.right < range.left || r.left > range.right || r.bottom > range.top || r.top < range.bottom) continue;
+        if (range_poly && r.footprint_size > 0) {
+            OGRGeometry* geom = nullptr;
+            bool intersects = true;
+            if (OGRGeometryFactory::createFromWkb(str(r.footprint), nullptr, &geom, r.footprint_size) == OGRERR_NONE && geom) {
+                intersects = geom->Intersects(range_poly);
+            }
+            if (geom) OGRGeometryFactory::destroyGeometry(geom);
+            if (!intersects) continue;
+        }
+        img.push_back(*it);
+    }
+    // restore the order of the snapshot
+    std::sort(img.begin(), img.end());
+
+    std::vector<image_collection::find_range_st_row> out;
+    for (uint32_t i = 0; i < img.size(); ++i) {
+        const image_record& r = _images[img[i]];
+        for (uint32_t j = r.first_gdalref; j < r.first_gdalref + r.n_gdalrefs; ++j) {
+            const gdalref_record& g = _gdalrefs[j];
+            if (!use_band[g.band]) continue;
+            image_collection::find_range_st_row row;
+            row.image_id = r.id;
+            row.image_name = str(r.name);
+            row.descriptor = str(g.descriptor);
+            row.datetime = str(r.datetime);
+            row.band_name = str(_bands[g.band].name);
+            row.band_num = g.band_num;
+            row.srs = str(r.srs);
+            row.left = r.left;
+            row.top = r.top;
+            row.bottom = r.bottom;
+            row.right = r.right;
+            row.md_order_null = r.md_order_null != 0;
+            row.md_order_value = str(r.md_order_value);
+            out.push_back(row);
+        }
+    }
+    return out;
+}
+
+std::vector<image_collection::bands_row> collection_snapshot::get_bands() {
+    std::vector<image_collection::bands_row> out;
+    for (uint32_t i = 0; i < _header->n_bands; ++i) {
+        image_collection::bands_row b;
+        b.id = _bands[i].id;
+        b.name = str(_bands[i].name);
+        b.type = (GDALDataType)_bands[i].type;
+        b.offset = _bands[i].offset;
+        b.scale = _bands[i].scale;
+        b.unit = str(_bands[i].unit);
+        b.nodata = str(_bands[i].nodata);
+        b.image_count = _bands[i].image_count;
+        out.push_back(b);
+    }
+    return out;
+}
+
+std::vector<image_collection::images_row> collection_snapshot::get_images() {
+    std::vector<image_collection::images_row> out;
+    for (uint32_t i = 0; i < _header->n_images; ++i) {
+        image_collection::images_row r;
+        r.id = _images[i].id;
+        r.name = str(_images[i].name);
+        r.left = _images[i].left;
+        r.top = _images[i].top;
+        r.bottom = _images[i].bottom;
+        r.right = _images[i].right;
+        r.datetime = str(_images[i].datetime);
+        r.proj = str(_images[i].srs);
+        out.push_back(r);
+    }
+    return out;
+}
+
+std::vector<image_collection::gdalrefs_row> collection_snapshot::get_gdalrefs() {
+    std::vector<image_collection::gdalrefs_row> out;
+    for (uint32_t i = 0; i < _header->n_images; ++i) {
+        for (uint32_t j = _images[i].first_gdalref; j < _images[i].first_gdalref + _images[i].n_gdalrefs; ++j) {
+            image_collection::gdalrefs_row r;
+            r.image_id = _images[i].id;
+            r.band_id = _bands[_gdalrefs[j].band].id;
+            r.descriptor = str(_gdalrefs[j].descriptor);
+            r.band_num = _gdalrefs[j].band_num;
+            out.push_back(r);
+        }
+    }
+    return out;
+}
+
+uint32_t collection_snapshot::count_images() {
+    return _header->n_images;
+}
+
+uint32_t collection_snapshot::count_gdalrefs() {
+    return _header->n_gdalrefs;
+}
+
+bool collection_snapshot::has_footprints() {
+    return _header->n_footprints > 0;
+}
+
+std::unordered_map<uint32_t, std::string> collection_snapshot::get_image_footprints(const std::vector<uint32_t>& image_id) {
+    std::unordered_map<uint32_t, uint32_t> index;
+    for (uint32_t i = 0; i < _header->n_images; ++i) {
+        index[_images[i].id] = i;
+    }
+    std::unordered_map<uint32_t, std::string> out;
+    for (uint32_t i = 0; i < image_id.size(); ++i) {
+        auto it = index.find(image_id[i]);
+        if (it == index.end() || _images[it->second].footprint_size == 0) continue;
+        out[image_id[i]] = std::string(str(_images[it->second].footprint), _images[it->second].footprint_size);
+    }
+    return out;
+}
+
+std::vector<std::string> collection_snapshot::order_by() {
+    std::vector<std::string> out;
+    std::string s = str(_header->order_by);
+    std::size_t start = 0;
+    while (start < s.size()) {
+        std::size_t end = s.find(',', start);
+        if (end == std::string::npos) end = s.size();
+        out.push_back(s.substr(start, end - start));
+        start = end + 1;
+    }
+    return out;
+}
+
+}  // namespace gdalcubes
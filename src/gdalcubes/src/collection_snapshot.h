@@ -0,0 +1,138 @@
+/*
+    MIT License
+
+    Copyright (c) 2023 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#ifndef COLLECTION_SNAPSHOT_H
+#define COLLECTION_SNAPSHOT_H
+
+#include <ogr_geometry.h>
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "image_collection.h"
+
+namespace gdalcubes {
+
+/**
+ * @brief Immutable binary snapshot of the part of an image collection needed by a data cube
+ *
+ * A snapshot stores bands, images, and GDAL dataset references of all images found by image_collection::find_range_st()
+ * for a given spatiotemporal range, bands, and image metadata predicates. The file consists of fixed-size records and
+ * a string table and can be used directly after reading it into (or mapping it to) memory, without any parsing and
+ * without SQLite. Snapshots are used to start worker processes, which only need to answer find_range_st() queries for
+ * chunks of a single data cube.
+ *
+ * Images are additionally indexed by their datetime, such that queries only iterate over images of the requested
+ * time range. Valid data footprints of images are stored as WKB and tested against the query range of each chunk.
+ * Records use the byte order of the machine that wrote the snapshot.
+ */
+class collection_snapshot {
+   public:
+    /**
+     * @brief Load a snapshot from a file
+     * @param filename path to the snapshot file
+     */
+    collection_snapshot(std::string filename);
+
+    /**
+     * @brief Write a snapshot to a file
+     * @param filename output path
+     * @param bands all bands of the collection
+     * @param rows result of image_collection::find_range_st(), rows of the same image must be consecutive
+     * @param footprints WKB footprints by image id, see image_collection::get_image_footprints()
+     * @param image_md_filter predicates used to create rows
+     * @param image_md_order image metadata key used to sort rows
+     * @param order_by columns used to sort rows
+     */
+    static void write(std::string filename, const std::vector<image_collection::bands_row>& bands,
+                      const std::vector<image_collection::find_range_st_row>& rows,
+                      const std::unordered_map<uint32_t, std::string>& footprints,
+                      const std::vector<image_collection::image_md_predicate>& image_md_filter, std::string image_md_order,
+                      std::vector<std::string> order_by);
+
+    /**
+     * @brief Check whether a file is a collection snapshot
+     */
+    static bool is_snapshot(std::string filename);
+
+    /**
+     * @brief Find all rows of images intersecting with a spatiotemporal range, in the order of the snapshot
+     * @param range spatial range in WGS84
+     * @param t0 start datetime as %Y-%m-%dT%H:%M:%S string
+     * @param t1 end datetime as %Y-%m-%dT%H:%M:%S string
+     * @param bands names of bands, if empty all bands are considered
+     * @param image_md_filter must be identical to the predicates used to create the snapshot
+     * @param image_md_order must be identical to the key used to create the snapshot
+     * @param range_poly polygon of the range in WGS84, images whose footprint does not intersect it are skipped; if null, footprints are ignored
+     */
+    std::vector<image_collection::find_range_st_row> find_range_st(bounds_2d<double> range, std::string t0, std::string t1,
+                                                                   std::vector<std::string> bands,
+                                                                   const std::vector<image_collection::image_md_predicate>& image_md_filter,
+                                                                   std::string image_md_order, const OGRGeometry* range_poly = nullptr);
+
+    std::vector<image_collection::bands_row> get_bands();
+    std::vector<image_collection::images_row> get_images();
+    std::vector<image_collection::gdalrefs_row> get_gdalrefs();
+
+    uint32_t count_images();
+    uint32_t count_gdalrefs();
+
+    /**
+     * @brief Check whether the snapshot contains footprints of (some) images
+     */
+    bool has_footprints();
+
+    /**
+     * @brief Get footprints of images, see image_collection::get_image_footprints()
+     */
+    std::unordered_map<uint32_t, std::string> get_image_footprints(const std::vector<uint32_t>& image_id);
+
+    /**
+     * @brief Columns used to sort rows of the snapshot, see image_collection::find_range_st()
+     */
+    std::vector<std::string> order_by();
+
+   private:
+    struct header;
+    struct band_record;
+    struct image_record;
+    struct gdalref_record;
+
+    std::vector<char> _buf;
+    const header* _header;
+    const band_record* _bands;
+    const image_record* _images;
+    const uint32_t* _time_index;  // image indexes ordered by datetime
+    const gdalref_record* _gdalrefs;
+    const char* _strings;
+
+    inline const char* str(uint64_t offset) const { return _strings + offset; }
+};
+
+}  // namespace gdalcubes
+
+#endif  //COLLECTION_SNAPSHOT_H
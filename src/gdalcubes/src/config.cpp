@@ -31,7 +31,14 @@
 #include <gdal_priv.h>
 #include <ogr_geometry.h>
 
+#include <algorithm>
+#include <limits>
+
 #include "cube.h"
+#include "dataset_pool.h"
+#include "prefetch.h"
+#include "resample.h"
+#include "thread_pool.h"
 
 namespace gdalcubes {
 
@@ -46,7 +53,14 @@ config::config() : _chunk_processor(std::make_shared<chunk_processor_singlethrea
                    _swarm_curl_verbose(false),
                    _gdal_num_threads(1),
                    _gdal_use_overviews(true),
+                   _prefetch_depth(2),
+                   _prefetch_memory_max(1024 * 1024 * 256),  // 256 MiB
+                   _thread_budget(0),
+                   _memory_budget(0),
                    _streaming_dir(filesystem::get_tempdir()),
+                   _archive_cache_dir(""),
+                   _remote_cache_dir(""),
+                   _remote_cache_max(uint64_t(1024) * 1024 * 1024 * 10),  // 10 GiB
                    _collection_format_preset_dirs() {}
 
 version_info config::get_version_info() {
@@ -89,7 +103,49 @@ void config::set_gdal_log(std::string logfile) {
 
 void config::set_gdal_num_threads(uint16_t threads) {
     _gdal_num_threads = threads;
-    CPLSetConfigOption("GDAL_NUM_THREADS", std::to_string(_gdal_num_threads).c_str());
+    CPLSetConfigOption("GDAL_NUM_THREADS", std::to_string(get_gdal_num_threads_per_worker()).c_str());
+}
+
+void config::set_thread_budget(uint16_t threads) {
+    _thread_budget = threads;
+    apply_budgets();
+}
+
+void config::set_memory_budget(uint64_t size_bytes) {
+    _memory_budget = size_bytes;
+    apply_budgets();
+}
+
+uint16_t config::get_gdal_num_threads_per_worker() {
+    if (_thread_budget == 0) {
+        return _gdal_num_threads;
+    }
+    uint32_t nworker = _chunk_processor ? _chunk_processor->max_threads() : 1;
+    if (nworker == 0) nworker = 1;
+    return std::max(uint32_t(1), _thread_budget / nworker);
+}
+
+uint64_t config::get_warp_memory_per_worker() {
+    if (_memory_budget == 0) {
+        return 0;
+    }
+    uint32_t nworker = _chunk_processor ? _chunk_processor->max_threads() : 1;
+    if (nworker == 0) nworker = 1;
+    return (_memory_budget / 2) / nworker;
+}
+
+void config::apply_budgets() {
+    thread_pool::instance()->set_default_size(_thread_budget);
+    if (_thread_budget > 0) {
+        if (_chunk_processor && _chunk_processor->max_threads() > _thread_budget) {
+            GCBS_WARN("Number of parallel chunk workers (" + std::to_string(_chunk_processor->max_threads()) + ") exceeds the thread budget (" + std::to_string(_thread_budget) + ")");
+        }
+        CPLSetConfigOption("GDAL_NUM_THREADS", std::to_string(get_gdal_num_threads_per_worker()).c_str());
+    }
+    if (_memory_budget > 0) {
+        GDALSetCacheMax64(_memory_budget / 2);
+        _gdal_cache_max = (uint32_t)std::min(_memory_budget / 2, uint64_t(std::numeric_limits<uint32_t>::max()));
+    }
 }
 
 void config::gdal_err_handler_default(CPLErr eErrClass, int err_no, const char *msg) {
@@ -131,7 +187,8 @@ void config::gdalcubes_init() {
     GDALSetCacheMax(_gdal_cache_max);
     CPLSetConfigOption("GDAL_PAM_ENABLED", "NO");  // avoid aux files for PNG tiles
 
-    CPLSetConfigOption("GDAL_NUM_THREADS", std::to_string(_gdal_num_threads).c_str());
+    CPLSetConfigOption("GDAL_NUM_THREADS", std::to_string(get_gdal_num_threads_per_worker()).c_str());
+    apply_budgets();
     //srand(time(NULL)); // R will complain if calling srand...
     CPLSetErrorHandler(config::gdal_err_handler_default);
 
@@ -182,6 +239,11 @@ void config::gdalcubes_cleanup() {
 #ifndef GDALCUBES_NO_SWARM
     curl_global_cleanup();
 #endif
+    prefetch_queue::instance()->clear();
+    thread_pool::instance()->clear();
+    gdal_dataset_pool::instance()->clear();
+    archive_listing_cache::instance()->clear();
+    gather_map_cache::instance()->clear();
     GDALDestroyDriverManager();
     OGRCleanupAll();
 }
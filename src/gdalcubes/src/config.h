@@ -100,6 +100,7 @@ class config {
     }
     inline void set_default_chunk_processor(std::shared_ptr<chunk_processor> p) {
         _chunk_processor = p;
+        apply_budgets();
     }
 
     inline void set_default_progress_bar(std::shared_ptr<progress> p) {
@@ -131,6 +132,21 @@ class config {
     inline bool get_gdal_use_overviews() { return _gdal_use_overviews; }
     inline void set_gdal_use_overviews(bool use_overviews) { _gdal_use_overviews = use_overviews; }
 
+    /**
+     * @brief Set the number of chunks for which source data is prefetched asynchronously
+     * @param depth look-ahead depth, 0 disables prefetching
+     */
+    inline void set_prefetch_depth(uint16_t depth) { _prefetch_depth = depth; }
+    inline uint16_t get_prefetch_depth() { return _prefetch_depth; }
+
+    /**
+     * @brief Set the maximum size of source windows that are prefetched but not yet read
+     * @details Prefetched windows are held in GDAL's caches rather than by gdalcubes, the limit bounds the look-ahead only
+     * @param size_bytes limit in bytes
+     */
+    inline void set_prefetch_memory_max(uint64_t size_bytes) { _prefetch_memory_max = size_bytes; }
+    inline uint64_t get_prefetch_memory_max() { return _prefetch_memory_max; }
+
     inline bool get_swarm_curl_verbose() { return _swarm_curl_verbose; }
     inline void set_swarm_curl_verbose(bool verbose) { _swarm_curl_verbose = verbose; }
 
@@ -139,6 +155,20 @@ class config {
     inline std::string get_streaming_dir() { return _streaming_dir; }
     inline void set_streaming_dir(std::string dir) { _streaming_dir = dir; }
 
+    // Get / set directory where listings of archive files are cached across sessions, see
+    // archive_listing_cache. If empty, listings are only cached in memory.
+    inline std::string get_archive_cache_dir() { return _archive_cache_dir; }
+    inline void set_archive_cache_dir(std::string dir) { _archive_cache_dir = dir; }
+
+    // Get / set directory where blocks of remote source files (e.g. /vsicurl/, /vsis3/) are cached
+    // across sessions and processes, see remote_block_cache. If empty, remote files are read directly.
+    inline std::string get_remote_cache_dir() { return _remote_cache_dir; }
+    inline void set_remote_cache_dir(std::string dir) { _remote_cache_dir = dir; }
+
+    // Get / set the maximum size of the remote block cache in bytes
+    inline uint64_t get_remote_cache_max() { return _remote_cache_max; }
+    inline void set_remote_cache_max(uint64_t size_bytes) { _remote_cache_max = size_bytes; }
+
     inline bool get_gdal_debug() { return _gdal_debug; }
     void set_gdal_debug(bool debug);
 
@@ -147,6 +177,36 @@ class config {
 
     inline uint16_t get_gdal_num_threads() { return _gdal_num_threads; }
 
+    /**
+     * @brief Set the total number of threads of this process
+     *
+     * The budget is split between parallel chunk workers of the default chunk processor and
+     * GDAL's internal threads (e.g. for warping), such that cores are not oversubscribed.
+     * @param threads total number of threads, 0 disables the budget and uses set_gdal_num_threads() as is
+     */
+    void set_thread_budget(uint16_t threads);
+    inline uint16_t get_thread_budget() { return _thread_budget; }
+
+    /**
+     * @brief Set the memory budget of this process
+     *
+     * Half of the budget is used for GDAL's (global) block cache, the other half is split
+     * among parallel chunk workers and limits the working memory of their warp operations.
+     * @param size_bytes memory budget in bytes, 0 disables the budget and uses set_gdal_cache_max() as is
+     */
+    void set_memory_budget(uint64_t size_bytes);
+    inline uint64_t get_memory_budget() { return _memory_budget; }
+
+    /**
+     * @brief Get the number of threads GDAL may use within a single chunk worker
+     */
+    uint16_t get_gdal_num_threads_per_worker();
+
+    /**
+     * @brief Get the working memory limit of warp operations within a single chunk worker in bytes, 0 means GDAL's default
+     */
+    uint64_t get_warp_memory_per_worker();
+
     /**
      * @brief Global gdalcubes library initialization function
      */
@@ -197,7 +257,16 @@ class config {
     uint16_t _gdal_num_threads;
     bool _gdal_debug;
     bool _gdal_use_overviews;
+    uint16_t _prefetch_depth;
+    uint64_t _prefetch_memory_max;
+    uint16_t _thread_budget;
+    uint64_t _memory_budget;
+
+    void apply_budgets();
     std::string _streaming_dir;
+    std::string _archive_cache_dir;
+    std::string _remote_cache_dir;
+    uint64_t _remote_cache_max;
     std::vector<std::string> _collection_format_preset_dirs;
 
    private:
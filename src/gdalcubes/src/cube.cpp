@@ -34,6 +34,10 @@ SOFTWARE.
 
 #include "build_info.h"
 #include "filesystem.h"
+#include "remote_cache.h"
+#include "thread_pool.h"
+#include "timer.h"
+#include "utils.h"
 
 #if defined(R_PACKAGE) && defined(__sun) && defined(__SVR4)
 #define USE_NCDF4 0
@@ -1700,39 +1704,75 @@ void cube::write_chunks_netcdf(std::string dir, std::string name, uint8_t compre
     prg->finalize();
 }
 
+/*
+ * Report how well chunk workers and GDAL threads utilized the CPU. If the CPU time of chunk workers
+ * is much lower than their real elapsed time, workers wait for I/O or locks (e.g. GDAL's global block cache mutex),
+ * which may be improved by adjusting the thread and memory budgets (see config::set_thread_budget()).
+ */
+static void log_chunk_processing_stats(uint32_t nchunks, uint32_t nworker, double t_real, double t_worker, double t_cpu) {
+    std::string cpu_str = "unknown";
+    if (t_cpu >= 0 && t_worker > 0) {
+        cpu_str = utils::dbl_to_string(100 * t_cpu / t_worker, 3) + "%";
+    }
+    GCBS_DEBUG("Processed " + std::to_string(nchunks) + " chunks in " + utils::dbl_to_string(t_real, 4) + "s using " +
+               std::to_string(nworker) + " chunk worker(s) with up to " + std::to_string(config::instance()->get_gdal_num_threads_per_worker()) +
+               " GDAL thread(s) each; CPU utilization of chunk workers: " + cpu_str +
+               "; GDAL block cache: " + std::to_string(GDALGetCacheUsed64() / (1024 * 1024)) + " of " + std::to_string(GDALGetCacheMax64() / (1024 * 1024)) + " MiB used");
+    remote_block_cache::cache_stats rc = remote_block_cache::instance()->stats();
+    if (rc.hits + rc.misses > 0) {
+        GCBS_DEBUG("Remote block cache (since start of process): " + std::to_string(rc.hits) + " hit(s), " + std::to_string(rc.misses) +
+                   " miss(es), hit rate " + utils::dbl_to_string(100.0 * (double)rc.hits / (double)(rc.hits + rc.misses), 3) + "%; " +
+                   std::to_string(rc.bytes_hit / (1024 * 1024)) + " MiB read from cache, " + std::to_string(rc.bytes_fetched / (1024 * 1024)) + " MiB fetched");
+    }
+}
+
 void chunk_processor_singlethread::apply(std::shared_ptr<cube> c,
                                          std::function<void(chunkid_t, std::shared_ptr<chunk_data>, std::mutex &)> f) {
     std::mutex mutex;
     uint32_t nchunks = c->count_chunks();
+    timer t;
+    double t_cpu = timer::thread_cpu_time();
     for (uint32_t i = 0; i < nchunks; ++i) {
         std::shared_ptr<chunk_data> dat = c->read_chunk(i);
         f(i, dat, mutex);
     }
+    double t_real = t.time();
+    if (t_cpu >= 0) t_cpu = timer::thread_cpu_time() - t_cpu;
+    log_chunk_processing_stats(nchunks, 1, t_real, t_real, t_cpu);
 }
 
 void chunk_processor_multithread::apply(std::shared_ptr<cube> c,
                                         std::function<void(chunkid_t, std::shared_ptr<chunk_data>, std::mutex &)> f) {
     std::mutex mutex;
-    std::vector<std::thread> workers;
-    for (uint16_t it = 0; it < _nthreads; ++it) {
-        workers.push_back(std::thread([this, &c, f, it, &mutex](void) {
-            for (uint32_t i = it; i < c->count_chunks(); i += _nthreads) {
-                try {
-                    std::shared_ptr<chunk_data> dat = c->read_chunk(i);
-                    f(i, dat, mutex);
-                } catch (std::string s) {
-                    GCBS_ERROR(s);
-                    continue;
-                } catch (...) {
-                    GCBS_ERROR("unexpected exception while processing chunk " + std::to_string(i));
-                    continue;
-                }
+    uint32_t nchunks = c->count_chunks();
+    std::vector<double> t_worker(nchunks, 0);
+    std::vector<double> t_cpu(nchunks, 0);
+    timer t;
+    // chunks are distributed dynamically among at most _nthreads threads of the global thread pool
+    thread_pool::instance()->parallel_for(
+        nchunks, [&c, &f, &mutex, &t_worker, &t_cpu](uint32_t i) {
+            timer tw;
+            double cpu_start = timer::thread_cpu_time();
+            try {
+                std::shared_ptr<chunk_data> dat = c->read_chunk(i);
+                f(i, dat, mutex);
+            } catch (std::string s) {
+                GCBS_ERROR(s);
+            } catch (...) {
+                GCBS_ERROR("unexpected exception while processing chunk " + std::to_string(i));
             }
-        }));
-    }
-    for (uint16_t it = 0; it < _nthreads; ++it) {
-        workers[it].join();
+            t_worker[i] = tw.time();
+            t_cpu[i] = (cpu_start >= 0) ? timer::thread_cpu_time() - cpu_start : -1;
+        },
+        _nthreads);
+
+    double t_worker_sum = 0;
+    double t_cpu_sum = 0;
+    for (uint32_t i = 0; i < nchunks; ++i) {
+        t_worker_sum += t_worker[i];
+        t_cpu_sum = (t_cpu[i] < 0 || t_cpu_sum < 0) ? -1 : t_cpu_sum + t_cpu[i];
     }
+    log_chunk_processing_stats(nchunks, _nthreads, t.time(), t_worker_sum, t_cpu_sum);
 }
 
 
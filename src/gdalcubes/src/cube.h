@@ -877,6 +877,19 @@ class cube : public std::enable_shared_from_this<cube> {
         _pre.push_back(std::weak_ptr<cube>(c));
     }
 
+    /**
+     * @brief Get all data cubes this cube directly depends on
+     * @return input data cubes that still exist
+     */
+    inline std::vector<std::shared_ptr<cube>> parent_cubes() {
+        std::vector<std::shared_ptr<cube>> out;
+        for (uint16_t i = 0; i < _pre.size(); ++i) {
+            std::shared_ptr<cube> p = _pre[i].lock();
+            if (p) out.push_back(p);
+        }
+        return out;
+    }
+
     /**
      * @brief Add a child data cube to keep track of cubes connections
      * @param c derived data cube
@@ -29,6 +29,7 @@
 #include "aggregate_time.h"
 #include "aggregate_space.h"
 #include "apply_pixel.h"
+#include "apply_time.h"
 #include "crop.h"
 #include "dummy.h"
 #include "external/json11/json11.hpp"
@@ -39,7 +40,9 @@
 #include "filter_pixel.h"
 #include "image_collection_cube.h"
 #include "join_bands.h"
+#include "kernel_plugin.h"
 #include "ncdf_cube.h"
+#include "predict_pixel.h"
 #include "reduce_time.h"
 #include "reduce_space.h"
 #include "rename_bands.h"
@@ -53,6 +56,7 @@
 #include "stream_apply_time.h"
 #include "stream_reduce_space.h"
 #include "stream_reduce_time.h"
+#include "window_space.h"
 #include "window_time.h"
 
 namespace gdalcubes {
@@ -122,6 +126,25 @@ void cube_factory::register_default() {
                                                 j["win_size_l"].int_value(), j["win_size_r"].int_value());
             }
         }));
+    cube_generators.insert(std::make_pair<std::string, std::function<std::shared_ptr<cube>(json11::Json&)>>(
+        "window_space", [](json11::Json& j) {
+            std::string pad = j["pad"].is_null() ? "NA" : j["pad"].string_value();
+            if (!j["kernel"].is_null()) {
+                std::vector<double> kernel;
+                for (uint16_t i = 0; i < j["kernel"].array_items().size(); ++i) {
+                    kernel.push_back(j["kernel"][i].number_value());
+                }
+                return window_space_cube::create(instance()->create_from_json(j["in_cube"]), kernel,
+                                                 j["win_size_y"].int_value(), j["win_size_x"].int_value(), pad, j["pad_fill"].number_value());
+            } else {
+                std::vector<std::pair<std::string, std::string>> band_reducers;
+                for (uint16_t i = 0; i < j["reducer_bands"].array_items().size(); ++i) {
+                    band_reducers.push_back(std::make_pair(j["reducer_bands"][i][0].string_value(), j["reducer_bands"][i][1].string_value()));
+                }
+                return window_space_cube::create(instance()->create_from_json(j["in_cube"]), band_reducers,
+                                                 j["win_size_y"].int_value(), j["win_size_x"].int_value(), pad, j["pad_fill"].number_value());
+            }
+        }));
     cube_generators.insert(std::make_pair<std::string, std::function<std::shared_ptr<cube>(json11::Json&)>>(
         "select_bands", [](json11::Json& j) {
             std::vector<std::string> bands;
@@ -293,35 +316,36 @@ void cube_factory::register_default() {
 
     cube_generators.insert(std::make_pair<std::string, std::function<std::shared_ptr<cube>(json11::Json&)>>(
         "image_collection", [](json11::Json& j) {
-            if (!filesystem::exists(j["file"].string_value())) {
+            // prefer a snapshot of the collection, if available (e.g. for worker processes)
+            std::string file = j["file"].string_value();
+            if (!j["snapshot"].is_null() && filesystem::exists(j["snapshot"].string_value())) {
+                file = j["snapshot"].string_value();
+            }
+            if (!filesystem::exists(file)) {
                 throw std::string("ERROR in cube_generators[\"image_collection\"](): image collection file does not exist.");
             }
             cube_view v = cube_view::read_json_string(j["view"].dump());
-            auto x = image_collection_cube::create(j["file"].string_value(), v);
+            auto x = image_collection_cube::create(file, v);
             x->set_chunk_size(j["chunk_size"][0].int_value(), j["chunk_size"][1].int_value(), j["chunk_size"][2].int_value());
 
             if (!j["mask"].is_null()) {
-                if (j["mask"]["mask_type"].is_null()) {
-                    GCBS_WARN("ERROR in cube_generators[\"image_collection\"](): missing mask type, mask will be ignored");
+                std::shared_ptr<image_mask> mask = image_mask::from_json(j["mask"]);
+                if (mask) {
+                    x->set_mask(j["mask_band"].string_value(), mask);
                 } else {
-                    std::string mask_type = j["mask"]["mask_type"].string_value();
-                    std::vector<uint8_t> bits;
-                    for (uint16_t i = 0; i < j["mask"]["bits"].array_items().size(); ++i) {
-                        bits.push_back(j["mask"]["bits"][i].int_value());
-                    }
-                    if (mask_type == "value_mask") {
-                        std::unordered_set<double> vals;
-                        for (uint16_t i = 0; i < j["mask"]["values"].array_items().size(); ++i) {
-                            vals.insert(j["mask"]["values"][i].number_value());
-                        }
-                        x->set_mask(j["mask_band"].string_value(), std::make_shared<value_mask>(vals, j["mask"]["invert"].bool_value(), bits));
-                    } else if (mask_type == "range_mask") {
-                        x->set_mask(j["mask_band"].string_value(), std::make_shared<range_mask>(j["mask"]["min"].number_value(), j["mask"]["max"].number_value(), j["mask"]["invert"].bool_value(), bits));
-                    } else {
-                        GCBS_WARN("ERROR in cube_generators[\"image_collection\"](): invalid mask type, mask will be ignored");
-                    }
+                    GCBS_WARN("ERROR in cube_generators[\"image_collection\"](): invalid mask, mask will be ignored");
                 }
             }
+            if (!j["image_md_filter"].is_null()) {
+                std::vector<image_collection::image_md_predicate> filter;
+                for (uint16_t i = 0; i < j["image_md_filter"].array_items().size(); ++i) {
+                    filter.push_back(image_collection::image_md_predicate::from_string(j["image_md_filter"][i].string_value()));
+                }
+                x->set_image_md_filter(filter);
+            }
+            if (!j["image_md_order"].is_null()) {
+                x->set_image_md_order(j["image_md_order"].string_value());
+            }
             return x;
         }));
 
@@ -379,6 +403,36 @@ void cube_factory::register_default() {
             return x;
         }));
 
+    cube_generators.insert(std::make_pair<std::string, std::function<std::shared_ptr<cube>(json11::Json&)>>(
+        "apply_time", [](json11::Json& j) {
+            std::vector<std::pair<std::string, std::string>> op_bands;
+            for (uint16_t i = 0; i < j["op_bands"].array_items().size(); ++i) {
+                op_bands.push_back(std::make_pair(j["op_bands"][i][0].string_value(), j["op_bands"][i][1].string_value()));
+            }
+            std::vector<int32_t> lags;
+            for (uint16_t i = 0; i < j["lags"].array_items().size(); ++i) {
+                lags.push_back(j["lags"][i].int_value());
+            }
+            std::vector<std::string> names;
+            for (uint16_t i = 0; i < j["names"].array_items().size(); ++i) {
+                names.push_back(j["names"][i].string_value());
+            }
+            auto x = apply_time_cube::create(instance()->create_from_json(j["in_cube"]), op_bands, lags, names);
+            return x;
+        }));
+
+    cube_generators.insert(std::make_pair<std::string, std::function<std::shared_ptr<cube>(json11::Json&)>>(
+        "kernel_plugin", [](json11::Json& j) {
+            auto x = kernel_plugin_cube::create(instance()->create_from_json(j["in_cube"]), j["plugin"].string_value(), j["mode"].string_value(), j["args"].string_value());
+            return x;
+        }));
+
+    cube_generators.insert(std::make_pair<std::string, std::function<std::shared_ptr<cube>(json11::Json&)>>(
+        "predict_pixel", [](json11::Json& j) {
+            auto x = predict_pixel_cube::create(instance()->create_from_json(j["in_cube"]), j["model"].string_value(), j["probabilities"].bool_value());
+            return x;
+        }));
+
     cube_generators.insert(std::make_pair<std::string, std::function<std::shared_ptr<cube>(json11::Json&)>>(
         "ncdf", [](json11::Json& j) {
             bool auto_unpack = j["auto_unpack"].bool_value();
@@ -0,0 +1,325 @@
+/*
+    MIT License
+
+    Copyright (c) 2023 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include "dataset_pool.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#include "config.h"
+#include "filesystem.h"
+#include "utils.h"
+
+namespace gdalcubes {
+
+gdal_dataset_pool::~gdal_dataset_pool() {
+    // Do not close remaining handles here, GDAL may already have been cleaned up
+    // at static destruction time, gdalcubes_cleanup() calls clear() instead.
+    _idle.clear();
+}
+
+bool gdal_dataset_pool::is_local_file(const std::string &path) {
+    return path.compare(0, 4, "/vsi") != 0 && path.find("://") == std::string::npos;
+}
+
+gdal_dataset_pool::file_signature gdal_dataset_pool::signature(const std::string &path) {
+    file_signature s = {-1, -1};
+    VSIStatBufL stat;
+    if (VSIStatL(path.c_str(), &stat) == 0) {
+        s.size = (int64_t)stat.st_size;
+        s.mtime = (int64_t)stat.st_mtime;
+    }
+    return s;
+}
+
+std::string gdal_dataset_pool::validation_file(const std::string &path) {
+    if (is_local_file(path)) {
+        return path;
+    }
+    std::string archive = archive_listing_cache::archive_of(path);
+    if (!archive.empty() && is_local_file(archive)) {
+        return archive;
+    }
+    return "";
+}
+
+GDALDataset *gdal_dataset_pool::acquire(std::string path) {
+    file_signature sig = {-1, -1};
+    std::string vfile = validation_file(path);
+    if (!vfile.empty()) {
+        sig = signature(vfile);
+    }
+
+    std::vector<GDALDataset *> outdated;
+    GDALDataset *out = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (auto it = _idle.begin(); it != _idle.end();) {
+            if (it->path != path) {
+                ++it;
+            } else if (it->sig != sig) {
+                // file has been modified after the handle has been opened
+                outdated.push_back(it->dataset);
+                it = _idle.erase(it);
+            } else {
+                out = it->dataset;
+                _idle.erase(it);
+                break;
+            }
+        }
+    }
+    for (uint32_t i = 0; i < outdated.size(); ++i) {
+        GDALClose(outdated[i]);
+    }
+    if (!out) {
+        bool contained = true;
+        if (vfile != path && !vfile.empty() && archive_listing_cache::instance()->lookup(path, contained) && !contained) {
+            return nullptr;
+        }
+        out = (GDALDataset *)GDALOpen(path.c_str(), GA_ReadOnly);
+    }
+    if (out) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _in_use[out] = sig;
+    }
+    return out;
+}
+
+void gdal_dataset_pool::release(std::string path, GDALDataset *dataset) {
+    if (!dataset) return;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto it = _in_use.find(dataset);
+        if (it != _in_use.end()) {
+            if (_max_idle > 0) {
+                _idle.push_front({path, dataset, it->second});
+                dataset = nullptr;
+            }
+            _in_use.erase(it);
+        }
+    }
+    if (dataset) {
+        GDALClose(dataset);
+    }
+    shrink(_max_idle);
+}
+
+void gdal_dataset_pool::shrink(uint32_t n) {
+    std::vector<GDALDataset *> closing;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        while (_idle.size() > n) {
+            closing.push_back(_idle.back().dataset);
+            _idle.pop_back();
+        }
+    }
+    for (uint32_t i = 0; i < closing.size(); ++i) {
+        GDALClose(closing[i]);
+    }
+}
+
+void gdal_dataset_pool::clear() {
+    shrink(0);
+}
+
+void gdal_dataset_pool::set_max_idle(uint32_t n) {
+    _max_idle = n;
+    shrink(n);
+}
+
+std::string archive_listing_cache::archive_of(const std::string &path) {
+    if (path.compare(0, 8, "/vsizip/") != 0 && path.compare(0, 8, "/vsitar/") != 0) {
+        return "";
+    }
+    std::string rest = path.substr(8);
+    if (!rest.empty() && rest[0] == '{') {
+        size_t end = rest.find("}/");
+        return (end == std::string::npos) ? "" : rest.substr(1, end - 1);
+    }
+    std::string lower = rest;
+    std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+    size_t end = std::string::npos;
+    for (std::string ext : {".zip/", ".tar/", ".tar.gz/", ".tgz/"}) {
+        size_t pos = lower.find(ext);
+        if (pos != std::string::npos) {
+            end = std::min(end, pos + ext.size() - 1);
+        }
+    }
+    return (end == std::string::npos) ? "" : rest.substr(0, end);
+}
+
+// Listing files start with the archive key and its size and modification time, followed by one line per file
+bool archive_listing_cache::read_listing(std::string file, std::string key, listing &l) {
+    std::ifstream is(file);
+    if (!is) {
+        return false;
+    }
+    std::string line;
+    if (!std::getline(is, line) || line != key) {
+        return false;  // hash collision or broken file
+    }
+    if (!std::getline(is, line)) {
+        return false;
+    }
+    std::istringstream ss(line);
+    listing out;
+    if (!(ss >> out.size >> out.mtime) || out.size != l.size || out.mtime != l.mtime) {
+        return false;
+    }
+    while (std::getline(is, line)) {
+        out.files.push_back(line);
+    }
+    l.files = out.files;
+    return true;
+}
+
+void archive_listing_cache::write_listing(std::string file, std::string key, const listing &l) {
+    // write to a temporary file first such that concurrent readers never see incomplete listings
+    std::string tmp = file + utils::generate_unique_filename(8, ".", ".tmp");
+    {
+        std::ofstream os(tmp);
+        if (!os) {
+            GCBS_DEBUG("Cannot write archive listing to '" + tmp + "'");
+            return;
+        }
+        os << key << "\n"
+           << l.size << "\t" << l.mtime << "\n";
+        for (uint32_t i = 0; i < l.files.size(); ++i) {
+            os << l.files[i] << "\n";
+        }
+    }
+    if (std::rename(tmp.c_str(), file.c_str()) != 0) {
+        std::remove(tmp.c_str());
+    }
+}
+
+bool archive_listing_cache::find_cached(const std::string &key, listing &l, std::string &cache_file) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto it = _entries.find(key);
+        if (it != _entries.end() && it->second.size == l.size && it->second.mtime == l.mtime) {
+            l.files = it->second.files;
+            return true;
+        }
+    }
+    std::string cache_dir = config::instance()->get_archive_cache_dir();
+    if (!cache_dir.empty()) {
+        cache_file = filesystem::join(cache_dir, "archive_" + utils::hash(key) + ".txt");
+        return read_listing(cache_file, key, l);
+    }
+    return false;
+}
+
+bool archive_listing_cache::lookup(const std::string &path, bool &contained) {
+    std::string archive = archive_of(path);
+    if (archive.empty()) {
+        return false;
+    }
+    std::string vsi_prefix = path.substr(0, 8);
+    std::size_t member_pos = vsi_prefix.size() + archive.size() + 1;
+    if (path[vsi_prefix.size()] == '{') member_pos += 2;  // /vsizip/{archive}/member
+    if (member_pos >= path.size()) {
+        return false;
+    }
+    std::string member = path.substr(member_pos);
+
+    listing l;
+    VSIStatBufL stat;
+    if (VSIStatL(archive.c_str(), &stat) != 0) {
+        return false;
+    }
+    l.size = (int64_t)stat.st_size;
+    l.mtime = (int64_t)stat.st_mtime;
+    std::string key = vsi_prefix + archive;
+    std::string cache_file;
+    if (!find_cached(key, l, cache_file)) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _entries[key] = l;
+    }
+    contained = std::find(l.files.begin(), l.files.end(), member) != l.files.end();
+    return true;
+}
+
+std::vector<std::string> archive_listing_cache::list(std::string archive, std::string vsi_prefix) {
+    std::string key = vsi_prefix + archive;
+    listing l;
+    l.size = -1;
+    l.mtime = -1;
+    VSIStatBufL stat;
+    if (VSIStatL(archive.c_str(), &stat) == 0) {
+        l.size = (int64_t)stat.st_size;
+        l.mtime = (int64_t)stat.st_mtime;
+    }
+    bool cacheable = l.size >= 0;
+
+    bool found = false;
+    std::string cache_file;
+    if (cacheable) {
+        found = find_cached(key, l, cache_file);
+    }
+    std::string cache_dir = config::instance()->get_archive_cache_dir();
+    if (!found) {
+        char **y = VSIReadDirRecursive(key.c_str());
+        char **x = y;
+        if (x != NULL) {
+            while (*x != NULL) {
+                l.files.push_back(*x);
+                ++x;
+            }
+            CSLDestroy(y);
+        } else {
+            cacheable = false;  // do not remember failures
+        }
+        if (cacheable && !cache_file.empty()) {
+            if (!filesystem::exists(cache_dir)) {
+                filesystem::mkdir_recursive(cache_dir);
+            }
+            write_listing(cache_file, key, l);
+        }
+    }
+    if (cacheable) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _entries[key] = l;
+    }
+
+    std::vector<std::string> out;
+    out.reserve(l.files.size());
+    for (uint32_t i = 0; i < l.files.size(); ++i) {
+        out.push_back(vsi_prefix + filesystem::join(archive, l.files[i]));
+    }
+    return out;
+}
+
+void archive_listing_cache::clear() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _entries.clear();
+}
+
+}  // namespace gdalcubes
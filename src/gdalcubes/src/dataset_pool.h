@@ -0,0 +1,221 @@
+/*
+    MIT License
+
+    Copyright (c) 2023 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef DATASET_POOL_H
+#define DATASET_POOL_H
+
+#include <gdal_priv.h>
+
+#include <cstdint>
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace gdalcubes {
+
+/**
+ * @brief Pool of reusable read-only GDAL dataset handles
+ *
+ * Opening a dataset (parsing headers, IFDs, or remote metadata) is often more expensive than
+ * reading a single chunk from it. The pool keeps idle handles per path and hands them out
+ * exclusively, since GDAL datasets must not be used from several threads at the same time.
+ * Handles of local files and of files in local .zip / .tar archives are validated against
+ * the (archive) file's size and modification time before being reused. Archive members that are missing
+ * in a cached archive listing (see archive_listing_cache) are not opened at all. The number of idle handles is limited, least recently released
+ * handles are closed first.
+ */
+class gdal_dataset_pool {
+   public:
+    static gdal_dataset_pool *instance() {
+        static gdal_dataset_pool instance;
+        return &instance;
+    }
+
+    /**
+     * @brief Get an exclusive read-only handle for a dataset
+     * @param path GDAL dataset descriptor (filename, URL, ...)
+     * @return dataset handle or nullptr if the dataset cannot be opened
+     * @note every non-null result must be given back with release()
+     */
+    GDALDataset *acquire(std::string path);
+
+    /**
+     * @brief Give back a handle obtained by acquire(), the handle may be reused by subsequent calls
+     * @param path GDAL dataset descriptor as passed to acquire()
+     * @param dataset dataset handle
+     */
+    void release(std::string path, GDALDataset *dataset);
+
+    /**
+     * @brief Close all idle handles
+     */
+    void clear();
+
+    /**
+     * @brief Set the maximum number of idle handles kept open, 0 disables pooling
+     * @param n maximum number of idle handles
+     */
+    void set_max_idle(uint32_t n);
+
+    inline uint32_t get_max_idle() { return _max_idle; }
+
+   private:
+    gdal_dataset_pool(const gdal_dataset_pool &) = delete;
+    gdal_dataset_pool(gdal_dataset_pool &&) = delete;
+    gdal_dataset_pool &operator=(const gdal_dataset_pool &) = delete;
+    gdal_dataset_pool &operator=(gdal_dataset_pool &&) = delete;
+    gdal_dataset_pool() : _idle(), _in_use(), _max_idle(64), _mutex() {}
+    ~gdal_dataset_pool();
+
+    struct file_signature {
+        int64_t size;
+        int64_t mtime;
+        bool operator==(const file_signature &other) const {
+            return size == other.size && mtime == other.mtime;
+        }
+        bool operator!=(const file_signature &other) const {
+            return !(*this == other);
+        }
+    };
+
+    static bool is_local_file(const std::string &path);
+    static file_signature signature(const std::string &path);
+
+    // file that is validated before reusing a handle for path, empty if handles are not validated
+    static std::string validation_file(const std::string &path);
+
+    void shrink(uint32_t n);
+
+    struct pool_entry {
+        std::string path;
+        GDALDataset *dataset;
+        file_signature sig;
+    };
+
+    // idle handles, most recently released first
+    std::list<pool_entry> _idle;
+
+    // signatures of handles that are currently in use
+    std::map<GDALDataset *, file_signature> _in_use;
+    uint32_t _max_idle;
+    std::mutex _mutex;
+};
+
+/**
+ * @brief RAII wrapper that acquires a dataset from the pool and releases it on destruction
+ */
+class pooled_dataset {
+   public:
+    pooled_dataset(std::string path) : _path(path), _dataset(gdal_dataset_pool::instance()->acquire(path)) {}
+    ~pooled_dataset() {
+        if (_dataset) gdal_dataset_pool::instance()->release(_path, _dataset);
+    }
+    pooled_dataset(const pooled_dataset &) = delete;
+    pooled_dataset &operator=(const pooled_dataset &) = delete;
+
+    inline GDALDataset *get() { return _dataset; }
+    inline GDALDataset *operator->() { return _dataset; }
+    inline explicit operator bool() const { return _dataset != nullptr; }
+
+   private:
+    std::string _path;
+    GDALDataset *_dataset;
+};
+
+/**
+ * @brief Cache of .zip and .tar archive listings
+ *
+ * Listing the content of an archive requires reading its central directory (.zip) or scanning all
+ * headers (.tar), which is expensive for large archives and is repeated whenever an image collection
+ * is created or extended from the same files. Listings are cached per archive and reused as long as the
+ * archive's size and modification time are unchanged. If config::get_archive_cache_dir() is not empty,
+ * listings are additionally stored as files in this directory, such that they are reused across sessions
+ * and worker processes.
+ */
+class archive_listing_cache {
+   public:
+    static archive_listing_cache *instance() {
+        static archive_listing_cache instance;
+        return &instance;
+    }
+
+    /**
+     * @brief List all files of an archive
+     * @param archive filename of the archive
+     * @param vsi_prefix GDAL virtual file system prefix, "/vsizip/" or "/vsitar/"
+     * @return GDAL descriptors of all files in the archive
+     */
+    std::vector<std::string> list(std::string archive, std::string vsi_prefix);
+
+    /**
+     * @brief Check whether a file is part of an archive using a cached listing only
+     *
+     * In contrast to list(), the archive is never read, i.e. this is cheap enough to be called before opening archive members.
+     * @param path GDAL descriptor of a file in a .zip or .tar archive, e.g. /vsizip/x.zip/a.tif
+     * @param[out] contained true if the cached listing contains the file
+     * @return false if no valid listing of the archive is cached in memory or in config::get_archive_cache_dir()
+     */
+    bool lookup(const std::string &path, bool &contained);
+
+    /**
+     * @brief Get the archive file of a descriptor pointing to a file in a .zip or .tar archive
+     * @param path GDAL dataset descriptor, e.g. /vsizip/x.zip/a.tif
+     * @return archive filename or empty string if the descriptor does not point to a file in an archive
+     */
+    static std::string archive_of(const std::string &path);
+
+    /**
+     * @brief Remove all listings from memory, files in the cache directory are kept
+     */
+    void clear();
+
+   private:
+    archive_listing_cache(const archive_listing_cache &) = delete;
+    archive_listing_cache(archive_listing_cache &&) = delete;
+    archive_listing_cache &operator=(const archive_listing_cache &) = delete;
+    archive_listing_cache &operator=(archive_listing_cache &&) = delete;
+    archive_listing_cache() : _entries(), _mutex() {}
+
+    struct listing {
+        int64_t size;
+        int64_t mtime;
+        std::vector<std::string> files;  // relative to the archive
+    };
+
+    static bool read_listing(std::string file, std::string key, listing &l);
+
+    // find a valid listing in memory or in the cache directory, l.size and l.mtime must be set
+    bool find_cached(const std::string &key, listing &l, std::string &cache_file);
+    static void write_listing(std::string file, std::string key, const listing &l);
+
+    std::unordered_map<std::string, listing> _entries;
+    std::mutex _mutex;
+};
+
+}  // namespace gdalcubes
+
+#endif  // DATASET_POOL_H
@@ -226,9 +226,170 @@ double datetime::to_double() {
     return out;
 }
 
+// Reads exactly n decimal digits starting at s[pos], returns false if fewer digits are available
+static inline bool read_digits(const std::string &s, std::size_t pos, uint8_t n, int32_t &out) {
+    if (pos + n > s.length()) return false;
+    int32_t v = 0;
+    for (uint8_t i = 0; i < n; ++i) {
+        char c = s[pos + i];
+        if (c < '0' || c > '9') return false;
+        v = v * 10 + (c - '0');
+    }
+    out = v;
+    return true;
+}
+
+// Converts civil date and time fields to a time point, returns false if any field is out of range
+static inline bool fields_to_sys_seconds(int32_t Y, int32_t m, int32_t d, int32_t yday, int32_t H, int32_t M, int32_t S, date::sys_seconds &out) {
+    if (H < 0 || H > 23 || M < 0 || M > 59 || S < 0 || S > 60) return false;
+    date::sys_days day;
+    if (yday > 0) {
+        date::year y(Y);
+        if (yday > (y.is_leap() ? 366 : 365)) return false;
+        day = date::sys_days{y / 1 / 1} + date::days{yday - 1};
+    } else {
+        date::year_month_day ymd = date::year(Y) / date::month(m) / date::day(d);
+        if (!ymd.ok()) return false;
+        day = date::sys_days{ymd};
+    }
+    out = day + std::chrono::hours{H} + std::chrono::minutes{M} + std::chrono::seconds{S};
+    return true;
+}
+
+bool datetime::tryparse_fixed(const std::string &format, const std::string &d, date::sys_seconds &out) {
+    int32_t Y = 0, m = 1, day = 1, yday = 0, H = 0, M = 0, S = 0;
+    std::size_t pos = 0;
+    for (std::size_t i = 0; i < format.length(); ++i) {
+        if (format[i] != '%') {
+            if (pos >= d.length() || d[pos] != format[i]) return false;
+            ++pos;
+            continue;
+        }
+        if (++i >= format.length()) return false;
+        bool ok;
+        switch (format[i]) {
+            case 'Y':
+                ok = read_digits(d, pos, 4, Y);
+                pos += 4;
+                break;
+            case 'm':
+                ok = read_digits(d, pos, 2, m);
+                pos += 2;
+                break;
+            case 'd':
+                ok = read_digits(d, pos, 2, day);
+                pos += 2;
+                break;
+            case 'j':
+                ok = read_digits(d, pos, 3, yday) && yday > 0;
+                pos += 3;
+                break;
+            case 'H':
+                ok = read_digits(d, pos, 2, H);
+                pos += 2;
+                break;
+            case 'M':
+                ok = read_digits(d, pos, 2, M);
+                pos += 2;
+                break;
+            case 'S':
+                ok = read_digits(d, pos, 2, S);
+                pos += 2;
+                break;
+            case '%':
+                ok = pos < d.length() && d[pos] == '%';
+                pos += 1;
+                break;
+            default:
+                return false;  // any other conversion specifier is left to the generic parsers
+        }
+        if (!ok) return false;
+    }
+    if (pos != d.length()) return false;
+    return fields_to_sys_seconds(Y, m, day, yday, H, M, S, out);
+}
+
+bool datetime::from_string_fixed(const std::string &s, datetime &out) {
+    int32_t Y = 0, m = 1, d = 1, yday = 0, H = 0, M = 0, S = 0;
+    datetime_unit u = datetime_unit::YEAR;
+    std::size_t pos = 0;
+
+    if (!read_digits(s, pos, 4, Y)) return false;
+    pos += 4;
+    if (pos < s.length()) {
+        bool compact = s[pos] != '-';
+        if (!compact) ++pos;
+
+        // YYYY-DDD (ordinal date)
+        if (!compact && pos + 3 == s.length() && read_digits(s, pos, 3, yday)) {
+            if (yday == 0) return false;
+            pos += 3;
+            u = datetime_unit::DAY;
+        } else {
+            if (!read_digits(s, pos, 2, m)) return false;
+            pos += 2;
+            u = datetime_unit::MONTH;
+            if (pos < s.length()) {
+                if (!compact) {
+                    if (s[pos] != '-') return false;
+                    ++pos;
+                }
+                if (!read_digits(s, pos, 2, d)) return false;
+                pos += 2;
+                u = datetime_unit::DAY;
+            }
+        }
+
+        // time of day, separated by 'T' or a space with optional ':' between components
+        if (pos < s.length() && u == datetime_unit::DAY && yday == 0) {
+            if (s[pos] != 'T' && s[pos] != ' ') return false;
+            ++pos;
+            int32_t *fields[3] = {&H, &M, &S};
+            datetime_unit units[3] = {datetime_unit::HOUR, datetime_unit::MINUTE, datetime_unit::SECOND};
+            for (uint8_t k = 0; k < 3; ++k) {
+                if (k > 0 && pos < s.length() && s[pos] == ':' && !compact) ++pos;
+                if (!read_digits(s, pos, 2, *fields[k])) {
+                    if (k == 0) return false;
+                    break;
+                }
+                pos += 2;
+                u = units[k];
+                if (pos >= s.length()) break;
+            }
+            // fractional seconds and time zone designators are ignored, as in from_YmdHMS_digits()
+            if (pos < s.length() && u == datetime_unit::SECOND && (s[pos] == '.' || s[pos] == ',')) {
+                ++pos;
+                while (pos < s.length() && s[pos] >= '0' && s[pos] <= '9') ++pos;
+            }
+            if (pos < s.length()) {
+                if (s[pos] == 'Z') {
+                    ++pos;
+                } else if (s[pos] == '+' || s[pos] == '-') {
+                    ++pos;
+                    int32_t tz;
+                    if (!read_digits(s, pos, 2, tz)) return false;
+                    pos += 2;
+                    if (pos < s.length() && s[pos] == ':') ++pos;
+                    if (pos < s.length()) {
+                        if (!read_digits(s, pos, 2, tz)) return false;
+                        pos += 2;
+                    }
+                }
+            }
+        }
+        if (pos != s.length()) return false;
+    }
+    if (!fields_to_sys_seconds(Y, m, d, yday, H, M, S, out._p)) return false;
+    out._unit = u;
+    return true;
+}
+
 date::sys_seconds datetime::tryparse(std::string format, std::string d) {
     bool success = false;
     date::sys_seconds out;  // TODO: set to invalid?!
+    if (tryparse_fixed(format, d, out)) {
+        return out;
+    }
     if (!success) {
         std::istringstream is(d);
         is >> date::parse(format, out);
@@ -339,6 +500,10 @@ datetime datetime::from_YmdHMS_digits(std::string s) {
 }
 
 datetime datetime::from_string(std::string s) {
+    datetime out;
+    if (from_string_fixed(s, out)) {
+        return out;
+    }
     return from_YmdHMS_digits(s); // 0.6.4 [experimental]
 }
 
@@ -228,6 +228,8 @@ class datetime {
     static date::sys_seconds tryparse(std::string format, std::string d);
 
     // from standard format with variable precision
+    // ISO 8601 (YYYY[-MM[-DD[THH[:MM[:SS]]]]], YYYY-DDD) and compact (YYYYMMDD[THHMMSS]) strings are parsed
+    // by a hand-written fixed-format parser, anything else falls back to from_YmdHMS_digits()
     static datetime from_string(std::string s);
 
 
@@ -265,36 +267,32 @@ class datetime {
 
     void unit(datetime_unit u) {
 
-        // Reset finer datetime components
+        // Reset finer datetime components, all units up to weeks are truncated on integer epoch counts
         switch (u) {
             case datetime_unit::NONE:
                 break;
             case datetime_unit::SECOND:
                 break;
             case datetime_unit::MINUTE:
-                _p = date::sys_days{date::year(this->year()) / date::month(this->month()) / date::day(this->dayofmonth())} +
-                    std::chrono::hours{this->hours()} + std::chrono::minutes{this->minutes()} + std::chrono::seconds{0};
+                _p = date::floor<std::chrono::minutes>(_p);
                 break;
             case datetime_unit::HOUR:
-                _p = date::sys_days{date::year(this->year()) / date::month(this->month()) / date::day(this->dayofmonth())} +
-                     std::chrono::hours{this->hours()} + std::chrono::minutes{0} + std::chrono::seconds{0};
+                _p = date::floor<std::chrono::hours>(_p);
                 break;
             case datetime_unit::DAY:
-                _p = date::sys_days{date::year(this->year()) / date::month(this->month()) / date::day(this->dayofmonth())} +
-                     std::chrono::hours{0} + std::chrono::minutes{0} + std::chrono::seconds{0};
-                break;
             case datetime_unit::WEEK:
-                _p = date::sys_days{date::year(this->year()) / date::month(this->month()) / date::day(this->dayofmonth())} +
-                     std::chrono::hours{0} + std::chrono::minutes{0} + std::chrono::seconds{0};
+                _p = date::floor<date::days>(_p);
                 break;
-            case datetime_unit::MONTH:
-                _p = date::sys_days{date::year(this->year()) / date::month(this->month()) / date::day(1)} +
-                     std::chrono::hours{0} + std::chrono::minutes{0} + std::chrono::seconds{0};
+            case datetime_unit::MONTH: {
+                auto ymd = date::year_month_day(date::floor<date::days>(_p));
+                _p = date::sys_days{ymd.year() / ymd.month() / date::day(1)};
                 break;
-            case datetime_unit::YEAR:
-               _p = date::sys_days{date::year(this->year()) / date::month(1) / date::day(1)} +
-                    std::chrono::hours{0} + std::chrono::minutes{0} + std::chrono::seconds{0};
+            }
+            case datetime_unit::YEAR: {
+                auto ymd = date::year_month_day(date::floor<date::days>(_p));
+                _p = date::sys_days{ymd.year() / date::month(1) / date::day(1)};
                 break;
+            }
         }
         _unit = u;
 
@@ -309,11 +307,7 @@ class datetime {
         // std::tm ltm = l._p;
         //std::tm rtm = r._p;
 
-        auto dp_l = date::floor<date::days>(l._p);
-        auto ymd_l = date::year_month_day(dp_l);
-        auto dp_r = date::floor<date::days>(r._p);
-        auto ymd_r = date::year_month_day(dp_r);
-
+        // Units up to weeks only need integer arithmetic on epoch counts, civil dates are computed for months and years only
         switch (out.dt_unit) {
             case datetime_unit::NONE:
                 break;
@@ -327,19 +321,24 @@ class datetime {
                 out.dt_interval = std::chrono::duration_cast<std::chrono::hours>(l._p - r._p).count();
                 break;
             case datetime_unit::DAY:
-                out.dt_interval = (dp_l - dp_r).count();
+                out.dt_interval = (date::floor<date::days>(l._p) - date::floor<date::days>(r._p)).count();
                 break;
             case datetime_unit::WEEK:
-                out.dt_interval = (dp_l - dp_r).count() / 7;
+                out.dt_interval = (date::floor<date::days>(l._p) - date::floor<date::days>(r._p)).count() / 7;
                 break;
             case datetime_unit::MONTH: {
                 // see https://github.com/HowardHinnant/date/wiki/Examples-and-Recipes#deltamonths
+                auto ymd_l = date::year_month_day(date::floor<date::days>(l._p));
+                auto ymd_r = date::year_month_day(date::floor<date::days>(r._p));
                 out.dt_interval = (ymd_l.year() / ymd_l.month() - ymd_r.year() / ymd_r.month()).count();
                 break;
             }
-            case datetime_unit::YEAR:
+            case datetime_unit::YEAR: {
+                auto ymd_l = date::year_month_day(date::floor<date::days>(l._p));
+                auto ymd_r = date::year_month_day(date::floor<date::days>(r._p));
                 out.dt_interval = (ymd_l.year() - ymd_r.year()).count();
                 break;
+            }
         }
         return out;
     }
@@ -408,6 +407,10 @@ class datetime {
     datetime_unit _unit;
 
     static std::string datetime_format_for_unit(datetime_unit u);
+
+    // Fixed-format fast paths of from_string() and tryparse(), return false if the string needs the generic parsers
+    static bool from_string_fixed(const std::string &s, datetime &out);
+    static bool tryparse_fixed(const std::string &format, const std::string &d, date::sys_seconds &out);
 };
 
 }  // namespace gdalcubes
@@ -296,7 +296,7 @@ std::shared_ptr<chunk_data> extract_geom::read_chunk(chunkid_t id) {
                 // even if they do not intersect in the time dimension.
                 // A more efficient way would be to apply an additional attribute filter before, but
                 // since the time unit of the cube might be different, this might be less reliable.
-                datetime tt = datetime::from_YmdHMS_digits(cur_feature->GetFieldAsString(_in_time_column.c_str()));
+                datetime tt = datetime::from_string(cur_feature->GetFieldAsString(_in_time_column.c_str()));
                 tt.unit(st_reference()->dt_unit());
                 // if outside chunk
                 if (tt < cbounds.t0 || tt > cbounds.t1) {
@@ -30,6 +30,7 @@
 #include "aggregate_time.h"
 #include "aggregate_space.h"
 #include "apply_pixel.h"
+#include "apply_time.h"
 #include "build_info.h"
 #include "config.h"
 #include "cube.h"
@@ -42,10 +43,13 @@
 #include "image_collection_cube.h"
 #include "image_collection_ops.h"
 #include "join_bands.h"
+#include "kernel_plugin.h"
 #include "ncdf_cube.h"
+#include "predict_pixel.h"
 #include "progress.h"
 #include "reduce_space.h"
 #include "reduce_time.h"
+#include "remote_cache.h"
 #include "rename_bands.h"
 #include "select_bands.h"
 #include "select_time.h"
@@ -59,6 +63,7 @@
 #include "stream_reduce_time.h"
 #include "utils.h"
 #include "vector_queries.h"
+#include "window_space.h"
 #include "window_time.h"
 
 #ifndef GDALCUBES_NO_SWARM
@@ -25,20 +25,113 @@
 #include "image_collection.h"
 
 #include <gdalwarper.h>
+#include <ogr_geometry.h>
 #include <sqlite3.h>
 
-#include <boost/regex.hpp>
+#include <algorithm>
 #include <set>
+#include <unordered_map>
 #include <unordered_set>
 
+#include "collection_snapshot.h"
 #include "config.h"
+#include "dataset_pool.h"
 #include "external/date.h"
 #include "filesystem.h"
+#include "thread_pool.h"
 #include "utils.h"
 
 namespace gdalcubes {
 
-image_collection::image_collection() : _format(), _filename(""), _db(nullptr) {
+// Secondary indexes, which are dropped during bulk inserts and recreated afterwards
+static const char* SQL_CREATE_INDEX_IMAGES = "CREATE INDEX IF NOT EXISTS idx_image_names ON images(name);";
+static const char* SQL_CREATE_INDEX_GDALREFS =
+    "CREATE INDEX IF NOT EXISTS idx_gdalrefs_bandid ON gdalrefs(band_id);"
+    "CREATE INDEX IF NOT EXISTS idx_gdalrefs_imageid ON gdalrefs(image_id);";
+static const char* SQL_CREATE_FOOTPRINTS =
+    "CREATE TABLE IF NOT EXISTS image_footprints(image_id INTEGER PRIMARY KEY, geom BLOB, FOREIGN KEY (image_id) REFERENCES images(id) ON DELETE CASCADE);";
+static const char* SQL_CREATE_SHARDS =
+    "CREATE TABLE shards(id INTEGER PRIMARY KEY, filename TEXT, id_offset INTEGER, left NUMERIC, top NUMERIC, bottom NUMERIC, right NUMERIC, t0 TEXT, t1 TEXT, image_count INTEGER, gdalref_count INTEGER, srs TEXT, aligned INTEGER);"
+    "CREATE TABLE shard_bands(shard_id INTEGER, band_id INTEGER, image_count INTEGER, PRIMARY KEY (shard_id, band_id), FOREIGN KEY (shard_id) REFERENCES shards(id) ON DELETE CASCADE);";
+static const char* SQL_DROP_INDEXES =
+    "DROP INDEX IF EXISTS idx_image_names;"
+    "DROP INDEX IF EXISTS idx_gdalrefs_bandid;"
+    "DROP INDEX IF EXISTS idx_gdalrefs_imageid;";
+
+// Owns prepared insert statements of a collection and finalizes them when going out of scope. If the scope is left
+// with an exception, i.e. before done() has been called, an active bulk insert of the collection is aborted.
+class bulk_insert_guard {
+   public:
+    bulk_insert_guard(image_collection* ic) : _ic(ic), _stmts(), _done(false) {}
+    ~bulk_insert_guard() {
+        for (uint32_t i = 0; i < _stmts.size(); ++i) {
+            sqlite3_finalize(_stmts[i]);
+        }
+        if (!_done) {
+            _ic->bulk_insert_abort();
+        }
+    }
+
+    sqlite3_stmt* prepare(std::string sql) {
+        sqlite3_stmt* stmt;
+        if (sqlite3_prepare_v2(_ic->get_db_handle(), sql.c_str(), -1, &stmt, NULL) != SQLITE_OK) {
+            std::string msg = "Failed to prepare insert statement: " + std::string(sqlite3_errmsg(_ic->get_db_handle()));
+            GCBS_ERROR(msg);
+            throw msg;
+        }
+        _stmts.push_back(stmt);
+        return stmt;
+    }
+
+    // Steps a prepared insert statement and resets it for the next row, throws on errors
+    void step(sqlite3_stmt* stmt, std::string table, std::size_t row) {
+        if (sqlite3_step(stmt) != SQLITE_DONE) {
+            std::string msg = "Failed to insert row " + std::to_string(row + 1) + " into table '" + table + "' of image collection database: " + std::string(sqlite3_errmsg(_ic->get_db_handle()));
+            GCBS_ERROR(msg);
+            throw msg;
+        }
+        sqlite3_reset(stmt);
+        sqlite3_clear_bindings(stmt);
+    }
+
+    inline void done() { _done = true; }
+
+   private:
+    image_collection* _ic;
+    std::vector<sqlite3_stmt*> _stmts;
+    bool _done;
+};
+
+static std::string sqlite_pragma(sqlite3* db, std::string name) {
+    std::string out = "";
+    sqlite3_stmt* stmt;
+    std::string sql = "PRAGMA " + name + ";";
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, NULL) != SQLITE_OK) {
+        return out;
+    }
+    if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_text(stmt, 0)) {
+        out = std::string(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)));
+    }
+    sqlite3_finalize(stmt);
+    return out;
+}
+
+static bool sqlite_has_table(sqlite3* db, std::string table) {
+    sqlite3_stmt* stmt;
+    std::string sql = "SELECT EXISTS (SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = '" + table + "');";
+    sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, NULL);
+    if (!stmt) {
+        return false;
+    }
+    bool out = false;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        out = sqlite3_column_int(stmt, 0) != 0;
+    }
+    sqlite3_finalize(stmt);
+    return out;
+}
+
+image_collection::image_collection() : _format(), _filename(""), _db(nullptr), _shard_info(), _shards(), _shards_mutex(), _shards_md_index(false), _snapshot(nullptr), _bulk_insert(false), _bulk_journal_mode(""), _bulk_synchronous(""), _has_footprints(-1) {
     if (sqlite3_open_v2("", &_db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_FULLMUTEX, NULL) != SQLITE_OK) {
         std::string msg = "ERROR in image_collection::create(): cannot create temporary image collection file.";
         throw msg;
@@ -73,7 +166,7 @@ image_collection::image_collection() : _format(), _filename(""), _db(nullptr) {
     }
 
     // Create image table
-    std::string sql_schema_images = "CREATE TABLE images (id INTEGER PRIMARY KEY, name TEXT, left NUMERIC, top NUMERIC, bottom NUMERIC, right NUMERIC, datetime TEXT, proj TEXT, UNIQUE(name));CREATE INDEX idx_image_names ON images(name);";
+    std::string sql_schema_images = "CREATE TABLE images (id INTEGER PRIMARY KEY, name TEXT, left NUMERIC, top NUMERIC, bottom NUMERIC, right NUMERIC, datetime TEXT, proj TEXT, UNIQUE(name));" + std::string(SQL_CREATE_INDEX_IMAGES);
     if (sqlite3_exec(_db, sql_schema_images.c_str(), NULL, NULL, NULL) != SQLITE_OK) {
         throw std::string("ERROR in image_collection::create(): cannot create image collection schema (iv).");
     }
@@ -86,9 +179,8 @@ image_collection::image_collection() : _format(), _filename(""), _db(nullptr) {
 
     // create gdal references table
     std::string sql_schema_gdalrefs =
-        "CREATE TABLE gdalrefs (image_id INTEGER, band_id INTEGER, descriptor TEXT, band_num INTEGER, FOREIGN KEY (image_id) REFERENCES images(id) ON DELETE CASCADE, PRIMARY KEY (image_id, band_id), FOREIGN KEY (band_id) REFERENCES bands(id) ON DELETE CASCADE);"
-        "CREATE INDEX idx_gdalrefs_bandid ON gdalrefs(band_id);"
-        "CREATE INDEX idx_gdalrefs_imageid ON gdalrefs(image_id);";
+        "CREATE TABLE gdalrefs (image_id INTEGER, band_id INTEGER, descriptor TEXT, band_num INTEGER, FOREIGN KEY (image_id) REFERENCES images(id) ON DELETE CASCADE, PRIMARY KEY (image_id, band_id), FOREIGN KEY (band_id) REFERENCES bands(id) ON DELETE CASCADE);" +
+        std::string(SQL_CREATE_INDEX_GDALREFS);
     if (sqlite3_exec(_db, sql_schema_gdalrefs.c_str(), NULL, NULL, NULL) != SQLITE_OK) {
         throw std::string("ERROR in collection_format::apply(): cannot create image collection schema (vi).");
     }
@@ -131,11 +223,15 @@ image_collection::image_collection(collection_format format) : image_collection(
     }
 }
 
-image_collection::image_collection(std::string filename) : _format(), _filename(filename), _db(nullptr) {
+image_collection::image_collection(std::string filename) : _format(), _filename(filename), _db(nullptr), _shard_info(), _shards(), _shards_mutex(), _shards_md_index(false), _snapshot(nullptr), _bulk_insert(false), _bulk_journal_mode(""), _bulk_synchronous(""), _has_footprints(-1) {
     // TODO: IMPLEMENT VERSIONING OF COLLECTION FORMATS AND CHECK COMPATIBILITY HERE
     if (!filesystem::exists(filename)) {
         throw std::string("ERROR in image_collection::image_collection(): input collection '" + filename + "' does not exist.");
     }
+    if (collection_snapshot::is_snapshot(filename)) {
+        _snapshot = std::make_shared<collection_snapshot>(filename);
+        return;
+    }
     if (sqlite3_open_v2(filename.c_str(), &_db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_FULLMUTEX, NULL) != SQLITE_OK) {
         std::string msg = "ERROR in image_collection::image_collection(): cannot open existing image collection file.";
         throw msg;
@@ -157,6 +253,8 @@ image_collection::image_collection(std::string filename) : _format(), _filename(
         _format.load_string(sqlite_as_string(stmt, 0));
     }
     sqlite3_finalize(stmt);
+
+    load_shards();
 }
 
 image_collection::~image_collection() {
@@ -202,6 +300,9 @@ struct image_band {
 
 void image_collection::add_with_datetime(std::vector<std::string> descriptors, std::vector<std::string> date_time,
                                          std::vector<std::string> band_names, bool use_subdatasets) {
+    if (is_sharded() || is_snapshot()) {
+        throw std::string("ERROR in image_collection::add_with_datetime(): sharded image collections and snapshots cannot be modified");
+    }
     if (!_format.is_null()) {
         GCBS_WARN("Image collection has nonempty format; trying to apply the format to provided datasets");
         add_with_collection_format(descriptors);
@@ -423,6 +524,9 @@ void image_collection::add_with_datetime(std::vector<std::string> descriptors, s
 
 void image_collection::add_with_datetime_bands(std::vector<std::string> descriptors, std::vector<std::string> date_time,
                                          std::vector<std::string> band_names, bool use_subdatasets) {
+    if (is_sharded() || is_snapshot()) {
+        throw std::string("ERROR in image_collection::add_with_datetime_bands(): sharded image collections and snapshots cannot be modified");
+    }
     if (!_format.is_null()) {
         GCBS_WARN("Image collection has nonempty format; trying to apply the format to provided datasets");
         add_with_collection_format(descriptors);
@@ -609,8 +713,9 @@ void image_collection::add_with_datetime_bands(std::vector<std::string> descript
 }
 
 void image_collection::add_with_collection_format(std::vector<std::string> descriptors, bool strict) {
-    std::vector<boost::regex> regex_band_pattern;
-
+    if (is_sharded() || is_snapshot()) {
+        throw std::string("ERROR in image_collection::add_with_collection_format(): sharded image collections and snapshots cannot be modified");
+    }
     if (_format.is_null()) {
         GCBS_ERROR("Failed to add GDAL dataset to image collection due to missing collection format entry");
         throw std::string("Failed to add GDAL dataset to image collection due to missing collection format entry");
@@ -628,7 +733,6 @@ void image_collection::add_with_collection_format(std::vector<std::string> descr
     uint16_t band_id = 0;
     for (auto it = _format.json()["bands"].object_items().begin(); it != _format.json()["bands"].object_items().end(); ++it) {
         band_name.push_back(it->first);
-        regex_band_pattern.push_back(boost::regex(it->second["pattern"].string_value()));
         if (!it->second["band"].is_null()) {
             band_num.push_back(it->second["band"].int_value());
         } else {
@@ -639,13 +743,8 @@ void image_collection::add_with_collection_format(std::vector<std::string> descr
         ++band_id;
     }
 
-    std::string global_pattern = "";
-    if (!_format.json()["pattern"].is_null()) global_pattern = _format.json()["pattern"].string_value();
-    boost::regex regex_global_pattern(global_pattern);
-
     if (_format.json()["images"]["pattern"].is_null())
         throw std::string("ERROR in image_collection::add(): image collection format does not contain a composition rule for images.");
-    boost::regex regex_images(_format.json()["images"]["pattern"].string_value());
 
     // @TODO: Make datetime optional, e.g., for DEMs
 
@@ -654,7 +753,6 @@ void image_collection::add_with_collection_format(std::vector<std::string> descr
         throw std::string("ERROR in image_collection::add(): image collection format does not contain a rule to derive date/time.");
     }
 
-    boost::regex regex_datetime(_format.json()["datetime"]["pattern"].string_value());
     if (!_format.json()["datetime"]["format"].is_null()) {
         datetime_format = _format.json()["datetime"]["format"].string_value();
     }
@@ -728,6 +826,10 @@ void image_collection::add_with_collection_format(std::vector<std::string> descr
         }
     }
 
+    // Evaluate all patterns of the format for all datasets in parallel before opening any dataset
+    collection_format_matcher matcher(_format);
+    std::vector<collection_format_matcher::result> matches = matcher.match(descriptors);
+
     uint32_t counter = -1;
     std::shared_ptr<progress> p = config::instance()->get_default_progress_bar()->get();
     p->set(0);  // explicitly set to zero to show progress bar immediately
@@ -735,12 +837,10 @@ void image_collection::add_with_collection_format(std::vector<std::string> descr
         ++counter;
 
         p->set((double)counter / (double)descriptors.size());
-        if (!global_pattern.empty()) {  // prevent unnecessary GDALOpen calls
-            if (!boost::regex_match(*it, regex_global_pattern)) {
-                // std::cout << "ignoring " << *it << std::endl;
-                GCBS_DEBUG("Dataset " + *it + " doesn't match the global collection pattern and will be ignored");
-                continue;
-            }
+        const collection_format_matcher::result& match = matches[counter];
+        if (!match.global) {  // prevent unnecessary GDALOpen calls
+            GCBS_DEBUG("Dataset " + *it + " doesn't match the global collection pattern and will be ignored");
+            continue;
         }
 
         // Read GDAL metadata
@@ -892,8 +992,7 @@ void image_collection::add_with_collection_format(std::vector<std::string> descr
         // TODO: check consistency for all files of an image?!
         // -> add parameter checks=true / false
 
-        boost::cmatch res_image;
-        if (!boost::regex_match(it->c_str(), res_image, regex_images)) {
+        if (!match.image) {
             if (strict) throw std::string("ERROR in image_collection::add(): image composition rule failed for " + std::string(*it));
             GCBS_WARN("Skipping " + *it + " due to failed image composition rule");
             continue;
@@ -923,7 +1022,7 @@ void image_collection::add_with_collection_format(std::vector<std::string> descr
             }
 
             uint32_t image_id;
-            std::string sql_select_image = "SELECT id FROM images WHERE name='" + res_image[1].str() + "'";
+            std::string sql_select_image = "SELECT id FROM images WHERE name='" + match.image_name + "'";
             sqlite3_stmt* stmt;
             sqlite3_prepare_v2(_db, sql_select_image.c_str(), -1, &stmt, NULL);
             if (!stmt) {
@@ -935,8 +1034,7 @@ void image_collection::add_with_collection_format(std::vector<std::string> descr
                 // @TODO: Shall we check that all files óf the same image have the same date / time? Currently we don't.
 
                 // Extract datetime
-                boost::cmatch res_datetime;
-                if (!boost::regex_match(it->c_str(), res_datetime, regex_datetime)) {  // not sure to continue or throw an exception here...
+                if (!match.datetime) {  // not sure to continue or throw an exception here...
                     if (strict) throw std::string("ERROR in image_collection::add(): datetime rule failed for " + std::string(*it));
                     GCBS_WARN("Skipping " + *it + " due to failed datetime rule");
                     continue;
@@ -944,11 +1042,11 @@ void image_collection::add_with_collection_format(std::vector<std::string> descr
 
                 std::stringstream os;
                 date::sys_seconds pt;
-                pt = datetime::tryparse(datetime_format, res_datetime[1].str());
+                pt = datetime::tryparse(datetime_format, match.datetime_str);
                 os << date::format("%Y-%m-%dT%H:%M:%S", pt);
 
                 // Convert to ISO string including separators (boost::to_iso_string or boost::to_iso_extended_string do not work with SQLite datetime functions)
-                std::string sql_insert_image = "INSERT OR IGNORE INTO images(name, datetime, left, top, bottom, right, proj) VALUES('" + res_image[1].str() + "','" +
+                std::string sql_insert_image = "INSERT OR IGNORE INTO images(name, datetime, left, top, bottom, right, proj) VALUES('" + match.image_name + "','" +
                                                os.str() + "'," +
                                                std::to_string(bbox.left) + "," + std::to_string(bbox.top) + "," + std::to_string(bbox.bottom) + "," + std::to_string(bbox.right) + ",'" + srs_str + "')";
                 if (sqlite3_exec(_db, sql_insert_image.c_str(), NULL, NULL, NULL) != SQLITE_OK) {
@@ -965,38 +1063,37 @@ void image_collection::add_with_collection_format(std::vector<std::string> descr
             sqlite3_finalize(stmt);
 
             // Insert into gdalrefs table
-            for (uint16_t i = 0; i < band_name.size(); ++i) {
-                if (boost::regex_match(*it, regex_band_pattern[i])) {
-                    // TODO: if checks, check whether bandnum exists in GDALdataset
-                    // TODO: if checks, compare band type, offset, scale, unit, etc. with current GDAL dataset
-
-                    if (!band_complete[i]) {
-                        std::string sql_band_update = "UPDATE bands SET type='" + utils::string_from_gdal_type(bands[band_num[i] - 1].type) + "'";
-
-                        if (_format.json()["bands"][band_name[i]]["scale"].is_null())
-                            sql_band_update += ",scale=" + std::to_string(bands[band_num[i] - 1].scale);
-                        if (_format.json()["bands"][band_name[i]]["offset"].is_null())
-                            sql_band_update += ",offset=" + std::to_string(bands[band_num[i] - 1].offset);
-                        if (_format.json()["bands"][band_name[i]]["unit"].is_null())
-                            sql_band_update += ",unit='" + bands[band_num[i] - 1].unit + "'";
-
-                        // TODO: also add no data if not defined in image collection?
-                        sql_band_update += " WHERE name='" + band_name[i] + "';";
-
-                        if (sqlite3_exec(_db, sql_band_update.c_str(), NULL, NULL, NULL) != SQLITE_OK) {
-                            if (strict) throw std::string("ERROR in image_collection::add(): cannot update band table.");
-                            GCBS_WARN("Skipping " + *it + " due to failed band table update");
-                            continue;
-                        }
-                        band_complete[i] = true;
+            for (uint16_t ib = 0; ib < match.bands.size(); ++ib) {
+                uint16_t i = match.bands[ib];
+                // TODO: if checks, check whether bandnum exists in GDALdataset
+                // TODO: if checks, compare band type, offset, scale, unit, etc. with current GDAL dataset
+
+                if (!band_complete[i]) {
+                    std::string sql_band_update = "UPDATE bands SET type='" + utils::string_from_gdal_type(bands[band_num[i] - 1].type) + "'";
+
+                    if (_format.json()["bands"][band_name[i]]["scale"].is_null())
+                        sql_band_update += ",scale=" + std::to_string(bands[band_num[i] - 1].scale);
+                    if (_format.json()["bands"][band_name[i]]["offset"].is_null())
+                        sql_band_update += ",offset=" + std::to_string(bands[band_num[i] - 1].offset);
+                    if (_format.json()["bands"][band_name[i]]["unit"].is_null())
+                        sql_band_update += ",unit='" + bands[band_num[i] - 1].unit + "'";
+
+                    // TODO: also add no data if not defined in image collection?
+                    sql_band_update += " WHERE name='" + band_name[i] + "';";
+
+                    if (sqlite3_exec(_db, sql_band_update.c_str(), NULL, NULL, NULL) != SQLITE_OK) {
+                        if (strict) throw std::string("ERROR in image_collection::add(): cannot update band table.");
+                        GCBS_WARN("Skipping " + *it + " due to failed band table update");
+                        continue;
                     }
+                    band_complete[i] = true;
+                }
 
-                    std::string sql_insert_gdalref = "INSERT INTO gdalrefs(descriptor, image_id, band_id, band_num) VALUES('" + sqlite_escape_singlequotes(*it) + "'," + std::to_string(image_id) + "," + std::to_string(band_ids[i]) + "," + std::to_string(band_num[i]) + ");";
-                    if (sqlite3_exec(_db, sql_insert_gdalref.c_str(), NULL, NULL, NULL) != SQLITE_OK) {
-                        if (strict) throw std::string("ERROR in image_collection::add(): cannot add dataset to gdalrefs table.");
-                        GCBS_WARN("Skipping " + *it + "  due to failed gdalrefs insert");
-                        break;  // break only works because there is nothing after the loop.
-                    }
+                std::string sql_insert_gdalref = "INSERT INTO gdalrefs(descriptor, image_id, band_id, band_num) VALUES('" + sqlite_escape_singlequotes(*it) + "'," + std::to_string(image_id) + "," + std::to_string(band_ids[i]) + "," + std::to_string(band_num[i]) + ");";
+                if (sqlite3_exec(_db, sql_insert_gdalref.c_str(), NULL, NULL, NULL) != SQLITE_OK) {
+                    if (strict) throw std::string("ERROR in image_collection::add(): cannot add dataset to gdalrefs table.");
+                    GCBS_WARN("Skipping " + *it + "  due to failed gdalrefs insert");
+                    break;  // break only works because there is nothing after the loop.
                 }
             }
 
@@ -1048,25 +1145,18 @@ void image_collection::add_with_collection_format(std::vector<std::string> descr
             // Input dataset is multitemporal, bands represent different points in time
             // Add as multiple images to the image collection as
 
-            boost::cmatch res_datetime;
-            if (!boost::regex_match(it->c_str(), res_datetime, regex_datetime)) {  // not sure to continue or throw an exception here...
+            if (!match.datetime) {  // not sure to continue or throw an exception here...
                 if (strict) throw std::string("ERROR in image_collection::add(): datetime rule failed for " + std::string(*it));
                 GCBS_WARN("Skipping " + *it + " due to failed datetime rule");
                 continue;
             }
 
             date::sys_seconds pt;
-            pt = datetime::tryparse(datetime_format, res_datetime[1].str());
+            pt = datetime::tryparse(datetime_format, match.datetime_str);
 
             // find the corresponding band of the dataset (there can be only 1 because bands represent time)
             // and update band information in database if needed
-            int16_t band_index = -1;
-            for (uint16_t i = 0; i < band_name.size(); ++i) {
-                if (boost::regex_match(*it, regex_band_pattern[i])) {
-                    band_index = i;
-                    break;
-                }
-            }
+            int16_t band_index = match.bands.empty() ? -1 : match.bands[0];
             if (band_index == -1) {
                 continue;
             }
@@ -1108,7 +1198,7 @@ void image_collection::add_with_collection_format(std::vector<std::string> descr
                 datetime t = datetime(pt, band_time_delta.dt_unit) + (band_time_delta * i);
 
                 // add image to collection
-                std::string image_name = res_image[1].str() + "_" + t.to_string();
+                std::string image_name = match.image_name + "_" + t.to_string();
                 std::string sql_insert_image = "INSERT OR IGNORE INTO images(name, datetime, left, top, bottom, right, proj) VALUES('" + image_name + "','" +
                                                t.to_string(datetime_unit::SECOND) + "'," +
                                                std::to_string(bbox.left) + "," + std::to_string(bbox.top) + "," + std::to_string(bbox.bottom) + "," + std::to_string(bbox.right) + ",'" + srs_str + "')";
@@ -1146,6 +1236,9 @@ void image_collection::write(const std::string filename) {
         return;
     }
 
+    if (_snapshot) {
+        throw std::string("ERROR in image_collection::write(): image collection snapshots cannot be written as database");
+    }
     if (!_db) {
         throw std::string("ERROR in image_collection::write(): database handle is not open");
     }
@@ -1170,9 +1263,21 @@ void image_collection::write(const std::string filename) {
 
     // Enable foreign key constraints
     sqlite3_db_config(_db, SQLITE_DBCONFIG_ENABLE_FKEY, 1, NULL);  // this is important!
+
+    // relative shard filenames refer to the directory of the previous manifest
+    for (uint32_t i = 0; i < _shard_info.size(); ++i) {
+        _shard_info[i].filename = filesystem::make_absolute(_shard_info[i].filename);
+        std::string sql = "UPDATE shards SET filename='" + sqlite_escape_singlequotes(_shard_info[i].filename) + "' WHERE id=" + std::to_string(_shard_info[i].id) + ";";
+        if (sqlite3_exec(_db, sql.c_str(), NULL, NULL, NULL) != SQLITE_OK) {
+            throw std::string("ERROR in image_collection::write(): cannot update shard filenames.");
+        }
+    }
 }
 
 uint16_t image_collection::count_bands() {
+    if (_snapshot) {
+        return _snapshot->get_bands().size();
+    }
     std::string sql = "SELECT COUNT(*) FROM bands;";
 
     sqlite3_stmt* stmt;
@@ -1187,6 +1292,14 @@ uint16_t image_collection::count_bands() {
 }
 
 uint32_t image_collection::count_images() {
+    if (_snapshot) {
+        return _snapshot->count_images();
+    }
+    if (is_sharded()) {
+        uint32_t n = 0;
+        for (uint32_t i = 0; i < _shard_info.size(); ++i) n += _shard_info[i].image_count;
+        return n;
+    }
     std::string sql = "SELECT COUNT(*) FROM images;";
 
     sqlite3_stmt* stmt;
@@ -1195,12 +1308,20 @@ uint32_t image_collection::count_images() {
         throw std::string("ERROR in image_collection::count_images(): cannot read query result");
     }
     sqlite3_step(stmt);
-    uint16_t out = sqlite3_column_int(stmt, 0);
+    uint32_t out = sqlite3_column_int(stmt, 0);
     sqlite3_finalize(stmt);
     return out;
 }
 
 uint32_t image_collection::count_gdalrefs() {
+    if (_snapshot) {
+        return _snapshot->count_gdalrefs();
+    }
+    if (is_sharded()) {
+        uint32_t n = 0;
+        for (uint32_t i = 0; i < _shard_info.size(); ++i) n += _shard_info[i].gdalref_count;
+        return n;
+    }
     std::string sql = "SELECT COUNT(*) FROM gdalrefs;";
 
     sqlite3_stmt* stmt;
@@ -1209,7 +1330,7 @@ uint32_t image_collection::count_gdalrefs() {
         throw std::string("ERROR in image_collection::count_gdalrefs(): cannot read query result");
     }
     sqlite3_step(stmt);
-    uint16_t out = sqlite3_column_int(stmt, 0);
+    uint32_t out = sqlite3_column_int(stmt, 0);
     sqlite3_finalize(stmt);
     return out;
 }
@@ -1232,6 +1353,9 @@ std::string image_collection::to_string() {
 }
 
 void image_collection::filter_bands(std::vector<std::string> bands) {
+    if (is_sharded() || is_snapshot()) {
+        throw std::string("ERROR in image_collection::filter_bands(): sharded image collections and snapshots cannot be modified");
+    }
     // This implementation requires a foreign key constraint for gdalrefs table with cascade delete
 
     if (bands.empty()) {
@@ -1253,6 +1377,9 @@ void image_collection::filter_bands(std::vector<std::string> bands) {
 }
 
 void image_collection::filter_datetime_range(date::sys_seconds start, date::sys_seconds end) {
+    if (is_sharded() || is_snapshot()) {
+        throw std::string("ERROR in image_collection::filter_datetime_range(): sharded image collections and snapshots cannot be modified");
+    }
     // This implementation requires a foreign key constraint for the gdalrefs table with cascade delete
 
     std::ostringstream os;
@@ -1270,6 +1397,9 @@ void image_collection::filter_datetime_range(date::sys_seconds start, date::sys_
 }
 
 void image_collection::filter_spatial_range(bounds_2d<double> range, std::string proj) {
+    if (is_sharded() || is_snapshot()) {
+        throw std::string("ERROR in image_collection::filter_spatial_range(): sharded image collections and snapshots cannot be modified");
+    }
     // This implementation requires a foreign key constraint for the gdalrefs table with cascade delete
 
     range.transform(proj, "EPSG:4326");
@@ -1281,6 +1411,14 @@ void image_collection::filter_spatial_range(bounds_2d<double> range, std::string
 }
 
 uint16_t image_collection::pixel_size_bytes(std::string band) {
+    if (_snapshot) {
+        uint16_t out = 0;
+        std::vector<image_collection::bands_row> b = _snapshot->get_bands();
+        for (uint16_t i = 0; i < b.size(); ++i) {
+            if (band.empty() || b[i].name == band) out += GDALGetDataTypeSizeBytes(b[i].type);
+        }
+        return out;
+    }
     std::string sql = "SELECT type FROM bands";
     if (!band.empty()) sql += " WHERE name='" + band + "'";
     sql += ";";
@@ -1300,6 +1438,55 @@ uint16_t image_collection::pixel_size_bytes(std::string band) {
 }
 
 bounds_st image_collection::extent() {
+    if (_snapshot) {
+        std::vector<image_collection::images_row> img = _snapshot->get_images();
+        if (img.empty()) {
+            throw std::string("ERROR in image_collection::extent(): image collection snapshot is empty");
+        }
+        bounds_st out;
+        out.s.left = img[0].left;
+        out.s.right = img[0].right;
+        out.s.bottom = img[0].bottom;
+        out.s.top = img[0].top;
+        out.t0 = datetime::from_string(img[0].datetime);
+        out.t1 = out.t0;
+        std::string t0 = out.t0.to_string(datetime_unit::SECOND);
+        std::string t1 = t0;
+        for (uint32_t i = 1; i < img.size(); ++i) {
+            out.s.left = std::min(out.s.left, img[i].left);
+            out.s.right = std::max(out.s.right, img[i].right);
+            out.s.bottom = std::min(out.s.bottom, img[i].bottom);
+            out.s.top = std::max(out.s.top, img[i].top);
+            datetime t = datetime::from_string(img[i].datetime);
+            std::string ts = t.to_string(datetime_unit::SECOND);
+            if (ts < t0) {
+                t0 = ts;
+                out.t0 = t;
+            }
+            if (ts > t1) {
+                t1 = ts;
+                out.t1 = t;
+            }
+        }
+        return out;
+    }
+    if (is_sharded()) {
+        bounds_st out;
+        out.s = _shard_info[0].extent;
+        std::string t0 = _shard_info[0].t0;
+        std::string t1 = _shard_info[0].t1;
+        for (uint32_t i = 1; i < _shard_info.size(); ++i) {
+            out.s.left = std::min(out.s.left, _shard_info[i].extent.left);
+            out.s.right = std::max(out.s.right, _shard_info[i].extent.right);
+            out.s.bottom = std::min(out.s.bottom, _shard_info[i].extent.bottom);
+            out.s.top = std::max(out.s.top, _shard_info[i].extent.top);
+            t0 = std::min(t0, _shard_info[i].t0);
+            t1 = std::max(t1, _shard_info[i].t1);
+        }
+        out.t0 = datetime::from_string(t0);
+        out.t1 = datetime::from_string(t1);
+        return out;
+    }
     std::string sql = "SELECT min(left), max(right), min(bottom), max(top), min(datetime), max(datetime) FROM images;";
     sqlite3_stmt* stmt;
     sqlite3_prepare_v2(_db, sql.c_str(), -1, &stmt, NULL);
@@ -1321,12 +1508,227 @@ bounds_st image_collection::extent() {
     return out;
 }
 
+// Create a coordinate transformation with longitude / easting as first axis for both SRS
+static OGRCoordinateTransformation* footprint_transformation(std::string srs_from, std::string srs_to) {
+    OGRSpatialReference srs_in;
+    OGRSpatialReference srs_out;
+    if (srs_in.SetFromUserInput(srs_from.c_str()) != OGRERR_NONE || srs_out.SetFromUserInput(srs_to.c_str()) != OGRERR_NONE) {
+        return nullptr;
+    }
+#if GDAL_VERSION_MAJOR >= 3
+    srs_in.SetAxisMappingStrategy(OAMS_TRADITIONAL_GIS_ORDER);
+    srs_out.SetAxisMappingStrategy(OAMS_TRADITIONAL_GIS_ORDER);
+#endif
+    return OGRCreateCoordinateTransformation(&srs_in, &srs_out);
+}
+
+// Polygon of a rectangle with n points per edge in WGS84 longitude / latitude, nullptr if transformation fails
+static OGRPolygon* footprint_range_polygon(bounds_2d<double> b, std::string srs, uint16_t n = 16) {
+    OGRLinearRing* ring = new OGRLinearRing();
+    for (uint16_t i = 0; i < n; ++i) ring->addPoint(b.left + i * (b.right - b.left) / n, b.bottom);
+    for (uint16_t i = 0; i < n; ++i) ring->addPoint(b.right, b.bottom + i * (b.top - b.bottom) / n);
+    for (uint16_t i = 0; i < n; ++i) ring->addPoint(b.right - i * (b.right - b.left) / n, b.top);
+    for (uint16_t i = 0; i < n; ++i) ring->addPoint(b.left, b.top - i * (b.top - b.bottom) / n);
+    ring->closeRings();
+    OGRPolygon* poly = new OGRPolygon();
+    poly->addRingDirectly(ring);
+    if (srs != "EPSG:4326") {
+        OGRCoordinateTransformation* ct = footprint_transformation(srs, "EPSG:4326");
+        if (!ct || poly->transform(ct) != OGRERR_NONE) {
+            if (ct) OCTDestroyCoordinateTransformation(ct);
+            delete poly;
+            return nullptr;
+        }
+        OCTDestroyCoordinateTransformation(ct);
+    }
+    return poly;
+}
+
+image_collection::image_md_predicate image_collection::image_md_predicate::from_string(std::string s) {
+    image_md_predicate out;
+    std::size_t pos = s.find_first_of("<>=!");
+    if (pos == std::string::npos || pos == 0) {
+        throw std::string("ERROR in image_md_predicate::from_string(): invalid predicate '" + s + "', expected e.g. 'eo:cloud_cover < 30'");
+    }
+    std::size_t len = (pos + 1 < s.length() && s[pos + 1] == '=') ? 2 : 1;
+    out.op = s.substr(pos, len);
+    if (out.op == "==") out.op = "=";
+    if (out.op != "=" && out.op != "!=" && out.op != "<" && out.op != "<=" && out.op != ">" && out.op != ">=") {
+        throw std::string("ERROR in image_md_predicate::from_string(): invalid operator '" + out.op + "' in predicate '" + s + "'");
+    }
+    auto trim = [](std::string x, bool& quoted) {
+        quoted = false;
+        std::size_t a = x.find_first_not_of(" \t");
+        std::size_t b = x.find_last_not_of(" \t");
+        if (a == std::string::npos) return std::string("");
+        x = x.substr(a, b - a + 1);
+        // remove optional quotes
+        if (x.length() >= 2 && (x[0] == '\'' || x[0] == '"') && x[x.length() - 1] == x[0]) {
+            x = x.substr(1, x.length() - 2);
+            quoted = true;
+        }
+        return x;
+    };
+    bool key_quoted;
+    out.key = trim(s.substr(0, pos), key_quoted);
+    out.value = trim(s.substr(pos + len), out.quoted);
+    if (out.key.empty()) {
+        throw std::string("ERROR in image_md_predicate::from_string(): missing key in predicate '" + s + "'");
+    }
+    return out;
+}
+
+std::string image_collection::image_md_predicate_sql(const image_md_predicate& p) {
+    std::string cond;
+    char* end = nullptr;
+    std::strtod(p.value.c_str(), &end);
+    bool numeric = !p.quoted && !p.value.empty() && end && *end == '\0' && p.value.find_first_not_of("0123456789+-.eE") == std::string::npos;
+    if (numeric) {
+        cond = "CAST(value AS REAL) " + p.op + " " + p.value;
+    } else {
+        cond = "value " + p.op + " '" + sqlite_escape_singlequotes(p.value) + "'";
+    }
+    return "images.id IN (SELECT image_id FROM image_md WHERE key = '" + sqlite_escape_singlequotes(p.key) + "' AND " + cond + ")";
+}
+
+void image_collection::create_image_md_index() {
+    if (_snapshot) {
+        return;
+    }
+    if (is_sharded()) {
+        // shards that are opened later will create the index in shard()
+        std::lock_guard<std::mutex> lock(_shards_mutex);
+        _shards_md_index = true;
+        for (auto it = _shards.begin(); it != _shards.end(); ++it) {
+            it->second->create_image_md_index();
+        }
+        return;
+    }
+    sqlite3_exec(_db, "CREATE INDEX IF NOT EXISTS idx_image_md_key ON image_md(key, value);", NULL, NULL, NULL);
+}
+
+// Order of find_range_st() results as defined by its ORDER BY clause, used to merge results of several shards
+struct find_range_st_row_less {
+    find_range_st_row_less(std::vector<std::string> order_by, std::string image_md_order) : _order_by(order_by),
+                                                                                            _md_order(!image_md_order.empty()),
+                                                                                            _md_desc(!image_md_order.empty() && image_md_order[0] == '-') {}
+
+    bool operator()(const image_collection::find_range_st_row& a, const image_collection::find_range_st_row& b) const {
+        if (_md_order) {
+            if (a.md_order_null != b.md_order_null) return b.md_order_null;
+            if (!a.md_order_null) {
+                // same as CAST(value AS REAL) followed by value in SQL
+                double va = std::strtod(a.md_order_value.c_str(), nullptr);
+                double vb = std::strtod(b.md_order_value.c_str(), nullptr);
+                if (va != vb) return _md_desc ? va > vb : va < vb;
+                int c = a.md_order_value.compare(b.md_order_value);
+                if (c != 0) return _md_desc ? c > 0 : c < 0;
+            }
+            if (a.image_id != b.image_id) return a.image_id < b.image_id;
+        }
+        for (uint16_t i = 0; i < _order_by.size(); ++i) {
+            int c = compare(a, b, _order_by[i]);
+            if (c != 0) return c < 0;
+        }
+        return false;
+    }
+
+   private:
+    static int compare(const image_collection::find_range_st_row& a, const image_collection::find_range_st_row& b, const std::string& column) {
+        if (column == "gdalrefs.image_id") return (a.image_id < b.image_id) ? -1 : (a.image_id > b.image_id ? 1 : 0);
+        if (column == "gdalrefs.band_num") return (a.band_num < b.band_num) ? -1 : (a.band_num > b.band_num ? 1 : 0);
+        if (column == "images.name") return a.image_name.compare(b.image_name);
+        if (column == "gdalrefs.descriptor") return a.descriptor.compare(b.descriptor);
+        if (column == "images.datetime") return a.datetime.compare(b.datetime);
+        if (column == "bands.name") return a.band_name.compare(b.band_name);
+        if (column == "images.proj") return a.srs.compare(b.srs);
+        return 0;
+    }
+
+    std::vector<std::string> _order_by;
+    bool _md_order;
+    bool _md_desc;
+};
+
 std::vector<image_collection::find_range_st_row> image_collection::find_range_st(bounds_st range, std::string srs,
-                                                                                 std::vector<std::string> bands, std::vector<std::string> order_by) {
+                                                                                 std::vector<std::string> bands, std::vector<std::string> order_by,
+                                                                                 const std::vector<image_md_predicate>& image_md_filter, std::string image_md_order) {
     bounds_2d<double> range_trans = (srs == "EPSG:4326") ? range.s : range.s.transform(srs, "EPSG:4326");
+
+    if (_snapshot) {
+        OGRPolygon* range_poly = nullptr;
+        if (_snapshot->has_footprints()) {
+            range_poly = footprint_range_polygon(range.s, srs);
+            if (!range_poly) {
+                GCBS_DEBUG("Failed to transform query range to WGS84; image footprints will be ignored");
+            }
+        }
+        // rows of a snapshot are already sorted
+        std::vector<find_range_st_row> out;
+        try {
+            out = _snapshot->find_range_st(range_trans, range.t0.to_string(datetime_unit::SECOND), range.t1.to_string(datetime_unit::SECOND),
+                                           bands, image_md_filter, image_md_order, range_poly);
+        } catch (...) {
+            if (range_poly) delete range_poly;
+            throw;
+        }
+        if (range_poly) delete range_poly;
+        if (order_by != _snapshot->order_by()) {
+            std::stable_sort(out.begin(), out.end(), find_range_st_row_less(order_by, image_md_order));
+        }
+        return out;
+    }
+
+    if (is_sharded()) {
+        // only query shards intersecting with the range
+        std::string t0 = range.t0.to_string(datetime_unit::SECOND);
+        std::string t1 = range.t1.to_string(datetime_unit::SECOND);
+        std::vector<find_range_st_row> out;
+        uint32_t nshards = 0;
+        for (uint32_t i = 0; i < _shard_info.size(); ++i) {
+            const shard_info& si = _shard_info[i];
+            if (si.t1 < t0 || si.t0 > t1) continue;
+            if (si.extent.right < range_trans.left || si.extent.left > range_trans.right || si.extent.bottom > range_trans.top || si.extent.top < range_trans.bottom) continue;
+            std::vector<find_range_st_row> x = shard(i)->find_range_st(range, srs, bands, order_by, image_md_filter, image_md_order);
+            if (x.empty()) continue;
+            for (uint32_t j = 0; j < x.size(); ++j) {
+                x[j].image_id += si.id_offset;
+                out.push_back(x[j]);
+            }
+            ++nshards;
+        }
+        if (nshards > 1 && (!order_by.empty() || !image_md_order.empty())) {
+            std::stable_sort(out.begin(), out.end(), find_range_st_row_less(order_by, image_md_order));
+        }
+        return out;
+    }
+
+    // Images with footprints are tested against the range polygon after the bounding box query
+    bool use_footprints = has_footprints();
+    OGRPolygon* range_poly = nullptr;
+    if (use_footprints) {
+        range_poly = footprint_range_polygon(range.s, srs);
+        if (!range_poly) {
+            GCBS_DEBUG("Failed to transform query range to WGS84; image footprints will be ignored");
+            use_footprints = false;
+        }
+    }
+
     std::string sql =  // TODO: do we really need image_name ?
-        "SELECT gdalrefs.image_id, images.name, gdalrefs.descriptor, images.datetime, bands.name, gdalrefs.band_num, images.proj "
-        "FROM images INNER JOIN gdalrefs ON images.id = gdalrefs.image_id INNER JOIN bands ON gdalrefs.band_id = bands.id WHERE "
+        "SELECT gdalrefs.image_id, images.name, gdalrefs.descriptor, images.datetime, bands.name, gdalrefs.band_num, images.proj, images.left, images.top, images.bottom, images.right" +
+        std::string(use_footprints ? ", image_footprints.geom" : "") + std::string(image_md_order.empty() ? "" : ", md_order.value") +
+        " FROM images INNER JOIN gdalrefs ON images.id = gdalrefs.image_id INNER JOIN bands ON gdalrefs.band_id = bands.id " +
+        std::string(use_footprints ? "LEFT JOIN image_footprints ON images.id = image_footprints.image_id " : "");
+
+    bool md_order_desc = !image_md_order.empty() && image_md_order[0] == '-';
+    if (md_order_desc) image_md_order = image_md_order.substr(1);
+    if (!image_md_order.empty()) {
+        sql += "LEFT JOIN image_md AS md_order ON images.id = md_order.image_id AND md_order.key = '" + sqlite_escape_singlequotes(image_md_order) + "' ";
+    }
+    for (uint16_t ip = 0; ip < image_md_filter.size(); ++ip) {
+        sql += (ip == 0 ? "WHERE " : "") + image_md_predicate_sql(image_md_filter[ip]) + " AND ";
+    }
+    sql += std::string(image_md_filter.empty() ? "WHERE " : "") +
         "strftime('%Y-%m-%dT%H:%M:%S', images.datetime) >= '" +
         range.t0.to_string(datetime_unit::SECOND) + "' AND strftime('%Y-%m-%dT%H:%M:%S', images.datetime) <= '" + range.t1.to_string(datetime_unit::SECOND) +
         "' AND NOT "
@@ -1341,8 +1743,15 @@ std::vector<image_collection::find_range_st_row> image_collection::find_range_st
         bandlist += "'" + bands[bands.size() - 1] + "'";
         sql += " AND bands.name IN (" + bandlist + ")";
     }
+    if (!image_md_order.empty()) {
+        // images without the key come last, numeric values are sorted numerically and strings lexicographically
+        std::string dir = md_order_desc ? " DESC" : " ASC";
+        sql += " ORDER BY md_order.value IS NULL, CAST(md_order.value AS REAL)" + dir + ", md_order.value" + dir + ", gdalrefs.image_id";
+        if (!order_by.empty()) sql += ", ";
+    } else if (!order_by.empty()) {
+        sql += " ORDER BY ";
+    }
     if (!order_by.empty()) {
-        sql += "ORDER BY ";
         for (uint16_t io = 0; io < order_by.size() - 1; ++io) {
             if (order_by[io] == "gdalrefs.image_id" ||
                 order_by[io] == "images.name" ||
@@ -1374,10 +1783,26 @@ std::vector<image_collection::find_range_st_row> image_collection::find_range_st
     sqlite3_stmt* stmt;
     sqlite3_prepare_v2(_db, sql.c_str(), -1, &stmt, NULL);
     if (!stmt) {
+        if (range_poly) delete range_poly;
         throw std::string("ERROR in image_collection::find_range_st(): cannot prepare query statement");
     }
     std::vector<find_range_st_row> out;
+    std::unordered_map<uint32_t, bool> footprint_intersects;
     while (sqlite3_step(stmt) == SQLITE_ROW) {
+        if (use_footprints && sqlite3_column_type(stmt, 11) == SQLITE_BLOB) {
+            uint32_t image_id = sqlite3_column_int(stmt, 0);
+            auto it = footprint_intersects.find(image_id);
+            if (it == footprint_intersects.end()) {
+                bool intersects = true;
+                OGRGeometry* geom = nullptr;
+                if (OGRGeometryFactory::createFromWkb(sqlite3_column_blob(stmt, 11), nullptr, &geom, sqlite3_column_bytes(stmt, 11)) == OGRERR_NONE && geom) {
+                    intersects = geom->Intersects(range_poly);
+                }
+                if (geom) OGRGeometryFactory::destroyGeometry(geom);
+                it = footprint_intersects.insert(std::make_pair(image_id, intersects)).first;
+            }
+            if (!it->second) continue;
+        }
         find_range_st_row r;
         r.image_id = sqlite3_column_int(stmt, 0);
         r.image_name = sqlite_as_string(stmt, 1);
@@ -1386,15 +1811,145 @@ std::vector<image_collection::find_range_st_row> image_collection::find_range_st
         r.band_name = sqlite_as_string(stmt, 4);
         r.band_num = sqlite3_column_int(stmt, 5);
         r.srs = sqlite_as_string(stmt, 6);
+        r.left = sqlite3_column_double(stmt, 7);
+        r.top = sqlite3_column_double(stmt, 8);
+        r.bottom = sqlite3_column_double(stmt, 9);
+        r.right = sqlite3_column_double(stmt, 10);
+        if (!image_md_order.empty()) {
+            uint16_t col = use_footprints ? 12 : 11;
+            r.md_order_null = sqlite3_column_type(stmt, col) == SQLITE_NULL;
+            if (!r.md_order_null) r.md_order_value = sqlite_as_string(stmt, col);
+        }
 
         out.push_back(r);
     }
     sqlite3_finalize(stmt);
+    if (range_poly) delete range_poly;
     return out;
 }
 
+bool image_collection::has_footprints() {
+    if (_snapshot) {
+        return _snapshot->has_footprints();
+    }
+    int has = _has_footprints.load();
+    if (has < 0) {
+        has = sqlite_has_table(_db, "image_footprints") ? 1 : 0;
+        _has_footprints.store(has);
+    }
+    return has == 1;
+}
+
+std::unordered_map<uint32_t, std::string> image_collection::get_image_footprints(const std::vector<uint32_t>& image_id) {
+    std::unordered_map<uint32_t, std::string> out;
+    if (_snapshot) {
+        return _snapshot->get_image_footprints(image_id);
+    }
+    if (is_sharded()) {
+        // image ids of shards are shifted by increasing offsets
+        std::map<uint32_t, std::vector<uint32_t>> shard_ids;
+        for (uint32_t i = 0; i < image_id.size(); ++i) {
+            int32_t is = -1;
+            for (uint32_t j = 0; j < _shard_info.size(); ++j) {
+                if (_shard_info[j].id_offset <= image_id[i] && (is < 0 || _shard_info[j].id_offset > _shard_info[is].id_offset)) {
+                    is = j;
+                }
+            }
+            if (is >= 0) shard_ids[is].push_back(image_id[i] - _shard_info[is].id_offset);
+        }
+        for (auto it = shard_ids.begin(); it != shard_ids.end(); ++it) {
+            std::unordered_map<uint32_t, std::string> x = shard(it->first)->get_image_footprints(it->second);
+            for (auto jt = x.begin(); jt != x.end(); ++jt) {
+                out[jt->first + _shard_info[it->first].id_offset] = jt->second;
+            }
+        }
+        return out;
+    }
+    if (!has_footprints()) {
+        return out;
+    }
+    sqlite3_stmt* stmt;
+    sqlite3_prepare_v2(_db, "SELECT geom FROM image_footprints WHERE image_id = ?;", -1, &stmt, NULL);
+    if (!stmt) {
+        throw std::string("ERROR in image_collection::get_image_footprints(): cannot prepare query statement");
+    }
+    for (uint32_t i = 0; i < image_id.size(); ++i) {
+        sqlite3_bind_int64(stmt, 1, image_id[i]);
+        if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_type(stmt, 0) == SQLITE_BLOB) {
+            out[image_id[i]] = std::string((const char*)sqlite3_column_blob(stmt, 0), sqlite3_column_bytes(stmt, 0));
+        }
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+    return out;
+}
+
+// Parse a WKT or GeoJSON footprint and convert to WKB, returns an empty string if the geometry is not a (multi)polygon
+static std::string footprint_wkb(const std::string& geom) {
+    const uint32_t MAX_WKB_SIZE = 2048;  // larger footprints are replaced by their convex hull
+    OGRGeometry* g = nullptr;
+    std::size_t first = geom.find_first_not_of(" \t\n");
+    if (first != std::string::npos && geom[first] == '{') {
+        g = OGRGeometryFactory::createFromGeoJson(geom.c_str());
+    } else {
+        OGRGeometryFactory::createFromWkt(geom.c_str(), nullptr, &g);
+    }
+    if (!g) {
+        return "";
+    }
+    OGRwkbGeometryType t = wkbFlatten(g->getGeometryType());
+    if (t != wkbPolygon && t != wkbMultiPolygon) {
+        OGRGeometryFactory::destroyGeometry(g);
+        return "";
+    }
+    if ((uint32_t)g->WkbSize() > MAX_WKB_SIZE) {
+        OGRGeometry* hull = g->ConvexHull();
+        if (hull) {
+            OGRGeometryFactory::destroyGeometry(g);
+            g = hull;
+        }
+    }
+    std::string out(g->WkbSize(), '\0');
+    g->exportToWkb(wkbNDR, reinterpret_cast<unsigned char*>(&out[0]));
+    OGRGeometryFactory::destroyGeometry(g);
+    return out;
+}
+
+void image_collection::insert_image_footprint(uint32_t image_id, std::string geom) {
+    insert_image_footprints(std::vector<uint32_t>{image_id}, std::vector<std::string>{geom});
+}
+
+void image_collection::insert_image_footprints(const std::vector<uint32_t>& image_id, const std::vector<std::string>& geom) {
+    bulk_insert_guard g(this);
+    if (image_id.size() != geom.size()) {
+        GCBS_ERROR("Arguments must have identical size.");
+        throw std::string("Arguments must have identical size.");
+    }
+    if (sqlite3_exec(_db, SQL_CREATE_FOOTPRINTS, NULL, NULL, NULL) != SQLITE_OK) {
+        GCBS_ERROR("Failed to create image footprints table in image collection database");
+        throw std::string("Failed to create image footprints table in image collection database");
+    }
+    _has_footprints.store(1);
+    sqlite3_stmt* stmt = g.prepare("INSERT OR REPLACE INTO image_footprints(image_id, geom) VALUES(?, ?);");
+    for (std::size_t i = 0; i < image_id.size(); ++i) {
+        if (geom[i].empty()) continue;
+        std::string wkb = footprint_wkb(geom[i]);
+        if (wkb.empty()) {
+            GCBS_WARN("Invalid footprint of image " + std::to_string(image_id[i]) + " will be ignored; expected a Polygon or MultiPolygon");
+            continue;
+        }
+        sqlite3_bind_int64(stmt, 1, image_id[i]);
+        sqlite3_bind_blob(stmt, 2, wkb.data(), wkb.size(), SQLITE_TRANSIENT);
+        g.step(stmt, "image_footprints", i);
+    }
+    g.done();
+}
+
 std::vector<image_collection::bands_row> image_collection::get_all_bands() {
     std::vector<image_collection::bands_row> out;
+    if (_snapshot) {
+        return _snapshot->get_bands();
+    }
 
     //std::string sql = "SELECT id, name, type, offset,scale, unit, nodata FROM bands ORDER BY name;";  // changing the order my have consequences to data read implementations
 
@@ -1419,6 +1974,25 @@ std::vector<image_collection::bands_row> image_collection::get_all_bands() {
         out.push_back(row);
     }
     sqlite3_finalize(stmt);
+
+    if (is_sharded()) {
+        // the manifest has no images, all bands of shards are identical; image counts are taken from the manifest if available
+        for (uint32_t i = 0; i < _shard_info.size(); ++i) {
+            if (_shard_info[i].has_summary) {
+                for (uint16_t ib = 0; ib < out.size(); ++ib) {
+                    auto it = _shard_info[i].band_image_count.find(out[ib].id);
+                    if (it != _shard_info[i].band_image_count.end()) out[ib].image_count += it->second;
+                }
+                continue;
+            }
+            std::vector<image_collection::bands_row> x = shard(i)->get_all_bands();
+            for (uint16_t ib = 0; ib < out.size(); ++ib) {
+                for (uint16_t jb = 0; jb < x.size(); ++jb) {
+                    if (x[jb].id == out[ib].id) out[ib].image_count += x[jb].image_count;
+                }
+            }
+        }
+    }
     return out;
 }
 
@@ -1439,6 +2013,19 @@ sqlite3* image_collection::get_db_handle() {
 
 std::vector<image_collection::gdalrefs_row> image_collection::get_gdalrefs() {
     std::vector<image_collection::gdalrefs_row> out;
+    if (_snapshot) {
+        return _snapshot->get_gdalrefs();
+    }
+    if (is_sharded()) {
+        for (uint32_t i = 0; i < _shard_info.size(); ++i) {
+            std::vector<image_collection::gdalrefs_row> x = shard(i)->get_gdalrefs();
+            for (uint32_t j = 0; j < x.size(); ++j) {
+                x[j].image_id += _shard_info[i].id_offset;
+                out.push_back(x[j]);
+            }
+        }
+        return out;
+    }
 
     std::string sql = "SELECT image_id, band_id, descriptor, band_num FROM gdalrefs";
     sqlite3_stmt* stmt;
@@ -1461,6 +2048,19 @@ std::vector<image_collection::gdalrefs_row> image_collection::get_gdalrefs() {
 
 std::vector<image_collection::images_row> image_collection::get_images() {
     std::vector<image_collection::images_row> out;
+    if (_snapshot) {
+        return _snapshot->get_images();
+    }
+    if (is_sharded()) {
+        for (uint32_t i = 0; i < _shard_info.size(); ++i) {
+            std::vector<image_collection::images_row> x = shard(i)->get_images();
+            for (uint32_t j = 0; j < x.size(); ++j) {
+                x[j].id += _shard_info[i].id_offset;
+                out.push_back(x[j]);
+            }
+        }
+        return out;
+    }
     std::string sql = "SELECT id, name, left, top, bottom, right, datetime, proj FROM images";
     sqlite3_stmt* stmt;
     sqlite3_prepare_v2(_db, sql.c_str(), -1, &stmt, NULL);
@@ -1487,6 +2087,22 @@ std::vector<image_collection::images_row> image_collection::get_images() {
 
 std::string image_collection::distinct_srs() {
     std::string out = "";
+    if (_snapshot) {
+        std::vector<image_collection::images_row> img = _snapshot->get_images();
+        for (uint32_t i = 0; i < img.size(); ++i) {
+            if (i > 0 && img[i].proj != out) return "";
+            out = img[i].proj;
+        }
+        return out;
+    }
+    if (is_sharded()) {
+        for (uint32_t i = 0; i < _shard_info.size(); ++i) {
+            std::string x = _shard_info[i].has_summary ? _shard_info[i].srs : shard(i)->distinct_srs();
+            if (x.empty() || (i > 0 && x != out)) return "";
+            out = x;
+        }
+        return out;
+    }
     std::string sql = "SELECT DISTINCT proj from images;";
     sqlite3_stmt* stmt;
     sqlite3_prepare_v2(_db, sql.c_str(), -1, &stmt, NULL);
@@ -1507,6 +2123,25 @@ std::string image_collection::distinct_srs() {
 
 bool image_collection::is_aligned() {
     bool aligned = false;
+    if (_snapshot) {
+        std::vector<image_collection::images_row> img = _snapshot->get_images();
+        for (uint32_t i = 1; i < img.size(); ++i) {
+            if (img[i].left != img[0].left || img[i].top != img[0].top || img[i].bottom != img[0].bottom ||
+                img[i].right != img[0].right || img[i].proj != img[0].proj) return false;
+        }
+        return !img.empty();
+    }
+    if (is_sharded()) {
+        // all shards must be aligned with identical extent and SRS
+        if (distinct_srs().empty()) return false;
+        for (uint32_t i = 0; i < _shard_info.size(); ++i) {
+            if (!(_shard_info[i].has_summary ? _shard_info[i].aligned : shard(i)->is_aligned())) return false;
+            const bounds_2d<double>& a = _shard_info[i].extent;
+            const bounds_2d<double>& b = _shard_info[0].extent;
+            if (a.left != b.left || a.right != b.right || a.bottom != b.bottom || a.top != b.top) return false;
+        }
+        return true;
+    }
     std::string sql = "SELECT DISTINCT \"left\", \"top\", \"bottom\", \"right\", \"proj\" from images;";
     sqlite3_stmt* stmt;
     sqlite3_prepare_v2(_db, sql.c_str(), -1, &stmt, NULL);
@@ -1525,40 +2160,334 @@ bool image_collection::is_aligned() {
     return aligned;
 }
 
-std::vector<std::string> image_collection::unroll_archives(std::vector<std::string> descriptors) {
-    std::vector<std::string> out;
+void image_collection::write_snapshot(std::string filename, bounds_st range, std::string srs, std::vector<std::string> bands,
+                                      const std::vector<image_md_predicate>& image_md_filter, std::string image_md_order) {
+    std::vector<std::string> order_by = {"gdalrefs.image_id", "gdalrefs.descriptor"};
+    std::vector<find_range_st_row> rows = find_range_st(range, srs, bands, order_by, image_md_filter, image_md_order);
 
-    for (uint32_t i = 0; i < descriptors.size(); ++i) {
-        std::string s = descriptors[i];
-        if (s.compare(s.length() - 4, 4, ".zip") == 0 || s.compare(s.length() - 4, 4, ".ZIP") == 0) {
-            char** y = VSIReadDirRecursive(("/vsizip/" + s).c_str());
-            char** x = y;
-            if (x != NULL) {
-                while (*x != NULL) {
-                    out.push_back("/vsizip/" + filesystem::join(s, *x));
-                    ++x;
-                }
-                CSLDestroy(y);
-            }
+    // footprints are kept such that chunks of worker processes are still tested against them
+    std::vector<uint32_t> image_id;
+    for (uint32_t i = 0; i < rows.size(); ++i) {
+        if (image_id.empty() || image_id.back() != rows[i].image_id) image_id.push_back(rows[i].image_id);
+    }
+    collection_snapshot::write(filename, get_all_bands(), rows, get_image_footprints(image_id), image_md_filter, image_md_order, order_by);
+    GCBS_DEBUG("Written snapshot of " + std::to_string(rows.size()) + " GDAL dataset references to '" + filename + "'");
+}
 
-        } else if (s.compare(s.length() - 3, 3, ".gz") == 0 || s.compare(s.length() - 3, 3, ".GZ") == 0) {
-            out.push_back("/vsigzip/" + s);
-        } else if (s.compare(s.length() - 4, 4, ".tar") == 0 || s.compare(s.length() - 4, 4, ".TAR") == 0 ||
-                   s.compare(s.length() - 7, 7, ".tar.gz") == 0 || s.compare(s.length() - 7, 7, ".TAR.GZ") == 0 ||
-                   s.compare(s.length() - 4, 4, ".tgz") == 0 || s.compare(s.length() - 4, 4, ".TGZ") == 0) {
-            char** y = VSIReadDirRecursive(("/vsitar/" + s).c_str());
-            char** x = y;
-            if (x != NULL) {
-                while (*x != NULL) {
-                    out.push_back("/vsitar/" + filesystem::join(s, *x));
-                    ++x;
-                }
-                CSLDestroy(y);
+void image_collection::load_shards() {
+    _shard_info.clear();
+    if (!sqlite_has_table(_db, "shards")) {
+        return;
+    }
+    // manifests written by older versions have no summary of shards (SRS, alignment, and image counts per band)
+    bool has_summary = sqlite_has_table(_db, "shard_bands");
+    std::string sql = "SELECT id, filename, id_offset, left, top, bottom, right, t0, t1, image_count, gdalref_count" +
+                      std::string(has_summary ? ", srs, aligned" : "") + " FROM shards ORDER BY id;";
+    sqlite3_stmt* stmt;
+    sqlite3_prepare_v2(_db, sql.c_str(), -1, &stmt, NULL);
+    if (!stmt) {
+        throw std::string("ERROR in image_collection::load_shards(): cannot prepare query statement");
+    }
+    std::string dir = filesystem::directory(_filename);
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        shard_info x;
+        x.id = sqlite3_column_int(stmt, 0);
+        x.filename = sqlite_as_string(stmt, 1);
+        if (filesystem::is_relative(x.filename) && !dir.empty()) {
+            // relative to the directory of the manifest
+            x.filename = filesystem::join(dir, x.filename);
+        }
+        x.id_offset = sqlite3_column_int(stmt, 2);
+        x.extent.left = sqlite3_column_double(stmt, 3);
+        x.extent.top = sqlite3_column_double(stmt, 4);
+        x.extent.bottom = sqlite3_column_double(stmt, 5);
+        x.extent.right = sqlite3_column_double(stmt, 6);
+        x.t0 = sqlite_as_string(stmt, 7);
+        x.t1 = sqlite_as_string(stmt, 8);
+        x.image_count = sqlite3_column_int(stmt, 9);
+        x.gdalref_count = sqlite3_column_int(stmt, 10);
+        x.has_summary = has_summary;
+        if (has_summary) {
+            x.srs = sqlite_as_string(stmt, 11);
+            x.aligned = sqlite3_column_int(stmt, 12) != 0;
+        }
+        _shard_info.push_back(x);
+    }
+    sqlite3_finalize(stmt);
+
+    if (has_summary) {
+        std::map<uint32_t, uint32_t> index;
+        for (uint32_t i = 0; i < _shard_info.size(); ++i) index[_shard_info[i].id] = i;
+        sql = "SELECT shard_id, band_id, image_count FROM shard_bands;";
+        sqlite3_prepare_v2(_db, sql.c_str(), -1, &stmt, NULL);
+        if (!stmt) {
+            throw std::string("ERROR in image_collection::load_shards(): cannot prepare query statement");
+        }
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            auto it = index.find(sqlite3_column_int(stmt, 0));
+            if (it == index.end()) continue;
+            _shard_info[it->second].band_image_count[sqlite3_column_int(stmt, 1)] = sqlite3_column_int(stmt, 2);
+        }
+        sqlite3_finalize(stmt);
+    }
+    GCBS_DEBUG("Image collection '" + _filename + "' consists of " + std::to_string(_shard_info.size()) + " shards");
+}
+
+std::shared_ptr<image_collection> image_collection::shard(uint32_t i) {
+    std::lock_guard<std::mutex> lock(_shards_mutex);
+    auto it = _shards.find(i);
+    if (it != _shards.end()) {
+        return it->second;
+    }
+    GCBS_DEBUG("Opening shard '" + _shard_info[i].filename + "'");
+    std::shared_ptr<image_collection> x = std::make_shared<image_collection>(_shard_info[i].filename);
+    if (x->is_sharded()) {
+        throw std::string("ERROR in image_collection::shard(): nested sharded image collections are not supported");
+    }
+    if (_shards_md_index) {
+        x->create_image_md_index();
+    }
+    _shards[i] = x;
+    return x;
+}
+
+void image_collection::write_subset(std::string filename, const std::vector<uint32_t>& image_ids) {
+    if (filesystem::exists(filename)) {
+        throw std::string("ERROR in image_collection::write_subset(): output file '" + filename + "' already exists");
+    }
+
+    // create tables and indexes with identical schema in a new database
+    sqlite3* out_db;
+    if (sqlite3_open_v2(filename.c_str(), &out_db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_FULLMUTEX, NULL) != SQLITE_OK) {
+        throw std::string("ERROR in image_collection::write_subset(): cannot create output database file.");
+    }
+    std::string sql_schema = "SELECT sql FROM sqlite_master WHERE sql IS NOT NULL AND name NOT LIKE 'sqlite_%' AND name <> 'shards' ORDER BY type = 'index';";
+    sqlite3_stmt* stmt;
+    sqlite3_prepare_v2(_db, sql_schema.c_str(), -1, &stmt, NULL);
+    if (!stmt) {
+        sqlite3_close(out_db);
+        throw std::string("ERROR in image_collection::write_subset(): cannot prepare query statement");
+    }
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        std::string sql = sqlite_as_string(stmt, 0);
+        if (sqlite3_exec(out_db, sql.c_str(), NULL, NULL, NULL) != SQLITE_OK) {
+            std::string msg = "ERROR in image_collection::write_subset(): cannot create image collection schema: " + std::string(sqlite3_errmsg(out_db));
+            sqlite3_finalize(stmt);
+            sqlite3_close(out_db);
+            GCBS_ERROR(msg);
+            throw msg;
+        }
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_close(out_db);
+
+    // copy rows of selected images
+    if (sqlite3_exec(_db, "CREATE TEMP TABLE IF NOT EXISTS subset_images(id INTEGER PRIMARY KEY); DELETE FROM temp.subset_images; BEGIN TRANSACTION;", NULL, NULL, NULL) != SQLITE_OK) {
+        throw std::string("ERROR in image_collection::write_subset(): cannot create temporary table of images");
+    }
+    try {
+        bulk_insert_guard g(this);
+        stmt = g.prepare("INSERT INTO temp.subset_images(id) VALUES(?);");
+        for (uint32_t i = 0; i < image_ids.size(); ++i) {
+            sqlite3_bind_int64(stmt, 1, image_ids[i]);
+            g.step(stmt, "subset_images", i);
+        }
+        g.done();
+    } catch (...) {
+        sqlite3_exec(_db, "ROLLBACK;", NULL, NULL, NULL);
+        throw;
+    }
+    sqlite3_exec(_db, "COMMIT;", NULL, NULL, NULL);
+
+    std::string sql =
+        "ATTACH DATABASE '" + sqlite_escape_singlequotes(filename) + "' AS subset;" +
+        "BEGIN TRANSACTION;"
+        "INSERT INTO subset.collection_md SELECT * FROM main.collection_md;"
+        "INSERT INTO subset.bands SELECT * FROM main.bands;"
+        "INSERT INTO subset.band_md SELECT * FROM main.band_md;"
+        "INSERT INTO subset.images SELECT * FROM main.images WHERE id IN (SELECT id FROM temp.subset_images);"
+        "INSERT INTO subset.image_md SELECT * FROM main.image_md WHERE image_id IN (SELECT id FROM temp.subset_images);"
+        "INSERT INTO subset.gdalrefs SELECT * FROM main.gdalrefs WHERE image_id IN (SELECT id FROM temp.subset_images);" +
+        std::string(has_footprints() ? "INSERT INTO subset.image_footprints SELECT * FROM main.image_footprints WHERE image_id IN (SELECT id FROM temp.subset_images);" : "") +
+        "COMMIT;";
+    if (sqlite3_exec(_db, sql.c_str(), NULL, NULL, NULL) != SQLITE_OK) {
+        std::string msg = "ERROR in image_collection::write_subset(): cannot copy images to '" + filename + "': " + std::string(sqlite3_errmsg(_db));
+        sqlite3_exec(_db, "ROLLBACK; DETACH DATABASE subset;", NULL, NULL, NULL);
+        GCBS_ERROR(msg);
+        throw msg;
+    }
+    sqlite3_exec(_db, "DETACH DATABASE subset; DROP TABLE temp.subset_images;", NULL, NULL, NULL);
+}
+
+std::shared_ptr<image_collection> image_collection::partition(std::string manifest, std::string time_unit, double tile_size) {
+    if (is_sharded()) {
+        throw std::string("ERROR in image_collection::partition(): image collection is already sharded");
+    }
+    if (!time_unit.empty() && time_unit != "year" && time_unit != "month") {
+        throw std::string("ERROR in image_collection::partition(): invalid time unit '" + time_unit + "', expected 'year', 'month', or an empty string");
+    }
+    if (tile_size < 0) {
+        throw std::string("ERROR in image_collection::partition(): tile size must not be negative");
+    }
+    if (filesystem::exists(manifest)) {
+        throw std::string("ERROR in image_collection::partition(): output file '" + manifest + "' already exists");
+    }
+
+    // assign images to shards by datetime and bounding box center
+    std::map<std::string, std::vector<uint32_t>> shard_images;
+    std::string sql = "SELECT id, left, top, bottom, right, datetime FROM images;";
+    sqlite3_stmt* stmt;
+    sqlite3_prepare_v2(_db, sql.c_str(), -1, &stmt, NULL);
+    if (!stmt) {
+        throw std::string("ERROR in image_collection::partition(): cannot prepare query statement");
+    }
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        std::string key;
+        if (!time_unit.empty()) {
+            // to_string() with a coarse unit still prints full dates
+            key = datetime::from_string(sqlite_as_string(stmt, 5)).to_string(datetime_unit::DAY).substr(0, time_unit == "year" ? 4 : 7);
+        }
+        if (tile_size > 0) {
+            double cx = (sqlite3_column_double(stmt, 1) + sqlite3_column_double(stmt, 4)) / 2.0;
+            double cy = (sqlite3_column_double(stmt, 2) + sqlite3_column_double(stmt, 3)) / 2.0;
+            int32_t tx = (int32_t)std::floor((cx + 180.0) / tile_size);
+            int32_t ty = (int32_t)std::floor((cy + 90.0) / tile_size);
+            key += (key.empty() ? "" : "_") + std::string("x") + std::to_string(tx) + "y" + std::to_string(ty);
+        }
+        if (key.empty()) key = "all";
+        shard_images[key].push_back(sqlite3_column_int(stmt, 0));
+    }
+    sqlite3_finalize(stmt);
+
+    if (shard_images.empty()) {
+        throw std::string("ERROR in image_collection::partition(): image collection is empty");
+    }
+
+    std::string dir = filesystem::directory(manifest);
+    std::vector<std::string> shards;
+    for (auto it = shard_images.begin(); it != shard_images.end(); ++it) {
+        std::string f = filesystem::stem(manifest) + "_" + it->first + ".db";
+        if (!dir.empty()) f = filesystem::join(dir, f);
+        GCBS_DEBUG("Writing " + std::to_string(it->second.size()) + " images to shard '" + f + "'");
+        write_subset(f, it->second);
+        shards.push_back(f);
+    }
+    return create_sharded(manifest, shards, true);
+}
+
+std::shared_ptr<image_collection> image_collection::create_sharded(std::string manifest, std::vector<std::string> shards, bool keep_image_ids) {
+    if (shards.empty()) {
+        throw std::string("ERROR in image_collection::create_sharded(): no shards given");
+    }
+    if (filesystem::exists(manifest)) {
+        throw std::string("ERROR in image_collection::create_sharded(): output file '" + manifest + "' already exists");
+    }
+    std::string manifest_dir = filesystem::directory(filesystem::make_absolute(manifest));
+
+    std::shared_ptr<image_collection> out = std::make_shared<image_collection>();
+    if (sqlite3_exec(out->_db, SQL_CREATE_SHARDS, NULL, NULL, NULL) != SQLITE_OK) {
+        throw std::string("ERROR in image_collection::create_sharded(): cannot create image collection schema.");
+    }
+
+    std::vector<bands_row> bands;
+    uint32_t id_offset = 0;
+    uint32_t id = 0;
+    for (uint32_t i = 0; i < shards.size(); ++i) {
+        std::shared_ptr<image_collection> x = std::make_shared<image_collection>(shards[i]);
+        if (x->is_sharded()) {
+            throw std::string("ERROR in image_collection::create_sharded(): nested sharded image collections are not supported");
+        }
+        std::vector<bands_row> xbands = x->get_all_bands();
+        if (i == 0) {
+            // bands and metadata of the manifest are taken from the first shard
+            bands = xbands;
+            std::string sql =
+                "DELETE FROM collection_md;"
+                "ATTACH DATABASE '" + sqlite_escape_singlequotes(shards[i]) + "' AS shard;" +
+                "INSERT INTO collection_md(key, value) SELECT key, value FROM shard.collection_md;"
+                "INSERT INTO bands(id, name, type, offset, scale, unit, nodata) SELECT id, name, type, offset, scale, unit, nodata FROM shard.bands;"
+                "INSERT INTO band_md(band_id, key, value) SELECT band_id, key, value FROM shard.band_md;"
+                "DETACH DATABASE shard;";
+            if (sqlite3_exec(out->_db, sql.c_str(), NULL, NULL, NULL) != SQLITE_OK) {
+                throw std::string("ERROR in image_collection::create_sharded(): cannot copy bands of shard '" + shards[i] + "': " + std::string(sqlite3_errmsg(out->_db)));
             }
         } else {
-            out.push_back(s);
+            bool same = xbands.size() == bands.size();
+            for (uint16_t ib = 0; same && ib < bands.size(); ++ib) {
+                same = xbands[ib].id == bands[ib].id && xbands[ib].name == bands[ib].name;
+            }
+            if (!same) {
+                throw std::string("ERROR in image_collection::create_sharded(): bands of shard '" + shards[i] + "' differ from bands of shard '" + shards[0] + "'");
+            }
+        }
+
+        std::string sql = "SELECT min(left), max(right), min(bottom), max(top), min(strftime('%Y-%m-%dT%H:%M:%S', datetime)), max(strftime('%Y-%m-%dT%H:%M:%S', datetime)), max(id), count(*) FROM images;";
+        sqlite3_stmt* stmt;
+        sqlite3_prepare_v2(x->_db, sql.c_str(), -1, &stmt, NULL);
+        if (!stmt) {
+            throw std::string("ERROR in image_collection::create_sharded(): cannot prepare query statement");
+        }
+        if (sqlite3_step(stmt) != SQLITE_ROW || sqlite3_column_int(stmt, 7) == 0) {
+            sqlite3_finalize(stmt);
+            GCBS_WARN("Shard '" + shards[i] + "' has no images and will be ignored");
+            continue;
+        }
+        std::string f = filesystem::make_absolute(shards[i]);
+        if (filesystem::directory(f) == manifest_dir) {
+            f = filesystem::filename(f);
+        }
+        uint32_t max_id = sqlite3_column_int(stmt, 6);
+        // store everything needed to create cubes in the manifest such that shards are only opened by find_range_st()
+        sql = "INSERT INTO shards(id, filename, id_offset, left, right, bottom, top, t0, t1, image_count, gdalref_count, srs, aligned) VALUES(" +
+              std::to_string(id) + ",'" + sqlite_escape_singlequotes(f) + "'," + std::to_string(id_offset) + "," +
+              std::to_string(sqlite3_column_double(stmt, 0)) + "," + std::to_string(sqlite3_column_double(stmt, 1)) + "," +
+              std::to_string(sqlite3_column_double(stmt, 2)) + "," + std::to_string(sqlite3_column_double(stmt, 3)) + ",'" +
+              sqlite_as_string(stmt, 4) + "','" + sqlite_as_string(stmt, 5) + "'," + std::to_string(sqlite3_column_int(stmt, 7)) + "," +
+              std::to_string(x->count_gdalrefs()) + ",'" + sqlite_escape_singlequotes(x->distinct_srs()) + "'," + std::to_string(x->is_aligned() ? 1 : 0) + ");";
+        sqlite3_finalize(stmt);
+        for (uint16_t ib = 0; ib < xbands.size(); ++ib) {
+            sql += "INSERT INTO shard_bands(shard_id, band_id, image_count) VALUES(" + std::to_string(id) + "," +
+                   std::to_string(xbands[ib].id) + "," + std::to_string(xbands[ib].image_count) + ");";
+        }
+        if (sqlite3_exec(out->_db, sql.c_str(), NULL, NULL, NULL) != SQLITE_OK) {
+            throw std::string("ERROR in image_collection::create_sharded(): cannot insert shard '" + shards[i] + "' to manifest");
+        }
+        ++id;
+        if (!keep_image_ids) {
+            id_offset += max_id + 1;
         }
     }
+    if (id == 0) {
+        throw std::string("ERROR in image_collection::create_sharded(): all shards are empty");
+    }
+    out->write(manifest);
+    out.reset();
+    return std::make_shared<image_collection>(manifest);
+}
+
+std::vector<std::string> image_collection::unroll_archives(std::vector<std::string> descriptors) {
+    // archives are listed in parallel, results keep the order of the input
+    std::vector<std::vector<std::string>> unrolled(descriptors.size());
+    thread_pool::instance()->parallel_for(descriptors.size(), [&descriptors, &unrolled](uint32_t i) {
+        std::string s = descriptors[i];
+        if (s.length() >= 4 && (s.compare(s.length() - 4, 4, ".zip") == 0 || s.compare(s.length() - 4, 4, ".ZIP") == 0)) {
+            unrolled[i] = archive_listing_cache::instance()->list(s, "/vsizip/");
+        } else if (s.length() >= 3 && (s.compare(s.length() - 3, 3, ".gz") == 0 || s.compare(s.length() - 3, 3, ".GZ") == 0) &&
+                   !(s.length() >= 7 && (s.compare(s.length() - 7, 7, ".tar.gz") == 0 || s.compare(s.length() - 7, 7, ".TAR.GZ") == 0))) {
+            unrolled[i].push_back("/vsigzip/" + s);
+        } else if (s.length() >= 4 && (s.compare(s.length() - 4, 4, ".tar") == 0 || s.compare(s.length() - 4, 4, ".TAR") == 0 ||
+                                       s.compare(s.length() - 4, 4, ".tgz") == 0 || s.compare(s.length() - 4, 4, ".TGZ") == 0 ||
+                                       (s.length() >= 7 && (s.compare(s.length() - 7, 7, ".tar.gz") == 0 || s.compare(s.length() - 7, 7, ".TAR.GZ") == 0)))) {
+            unrolled[i] = archive_listing_cache::instance()->list(s, "/vsitar/");
+        } else {
+            unrolled[i].push_back(s);
+        }
+    });
+
+    std::vector<std::string> out;
+    for (uint32_t i = 0; i < unrolled.size(); ++i) {
+        out.insert(out.end(), unrolled[i].begin(), unrolled[i].end());
+    }
     return out;
 }
 
@@ -1589,54 +2518,120 @@ std::shared_ptr<image_collection> image_collection::create_from_tables(std::vect
     // create empty image collection
     std::shared_ptr<image_collection> o = std::make_shared<image_collection>();
 
-    std::map<std::string, uint32_t> image_ids;
-    std::map<std::string, uint32_t> band_ids;
+    std::unordered_map<std::string, uint32_t> image_ids;
+    std::unordered_map<std::string, uint32_t> band_ids;
+    std::set<std::pair<uint32_t, uint32_t>> gdalref_ids;
     uint32_t cur_image_id;
     uint32_t cur_band_id;
 
-    sqlite3_exec(o->get_db_handle(), "BEGIN TRANSACTION;", NULL, NULL, NULL);  // what if this fails?!
+    // Rows are inserted with prepared statements in a single transaction, where duplicates are detected
+    // before touching the database such that no per-row savepoints are needed
+    o->bulk_insert_start();
+    bulk_insert_guard g(o.get());
+    sqlite3_stmt* stmt_band = g.prepare("INSERT INTO bands(id, name) VALUES (?, ?);");
+    sqlite3_stmt* stmt_image = g.prepare("INSERT INTO images(id, name, datetime, left, top, bottom, right, proj) VALUES(?, ?, ?, ?, ?, ?, ?, ?);");
+    sqlite3_stmt* stmt_gdalref = g.prepare("INSERT INTO gdalrefs(descriptor, image_id, band_id, band_num) VALUES(?, ?, ?, ?);");
+    sqlite3_stmt* stmt_band_delete = g.prepare("DELETE FROM bands WHERE id = ?;");
+    sqlite3_stmt* stmt_image_delete = g.prepare("DELETE FROM images WHERE id = ?;");
+
+    // Removes a band or image that has been inserted for the current row only, if a later insert of the row fails,
+    // such that no bands or images without datasets remain
+    auto undo_insert = [](sqlite3_stmt* stmt_delete, uint32_t id) {
+        sqlite3_bind_int64(stmt_delete, 1, id);
+        sqlite3_step(stmt_delete);
+        sqlite3_reset(stmt_delete);
+    };
+
     for (uint32_t i = 0; i < image_name.size(); ++i) {
-        sqlite3_exec(o->get_db_handle(), "SAVEPOINT s1;", NULL, NULL, NULL);  // what if this fails?!
+        bool new_band = false;
         auto itband = band_ids.find(band_name[i]);
         if (itband == band_ids.end()) {
-            std::string sql_band_insert = "INSERT INTO bands(name) VALUES ('" + sqlite_escape_singlequotes(band_name[i]) + "')";
-            if (sqlite3_exec(o->get_db_handle(), sql_band_insert.c_str(), NULL, NULL, NULL) != SQLITE_OK) {
-                GCBS_WARN("Failed to add band '" + band_name[i] + "' for dataset at row " + std::to_string(i) + "; dataset will be skipped");
-                sqlite3_exec(o->get_db_handle(), "ROLLBACK TO s1;", NULL, NULL, NULL);  // what if this fails?!
-                continue;
-            }
-            cur_band_id = sqlite3_last_insert_rowid(o->get_db_handle());
-            band_ids.insert(std::make_pair(band_name[i], cur_band_id));
+            cur_band_id = band_ids.size() + 1;
+            new_band = true;
         } else {
             cur_band_id = itband->second;
         }
 
+        bool new_image = false;
         auto itimage = image_ids.find(image_name[i]);
         if (itimage == image_ids.end()) {
-            datetime d = datetime::from_string(image_datetime[i]);
-            std::string sql_insert_image = "INSERT INTO images(name, datetime, left, top, bottom, right, proj) VALUES('" + sqlite_escape_singlequotes(image_name[i]) + "','" +
-                                           d.to_string() + "'," +
-                                           std::to_string(image_left[i]) + "," + std::to_string(image_top[i]) + "," + std::to_string(image_bottom[i]) + "," + std::to_string(image_right[i]) + ",'" + sqlite_escape_singlequotes(image_proj[i]) + "')";
-            if (sqlite3_exec(o->get_db_handle(), sql_insert_image.c_str(), NULL, NULL, NULL) != SQLITE_OK) {
-                GCBS_WARN("Failed to add image '" + image_name[i] + "' for dataset at row " + std::to_string(i) + "; dataset will be skipped");
-                sqlite3_exec(o->get_db_handle(), "ROLLBACK TO s1;", NULL, NULL, NULL);  // what if this fails?!
-                continue;
-            }
-            cur_image_id = sqlite3_last_insert_rowid(o->get_db_handle());
-            image_ids.insert(std::make_pair(image_name[i], cur_image_id));  // take care of race conditions if things run parallel at some po
+            cur_image_id = image_ids.size() + 1;
+            new_image = true;
         } else {
             cur_image_id = itimage->second;
         }
 
-        std::string sql_insert_gdalref = "INSERT INTO gdalrefs(descriptor, image_id, band_id, band_num) VALUES('" + sqlite_escape_singlequotes(gdalrefs_descriptor[i]) + "'," + std::to_string(cur_image_id) + "," + std::to_string(cur_band_id) + "," + std::to_string(gdalrefs_band_num[i]) + ");";
-        if (sqlite3_exec(o->get_db_handle(), sql_insert_gdalref.c_str(), NULL, NULL, NULL) != SQLITE_OK) {
+        if (gdalref_ids.count(std::make_pair(cur_image_id, cur_band_id)) > 0) {
             GCBS_WARN("Failed to add dataset '" + gdalrefs_descriptor[i] + "'; dataset will be skipped");
-            sqlite3_exec(o->get_db_handle(), "ROLLBACK TO s1;", NULL, NULL, NULL);  // what if this fails?!
             continue;
         }
-        sqlite3_exec(o->get_db_handle(), "RELEASE s1;", NULL, NULL, NULL);  // what if this fails?!
+
+        if (new_band) {
+            sqlite3_bind_int64(stmt_band, 1, cur_band_id);
+            sqlite3_bind_text(stmt_band, 2, band_name[i].c_str(), band_name[i].size(), SQLITE_STATIC);
+            if (sqlite3_step(stmt_band) != SQLITE_DONE) {
+                GCBS_WARN("Failed to add band '" + band_name[i] + "' for dataset at row " + std::to_string(i) + "; dataset will be skipped");
+                sqlite3_reset(stmt_band);
+                continue;
+            }
+            sqlite3_reset(stmt_band);
+            band_ids.insert(std::make_pair(band_name[i], cur_band_id));
+        }
+
+        if (new_image) {
+            std::string dt;
+            try {
+                dt = datetime::from_string(image_datetime[i]).to_string();
+            } catch (...) {
+                GCBS_WARN("Failed to parse datetime '" + image_datetime[i] + "' of image '" + image_name[i] + "'; dataset will be skipped");
+                if (new_band) {
+                    undo_insert(stmt_band_delete, cur_band_id);
+                    band_ids.erase(band_name[i]);
+                }
+                continue;
+            }
+            sqlite3_bind_int64(stmt_image, 1, cur_image_id);
+            sqlite3_bind_text(stmt_image, 2, image_name[i].c_str(), image_name[i].size(), SQLITE_STATIC);
+            sqlite3_bind_text(stmt_image, 3, dt.c_str(), dt.size(), SQLITE_TRANSIENT);
+            sqlite3_bind_double(stmt_image, 4, image_left[i]);
+            sqlite3_bind_double(stmt_image, 5, image_top[i]);
+            sqlite3_bind_double(stmt_image, 6, image_bottom[i]);
+            sqlite3_bind_double(stmt_image, 7, image_right[i]);
+            sqlite3_bind_text(stmt_image, 8, image_proj[i].c_str(), image_proj[i].size(), SQLITE_STATIC);
+            if (sqlite3_step(stmt_image) != SQLITE_DONE) {
+                GCBS_WARN("Failed to add image '" + image_name[i] + "' for dataset at row " + std::to_string(i) + "; dataset will be skipped");
+                sqlite3_reset(stmt_image);
+                if (new_band) {
+                    undo_insert(stmt_band_delete, cur_band_id);
+                    band_ids.erase(band_name[i]);
+                }
+                continue;
+            }
+            sqlite3_reset(stmt_image);
+            image_ids.insert(std::make_pair(image_name[i], cur_image_id));
+        }
+
+        sqlite3_bind_text(stmt_gdalref, 1, gdalrefs_descriptor[i].c_str(), gdalrefs_descriptor[i].size(), SQLITE_STATIC);
+        sqlite3_bind_int64(stmt_gdalref, 2, cur_image_id);
+        sqlite3_bind_int64(stmt_gdalref, 3, cur_band_id);
+        sqlite3_bind_int64(stmt_gdalref, 4, gdalrefs_band_num[i]);
+        if (sqlite3_step(stmt_gdalref) != SQLITE_DONE) {
+            GCBS_WARN("Failed to add dataset '" + gdalrefs_descriptor[i] + "'; dataset will be skipped");
+            if (new_image) {
+                undo_insert(stmt_image_delete, cur_image_id);
+                image_ids.erase(image_name[i]);
+            }
+            if (new_band) {
+                undo_insert(stmt_band_delete, cur_band_id);
+                band_ids.erase(band_name[i]);
+            }
+        } else {
+            gdalref_ids.insert(std::make_pair(cur_image_id, cur_band_id));
+        }
+        sqlite3_reset(stmt_gdalref);
     }
-    sqlite3_exec(o->get_db_handle(), "COMMIT TRANSACTION;", NULL, NULL, NULL);  // what if this fails?!
+    g.done();
+    o->bulk_insert_end();
     return o;
 }
 
@@ -1724,6 +2719,127 @@ void image_collection::transaction_end() {
     sqlite3_exec(_db, "COMMIT TRANSACTION;", NULL, NULL, NULL);  // what if this fails?!
 }
 
+void image_collection::bulk_insert_start() {
+    _bulk_journal_mode = sqlite_pragma(_db, "journal_mode");
+    _bulk_synchronous = sqlite_pragma(_db, "synchronous");
+    sqlite3_exec(_db, "PRAGMA synchronous = OFF;", NULL, NULL, NULL);
+    sqlite3_exec(_db, "PRAGMA journal_mode = MEMORY;", NULL, NULL, NULL);
+    _bulk_insert = true;
+    if (sqlite3_exec(_db, "BEGIN TRANSACTION;", NULL, NULL, NULL) != SQLITE_OK) {
+        bulk_insert_abort();
+        GCBS_ERROR("Failed to start bulk insert into image collection database");
+        throw std::string("Failed to start bulk insert into image collection database");
+    }
+    sqlite3_exec(_db, SQL_DROP_INDEXES, NULL, NULL, NULL);
+}
+
+void image_collection::bulk_insert_end() {
+    if (sqlite3_exec(_db, SQL_CREATE_INDEX_IMAGES, NULL, NULL, NULL) != SQLITE_OK ||
+        sqlite3_exec(_db, SQL_CREATE_INDEX_GDALREFS, NULL, NULL, NULL) != SQLITE_OK) {
+        GCBS_WARN("Failed to create indexes after bulk insert into image collection database");
+    }
+    if (sqlite3_exec(_db, "COMMIT TRANSACTION;", NULL, NULL, NULL) != SQLITE_OK) {
+        bulk_insert_abort();
+        GCBS_ERROR("Failed to commit bulk insert into image collection database");
+        throw std::string("Failed to commit bulk insert into image collection database");
+    }
+    restore_durability();
+}
+
+void image_collection::bulk_insert_abort() {
+    if (!_bulk_insert) return;
+    // indexes have been dropped within the transaction and are restored by the rollback
+    if (sqlite3_get_autocommit(_db) == 0) {
+        sqlite3_exec(_db, "ROLLBACK TRANSACTION;", NULL, NULL, NULL);
+        _has_footprints.store(-1);  // the rollback may have dropped a newly created footprints table
+    }
+    restore_durability();
+}
+
+void image_collection::restore_durability() {
+    if (!_bulk_journal_mode.empty()) {
+        sqlite3_exec(_db, ("PRAGMA journal_mode = " + _bulk_journal_mode + ";").c_str(), NULL, NULL, NULL);
+    }
+    if (!_bulk_synchronous.empty()) {
+        sqlite3_exec(_db, ("PRAGMA synchronous = " + _bulk_synchronous + ";").c_str(), NULL, NULL, NULL);
+    }
+    _bulk_insert = false;
+}
+
+void image_collection::insert_bands(const std::vector<uint32_t>& id, const std::vector<std::string>& name) {
+    bulk_insert_guard g(this);
+    if (id.size() != name.size()) {
+        GCBS_ERROR("Arguments must have identical size.");
+        throw std::string("Arguments must have identical size.");
+    }
+    sqlite3_stmt* stmt = g.prepare("INSERT INTO bands(id, name, type, offset, scale, unit, nodata) VALUES (?, ?, '', 0.0, 1.0, '', '');");
+    for (std::size_t i = 0; i < id.size(); ++i) {
+        sqlite3_bind_int64(stmt, 1, id[i]);
+        sqlite3_bind_text(stmt, 2, name[i].c_str(), name[i].size(), SQLITE_STATIC);
+        g.step(stmt, "bands", i);
+    }
+    g.done();
+}
+
+void image_collection::insert_images(const std::vector<uint32_t>& id, const std::vector<std::string>& name, const std::vector<double>& left,
+                                     const std::vector<double>& top, const std::vector<double>& bottom, const std::vector<double>& right,
+                                     const std::vector<std::string>& datetime, const std::vector<std::string>& proj) {
+    bulk_insert_guard g(this);
+    if (id.size() != name.size() || id.size() != left.size() || id.size() != top.size() || id.size() != bottom.size() ||
+        id.size() != right.size() || id.size() != datetime.size() || id.size() != proj.size()) {
+        GCBS_ERROR("Arguments must have identical size.");
+        throw std::string("Arguments must have identical size.");
+    }
+    sqlite3_stmt* stmt = g.prepare("INSERT INTO images(id, name, datetime, left, top, bottom, right, proj) VALUES(?, ?, ?, ?, ?, ?, ?, ?);");
+    for (std::size_t i = 0; i < id.size(); ++i) {
+        std::string dt = datetime::from_string(datetime[i]).to_string();
+        sqlite3_bind_int64(stmt, 1, id[i]);
+        sqlite3_bind_text(stmt, 2, name[i].c_str(), name[i].size(), SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 3, dt.c_str(), dt.size(), SQLITE_TRANSIENT);
+        sqlite3_bind_double(stmt, 4, left[i]);
+        sqlite3_bind_double(stmt, 5, top[i]);
+        sqlite3_bind_double(stmt, 6, bottom[i]);
+        sqlite3_bind_double(stmt, 7, right[i]);
+        sqlite3_bind_text(stmt, 8, proj[i].c_str(), proj[i].size(), SQLITE_STATIC);
+        g.step(stmt, "images", i);
+    }
+    g.done();
+}
+
+void image_collection::insert_datasets(const std::vector<uint32_t>& image_id, const std::vector<uint32_t>& band_id,
+                                       const std::vector<std::string>& descriptor, const std::vector<uint32_t>& band_num) {
+    bulk_insert_guard g(this);
+    if (image_id.size() != band_id.size() || image_id.size() != descriptor.size() || image_id.size() != band_num.size()) {
+        GCBS_ERROR("Arguments must have identical size.");
+        throw std::string("Arguments must have identical size.");
+    }
+    sqlite3_stmt* stmt = g.prepare("INSERT INTO gdalrefs(descriptor, image_id, band_id, band_num) VALUES(?, ?, ?, ?);");
+    for (std::size_t i = 0; i < image_id.size(); ++i) {
+        sqlite3_bind_text(stmt, 1, descriptor[i].c_str(), descriptor[i].size(), SQLITE_STATIC);
+        sqlite3_bind_int64(stmt, 2, image_id[i]);
+        sqlite3_bind_int64(stmt, 3, band_id[i]);
+        sqlite3_bind_int64(stmt, 4, band_num[i]);
+        g.step(stmt, "gdalrefs", i);
+    }
+    g.done();
+}
+
+void image_collection::insert_image_md(const std::vector<uint32_t>& image_id, const std::vector<std::string>& key, const std::vector<std::string>& value) {
+    bulk_insert_guard g(this);
+    if (image_id.size() != key.size() || image_id.size() != value.size()) {
+        GCBS_ERROR("Arguments must have identical size.");
+        throw std::string("Arguments must have identical size.");
+    }
+    sqlite3_stmt* stmt = g.prepare("INSERT INTO image_md(image_id, key, value) VALUES(?, ?, ?);");
+    for (std::size_t i = 0; i < image_id.size(); ++i) {
+        sqlite3_bind_int64(stmt, 1, image_id[i]);
+        sqlite3_bind_text(stmt, 2, key[i].c_str(), key[i].size(), SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 3, value[i].c_str(), value[i].size(), SQLITE_STATIC);
+        g.step(stmt, "image_md", i);
+    }
+    g.done();
+}
+
 bool image_collection::is_empty() {
     if (count_bands() == 0 || count_images() == 0 || count_gdalrefs() == 0) return true;
     return false;
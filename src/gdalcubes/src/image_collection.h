@@ -27,6 +27,11 @@
 
 #include <ogr_spatialref.h>
 
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+
 #include "collection_format.h"
 #include "coord_types.h"
 #include "datetime.h"
@@ -37,6 +42,8 @@ class sqlite3_stmt;
 
 namespace gdalcubes {
 
+class collection_snapshot;
+
 /**
  * @note copy construction and assignment are deleted because the sqlite must not be shared (handle will be closed in destructor). Instrad, use
  * std::shared_ptr<image_collection> to share the whole image collection resource if needed.
@@ -86,7 +93,8 @@ class image_collection {
     image_collection(collection_format format);
 
     /**
-     * Opens an existing image collection from a file
+     * Opens an existing image collection from a file, which may be an SQLite database or a
+     * snapshot created with write_snapshot()
      * @param filename
      */
     image_collection(std::string filename);
@@ -96,7 +104,7 @@ class image_collection {
     void operator=(const image_collection&) = delete;
 
     // move constructor
-    image_collection(image_collection&& A) : _format(A._format), _filename(A._filename), _db(A._db) {}
+    image_collection(image_collection&& A) : _format(A._format), _filename(A._filename), _db(A._db), _shard_info(A._shard_info), _shards(A._shards), _shards_mutex(), _shards_md_index(A._shards_md_index), _snapshot(A._snapshot), _bulk_insert(A._bulk_insert), _bulk_journal_mode(A._bulk_journal_mode), _bulk_synchronous(A._bulk_synchronous), _has_footprints(A._has_footprints.load()) {}
 
     static std::shared_ptr<image_collection> create(collection_format format, std::vector<std::string> descriptors, bool strict = true);
     static std::shared_ptr<image_collection> create(std::vector<std::string> descriptors, std::vector<std::string> date_time,
@@ -187,7 +195,7 @@ class image_collection {
     uint32_t count_gdalrefs();
 
     struct find_range_st_row {
-        find_range_st_row() : image_id(0), image_name(""), descriptor(""), datetime(""), band_name(""), band_num(1) {}
+        find_range_st_row() : image_id(0), image_name(""), descriptor(""), datetime(""), band_name(""), band_num(1), srs(""), left(0), top(0), bottom(0), right(0), md_order_value(""), md_order_null(true) {}
         uint32_t image_id;
         std::string image_name;
         std::string descriptor;
@@ -195,9 +203,57 @@ class image_collection {
         std::string band_name;
         uint16_t band_num;
         std::string srs;
+        double left;  // WGS84 bounding box of the image
+        double top;
+        double bottom;
+        double right;
+        std::string md_order_value;  // value of the image_md_order key, only used to merge results of shards
+        bool md_order_null;
     };
+    /**
+     * Condition on a single image metadata field such as "eo:cloud_cover < 30", images without
+     * the key never satisfy a predicate
+     */
+    struct image_md_predicate {
+        std::string key;
+        std::string op;     // one of =, !=, <, <=, >, >=
+        std::string value;  // compared numerically if the value is an unquoted number, otherwise as string
+        bool quoted = false;  // value has been given in quotes, e.g. "tile = '07'"
+
+        /**
+         * Parse a predicate from a string like "eo:cloud_cover <= 30" or "platform = sentinel-2a"
+         */
+        static image_md_predicate from_string(std::string s);
+        std::string to_string() const {
+            if (!quoted) return key + " " + op + " " + value;
+            std::string q = (value.find('\'') == std::string::npos) ? "'" : "\"";
+            return key + " " + op + " " + q + value + q;
+        }
+    };
+
+    /**
+     * SQL condition on images.id selecting images that satisfy an image metadata predicate; values are compared
+     * numerically if they are unquoted numbers
+     */
+    static std::string image_md_predicate_sql(const image_md_predicate& p);
+
+    /**
+     * Find all gdalrefs of images intersecting with a spatiotemporal range
+     * @param range spatiotemporal range
+     * @param srs spatial reference system of range
+     * @param bands names of bands, if empty all bands are considered
+     * @param order_by columns used to sort the result
+     * @param image_md_filter only consider images whose metadata satisfy all predicates
+     * @param image_md_order key of image metadata used to sort images before all order_by columns, images without this key
+     * come last; a leading "-" sorts in decreasing order
+     */
     std::vector<find_range_st_row> find_range_st(bounds_st range, std::string srs,
-                                                 std::vector<std::string> bands, std::vector<std::string> order_by = {});
+                                                 std::vector<std::string> bands, std::vector<std::string> order_by,
+                                                 const std::vector<image_md_predicate>& image_md_filter, std::string image_md_order = "");
+    inline std::vector<find_range_st_row> find_range_st(bounds_st range, std::string srs,
+                                                        std::vector<std::string> bands, std::vector<std::string> order_by = {}) {
+        return find_range_st(range, srs, bands, order_by, std::vector<image_md_predicate>());
+    }
     inline std::vector<find_range_st_row> find_range_st(bounds_st range, std::string srs, std::vector<std::string> order_by = {}) {
         return find_range_st(range, srs, std::vector<std::string>(), order_by);
     };
@@ -220,6 +276,60 @@ class image_collection {
 
     std::vector<image_collection::images_row> get_images();
 
+    /**
+     * @brief Create a sharded image collection from existing image collection files
+     *
+     * A sharded collection consists of a small manifest database, which contains the bands, collection metadata, and
+     * a table of shards with their filenames, spatiotemporal extents, SRS, and image counts per band. Shards are regular
+     * image collection files that are only opened when a query intersects with their extent; functions listing all
+     * images or GDAL dataset references open all shards. All shards must have identical bands.
+     *
+     * @param manifest filename of the manifest database, must not exist
+     * @param shards filenames of existing image collections
+     * @param keep_image_ids if true, image ids of the shards are assumed to be unique across shards (e.g. if shards have been
+     * created with partition()), otherwise ids of shards are shifted by an offset
+     * @return the opened sharded image collection
+     */
+    static std::shared_ptr<image_collection> create_sharded(std::string manifest, std::vector<std::string> shards, bool keep_image_ids = false);
+
+    /**
+     * @brief Partition this collection into shards by time and / or spatial tiles and create a sharded collection
+     *
+     * Images are assigned to shards by their datetime and the center of their bounding box. Shards are written to the
+     * directory of the manifest with filenames "<manifest stem>_<key>.db".
+     * @param manifest filename of the manifest database, must not exist
+     * @param time_unit one of "year", "month", or "" to not partition by time
+     * @param tile_size size of spatial tiles in degrees (WGS84), zero to not partition by space
+     * @return the opened sharded image collection
+     */
+    std::shared_ptr<image_collection> partition(std::string manifest, std::string time_unit, double tile_size);
+
+    /**
+     * @brief Check whether the collection is a manifest of shards, see create_sharded()
+     */
+    inline bool is_sharded() { return !_shard_info.empty(); }
+
+    /**
+     * @brief Write a read-only binary snapshot of all images intersecting with a spatiotemporal range
+     *
+     * The snapshot can be opened like a regular image collection file but only supports queries with the same bands and
+     * image metadata predicates. It does not depend on SQLite and is used to start worker processes quickly.
+     * @see collection_snapshot
+     * @param filename output file
+     * @param range spatiotemporal range
+     * @param srs spatial reference system of range
+     * @param bands names of bands, if empty all bands are considered
+     * @param image_md_filter image metadata predicates, see find_range_st()
+     * @param image_md_order image metadata key defining the order of images, see find_range_st()
+     */
+    void write_snapshot(std::string filename, bounds_st range, std::string srs, std::vector<std::string> bands,
+                        const std::vector<image_md_predicate>& image_md_filter, std::string image_md_order);
+
+    /**
+     * @brief Check whether the collection has been opened from a snapshot, see write_snapshot()
+     */
+    inline bool is_snapshot() { return _snapshot != nullptr; }
+
     /**
      * Helper function to create image collections from full tables
      *
@@ -255,6 +365,64 @@ class image_collection {
     void transaction_start();
     void transaction_end();
 
+    /**
+     * Add the valid data footprint of an image. Footprints are used in find_range_st() to skip images that do not
+     * intersect with the requested range although their bounding box does (e.g. nodata wedges of tiled products).
+     * @param image_id image identifier
+     * @param geom Polygon or MultiPolygon as WKT or GeoJSON string with WGS84 longitude / latitude coordinates
+     * @note Footprints with many vertices are stored as their convex hull
+     */
+    void insert_image_footprint(uint32_t image_id, std::string geom);
+    void insert_image_footprints(const std::vector<uint32_t>& image_id, const std::vector<std::string>& geom);
+
+    /**
+     * Check whether the collection stores valid data footprints of (some) images
+     * @note The result is cached and updated when footprints are inserted
+     */
+    bool has_footprints();
+
+    /**
+     * Get the valid data footprints of images, see insert_image_footprint()
+     * @param image_id image identifiers
+     * @return footprints as WKB with WGS84 longitude / latitude coordinates by image identifier, images without footprint are omitted
+     */
+    std::unordered_map<uint32_t, std::string> get_image_footprints(const std::vector<uint32_t>& image_id);
+
+    /**
+     * Create an index on image metadata keys and values, which speeds up queries with image metadata predicates
+     * @note Fails silently, e.g. if the collection file is read-only
+     */
+    void create_image_md_index();
+
+    // Bulk loading of columnar tables, e.g. from STAC search results
+
+    /**
+     * Start a bulk insert, which drops secondary indexes, relaxes durability settings of the database,
+     * and starts a transaction. Indexes are recreated and previous durability settings are restored in bulk_insert_end().
+     */
+    void bulk_insert_start();
+    void bulk_insert_end();
+
+    /**
+     * Abort a bulk insert, i.e. roll back all changes since bulk_insert_start() including dropped indexes and restore
+     * previous durability settings. Insert functions call this automatically before throwing an exception.
+     * @note Does nothing if no bulk insert is active
+     */
+    void bulk_insert_abort();
+
+    /**
+     * Insert many rows at once with prepared statements. All vector arguments represent columns of a table and
+     * must have identical sizes. Datetime strings are normalized as in insert_image().
+     * @note Should be called between bulk_insert_start() and bulk_insert_end()
+     */
+    void insert_bands(const std::vector<uint32_t>& id, const std::vector<std::string>& name);
+    void insert_images(const std::vector<uint32_t>& id, const std::vector<std::string>& name, const std::vector<double>& left,
+                       const std::vector<double>& top, const std::vector<double>& bottom, const std::vector<double>& right,
+                       const std::vector<std::string>& datetime, const std::vector<std::string>& proj);
+    void insert_datasets(const std::vector<uint32_t>& image_id, const std::vector<uint32_t>& band_id,
+                         const std::vector<std::string>& descriptor, const std::vector<uint32_t>& band_num);
+    void insert_image_md(const std::vector<uint32_t>& image_id, const std::vector<std::string>& key, const std::vector<std::string>& value);
+
     /**
      * Derive the size of a pixel for one or all bands in bytes
      * @param band band identifier, if emtpy the sum of all bands is used
@@ -287,6 +455,7 @@ class image_collection {
      * @see https://www.gdal.org/gdal_virtual_file_systems.html
      * @param descriptors input list of filenames
      * @note This function is not recursive, i.e., it will not unroll .zip files within .zip files etc.
+     * @note Archives are listed in parallel, listings are cached, see archive_listing_cache
      * @return list of filenames with unrolled archive and or compressed files using GDAL VSI
      */
     static std::vector<std::string> unroll_archives(std::vector<std::string> descriptors);
@@ -306,6 +475,49 @@ class image_collection {
     std::string _filename;
     sqlite3* _db;
 
+    struct shard_info {
+        uint32_t id;
+        std::string filename;  // resolved path
+        uint32_t id_offset;
+        bounds_2d<double> extent;  // WGS84
+        std::string t0;            // %Y-%m-%dT%H:%M:%S
+        std::string t1;
+        uint32_t image_count;
+        uint32_t gdalref_count;
+
+        // summary of the shard stored in the manifest, avoids opening shards when creating cubes
+        bool has_summary = false;
+        std::string srs;  // empty if images have different SRS
+        bool aligned = false;
+        std::map<uint32_t, uint32_t> band_image_count;  // number of images by band id
+    };
+
+    // shards of a sharded collection, empty otherwise
+    std::vector<shard_info> _shard_info;
+
+    // opened shards by index in _shard_info, shards are opened lazily on first use
+    std::map<uint32_t, std::shared_ptr<image_collection>> _shards;
+    std::mutex _shards_mutex;
+    bool _shards_md_index;
+
+    void load_shards();
+    std::shared_ptr<image_collection> shard(uint32_t i);
+
+    // Write images with given ids to a new image collection file with identical schema, bands, and metadata
+    void write_subset(std::string filename, const std::vector<uint32_t>& image_ids);
+
+    // read-only snapshot if opened from a snapshot file, _db is null in this case
+    std::shared_ptr<collection_snapshot> _snapshot;
+
+    // state of an active bulk insert, durability settings are restored afterwards
+    bool _bulk_insert;
+    std::string _bulk_journal_mode;
+    std::string _bulk_synchronous;
+    void restore_durability();
+
+    // whether the image_footprints table exists (1 / 0), -1 if unknown; avoids a schema query per find_range_st() call
+    std::atomic<int> _has_footprints;
+
     static std::string sqlite_as_string(sqlite3_stmt* stmt, uint16_t col);
 
 
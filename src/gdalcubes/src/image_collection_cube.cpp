@@ -25,29 +25,126 @@
 
 #include <gdal_utils.h>
 
+#include <algorithm>
 #include <map>
 #include <unordered_map>
 
+#include "dataset_pool.h"
 #include "error.h"
+#include "prefetch.h"
+#include "remote_cache.h"
 #include "utils.h"
 #include "warp.h"
 
 namespace gdalcubes {
 
-image_collection_cube::image_collection_cube(std::shared_ptr<image_collection> ic, cube_view v) : cube(std::make_shared<cube_view>(v)), _collection(ic), _input_bands(), _mask(nullptr), _mask_band("") { load_bands(); }
-image_collection_cube::image_collection_cube(std::string icfile, cube_view v) : cube(std::make_shared<cube_view>(v)), _collection(std::make_shared<image_collection>(icfile)), _input_bands(), _mask(nullptr), _mask_band("") { load_bands(); }
-image_collection_cube::image_collection_cube(std::shared_ptr<image_collection> ic, std::string vfile) : cube(std::make_shared<cube_view>(cube_view::read_json(vfile))), _collection(ic), _input_bands(), _mask(nullptr), _mask_band("") { load_bands(); }
-image_collection_cube::image_collection_cube(std::string icfile, std::string vfile) : cube(std::make_shared<cube_view>(cube_view::read_json(vfile))), _collection(std::make_shared<image_collection>(icfile)), _input_bands(), _mask(nullptr), _mask_band("") { load_bands(); }
-image_collection_cube::image_collection_cube(std::shared_ptr<image_collection> ic) : cube(), _collection(ic), _input_bands(), _mask(nullptr), _mask_band("") {
+/*
+ * Prediction of next chunks and their intersection plans. Plans are computed by background tasks,
+ * which additionally announce the relevant source windows to GDAL, and are consumed by read_chunk().
+ */
+struct image_collection_cube::prefetch_state {
+    chunk_access_predictor predictor;
+    prefetch_plans plans;
+};
+
+image_collection_cube::image_collection_cube(std::shared_ptr<image_collection> ic, cube_view v) : cube(std::make_shared<cube_view>(v)), _collection(ic), _input_bands(), _mask(nullptr), _mask_band(""), _image_md_filter(), _image_md_order(""), _snapshot_file(""), _prefetch(std::make_shared<prefetch_state>()) { load_bands(); }
+image_collection_cube::image_collection_cube(std::string icfile, cube_view v) : cube(std::make_shared<cube_view>(v)), _collection(std::make_shared<image_collection>(icfile)), _input_bands(), _mask(nullptr), _mask_band(""), _image_md_filter(), _image_md_order(""), _snapshot_file(""), _prefetch(std::make_shared<prefetch_state>()) { load_bands(); }
+image_collection_cube::image_collection_cube(std::shared_ptr<image_collection> ic, std::string vfile) : cube(std::make_shared<cube_view>(cube_view::read_json(vfile))), _collection(ic), _input_bands(), _mask(nullptr), _mask_band(""), _image_md_filter(), _image_md_order(""), _snapshot_file(""), _prefetch(std::make_shared<prefetch_state>()) { load_bands(); }
+image_collection_cube::image_collection_cube(std::string icfile, std::string vfile) : cube(std::make_shared<cube_view>(cube_view::read_json(vfile))), _collection(std::make_shared<image_collection>(icfile)), _input_bands(), _mask(nullptr), _mask_band(""), _image_md_filter(), _image_md_order(""), _snapshot_file(""), _prefetch(std::make_shared<prefetch_state>()) { load_bands(); }
+image_collection_cube::image_collection_cube(std::shared_ptr<image_collection> ic) : cube(), _collection(ic), _input_bands(), _mask(nullptr), _mask_band(""), _image_md_filter(), _image_md_order(""), _snapshot_file(""), _prefetch(std::make_shared<prefetch_state>()) {
     st_reference(std::make_shared<cube_view>(image_collection_cube::default_view(_collection)));
     load_bands();
 }
 
-image_collection_cube::image_collection_cube(std::string icfile) : cube(), _collection(std::make_shared<image_collection>(icfile)), _input_bands(), _mask(nullptr), _mask_band("") {
+image_collection_cube::image_collection_cube(std::string icfile) : cube(), _collection(std::make_shared<image_collection>(icfile)), _input_bands(), _mask(nullptr), _mask_band(""), _image_md_filter(), _image_md_order(""), _snapshot_file(""), _prefetch(std::make_shared<prefetch_state>()) {
     st_reference(std::make_shared<cube_view>(image_collection_cube::default_view(_collection)));
     load_bands();
 }
 
+uint32_t image_mask::bitmask(const std::vector<uint8_t> &bits) {
+    uint32_t out = 0;
+    for (uint8_t ib = 0; ib < bits.size(); ++ib) {
+        out |= (uint32_t(1) << bits[ib]);
+    }
+    return out;
+}
+
+void image_mask::build_lut() {
+    _lut.resize(65536);
+    for (uint32_t i = 0; i < 65536; ++i) {
+        _lut[i] = is_masked(double(i)) ? 1 : 0;
+    }
+}
+
+void image_mask::evaluate(const double *mask_buf, uint8_t *out, uint32_t n) {
+    // masks are shared between threads of the chunk processor
+    std::call_once(_lut_once, [this]() { build_lut(); });
+    for (uint32_t i = 0; i < n; ++i) {
+        double v = mask_buf[i];
+        // integers in [0, 65535] are looked up, everything else (including NAN) is evaluated directly
+        if (v >= 0 && v < 65536) {
+            uint32_t k = (uint32_t)v;
+            if ((double)k == v) {
+                out[i] = _lut[k];
+                continue;
+            }
+        }
+        out[i] = is_masked(v) ? 1 : 0;
+    }
+}
+
+void image_mask::apply(double *mask_buf, double *pixel_buf, uint32_t nb, uint32_t ny, uint32_t nx) {
+    uint32_t n = ny * nx;
+    std::vector<uint8_t> masked(n);
+    evaluate(mask_buf, masked.data(), n);
+
+    // set all bands of masked pixels to NAN, band by band to write contiguous memory
+    for (uint32_t ib = 0; ib < nb; ++ib) {
+        double *band_buf = pixel_buf + uint64_t(ib) * n;
+        for (uint32_t i = 0; i < n; ++i) {
+            if (masked[i]) band_buf[i] = NAN;
+        }
+    }
+}
+
+std::shared_ptr<image_mask> image_mask::from_json(json11::Json j) {
+    if (j["mask_type"].is_null()) {
+        GCBS_WARN("Missing mask type");
+        return nullptr;
+    }
+    std::string mask_type = j["mask_type"].string_value();
+    std::vector<uint8_t> bits;
+    for (uint16_t i = 0; i < j["bits"].array_items().size(); ++i) {
+        bits.push_back(j["bits"][i].int_value());
+    }
+    if (mask_type == "value_mask") {
+        std::unordered_set<double> vals;
+        for (uint16_t i = 0; i < j["values"].array_items().size(); ++i) {
+            vals.insert(j["values"][i].number_value());
+        }
+        return std::make_shared<value_mask>(vals, j["invert"].bool_value(), bits);
+    } else if (mask_type == "range_mask") {
+        return std::make_shared<range_mask>(j["min"].number_value(), j["max"].number_value(), j["invert"].bool_value(), bits);
+    } else if (mask_type == "mask_combination") {
+        std::vector<std::shared_ptr<image_mask>> masks;
+        for (uint16_t i = 0; i < j["masks"].array_items().size(); ++i) {
+            std::shared_ptr<image_mask> m = from_json(j["masks"][i]);
+            if (!m) return nullptr;
+            masks.push_back(m);
+        }
+        std::string op = j["op"].string_value();
+        if (op == "and") {
+            return std::make_shared<mask_combination>(mask_combination::op::AND, masks);
+        } else if (op == "or") {
+            return std::make_shared<mask_combination>(mask_combination::op::OR, masks);
+        }
+        GCBS_WARN("Invalid mask combination operator '" + op + "'");
+        return nullptr;
+    }
+    GCBS_WARN("Invalid mask type '" + mask_type + "'");
+    return nullptr;
+}
+
 std::string image_collection_cube::to_string() {
     std::stringstream out;
     std::shared_ptr<cube_view> x = std::dynamic_pointer_cast<cube_view>(_st_ref);
@@ -305,6 +402,116 @@ struct aggregation_state_none : public aggregation_state {
     void finalize(void *buf) override {}
 };
 
+void image_collection_cube::prefetch(chunkid_t id) {
+    uint16_t depth = config::instance()->get_prefetch_depth();
+    if (depth == 0) return;
+
+    std::vector<chunkid_t> next = _prefetch->predictor.next(id, count_chunks(), depth);
+    if (next.empty()) return;
+
+    // bands that will be read, including the mask band
+    std::set<std::string> band_names;
+    for (uint16_t ib = 0; ib < _bands.count(); ++ib) {
+        band_names.insert(_bands.get(ib).name);
+    }
+    if (_mask) {
+        band_names.insert(_mask_band);
+    }
+    bool use_overviews = config::instance()->get_gdal_use_overviews();
+
+    for (uint16_t k = 0; k < next.size(); ++k) {
+        chunkid_t next_id = next[k];
+        bounds_st extent = bounds_from_chunk(next_id);
+        coords_nd<uint32_t, 3> size_tyx = chunk_size(next_id);
+        // limit the number of plans, plans of mispredicted chunks are dropped
+        if (!_prefetch->plans.add(next_id, extent, uint32_t(16) * depth)) {
+            continue;
+        }
+
+        // Notice that the task must not capture this, because the cube might be destroyed before the task runs
+        std::shared_ptr<image_collection> collection = _collection;
+        std::shared_ptr<prefetch_state> state = _prefetch;
+        std::string srs = _st_ref->srs();
+        std::vector<image_collection::image_md_predicate> md_filter = _image_md_filter;
+        std::string md_order = _image_md_order;
+        bool queued = prefetch_queue::instance()->push([collection, state, next_id, extent, srs, md_filter, md_order, band_names, size_tyx, use_overviews]() {
+            std::vector<image_collection::find_range_st_row> datasets = collection->find_range_st(extent, srs, std::vector<std::string>(), std::vector<std::string>{"gdalrefs.image_id", "gdalrefs.descriptor"}, md_filter, md_order);
+
+            // map: gdal dataset descriptor -> (srs, band numbers)
+            std::map<std::string, std::pair<std::string, std::vector<int>>> descriptors;
+            for (uint32_t i = 0; i < datasets.size(); ++i) {
+                if (band_names.count(datasets[i].band_name) == 0) continue;
+                descriptors[datasets[i].descriptor].first = datasets[i].srs;
+                descriptors[datasets[i].descriptor].second.push_back(datasets[i].band_num);
+            }
+
+            uint64_t bytes = 0;
+            for (auto it = descriptors.begin(); it != descriptors.end(); ++it) {
+                // The handle goes back to the pool afterwards, such that read_image() reads the chunk through the same handle.
+                // Remote files that are not read through the local block cache are announced only, other files are read ahead.
+                std::string descriptor = remote_block_cache::instance()->wrap(it->first);
+                bool advise = descriptor == it->first && remote_block_cache::remote_prefix_pos(descriptor) != std::string::npos;
+                pooled_dataset g(descriptor);
+                if (!g) continue;
+
+                double affine[6];
+                if (g->GetGeoTransform(affine) != CE_None || affine[2] != 0 || affine[4] != 0) {
+                    continue;  // only north-up images
+                }
+                std::vector<int> band_map;
+                for (uint16_t b = 0; b < it->second.second.size(); ++b) {
+                    if (it->second.second[b] >= 1 && it->second.second[b] <= g->GetRasterCount()) {
+                        band_map.push_back(it->second.second[b]);
+                    }
+                }
+                if (band_map.empty()) continue;
+
+                std::string img_srs = it->second.first.empty() ? std::string(g->GetProjectionRef()) : it->second.first;
+                bounds_2d<double> win = extent.s;
+                win.transform(srs, img_srs);
+
+                int32_t left = (int32_t)std::floor((win.left - affine[0]) / affine[1]);
+                int32_t right = (int32_t)std::ceil((win.right - affine[0]) / affine[1]);
+                int32_t top = (int32_t)std::floor((win.top - affine[3]) / affine[5]);
+                int32_t bottom = (int32_t)std::ceil((win.bottom - affine[3]) / affine[5]);
+                if (left > right) std::swap(left, right);
+                if (top > bottom) std::swap(top, bottom);
+                left = std::max(left, 0);
+                top = std::max(top, 0);
+                right = std::min(right, g->GetRasterXSize());
+                bottom = std::min(bottom, g->GetRasterYSize());
+                if (right <= left || bottom <= top) continue;
+
+                // let GDAL select overviews if the chunk has a lower resolution than the image
+                int buf_x = right - left;
+                int buf_y = bottom - top;
+                if (use_overviews) {
+                    buf_x = std::min(buf_x, (int)size_tyx[2]);
+                    buf_y = std::min(buf_y, (int)size_tyx[1]);
+                }
+
+                GDALDataType type = g->GetRasterBand(band_map[0])->GetRasterDataType();
+                uint64_t size = uint64_t(buf_x) * uint64_t(buf_y) * band_map.size() * GDALGetDataTypeSizeBytes(type);
+                if (!prefetch_queue::instance()->reserve(size)) {
+                    break;  // memory limit reached
+                }
+                bytes += size;
+                prefetch_window(g.get(), advise, left, top, right - left, bottom - top, buf_x, buf_y, type, band_map);
+            }
+
+            state->plans.complete(next_id, datasets, bytes);
+        });
+        if (!queued) {
+            _prefetch->plans.remove(next_id);
+            return;
+        }
+    }
+}
+
+bool image_collection_cube::take_prefetched(chunkid_t id, bounds_st extent, std::vector<image_collection::find_range_st_row> &datasets) {
+    return _prefetch->plans.take(id, extent, datasets);
+}
+
 /*
  * The procedure to read data for a chunk is the following:
  * 1. Exclude images that are completely ouside the spatiotemporal chunk boundaries
@@ -312,274 +519,296 @@ struct aggregation_state_none : public aggregation_state {
  * 3. use gdal warp to reproject the VRT dataset to an in-memory GDAL dataset (this will take most of the time)
  * 4. use RasterIO to read from the dataset
  */
-std::shared_ptr<chunk_data> image_collection_cube::read_chunk(chunkid_t id) {
-    GCBS_TRACE("image_collection_cube::read_chunk(" + std::to_string(id) + ")");
-    std::shared_ptr<chunk_data> out = std::make_shared<chunk_data>();
-    if (id >= count_chunks()) {
-        // chunk is outside of the cube, we don't need to read anything.
-        GCBS_WARN("Chunk id " + std::to_string(id) + " is out of range");
-        return out;
+static aggregation_state *make_aggregation_state(aggregation::aggregation_type method, coords_nd<uint32_t, 4> size_btyx) {
+    if (method == aggregation::aggregation_type::AGG_MEAN) {
+        return new aggregation_state_mean(size_btyx);
+    } else if (method == aggregation::aggregation_type::AGG_MIN) {
+        return new aggregation_state_min(size_btyx);
+    } else if (method == aggregation::aggregation_type::AGG_MAX) {
+        return new aggregation_state_max(size_btyx);
+    } else if (method == aggregation::aggregation_type::AGG_FIRST) {
+        return new aggregation_state_first(size_btyx);
+    } else if (method == aggregation::aggregation_type::AGG_LAST) {
+        return new aggregation_state_last(size_btyx);
+    } else if (method == aggregation::aggregation_type::AGG_MEDIAN) {
+        return new aggregation_state_median(size_btyx);
+    } else if (method == aggregation::aggregation_type::AGG_IMAGE_COUNT) {
+        return new aggregation_state_count_images(size_btyx);
+    } else if (method == aggregation::aggregation_type::AGG_VALUE_COUNT) {
+        return new aggregation_state_count_values(size_btyx);
     }
+    return new aggregation_state_none(size_btyx);
+}
 
-    // Find intersecting images from collection and iterate over these
-    // Note that these are ordered by image id and descriptor
-    bounds_st cextent = bounds_from_chunk(id);
-    std::vector<image_collection::find_range_st_row> datasets = _collection->find_range_st(cextent, _st_ref->srs(), std::vector<std::string>(), std::vector<std::string>{"gdalrefs.image_id", "gdalrefs.descriptor"});
-
-    if (datasets.empty()) {
-        //GCBS_DEBUG("Chunk " + std::to_string(id) + " does not intersect with any image from the image_collection_cube");
-        return out;  // empty chunk data
+std::vector<image_collection_cube::chunk_image> image_collection_cube::find_chunk_images(chunkid_t id, bounds_st cextent, uint32_t nt) {
+    // Announce source data of the next chunks while this chunk is being read and processed;
+    // if this chunk has been prefetched before, its intersecting images are already known
+    prefetch(id);
+    std::vector<image_collection::find_range_st_row> datasets;
+    if (!take_prefetched(id, cextent, datasets)) {
+        datasets = _collection->find_range_st(cextent, _st_ref->srs(), std::vector<std::string>(), std::vector<std::string>{"gdalrefs.image_id", "gdalrefs.descriptor"}, _image_md_filter, _image_md_order);
     }
 
-    // Derive how many pixels the chunk has (this varies for chunks at the boundary of the view)
-    coords_nd<uint32_t, 3> size_tyx = chunk_size(id);
-    coords_nd<uint32_t, 4> size_btyx = {_bands.count(), size_tyx[0], size_tyx[1], size_tyx[2]};
-    out->size(size_btyx);
-
-    if (size_btyx[0] * size_btyx[1] * size_btyx[2] * size_btyx[3] == 0)
-        return out;
-
-    // Fill buffers accordingly
-    out->buf(std::calloc(size_btyx[0] * size_btyx[1] * size_btyx[2] * size_btyx[3], sizeof(double)));
-    double *begin = (double *)out->buf();
-    double *end = ((double *)out->buf()) + size_btyx[0] * size_btyx[1] * size_btyx[2] * size_btyx[3];
-    std::fill(begin, end, NAN);
+    std::vector<chunk_image> out;
 
-    OGRSpatialReference proj_out;
-    proj_out.SetFromUserInput(_st_ref->srs().c_str());
-
-    aggregation_state *agg = nullptr;
-    if (view()->aggregation_method() == aggregation::aggregation_type::AGG_MEAN) {
-        agg = new aggregation_state_mean(size_btyx);
-    } else if (view()->aggregation_method() == aggregation::aggregation_type::AGG_MIN) {
-        agg = new aggregation_state_min(size_btyx);
-    } else if (view()->aggregation_method() == aggregation::aggregation_type::AGG_MAX) {
-        agg = new aggregation_state_max(size_btyx);
-    } else if (view()->aggregation_method() == aggregation::aggregation_type::AGG_FIRST) {
-        agg = new aggregation_state_first(size_btyx);
-    } else if (view()->aggregation_method() == aggregation::aggregation_type::AGG_LAST) {
-        agg = new aggregation_state_last(size_btyx);
-    } else if (view()->aggregation_method() == aggregation::aggregation_type::AGG_MEDIAN) {
-        agg = new aggregation_state_median(size_btyx);
-    } else if (view()->aggregation_method() == aggregation::aggregation_type::AGG_IMAGE_COUNT) {
-        agg = new aggregation_state_count_images(size_btyx);
-    } else if (view()->aggregation_method() == aggregation::aggregation_type::AGG_VALUE_COUNT) {
-        agg = new aggregation_state_count_values(size_btyx);
-    } else
-        agg = new aggregation_state_none(size_btyx);
-
-    agg->init();
-
-    void *img_buf = std::calloc(size_btyx[0] * size_btyx[3] * size_btyx[2], sizeof(double));
-    void *mask_buf = nullptr;
-    if (_mask) {
-        mask_buf = std::calloc(size_btyx[3] * size_btyx[2], sizeof(double));
-    }
+    duration temp_dt = _st_ref->dt();
+    datetime_unit temp_unit = _st_ref->dt_unit();
 
     uint32_t i = 0;
     while (i < datasets.size()) {
-        std::pair<std::string, uint16_t> mask_dataset_band;
-        mask_dataset_band.first = "";
-        mask_dataset_band.second = 0;
+        chunk_image img;
+        img.mask_dataset_band.first = "";
+        img.mask_dataset_band.second = 0;
 
         uint32_t image_id = datasets[i].image_id;
-        std::string image_name = datasets[i].image_name;
-        std::string src_srs = datasets[i].srs;
+        img.image_name = datasets[i].image_name;
+        img.srs = datasets[i].srs;
         datetime dt = datetime::from_string(datasets[i].datetime);
-        dt.unit(_st_ref->dt_unit());  // explicit datetime unit cast
-        duration temp_dt = _st_ref->dt();
-        int itime = (dt - cextent.t0) / temp_dt;  // time index, at which time slice of the chunk buffer will this image be written?
+        dt.unit(temp_unit);  // explicit datetime unit cast
+        img.itime = (dt - cextent.t0) / temp_dt;  // time index, at which time slice of the chunk buffer will this image be written?
 
-        // map: gdal dataset descriptor -> list of contained bands (name and number)
-        std::unordered_map<std::string, std::vector<std::tuple<std::string, uint16_t>>> image_datasets;
         while (i < datasets.size() && datasets[i].image_id == image_id) {
             std::string descriptor_name = datasets[i].descriptor;
             while (i < datasets.size() && datasets[i].image_id == image_id && datasets[i].descriptor == descriptor_name) {
                 if (_mask) {
                     if (datasets[i].band_name == _mask_band) {
-                        mask_dataset_band.first = descriptor_name;
-                        mask_dataset_band.second = datasets[i].band_num;
+                        img.mask_dataset_band.first = descriptor_name;
+                        img.mask_dataset_band.second = datasets[i].band_num;
                     }
                 }
                 if (_bands.has(datasets[i].band_name)) {
-                    image_datasets[descriptor_name].push_back(std::tuple<std::string, uint16_t>(datasets[i].band_name, datasets[i].band_num));
+                    img.datasets[descriptor_name].push_back(std::tuple<std::string, uint16_t>(datasets[i].band_name, datasets[i].band_num));
                 }
                 ++i;
             }
         }
-        if (image_datasets.empty()) {
+        if (img.datasets.empty()) {
             continue;
         }
-        if (itime < 0 || itime >= (int)(out->size()[1])) {
+        if (img.itime < 0 || img.itime >= (int)nt) {
             continue;  // image would be written outside of the chunk buffer
         }
+        out.push_back(img);
+    }
+    return out;
+}
 
-        // refill for all images
-        std::fill((double *)img_buf, ((double *)img_buf) + size_btyx[0] * size_btyx[3] * size_btyx[2], NAN);
-
-        for (auto it = image_datasets.begin(); it != image_datasets.end(); ++it) {
-            GDALDataset *bandsel_vrt = nullptr;
-            std::string bandsel_vrt_name = "";
-            GDALDataset *g = (GDALDataset *)GDALOpen(it->first.c_str(), GA_ReadOnly);
-            if (!g) {
-                GCBS_WARN("GDAL cannot open '" + it->first + "', image will be ignored");
-                continue;
-            }
+void image_collection_cube::read_image(const chunk_image &img, bounds_st cextent, coords_nd<uint32_t, 4> size_btyx, double *img_buf, double *mask_buf) {
+    // refill for all images
+    std::fill(img_buf, img_buf + size_btyx[0] * size_btyx[3] * size_btyx[2], NAN);
+
+    for (auto it = img.datasets.begin(); it != img.datasets.end(); ++it) {
+        GDALDataset *bandsel_vrt = nullptr;
+        std::string bandsel_vrt_name = "";
+        // pooled handles may have been used for prefetching the chunk and contain its blocks already
+        pooled_dataset g(remote_block_cache::instance()->wrap(it->first));
+        if (!g) {
+            GCBS_WARN("GDAL cannot open '" + it->first + "', image will be ignored");
+            continue;
+        }
 
-            // If input dataset has more bands than requested
-            bool create_band_subset_vrt = false;
-            if (g->GetRasterCount() > int(it->second.size())) {
-                create_band_subset_vrt = true;
-                // create temporary VRT dataset
+        // If input dataset has more bands than requested
+        bool create_band_subset_vrt = false;
+        if (g->GetRasterCount() > int(it->second.size())) {
+            create_band_subset_vrt = true;
+            // create temporary VRT dataset
 
-                CPLStringList translate_args;
-                translate_args.AddString("-of");
-                translate_args.AddString("VRT");
+            CPLStringList translate_args;
+            translate_args.AddString("-of");
+            translate_args.AddString("VRT");
 
-                for (uint16_t b = 0; b < it->second.size(); ++b) {
-                    translate_args.AddString("-b");
-                    translate_args.AddString(std::to_string(std::get<1>(it->second[b])).c_str());
-                }
+            for (uint16_t b = 0; b < it->second.size(); ++b) {
+                translate_args.AddString("-b");
+                translate_args.AddString(std::to_string(std::get<1>(it->second[b])).c_str());
+            }
 
-                GDALTranslateOptions *trans_options = GDALTranslateOptionsNew(translate_args.List(), NULL);
-                if (trans_options == NULL) {
-                    GCBS_ERROR("Cannot create gdal_translate options");
-                    throw std::string("Cannot create gdal_translate options");
-                }
-                bandsel_vrt_name = "/vsimem/" + utils::generate_unique_filename() + ".vrt";
-                bandsel_vrt = (GDALDataset *)GDALTranslate(bandsel_vrt_name.c_str(), (GDALDatasetH)g, trans_options, NULL);
-                if (bandsel_vrt == NULL) {
-                    create_band_subset_vrt = false;
-                }
-                GDALTranslateOptionsFree(trans_options);
+            GDALTranslateOptions *trans_options = GDALTranslateOptionsNew(translate_args.List(), NULL);
+            if (trans_options == NULL) {
+                GCBS_ERROR("Cannot create gdal_translate options");
+                throw std::string("Cannot create gdal_translate options");
+            }
+            bandsel_vrt_name = "/vsimem/" + utils::generate_unique_filename() + ".vrt";
+            bandsel_vrt = (GDALDataset *)GDALTranslate(bandsel_vrt_name.c_str(), (GDALDatasetH)g.get(), trans_options, NULL);
+            if (bandsel_vrt == NULL) {
+                create_band_subset_vrt = false;
             }
+            GDALTranslateOptionsFree(trans_options);
+        }
 
-            std::vector<double> nodata_value_list;
-            //std::string nodata_value_list = "";
-            for (uint16_t b = 0; b < it->second.size(); ++b) {
-                if (!_input_bands.get(std::get<0>(it->second[b])).no_data_value.empty()) {
-                    //nodata_value_list += _input_bands.get(std::get<0>(it->second[b])).no_data_value;
-                    nodata_value_list.push_back(std::stod(_input_bands.get(std::get<0>(it->second[b])).no_data_value));
-                    //if (b < it->second.size() - 1) nodata_value_list += " ";
-                }
+        std::vector<double> nodata_value_list;
+        //std::string nodata_value_list = "";
+        for (uint16_t b = 0; b < it->second.size(); ++b) {
+            if (!_input_bands.get(std::get<0>(it->second[b])).no_data_value.empty()) {
+                //nodata_value_list += _input_bands.get(std::get<0>(it->second[b])).no_data_value;
+                nodata_value_list.push_back(std::stod(_input_bands.get(std::get<0>(it->second[b])).no_data_value));
+                //if (b < it->second.size() - 1) nodata_value_list += " ";
             }
-            if (nodata_value_list.empty()) {
-                // try to derive nodata value from gdal dataset
-                GDALDataset *d = (create_band_subset_vrt && bandsel_vrt != nullptr) ? bandsel_vrt : g;
-                for (uint16_t b = 0; b < d->GetRasterCount(); ++b) {
-                    int succ = 0;
-                    double val = d->GetRasterBand(b + 1)->GetNoDataValue(&succ);
-                    if (succ) {
-                        nodata_value_list.push_back(val);
-                    }
-                }
-                if ((int)nodata_value_list.size() != d->GetRasterCount()) {
-                    nodata_value_list.clear();
+        }
+        if (nodata_value_list.empty()) {
+            // try to derive nodata value from gdal dataset
+            GDALDataset *d = (create_band_subset_vrt && bandsel_vrt != nullptr) ? bandsel_vrt : g.get();
+            for (uint16_t b = 0; b < d->GetRasterCount(); ++b) {
+                int succ = 0;
+                double val = d->GetRasterBand(b + 1)->GetNoDataValue(&succ);
+                if (succ) {
+                    nodata_value_list.push_back(val);
                 }
             }
+            if ((int)nodata_value_list.size() != d->GetRasterCount()) {
+                nodata_value_list.clear();
+            }
+        }
+
+        GDALDataset *gdal_out = nullptr;
+        if (create_band_subset_vrt && bandsel_vrt != nullptr) {
+            //gdal_out = (GDALDataset *)GDALWarp("", NULL, 1, (GDALDatasetH *)(&bandsel_vrt), warp_opts, NULL);
+            gdal_out = gdalwarp_client::warp(bandsel_vrt, img.srs.c_str(), _st_ref->srs().c_str(), cextent.s.left, cextent.s.right,
+                                             cextent.s.top, cextent.s.bottom, size_btyx[3], size_btyx[2],
+                                             resampling::to_string(view()->resampling_method()), nodata_value_list);
+        } else {
+            //gdal_out = (GDALDataset *)GDALWarp("", NULL, 1, (GDALDatasetH *)(&g), warp_opts, NULL);
+            g->Reference();  // warp releases one reference, the handle goes back to the pool
+            gdal_out = gdalwarp_client::warp(g.get(), img.srs.c_str(), _st_ref->srs().c_str(), cextent.s.left, cextent.s.right,
+                                             cextent.s.top, cextent.s.bottom, size_btyx[3], size_btyx[2],
+                                             resampling::to_string(view()->resampling_method()), nodata_value_list);
+        }
 
-            GDALDataset *gdal_out = nullptr;
-            if (create_band_subset_vrt && bandsel_vrt != nullptr) {
-                //gdal_out = (GDALDataset *)GDALWarp("", NULL, 1, (GDALDatasetH *)(&bandsel_vrt), warp_opts, NULL);
-                gdal_out = gdalwarp_client::warp(bandsel_vrt, src_srs.c_str(), _st_ref->srs().c_str(), cextent.s.left, cextent.s.right,
-                                                 cextent.s.top, cextent.s.bottom, size_btyx[3], size_btyx[2],
-                                                 resampling::to_string(view()->resampling_method()), nodata_value_list);
+        // For each band, call RasterIO to read and copy data to the right position in the buffers
+        for (uint16_t b = 0; b < it->second.size(); ++b) {
+            uint16_t b_internal = _bands.get_index(std::get<0>(it->second[b]));
+
+            // Make sure that b_internal is valid in order to prevent buffer overflows
+            if (b_internal < 0 || b_internal >= size_btyx[0])
+                continue;
+
+            CPLErr res;
+            if (create_band_subset_vrt) {  // bands have been renumbered / sorted according to order of it->second
+                res = gdal_out->GetRasterBand(b + 1)->RasterIO(GF_Read, 0, 0, size_btyx[3], size_btyx[2], img_buf + b_internal * size_btyx[2] * size_btyx[3], size_btyx[3], size_btyx[2], GDT_Float64, 0, 0, NULL);
             } else {
-                //gdal_out = (GDALDataset *)GDALWarp("", NULL, 1, (GDALDatasetH *)(&g), warp_opts, NULL);
-                gdal_out = gdalwarp_client::warp(g, src_srs.c_str(), _st_ref->srs().c_str(), cextent.s.left, cextent.s.right,
-                                                 cextent.s.top, cextent.s.bottom, size_btyx[3], size_btyx[2],
-                                                 resampling::to_string(view()->resampling_method()), nodata_value_list);
+                res = gdal_out->GetRasterBand(std::get<1>(it->second[b]))->RasterIO(GF_Read, 0, 0, size_btyx[3], size_btyx[2], img_buf + b_internal * size_btyx[2] * size_btyx[3], size_btyx[3], size_btyx[2], GDT_Float64, 0, 0, NULL);
+            }
+            if (res != CE_None) {
+                GCBS_WARN("RasterIO (read) failed for " + std::string(gdal_out->GetDescription()));
             }
+        }
+        if (!bandsel_vrt_name.empty()) {
+            filesystem::remove(bandsel_vrt_name);
+        }
+        GDALClose(gdal_out);
+    }
 
-            // For each band, call RasterIO to read and copy data to the right position in the buffers
-            for (uint16_t b = 0; b < it->second.size(); ++b) {
-                uint16_t b_internal = _bands.get_index(std::get<0>(it->second[b]));
+    // now, we have filled img_buf with data from all available bands
+    if (_mask) {
+        // if we apply a mask, we again read the mask band with NN / MODE resampling
+        // read mask again (with NN
 
-                // Make sure that b_internal is valid in order to prevent buffer overflows
-                if (b_internal < 0 || b_internal >= out->size()[0])
-                    continue;
+        // find out, which dataset has mask band
+        if (img.mask_dataset_band.first.empty()) {
+            GCBS_WARN("Missing mask band for image '" + img.image_name + "', mask will be ignored");
+        } else {
+            GDALDataset *bandsel_vrt = nullptr;
+            pooled_dataset g(remote_block_cache::instance()->wrap(img.mask_dataset_band.first));
+            if (!g) {
+                GCBS_WARN("GDAL cannot open '" + img.mask_dataset_band.first + "', mask will be ignored");
+            }
+            else {
+                // If input dataset has more bands than requested
+                bool create_band_subset_vrt = false;
+                if (g->GetRasterCount() > 1) {
+                    create_band_subset_vrt = true;
+                    // create temporary VRT dataset
 
-                CPLErr res;
-                if (create_band_subset_vrt) {  // bands have been renumbered / sorted according to order of it->second
-                    res = gdal_out->GetRasterBand(b + 1)->RasterIO(GF_Read, 0, 0, size_btyx[3], size_btyx[2], ((double *)img_buf) + b_internal * size_btyx[2] * size_btyx[3], size_btyx[3], size_btyx[2], GDT_Float64, 0, 0, NULL);
+                    CPLStringList translate_args;
+                    translate_args.AddString("-of");
+                    translate_args.AddString("VRT");
+
+                    translate_args.AddString("-b");
+                    translate_args.AddString(std::to_string(img.mask_dataset_band.second).c_str());
+
+                    GDALTranslateOptions *trans_options = GDALTranslateOptionsNew(translate_args.List(), NULL);
+                    if (trans_options == NULL) {
+                        GCBS_ERROR("Cannot create gdal_translate options");
+                        throw std::string("Cannot create gdal_translate options");
+                    }
+
+                    bandsel_vrt = (GDALDataset *)GDALTranslate("", (GDALDatasetH)g.get(), trans_options, NULL);
+                    if (bandsel_vrt == NULL) {
+                        create_band_subset_vrt = false;
+                    }
+                    GDALTranslateOptionsFree(trans_options);
+                }
+
+                GDALDataset *gdal_out = nullptr;
+                if (create_band_subset_vrt && bandsel_vrt != nullptr) {
+                    //gdal_out = (GDALDataset *)GDALWarp("", NULL, 1, (GDALDatasetH *)(&bandsel_vrt), warp_opts, NULL);
+                    gdal_out = gdalwarp_client::warp(bandsel_vrt, img.srs.c_str(), _st_ref->srs().c_str(), cextent.s.left, cextent.s.right,
+                                                     cextent.s.top, cextent.s.bottom, size_btyx[3], size_btyx[2],
+                                                     "near", std::vector<double>());
                 } else {
-                    res = gdal_out->GetRasterBand(std::get<1>(it->second[b]))->RasterIO(GF_Read, 0, 0, size_btyx[3], size_btyx[2], ((double *)img_buf) + b_internal * size_btyx[2] * size_btyx[3], size_btyx[3], size_btyx[2], GDT_Float64, 0, 0, NULL);
+                    //gdal_out = (GDALDataset *)GDALWarp("", NULL, 1, (GDALDatasetH *)(&g), warp_opts, NULL);
+                    g->Reference();
+                    gdal_out = gdalwarp_client::warp(g.get(), img.srs.c_str(), _st_ref->srs().c_str(), cextent.s.left, cextent.s.right,
+                                                     cextent.s.top, cextent.s.bottom, size_btyx[3], size_btyx[2],
+                                                     "near", std::vector<double>());
                 }
+                CPLErr res = gdal_out->GetRasterBand(img.mask_dataset_band.second)->RasterIO(GF_Read, 0, 0, size_btyx[3], size_btyx[2], mask_buf, size_btyx[3], size_btyx[2], GDT_Float64, 0, 0, NULL);
                 if (res != CE_None) {
                     GCBS_WARN("RasterIO (read) failed for " + std::string(gdal_out->GetDescription()));
                 }
+                GDALClose(gdal_out);
+                _mask->apply(mask_buf, img_buf, size_btyx[0], size_btyx[2], size_btyx[3]);
             }
-            if (!bandsel_vrt_name.empty()) {
-                filesystem::remove(bandsel_vrt_name);
-            }
-            GDALClose(gdal_out);
         }
+    }
+}
 
-        // now, we have filled img_buf with data from all available bands
-        if (_mask) {
-            // if we apply a mask, we again read the mask band with NN / MODE resampling
-            // read mask again (with NN
+std::shared_ptr<chunk_data> image_collection_cube::read_chunk(chunkid_t id) {
+    GCBS_TRACE("image_collection_cube::read_chunk(" + std::to_string(id) + ")");
+    std::shared_ptr<chunk_data> out = std::make_shared<chunk_data>();
+    if (id >= count_chunks()) {
+        // chunk is outside of the cube, we don't need to read anything.
+        GCBS_WARN("Chunk id " + std::to_string(id) + " is out of range");
+        return out;
+    }
 
-            // find out, which dataset has mask band
-            if (mask_dataset_band.first.empty()) {
-                GCBS_WARN("Missing mask band for image '" + image_name + "', mask will be ignored");
-            } else {
-                GDALDataset *bandsel_vrt = nullptr;
-                GDALDataset *g = (GDALDataset *)GDALOpen(mask_dataset_band.first.c_str(), GA_ReadOnly);
-                if (!g) {
-                    GCBS_WARN("GDAL cannot open '" + mask_dataset_band.first + "', mask will be ignored");
-                }
-                else {
-                    // If input dataset has more bands than requested
-                    bool create_band_subset_vrt = false;
-                    if (g->GetRasterCount() > 1) {
-                        create_band_subset_vrt = true;
-                        // create temporary VRT dataset
-
-                        CPLStringList translate_args;
-                        translate_args.AddString("-of");
-                        translate_args.AddString("VRT");
-
-                        translate_args.AddString("-b");
-                        translate_args.AddString(std::to_string(mask_dataset_band.second).c_str());
-
-                        GDALTranslateOptions *trans_options = GDALTranslateOptionsNew(translate_args.List(), NULL);
-                        if (trans_options == NULL) {
-                            GCBS_ERROR("Cannot create gdal_translate options");
-                            throw std::string("Cannot create gdal_translate options");
-                        }
-
-                        bandsel_vrt = (GDALDataset *)GDALTranslate("", (GDALDatasetH)g, trans_options, NULL);
-                        if (bandsel_vrt == NULL) {
-                            create_band_subset_vrt = false;
-                        }
-                        GDALTranslateOptionsFree(trans_options);
-                    }
+    // Find intersecting images from collection and iterate over these
+    // Note that these are ordered by image id and descriptor, unless an image metadata key has been set to define the order
+    // (rows of the same image are consecutive in both cases)
+    bounds_st cextent = bounds_from_chunk(id);
 
-                    GDALDataset *gdal_out = nullptr;
-                    if (create_band_subset_vrt && bandsel_vrt != nullptr) {
-                        //gdal_out = (GDALDataset *)GDALWarp("", NULL, 1, (GDALDatasetH *)(&bandsel_vrt), warp_opts, NULL);
-                        gdal_out = gdalwarp_client::warp(bandsel_vrt, src_srs.c_str(), _st_ref->srs().c_str(), cextent.s.left, cextent.s.right,
-                                                         cextent.s.top, cextent.s.bottom, size_btyx[3], size_btyx[2],
-                                                         "near", std::vector<double>());
-                    } else {
-                        //gdal_out = (GDALDataset *)GDALWarp("", NULL, 1, (GDALDatasetH *)(&g), warp_opts, NULL);
-                        gdal_out = gdalwarp_client::warp(g, src_srs.c_str(), _st_ref->srs().c_str(), cextent.s.left, cextent.s.right,
-                                                         cextent.s.top, cextent.s.bottom, size_btyx[3], size_btyx[2],
-                                                         "near", std::vector<double>());
-                    }
-                    CPLErr res = gdal_out->GetRasterBand(mask_dataset_band.second)->RasterIO(GF_Read, 0, 0, size_btyx[3], size_btyx[2], mask_buf, size_btyx[3], size_btyx[2], GDT_Float64, 0, 0, NULL);
-                    if (res != CE_None) {
-                        GCBS_WARN("RasterIO (read) failed for " + std::string(gdal_out->GetDescription()));
-                    }
-                    GDALClose(gdal_out);
-                    _mask->apply((double *)mask_buf, (double *)img_buf, size_btyx[0], size_btyx[2], size_btyx[3]);
-                }
-            }
-        }
+    // Derive how many pixels the chunk has (this varies for chunks at the boundary of the view)
+    coords_nd<uint32_t, 3> size_tyx = chunk_size(id);
+    std::vector<chunk_image> images = find_chunk_images(id, cextent, size_tyx[0]);
+    if (images.empty()) {
+        //GCBS_DEBUG("Chunk " + std::to_string(id) + " does not intersect with any image from the image_collection_cube");
+        return out;  // empty chunk data
+    }
+
+    coords_nd<uint32_t, 4> size_btyx = {_bands.count(), size_tyx[0], size_tyx[1], size_tyx[2]};
+    out->size(size_btyx);
+
+    if (size_btyx[0] * size_btyx[1] * size_btyx[2] * size_btyx[3] == 0)
+        return out;
 
+    // Fill buffers accordingly
+    out->buf(std::calloc(size_btyx[0] * size_btyx[1] * size_btyx[2] * size_btyx[3], sizeof(double)));
+    double *begin = (double *)out->buf();
+    double *end = ((double *)out->buf()) + size_btyx[0] * size_btyx[1] * size_btyx[2] * size_btyx[3];
+    std::fill(begin, end, NAN);
+
+    aggregation_state *agg = make_aggregation_state(view()->aggregation_method(), size_btyx);
+    agg->init();
+
+    double *img_buf = (double *)std::calloc(size_btyx[0] * size_btyx[3] * size_btyx[2], sizeof(double));
+    double *mask_buf = nullptr;
+    if (_mask) {
+        mask_buf = (double *)std::calloc(size_btyx[3] * size_btyx[2], sizeof(double));
+    }
+
+    for (uint32_t i = 0; i < images.size(); ++i) {
+        read_image(images[i], cextent, size_btyx, img_buf, mask_buf);
         // feed the aggregator
-        agg->update(out->buf(), img_buf, itime);
+        agg->update(out->buf(), img_buf, images[i].itime);
     }
 
     agg->finalize(out->buf());
@@ -593,10 +822,67 @@ std::shared_ptr<chunk_data> image_collection_cube::read_chunk(chunkid_t id) {
         out = std::make_shared<chunk_data>();
     }
 
-    //    CPLFree(srs_out_str);
     return out;
 }
 
+void image_collection_cube::read_chunk_slices(chunkid_t id, std::function<void(uint32_t, std::shared_ptr<chunk_data>)> f) {
+    GCBS_TRACE("image_collection_cube::read_chunk_slices(" + std::to_string(id) + ")");
+    if (id >= count_chunks()) {
+        GCBS_WARN("Chunk id " + std::to_string(id) + " is out of range");
+        return;
+    }
+
+    bounds_st cextent = bounds_from_chunk(id);
+    coords_nd<uint32_t, 3> size_tyx = chunk_size(id);
+    std::vector<chunk_image> images = find_chunk_images(id, cextent, size_tyx[0]);
+    if (images.empty()) {
+        return;
+    }
+
+    // one time slice of the chunk
+    coords_nd<uint32_t, 4> size_btyx = {_bands.count(), 1, size_tyx[1], size_tyx[2]};
+    if (size_btyx[0] * size_btyx[2] * size_btyx[3] == 0)
+        return;
+
+    // Images of the same time slice must be passed to the aggregator in their original order (e.g. for first / last)
+    std::stable_sort(images.begin(), images.end(), [](const chunk_image &a, const chunk_image &b) {
+        return a.itime < b.itime;
+    });
+
+    double *img_buf = (double *)std::calloc(size_btyx[0] * size_btyx[3] * size_btyx[2], sizeof(double));
+    double *mask_buf = nullptr;
+    if (_mask) {
+        mask_buf = (double *)std::calloc(size_btyx[3] * size_btyx[2], sizeof(double));
+    }
+
+    uint32_t i = 0;
+    while (i < images.size()) {
+        int itime = images[i].itime;
+
+        std::shared_ptr<chunk_data> slice = std::make_shared<chunk_data>();
+        slice->size(size_btyx);
+        slice->buf(std::calloc(size_btyx[0] * size_btyx[2] * size_btyx[3], sizeof(double)));
+        std::fill((double *)slice->buf(), ((double *)slice->buf()) + size_btyx[0] * size_btyx[2] * size_btyx[3], NAN);
+
+        aggregation_state *agg = make_aggregation_state(view()->aggregation_method(), size_btyx);
+        agg->init();
+        while (i < images.size() && images[i].itime == itime) {
+            read_image(images[i], cextent, size_btyx, img_buf, mask_buf);
+            agg->update(slice->buf(), img_buf, 0);
+            ++i;
+        }
+        agg->finalize(slice->buf());
+        delete agg;
+
+        if (!slice->all_nan()) {
+            f(itime, slice);
+        }
+    }
+
+    std::free(img_buf);
+    if (mask_buf) std::free(mask_buf);
+}
+
 void image_collection_cube::load_bands() {
     // Access image collection and fetch band information
     std::vector<image_collection::bands_row> band_info = _collection->get_available_bands();
@@ -677,6 +963,30 @@ cube_view image_collection_cube::default_view(std::shared_ptr<image_collection>
     return out;
 }
 
+void image_collection_cube::write_snapshot(std::string filename) {
+    // all cells of the cube
+    coords_st low = _st_ref->map_coords({0, 0, 0});
+    coords_st high = _st_ref->map_coords({_st_ref->nt(), _st_ref->ny(), _st_ref->nx()});
+    bounds_st extent;
+    extent.s.left = low.s.x;
+    extent.s.right = high.s.x;
+    extent.s.bottom = high.s.y;
+    extent.s.top = low.s.y;
+    extent.t0 = low.t;
+    extent.t1 = high.t;
+
+    // selected bands and the mask band
+    std::vector<std::string> bands;
+    for (uint16_t i = 0; i < _bands.count(); ++i) {
+        bands.push_back(_bands.get(i).name);
+    }
+    if (_mask && std::find(bands.begin(), bands.end(), _mask_band) == bands.end()) {
+        bands.push_back(_mask_band);
+    }
+    _collection->write_snapshot(filename, extent, _st_ref->srs(), bands, _image_md_filter, _image_md_order);
+    _snapshot_file = filename;
+}
+
 void image_collection_cube::select_bands(std::vector<std::string> bands) {
     if (bands.empty()) {
         load_bands();  // restore band selection from original image collection
@@ -717,4 +1027,15 @@ void image_collection_cube::select_bands(std::vector<uint16_t> bands) {
     _bands = sel;
 }
 
+std::shared_ptr<image_collection_cube> image_collection_cube::with_view(cube_view v) {
+    std::shared_ptr<image_collection_cube> out = image_collection_cube::create(_collection, v);
+    out->_bands = _bands;
+    out->_mask = _mask;
+    out->_mask_band = _mask_band;
+    out->_image_md_filter = _image_md_filter;
+    out->_image_md_order = _image_md_order;
+    out->_snapshot_file = _snapshot_file;
+    return out;
+}
+
 }  // namespace gdalcubes
\ No newline at end of file
@@ -24,6 +24,10 @@
 #ifndef IMAGE_COLLECTION_CUBE_H
 #define IMAGE_COLLECTION_CUBE_H
 
+#include <functional>
+#include <mutex>
+#include <tuple>
+#include <unordered_map>
 #include <unordered_set>
 
 #include "cube.h"
@@ -31,47 +35,67 @@
 
 namespace gdalcubes {
 
+/**
+ * @brief Base class for masks that are applied to images based on the values of a mask band
+ *
+ * Masks are evaluated for many pixels of many images. Implementations provide is_masked() for single values
+ * of the mask band, which is tabulated for all integer values in [0, 65535] when the mask is first evaluated, such that
+ * typical (unsigned) integer quality bands are decoded with a single table lookup per pixel. Masks that are only
+ * used as part of a mask_combination are never evaluated and hence never tabulated.
+ */
 struct image_mask {
     virtual ~image_mask() {}
-    virtual void apply(double *mask_buf, double *pixel_buf, uint32_t nb, uint32_t ny, uint32_t nx) = 0;
+
+    /**
+     * @brief Set all bands of masked pixels to NAN
+     * @param mask_buf values of the mask band with ny rows of nx pixels
+     * @param pixel_buf pixel values of nb bands, each with ny rows of nx pixels
+     */
+    virtual void apply(double *mask_buf, double *pixel_buf, uint32_t nb, uint32_t ny, uint32_t nx);
+
+    /**
+     * @brief Evaluate the mask for n values of the mask band
+     * @param mask_buf values of the mask band
+     * @param out output, 1 for masked pixels and 0 otherwise
+     * @param n number of pixels
+     */
+    void evaluate(const double *mask_buf, uint8_t *out, uint32_t n);
+
+    /**
+     * @brief Check whether a pixel with the given value of the mask band is masked
+     */
+    virtual bool is_masked(double v) const = 0;
+
     virtual json11::Json as_json() = 0;
+
+    /**
+     * @brief Create a mask from its JSON representation
+     * @return mask or nullptr if the JSON representation is invalid
+     */
+    static std::shared_ptr<image_mask> from_json(json11::Json j);
+
+   protected:
+    /**
+     * @brief Tabulate is_masked() for small integers, called once by the first call of evaluate()
+     */
+    void build_lut();
+
+    static uint32_t bitmask(const std::vector<uint8_t> &bits);
+
+   private:
+    std::vector<uint8_t> _lut;
+    std::once_flag _lut_once;
 };
 
 struct value_mask : public image_mask {
    public:
-    value_mask(std::unordered_set<double> mask_values, bool invert = false, std::vector<uint8_t> bits = std::vector<uint8_t>()) : _mask_values(mask_values), _invert(invert), _bits(bits) {}
-    void apply(double *mask_buf, double *pixel_buf, uint32_t nb, uint32_t ny, uint32_t nx) override {
-        uint32_t bitmask = 0;
-        if (!_bits.empty()) {
-            for (uint8_t ib = 0; ib < _bits.size(); ++ib) {
-                bitmask += (uint32_t)std::pow(2.0, (double)_bits[ib]);
-            }
-        }
-        if (!_invert) {
-            for (uint32_t ixy = 0; ixy < ny * nx; ++ixy) {
-                if (!_bits.empty()) {
-                    mask_buf[ixy] = (uint32_t)(mask_buf[ixy]) & bitmask;
-                }
-                if (_mask_values.count(mask_buf[ixy]) == 1) {  // if mask has value
-                    // set all bands to NAN
-                    for (uint32_t ib = 0; ib < nb; ++ib) {
-                        pixel_buf[ib * nx * ny + ixy] = NAN;
-                    }
-                }
-            }
-        } else {
-            for (uint32_t ixy = 0; ixy < ny * nx; ++ixy) {
-                if (!_bits.empty()) {
-                    mask_buf[ixy] = (uint32_t)(mask_buf[ixy]) & bitmask;
-                }
-                if (_mask_values.count(mask_buf[ixy]) == 0) {
-                    // set all bands to NAN
-                    for (uint32_t ib = 0; ib < nb; ++ib) {
-                        pixel_buf[ib * nx * ny + ixy] = NAN;
-                    }
-                }
-            }
+    value_mask(std::unordered_set<double> mask_values, bool invert = false, std::vector<uint8_t> bits = std::vector<uint8_t>()) : _mask_values(mask_values), _invert(invert), _bits(bits), _bitmask(bitmask(bits)) {}
+
+    bool is_masked(double v) const override {
+        if (!_bits.empty() && !std::isnan(v)) {
+            v = (uint32_t)(v)&_bitmask;
         }
+        return (_mask_values.count(v) == 1) != _invert;
     }
 
     json11::Json as_json() override {
@@ -87,44 +111,21 @@ struct value_mask : public image_mask {
     std::unordered_set<double> _mask_values;
     bool _invert;
     std::vector<uint8_t> _bits;
+    uint32_t _bitmask;
 };
 
 struct range_mask : public image_mask {
    public:
-    range_mask(double min, double max, bool invert = false, std::vector<uint8_t> bits = std::vector<uint8_t>()) : _min(min), _max(max), _invert(invert), _bits(bits) {}
+    range_mask(double min, double max, bool invert = false, std::vector<uint8_t> bits = std::vector<uint8_t>()) : _min(min), _max(max), _invert(invert), _bits(bits), _bitmask(bitmask(bits)) {}
 
-    void apply(double *mask_buf, double *pixel_buf, uint32_t nb, uint32_t ny, uint32_t nx) override {
-        uint32_t bitmask = 0;
-        if (!_bits.empty()) {
-            for (uint8_t ib = 0; ib < _bits.size(); ++ib) {
-                bitmask += (uint32_t)std::pow(2.0, (double)_bits[ib]);
-            }
+    bool is_masked(double v) const override {
+        if (!_bits.empty() && !std::isnan(v)) {
+            v = (uint32_t)(v)&_bitmask;
         }
         if (!_invert) {
-            for (uint32_t ixy = 0; ixy < ny * nx; ++ixy) {
-                if (!_bits.empty()) {
-                    mask_buf[ixy] = (uint32_t)(mask_buf[ixy]) & bitmask;
-                }
-                if (mask_buf[ixy] >= _min && mask_buf[ixy] <= _max) {
-                    // set all bands to NAN
-                    for (uint32_t ib = 0; ib < nb; ++ib) {
-                        pixel_buf[ib * nx * ny + ixy] = NAN;
-                    }
-                }
-            }
-        } else {
-            for (uint32_t ixy = 0; ixy < ny * nx; ++ixy) {
-                if (!_bits.empty()) {
-                    mask_buf[ixy] = (uint32_t)(mask_buf[ixy]) & bitmask;
-                }
-                if (mask_buf[ixy] < _min || mask_buf[ixy] > _max) {
-                    // set all bands to NAN
-                    for (uint32_t ib = 0; ib < nb; ++ib) {
-                        pixel_buf[ib * nx * ny + ixy] = NAN;
-                    }
-                }
-            }
+            return v >= _min && v <= _max;
         }
+        return v < _min || v > _max;
     }
 
     json11::Json as_json() override {
@@ -142,6 +143,49 @@ struct range_mask : public image_mask {
     double _max;
     bool _invert;
     std::vector<uint8_t> _bits;
+    uint32_t _bitmask;
+};
+
+/**
+ * @brief Combination of several masks on the same mask band
+ *
+ * With AND, pixels are masked if they are masked by all masks, with OR, pixels are masked if they are masked by
+ * at least one mask. The combination is tabulated as a whole, such that all masks are evaluated in a single pass
+ * and the combined masks themselves are never tabulated.
+ */
+struct mask_combination : public image_mask {
+   public:
+    enum class op {
+        AND,
+        OR
+    };
+
+    mask_combination(op o, std::vector<std::shared_ptr<image_mask>> masks) : _op(o), _masks(masks) {}
+
+    bool is_masked(double v) const override {
+        for (uint16_t i = 0; i < _masks.size(); ++i) {
+            bool m = _masks[i]->is_masked(v);
+            if (_op == op::AND && !m) return false;
+            if (_op == op::OR && m) return true;
+        }
+        return _op == op::AND && !_masks.empty();
+    }
+
+    json11::Json as_json() override {
+        json11::Json::object out;
+        out["mask_type"] = "mask_combination";
+        out["op"] = (_op == op::AND) ? "and" : "or";
+        json11::Json::array masks;
+        for (uint16_t i = 0; i < _masks.size(); ++i) {
+            masks.push_back(_masks[i]->as_json());
+        }
+        out["masks"] = masks;
+        return out;
+    }
+
+   private:
+    op _op;
+    std::vector<std::shared_ptr<image_mask>> _masks;
 };
 
 // TODO: mask that applies a lambda expression / std::function on the mask band
@@ -266,6 +310,15 @@ class image_collection_cube : public cube {
      */
     void select_bands(std::vector<uint16_t> bands);
 
+    /**
+     * @brief Create a data cube from the same image collection with a different data cube view
+     * @details The new cube shares the image collection and keeps the band selection, the image mask, and image metadata
+     * filters and ordering of this cube. Chunk sizes are not copied.
+     * @param v data cube view of the new cube
+     * @return a shared pointer to the created data cube instance
+     */
+    std::shared_ptr<image_collection_cube> with_view(cube_view v);
+
     void set_mask(std::string band, std::shared_ptr<image_mask> mask) {
         std::vector<image_collection::bands_row> bands = _collection->get_available_bands();
         for (uint16_t ib = 0; ib < bands.size(); ++ib) {
@@ -278,8 +331,62 @@ class image_collection_cube : public cube {
         GCBS_ERROR("Band '" + band + "' does not exist in image collection, image mask will not be modified.");
     }
 
+    /**
+     * @brief Only consider images whose metadata satisfy all given predicates
+     * @param filter predicates on image metadata, e.g. "eo:cloud_cover < 30"
+     */
+    void set_image_md_filter(std::vector<image_collection::image_md_predicate> filter) {
+        _image_md_filter = filter;
+        if (!filter.empty()) {
+            _collection->create_image_md_index();
+        }
+    }
+
+    /**
+     * @brief Set the order in which images are read and combined within a chunk, e.g. to prefer images
+     * with low cloud cover for first / last aggregation
+     * @param key image metadata key, a leading "-" sorts in decreasing order, an empty string sorts images by id
+     */
+    void set_image_md_order(std::string key) {
+        _image_md_order = key;
+    }
+
+    /**
+     * @brief Get the image metadata predicates, see set_image_md_filter()
+     */
+    const std::vector<image_collection::image_md_predicate>& image_md_filter() const { return _image_md_filter; }
+
+    /**
+     * @brief Get the image metadata key defining the order of images, see set_image_md_order()
+     */
+    std::string image_md_order() const { return _image_md_order; }
+
+    /**
+     * @brief Write a snapshot of all images needed to read chunks of this cube, which is then referenced by
+     * make_constructible_json() instead of the image collection file
+     * @see image_collection::write_snapshot()
+     * @param filename output file
+     */
+    void write_snapshot(std::string filename);
+
+    /**
+     * @brief Stop referencing a snapshot in make_constructible_json(), e.g., after the snapshot file has been removed
+     */
+    void clear_snapshot() {
+        _snapshot_file = "";
+    }
+
     std::shared_ptr<chunk_data> read_chunk(chunkid_t id) override;
 
+    /**
+     * @brief Read a chunk time slice by time slice without allocating the full chunk buffer
+     * @details Images are warped and aggregated as in read_chunk() but f is called as soon as a time slice is complete.
+     * Slices are visited in ascending time order, empty slices are skipped.
+     * @param id chunk id
+     * @param f function that receives the time index of the slice within the chunk and the slice data with size (nbands, 1, ny, nx)
+     */
+    void read_chunk_slices(chunkid_t id, std::function<void(uint32_t, std::shared_ptr<chunk_data>)> f);
+
     // image_collection_cube allows changing chunk sizes from outside!
     // This is important for e.g. streaming.
     void set_chunk_size(uint32_t t, uint32_t y, uint32_t x) {
@@ -287,7 +394,7 @@ class image_collection_cube : public cube {
     }
 
     json11::Json make_constructible_json() override {
-        if (_collection->is_temporary()) {
+        if (_collection->is_temporary() && _snapshot_file.empty()) {
             throw std::string("ERROR in image_collection_cube::make_constructible_json(): image collection is temporary, please export as file using write() first.");
         }
         json11::Json::object out;
@@ -296,10 +403,23 @@ class image_collection_cube : public cube {
         std::string err;  // TODO: do something with err
         out["view"] = json11::Json::parse(std::dynamic_pointer_cast<cube_view>(_st_ref)->write_json_string(), err);
         out["file"] = _collection->get_filename();
+        if (!_snapshot_file.empty()) {
+            out["snapshot"] = _snapshot_file;
+        }
         if (_mask) {
             out["mask"] = _mask->as_json();
             out["mask_band"] = _mask_band;
         }
+        if (!_image_md_filter.empty()) {
+            json11::Json::array filter;
+            for (uint16_t i = 0; i < _image_md_filter.size(); ++i) {
+                filter.push_back(_image_md_filter[i].to_string());
+            }
+            out["image_md_filter"] = filter;
+        }
+        if (!_image_md_order.empty()) {
+            out["image_md_order"] = _image_md_order;
+        }
         return out;
     }
 
@@ -314,6 +434,30 @@ class image_collection_cube : public cube {
 
     std::shared_ptr<image_mask> _mask;
     std::string _mask_band;
+
+    std::vector<image_collection::image_md_predicate> _image_md_filter;
+    std::string _image_md_order;
+
+    std::string _snapshot_file;
+
+    // state of asynchronous source prefetching, see read_chunk()
+    struct prefetch_state;
+    std::shared_ptr<prefetch_state> _prefetch;
+
+    void prefetch(chunkid_t id);
+    bool take_prefetched(chunkid_t id, bounds_st extent, std::vector<image_collection::find_range_st_row> &datasets);
+
+    // image intersecting with a chunk, see read_chunk()
+    struct chunk_image {
+        std::string image_name;
+        std::string srs;
+        int itime;  // time index within the chunk
+        std::unordered_map<std::string, std::vector<std::tuple<std::string, uint16_t>>> datasets;  // GDAL dataset descriptor -> contained bands (name and number)
+        std::pair<std::string, uint16_t> mask_dataset_band;
+    };
+
+    std::vector<chunk_image> find_chunk_images(chunkid_t id, bounds_st cextent, uint32_t nt);
+    void read_image(const chunk_image &img, bounds_st cextent, coords_nd<uint32_t, 4> size_btyx, double *img_buf, double *mask_buf);
 };
 
 }  // namespace gdalcubes
@@ -17,109 +17,110 @@
 #include "image_collection_ops.h"
 
 #include <gdal_utils.h>
+#include <ogr_geometry.h>
 #include <sqlite3.h>
 
-#include <thread>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
 #include <unordered_set>
 
 #include "cube.h"
+#include "thread_pool.h"
 
 namespace gdalcubes {
 
-void image_collection_ops::translate_gtiff(std::shared_ptr<gdalcubes::image_collection> in, std::string out_dir, uint16_t nthreads, bool overwrite, std::vector<std::string> creation_options) {
-    if (!filesystem::exists(out_dir)) {
-        filesystem::mkdir_recursive(out_dir);
+// Size and modification time of a (possibly remote) file, returns false if the file cannot be accessed
+static bool stat_file(std::string f, uint64_t& size, int64_t& mtime) {
+    VSIStatBufL s;
+    if (VSIStatL(f.c_str(), &s) != 0) {
+        return false;
     }
+    size = s.st_size;
+    mtime = s.st_mtime;
+    return true;
+}
 
-    if (!filesystem::is_directory(out_dir)) {
-        throw std::string("ERROR in image_collection_ops::translate_cog(): output is not a directory.");
+std::vector<uint32_t> image_collection_ops::largest_first(const std::vector<uint64_t>& size) {
+    std::vector<uint32_t> order(size.size());
+    for (uint32_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
     }
+    std::stable_sort(order.begin(), order.end(), [&size](uint32_t a, uint32_t b) { return size[a] > size[b]; });
+    return order;
+}
 
-    std::vector<std::thread> thrds;
-
-    std::shared_ptr<progress> prg = config::instance()->get_default_progress_bar()->get();
-    prg->set(0);  // explicitly set to zero to show progress bar immediately
-
-    in->write(filesystem::join(out_dir, filesystem::filename(in->get_filename())));
-
-    std::mutex mutex;
-    std::vector<image_collection::gdalrefs_row> gdalrefs = in->get_gdalrefs();
-
-    for (uint16_t it = 0; it < nthreads; ++it) {
-        thrds.push_back(std::thread([it, nthreads, &out_dir, &gdalrefs, &prg, in, &mutex, overwrite, &creation_options]() {
-            for (uint32_t i = it; i < gdalrefs.size(); i += nthreads) {
-                prg->increment((double)1 / (double)gdalrefs.size());
-                std::string descr = gdalrefs[i].descriptor;
-
-                CPLStringList translate_args;
-
-                translate_args.AddString("-of");
-                translate_args.AddString("GTiff");
-                for (auto it = creation_options.begin(); it != creation_options.end(); ++it) {
-                    translate_args.AddString("-co");
-                    translate_args.AddString(it->c_str());
-                }
-
-                translate_args.AddString("-b");
-                translate_args.AddString(std::to_string(gdalrefs[i].band_num).c_str());  // band_num is 1 based
-
-                GDALTranslateOptions* trans_options = GDALTranslateOptionsNew(translate_args.List(), NULL);
-                if (trans_options == NULL) {
-                    GCBS_WARN("Cannot create gdal_translate options.");
-                    continue;
-                }
-                GDALDataset* dataset = (GDALDataset*)GDALOpen(descr.c_str(), GA_ReadOnly);
-                if (!dataset) {
-                    GCBS_WARN("Cannot open GDAL dataset '" + descr + "'.");
-                    GDALTranslateOptionsFree(trans_options);
-                    continue;
-                }
-                std::string outimgdir = filesystem::join(out_dir, std::to_string(gdalrefs[i].image_id));
-                if (!filesystem::exists(outimgdir)) {
-                    filesystem::mkdir(outimgdir);
-                }
-                std::string outfile = filesystem::join(outimgdir, std::to_string(gdalrefs[i].band_id) + ".tif");
-                if (filesystem::exists(outfile) && !overwrite) {
-                    GCBS_DEBUG(outfile + " already exists; set overwrite=true to force recreation of existing files.");
-                } else {
-                    GDALDatasetH out = GDALTranslate(outfile.c_str(), (GDALDatasetH)dataset, trans_options, NULL);
-                    if (!out) {
-                        GCBS_WARN("Cannot translate GDAL dataset '" + descr + "'.");
-                        GDALClose((GDALDatasetH)dataset);
-                        GDALTranslateOptionsFree(trans_options);
-                    }
-                    GDALClose(out);
-                    GDALTranslateOptionsFree(trans_options);
-                }
-                GDALClose((GDALDatasetH)dataset);
+std::vector<int> image_collection_ops::missing_overview_levels(int xsize, const std::vector<int>& overview_xsize, const std::vector<int>& levels) {
+    std::vector<int> out;
+    for (uint16_t i = 0; i < levels.size(); ++i) {
+        if (levels[i] <= 1) continue;
+        // GDAL rounds overview sizes up, factors of existing overviews may thus be slightly off
+        int expected = (xsize + levels[i] - 1) / levels[i];
+        bool found = false;
+        for (uint16_t j = 0; !found && j < overview_xsize.size(); ++j) {
+            found = overview_xsize[j] == expected || (overview_xsize[j] > 0 && (int)std::lround((double)xsize / overview_xsize[j]) == levels[i]);
+        }
+        if (!found) out.push_back(levels[i]);
+    }
+    return out;
+}
 
-                // Run SQL update anyway to fix broken links etc. if needed
-                std::string sql = "UPDATE gdalrefs SET descriptor='" + outfile + "', band_num=1 " + "WHERE image_id=" + std::to_string(gdalrefs[i].image_id) + " AND band_id=" + std::to_string(gdalrefs[i].band_id) + ";";
+// Number of GDAL threads per file such that all concurrently processed files stay within the thread budget,
+// files at the end of a batch may use threads of idle workers
+static uint16_t gdal_threads_per_file(uint16_t nthreads, uint32_t remaining) {
+    uint32_t total = config::instance()->get_thread_budget() > 0 ? config::instance()->get_thread_budget() : nthreads;
+    uint32_t concurrent = std::max(uint32_t(1), std::min(uint32_t(nthreads), remaining));
+    return std::max(uint32_t(1), total / concurrent);
+}
 
-                mutex.lock();
-                if (sqlite3_exec(in->get_db_handle(), sql.c_str(), NULL, NULL, NULL) != SQLITE_OK) {
-                    GCBS_WARN("Skipping image " + std::to_string(gdalrefs[i].image_id) + " due to failed band table update");
-                }
-                mutex.unlock();
+const std::string translate_manifest::FILENAME = ".gdalcubes_translate";
+
+translate_manifest::translate_manifest(std::string out_dir, bool overwrite) : _has_previous(false), _entries(), _out() {
+    std::string file = filesystem::join(out_dir, FILENAME);
+    _has_previous = !overwrite && filesystem::exists(file);
+    if (_has_previous) {
+        std::ifstream is(file);
+        std::string line;
+        while (std::getline(is, line)) {
+            std::istringstream ss(line);
+            std::string name;
+            entry e;
+            if (std::getline(ss, name, '\t') && (ss >> e.src_size >> e.src_mtime >> e.out_size)) {
+                _entries[name] = e;
             }
-        }));
+        }
     }
-    for (uint16_t it = 0; it < nthreads; ++it) {
-        thrds[it].join();
+    _out.open(file, overwrite ? std::ios::trunc : std::ios::app);
+}
+
+bool translate_manifest::up_to_date(std::string name, uint64_t src_size, int64_t src_mtime, uint64_t out_size, int64_t out_mtime) const {
+    auto it = _entries.find(name);
+    if (it != _entries.end()) {
+        return it->second.out_size == out_size && it->second.src_size == src_size && it->second.src_mtime == src_mtime;
     }
-    prg->finalize();
+    return !_has_previous && out_mtime >= src_mtime;
 }
 
-void image_collection_ops::translate_cog(std::shared_ptr<gdalcubes::image_collection> in, std::string out_dir, uint16_t nthreads, bool overwrite, std::vector<std::string> creation_options) {
+void translate_manifest::add(std::string name, uint64_t src_size, int64_t src_mtime, uint64_t out_size) {
+    _out << name << "\t" << src_size << "\t" << src_mtime << "\t" << out_size << "\n";
+    _out.flush();
+}
+
+static void translate_images(std::shared_ptr<gdalcubes::image_collection> in, std::string out_dir, uint16_t nthreads, bool overwrite, std::vector<std::string> creation_options, std::string driver, std::string caller) {
+    if (in->is_sharded() || in->is_snapshot()) {
+        throw std::string("ERROR in image_collection_ops::" + caller + "(): sharded image collections and snapshots are not supported");
+    }
     if (!filesystem::exists(out_dir)) {
         filesystem::mkdir_recursive(out_dir);
     }
 
     if (!filesystem::is_directory(out_dir)) {
-        throw std::string("ERROR in image_collection_ops::translate_cog(): output is not a directory.");
+        throw std::string("ERROR in image_collection_ops::" + caller + "(): output is not a directory.");
     }
-
-    std::vector<std::thread> thrds;
+    if (nthreads == 0) nthreads = 1;
 
     std::shared_ptr<progress> prg = config::instance()->get_default_progress_bar()->get();
     prg->set(0);  // explicitly set to zero to show progress bar immediately
@@ -129,119 +130,315 @@ void image_collection_ops::translate_cog(std::shared_ptr<gdalcubes::image_collec
     std::mutex mutex;
     std::vector<image_collection::gdalrefs_row> gdalrefs = in->get_gdalrefs();
 
-    bool has_COG = GetGDALDriverManager()->GetDriverByName("COG") != NULL;
-    if (!has_COG) {
-        throw std::string("Direct translation to COG requires GDAL >= 3.1, please combine translate_gtiff and create_overviews instead");
+    // Start with the largest files such that a single large file does not delay the end of the batch
+    std::vector<uint64_t> src_size(gdalrefs.size(), 0);
+    std::vector<int64_t> src_mtime(gdalrefs.size(), 0);
+    thread_pool::instance()->parallel_for(
+        gdalrefs.size(), [&gdalrefs, &src_size, &src_mtime](uint32_t i) {
+            stat_file(gdalrefs[i].descriptor, src_size[i], src_mtime[i]);
+        },
+        nthreads);
+    std::vector<uint32_t> order = image_collection_ops::largest_first(src_size);
+
+    translate_manifest manifest(out_dir, overwrite);
+
+    // GDAL threads are only added if not explicitly given as creation option
+    bool user_num_threads = false;
+    for (auto it = creation_options.begin(); it != creation_options.end(); ++it) {
+        std::string key = it->substr(0, 12);
+        std::transform(key.begin(), key.end(), key.begin(), ::toupper);
+        if (key == "NUM_THREADS=") {
+            user_num_threads = true;
+        }
     }
 
-    for (uint16_t it = 0; it < nthreads; ++it) {
-        thrds.push_back(std::thread([it, nthreads, &out_dir, &gdalrefs, &prg, in, &mutex, overwrite, &creation_options]() {
-            for (uint32_t i = it; i < gdalrefs.size(); i += nthreads) {
-                prg->increment((double)1 / (double)gdalrefs.size());
-                std::string descr = gdalrefs[i].descriptor;
+    std::atomic<uint32_t> started(0);
+    uint32_t n = gdalrefs.size();
+    thread_pool::instance()->parallel_for(
+        n, [&](uint32_t k) {
+            uint32_t i = order[k];
+            uint32_t remaining = n - started++;
+            prg->increment((double)1 / (double)n);
+            std::string descr = gdalrefs[i].descriptor;
+
+            std::string outimgdir = filesystem::join(out_dir, std::to_string(gdalrefs[i].image_id));
+            if (!filesystem::exists(outimgdir)) {
+                filesystem::mkdir(outimgdir);
+            }
+            std::string outname = std::to_string(gdalrefs[i].image_id) + "/" + std::to_string(gdalrefs[i].band_id) + ".tif";
+            std::string outfile = filesystem::join(outimgdir, std::to_string(gdalrefs[i].band_id) + ".tif");
+
+            // Existing outputs are kept if recorded as complete in the manifest, or, without manifest, if newer than the source
+            bool up_to_date = false;
+            uint64_t out_size = 0;
+            int64_t out_mtime = 0;
+            if (!overwrite && stat_file(outfile, out_size, out_mtime) && out_size > 0) {
+                up_to_date = manifest.up_to_date(outname, src_size[i], src_mtime[i], out_size, out_mtime);
+            }
 
+            if (up_to_date) {
+                GCBS_DEBUG(outfile + " is up to date; set overwrite=true to force recreation of existing files.");
+            } else {
                 CPLStringList translate_args;
                 translate_args.AddString("-of");
-                translate_args.AddString("COG");
-
+                translate_args.AddString(driver.c_str());
                 for (auto it = creation_options.begin(); it != creation_options.end(); ++it) {
                     translate_args.AddString("-co");
                     translate_args.AddString(it->c_str());
                 }
-
+                if (!user_num_threads) {
+                    translate_args.AddString("-co");
+                    translate_args.AddString(("NUM_THREADS=" + std::to_string(gdal_threads_per_file(nthreads, remaining))).c_str());
+                }
                 translate_args.AddString("-b");
                 translate_args.AddString(std::to_string(gdalrefs[i].band_num).c_str());  // band_num is 1 based
 
                 GDALTranslateOptions* trans_options = GDALTranslateOptionsNew(translate_args.List(), NULL);
                 if (trans_options == NULL) {
                     GCBS_WARN("Cannot create gdal_translate options.");
-                    continue;
+                    return;
                 }
                 GDALDataset* dataset = (GDALDataset*)GDALOpen(descr.c_str(), GA_ReadOnly);
                 if (!dataset) {
                     GCBS_WARN("Cannot open GDAL dataset '" + descr + "'.");
                     GDALTranslateOptionsFree(trans_options);
-                    continue;
-                }
-                std::string outimgdir = filesystem::join(out_dir, std::to_string(gdalrefs[i].image_id));
-                if (!filesystem::exists(outimgdir)) {
-                    filesystem::mkdir(outimgdir);
-                }
-
-                std::string outfile = filesystem::join(outimgdir, std::to_string(gdalrefs[i].band_id) + ".tif");
-                if (filesystem::exists(outfile) && !overwrite) {
-                    GCBS_DEBUG(outfile + " already exists; set overwrite=true to force recreation of existing files.");
-                } else {
-                    GDALDatasetH out = GDALTranslate(outfile.c_str(), (GDALDatasetH)dataset, trans_options, NULL);
-                    if (!out) {
-                        GCBS_WARN("Cannot translate GDAL dataset '" + descr + "'.");
-                        GDALClose((GDALDatasetH)dataset);
-                        GDALTranslateOptionsFree(trans_options);
-                    }
-                    GDALClose(out);
-                    GDALTranslateOptionsFree(trans_options);
+                    return;
                 }
+                GDALDatasetH out = GDALTranslate(outfile.c_str(), (GDALDatasetH)dataset, trans_options, NULL);
+                GDALTranslateOptionsFree(trans_options);
                 GDALClose((GDALDatasetH)dataset);
+                if (!out) {
+                    // keep the reference to the original file
+                    GCBS_WARN("Cannot translate GDAL dataset '" + descr + "'.");
+                    return;
+                }
+                GDALClose(out);
+                stat_file(outfile, out_size, out_mtime);
+            }
 
-                // Run SQL update anyway to fix broken links etc. if needed
-                std::string sql = "UPDATE gdalrefs SET descriptor='" + outfile + "', band_num=1 " + "WHERE image_id=" + std::to_string(gdalrefs[i].image_id) + " AND band_id=" + std::to_string(gdalrefs[i].band_id) + ";";
+            // Run SQL update also for existing files to fix broken links etc. if needed
+            std::string sql = "UPDATE gdalrefs SET descriptor='" + outfile + "', band_num=1 " + "WHERE image_id=" + std::to_string(gdalrefs[i].image_id) + " AND band_id=" + std::to_string(gdalrefs[i].band_id) + ";";
 
-                mutex.lock();
-                if (sqlite3_exec(in->get_db_handle(), sql.c_str(), NULL, NULL, NULL) != SQLITE_OK) {
-                    GCBS_WARN("Skipping image " + std::to_string(gdalrefs[i].image_id) + " due to failed band table update");
-                }
-                mutex.unlock();
+            mutex.lock();
+            if (sqlite3_exec(in->get_db_handle(), sql.c_str(), NULL, NULL, NULL) != SQLITE_OK) {
+                GCBS_WARN("Skipping image " + std::to_string(gdalrefs[i].image_id) + " due to failed band table update");
             }
-        }));
-    }
-    for (uint16_t it = 0; it < nthreads; ++it) {
-        thrds[it].join();
-    }
+            manifest.add(outname, src_size[i], src_mtime[i], out_size);
+            mutex.unlock();
+        },
+        nthreads);
     prg->finalize();
 }
 
+void image_collection_ops::translate_gtiff(std::shared_ptr<gdalcubes::image_collection> in, std::string out_dir, uint16_t nthreads, bool overwrite, std::vector<std::string> creation_options) {
+    translate_images(in, out_dir, nthreads, overwrite, creation_options, "GTiff", "translate_gtiff");
+}
+
+void image_collection_ops::translate_cog(std::shared_ptr<gdalcubes::image_collection> in, std::string out_dir, uint16_t nthreads, bool overwrite, std::vector<std::string> creation_options) {
+    bool has_COG = GetGDALDriverManager()->GetDriverByName("COG") != NULL;
+    if (!has_COG) {
+        throw std::string("Direct translation to COG requires GDAL >= 3.1, please combine translate_gtiff and create_overviews instead");
+    }
+    translate_images(in, out_dir, nthreads, overwrite, creation_options, "COG", "translate_cog");
+}
+
 void image_collection_ops::create_overviews(std::shared_ptr<image_collection> in, std::vector<int> levels, std::string resampling, uint16_t nthreads) {
+    if (in->is_sharded() || in->is_snapshot()) {
+        throw std::string("ERROR in image_collection_ops::create_overviews(): sharded image collections and snapshots are not supported");
+    }
+    if (nthreads == 0) nthreads = 1;
     std::vector<image_collection::gdalrefs_row> gdalrefs = in->get_gdalrefs();
 
-    std::unordered_set<std::string> done;
-    std::mutex m;
-
-    std::vector<std::thread> thrds;
+    // distinct datasets, largest first
+    std::vector<std::string> descr;
+    std::unordered_set<std::string> seen;
+    for (uint32_t i = 0; i < gdalrefs.size(); ++i) {
+        if (seen.insert(gdalrefs[i].descriptor).second) {
+            descr.push_back(gdalrefs[i].descriptor);
+        }
+    }
+    std::vector<uint64_t> size(descr.size(), 0);
+    thread_pool::instance()->parallel_for(
+        descr.size(), [&descr, &size](uint32_t i) {
+            int64_t mtime;
+            stat_file(descr[i], size[i], mtime);
+        },
+        nthreads);
+    std::vector<uint32_t> order = image_collection_ops::largest_first(size);
 
     std::shared_ptr<progress> prg = config::instance()->get_default_progress_bar()->get();
     prg->set(0);  // explicitly set to zero to show progress bar immediately
 
-    for (uint16_t it = 0; it < nthreads; ++it) {
-        thrds.push_back(std::thread([it, nthreads, &done, &m, &gdalrefs, &resampling, &levels, &prg]() {
-            for (uint32_t i = it; i < gdalrefs.size(); i += nthreads) {
-                prg->increment((double)1 / (double)gdalrefs.size());
-                std::string descr = gdalrefs[i].descriptor;
-                m.lock();
-                if (done.count(descr) > 0) {
-                    m.unlock();
-                    continue;
-                }
-                done.insert(descr);
-                m.unlock();
-
-                GDALDataset* dataset = (GDALDataset*)GDALOpen(descr.c_str(), GA_Update);
+    std::atomic<uint32_t> started(0);
+    uint32_t n = descr.size();
+    thread_pool::instance()->parallel_for(
+        n, [&](uint32_t k) {
+            uint32_t i = order[k];
+            uint32_t remaining = n - started++;
+            prg->increment((double)1 / (double)n);
+
+            GDALDataset* dataset = (GDALDataset*)GDALOpen(descr[i].c_str(), GA_Update);
+            if (!dataset) {
+                dataset = (GDALDataset*)GDALOpen(descr[i].c_str(), GA_ReadOnly);
                 if (!dataset) {
-                    dataset = (GDALDataset*)GDALOpen(descr.c_str(), GA_ReadOnly);
-                    if (!dataset) {
-                        GCBS_WARN("Cannot open GDAL dataset '" + descr + "'.");
-                        continue;
-                    }
+                    GCBS_WARN("Cannot open GDAL dataset '" + descr[i] + "'.");
+                    return;
                 }
-                if (dataset->BuildOverviews(resampling.c_str(), levels.size(), levels.data(), 0, nullptr, NULL, nullptr) == CE_Failure) {
-                    GCBS_WARN("Cannot build overviews for dataset '" + descr + "'.");
+            }
+            // Existing overview levels are not rebuilt, e.g. when resuming an interrupted run
+            std::vector<int> missing = levels;
+            if (dataset->GetRasterCount() > 0) {
+                GDALRasterBand* band = dataset->GetRasterBand(1);
+                std::vector<int> overview_xsize;
+                for (int io = 0; io < band->GetOverviewCount(); ++io) {
+                    overview_xsize.push_back(band->GetOverview(io)->GetXSize());
                 }
+                missing = image_collection_ops::missing_overview_levels(band->GetXSize(), overview_xsize, levels);
+            }
+            if (missing.empty()) {
+                GCBS_DEBUG("Dataset '" + descr[i] + "' already has overviews.");
                 GDALClose((GDALDatasetH)dataset);
+                return;
+            }
+            CPLSetThreadLocalConfigOption("GDAL_NUM_THREADS", std::to_string(gdal_threads_per_file(nthreads, remaining)).c_str());
+            if (dataset->BuildOverviews(resampling.c_str(), missing.size(), missing.data(), 0, nullptr, NULL, nullptr) == CE_Failure) {
+                GCBS_WARN("Cannot build overviews for dataset '" + descr[i] + "'.");
+            }
+            CPLSetThreadLocalConfigOption("GDAL_NUM_THREADS", NULL);
+            GDALClose((GDALDatasetH)dataset);
+        },
+        nthreads);
+    prg->finalize();
+}
+
+// Valid data footprint of a dataset as WKT in WGS84 longitude / latitude, empty string on errors
+static std::string footprint_from_mask(std::string descr, uint16_t band_num, uint16_t max_size) {
+    GDALDataset* dataset = (GDALDataset*)GDALOpen(descr.c_str(), GA_ReadOnly);
+    if (!dataset) {
+        GCBS_WARN("Cannot open GDAL dataset '" + descr + "'.");
+        return "";
+    }
+    double gt[6];
+    std::string srs_str = dataset->GetProjectionRef() ? dataset->GetProjectionRef() : "";
+    if (dataset->GetGeoTransform(gt) != CE_None || srs_str.empty() || band_num < 1 || band_num > dataset->GetRasterCount()) {
+        GDALClose((GDALDatasetH)dataset);
+        return "";
+    }
+    int nx = dataset->GetRasterXSize();
+    int ny = dataset->GetRasterYSize();
+    double scale = std::max(1.0, std::max(nx, ny) / (double)max_size);
+    int bx = std::max(1, (int)std::ceil(nx / scale));
+    int by = std::max(1, (int)std::ceil(ny / scale));
+    double cx = nx / (double)bx;  // cell size in pixels
+    double cy = ny / (double)by;
+
+    // average of the mask is > 0 for all cells with at least one valid pixel
+    std::vector<float> mask(bx * by, 1);
+    GDALRasterBand* band = dataset->GetRasterBand(band_num);
+    if (!(band->GetMaskFlags() & GMF_ALL_VALID)) {
+        GDALRasterIOExtraArg extra;
+        INIT_RASTERIO_EXTRA_ARG(extra);
+        extra.eResampleAlg = GRIORA_Average;
+        if (band->GetMaskBand()->RasterIO(GF_Read, 0, 0, nx, ny, mask.data(), bx, by, GDT_Float32, 0, 0, &extra) != CE_None) {
+            GCBS_WARN("Cannot read mask band of GDAL dataset '" + descr + "'.");
+            GDALClose((GDALDatasetH)dataset);
+            return "";
+        }
+    }
+    GDALClose((GDALDatasetH)dataset);
+
+    // leftmost and rightmost valid cells of each row, enlarged by one cell, are sufficient for the convex hull
+    OGRMultiPoint points;
+    for (int iy = 0; iy < by; ++iy) {
+        int xmin = -1, xmax = -1;
+        for (int ix = 0; ix < bx; ++ix) {
+            if (mask[iy * bx + ix] > 0) {
+                if (xmin < 0) xmin = ix;
+                xmax = ix;
+            }
+        }
+        if (xmin < 0) continue;
+        double px[2] = {std::max(0.0, (xmin - 1) * cx), std::min((double)nx, (xmax + 2) * cx)};
+        double py[2] = {std::max(0.0, (iy - 1) * cy), std::min((double)ny, (iy + 2) * cy)};
+        for (uint8_t k = 0; k < 2; ++k) {
+            for (uint8_t l = 0; l < 2; ++l) {
+                OGRPoint p(gt[0] + px[k] * gt[1] + py[l] * gt[2], gt[3] + px[k] * gt[4] + py[l] * gt[5]);
+                points.addGeometry(&p);
             }
-        }));
+        }
+    }
+    if (points.IsEmpty()) {
+        return "";
     }
-    for (uint16_t it = 0; it < nthreads; ++it) {
-        thrds[it].join();
+    OGRGeometry* hull = points.ConvexHull();
+    if (!hull) {
+        return "";
+    }
+
+    // densify before transformation such that curved edges are approximated
+    hull->segmentize(std::max(nx * std::fabs(gt[1]), ny * std::fabs(gt[5])) / 32);
+    OGRSpatialReference srs_in;
+    OGRSpatialReference srs_out;
+    srs_in.SetFromUserInput(srs_str.c_str());
+    srs_out.SetFromUserInput("EPSG:4326");
+#if GDAL_VERSION_MAJOR >= 3
+    srs_in.SetAxisMappingStrategy(OAMS_TRADITIONAL_GIS_ORDER);
+    srs_out.SetAxisMappingStrategy(OAMS_TRADITIONAL_GIS_ORDER);
+#endif
+    OGRCoordinateTransformation* ct = OGRCreateCoordinateTransformation(&srs_in, &srs_out);
+    std::string out;
+    if (ct && hull->transform(ct) == OGRERR_NONE) {
+        char* wkt = nullptr;
+        hull->exportToWkt(&wkt);
+        if (wkt) {
+            out = wkt;
+            CPLFree(wkt);
+        }
+    }
+    if (ct) OCTDestroyCoordinateTransformation(ct);
+    OGRGeometryFactory::destroyGeometry(hull);
+    return out;
+}
+
+void image_collection_ops::compute_footprints(std::shared_ptr<image_collection> in, uint16_t nthreads, uint16_t max_size) {
+    if (in->is_sharded() || in->is_snapshot()) {
+        throw std::string("ERROR in image_collection_ops::compute_footprints(): sharded image collections and snapshots are not supported");
+    }
+    std::vector<image_collection::gdalrefs_row> gdalrefs = in->get_gdalrefs();
+
+    // first dataset of each image
+    std::vector<image_collection::gdalrefs_row> refs;
+    std::unordered_set<uint32_t> images;
+    for (uint32_t i = 0; i < gdalrefs.size(); ++i) {
+        if (images.insert(gdalrefs[i].image_id).second) {
+            refs.push_back(gdalrefs[i]);
+        }
+    }
+
+    std::shared_ptr<progress> prg = config::instance()->get_default_progress_bar()->get();
+    prg->set(0);  // explicitly set to zero to show progress bar immediately
+
+    std::vector<std::string> footprints(refs.size());
+    thread_pool::instance()->parallel_for(
+        refs.size(), [&refs, &footprints, &prg, max_size](uint32_t i) {
+            prg->increment((double)1 / (double)refs.size());
+            footprints[i] = footprint_from_mask(refs[i].descriptor, refs[i].band_num, max_size);
+        },
+        nthreads);
+
+    std::vector<uint32_t> image_id;
+    std::vector<std::string> geom;
+    for (uint32_t i = 0; i < refs.size(); ++i) {
+        if (footprints[i].empty()) {
+            GCBS_DEBUG("Failed to derive footprint of image " + std::to_string(refs[i].image_id) + "; image will be considered by its bounding box only");
+            continue;
+        }
+        image_id.push_back(refs[i].image_id);
+        geom.push_back(footprints[i]);
     }
+    in->transaction_start();
+    in->insert_image_footprints(image_id, geom);
+    in->transaction_end();
     prg->finalize();
 }
 
@@ -18,20 +18,94 @@
 #define IMAGE_COLLECTION_OPS_H
 
 #include <cstdint> // 2023-01-12: GCC 13 compatibility
+#include <fstream>
+#include <unordered_map>
+
 #include "image_collection.h"
 
 namespace gdalcubes {
 
+/**
+ * Record of completed outputs of translate_gtiff() and translate_cog(), stored as file ".gdalcubes_translate"
+ * in the output directory with one tab-separated line per file: path relative to the output directory, source size,
+ * source modification time, and output size. Interrupted runs can be resumed with overwrite = false.
+ */
+class translate_manifest {
+   public:
+    /**
+     * Open the manifest of an output directory, existing entries are discarded if overwrite is true
+     */
+    translate_manifest(std::string out_dir, bool overwrite);
+
+    /**
+     * Check whether an existing output is complete and up to date. Outputs are up to date if recorded with identical
+     * sizes and source modification time or, if there is no manifest from a previous run, if newer than the source.
+     */
+    bool up_to_date(std::string name, uint64_t src_size, int64_t src_mtime, uint64_t out_size, int64_t out_mtime) const;
+
+    /**
+     * Record a completed output, not thread-safe
+     */
+    void add(std::string name, uint64_t src_size, int64_t src_mtime, uint64_t out_size);
+
+    static const std::string FILENAME;
+
+   private:
+    struct entry {
+        uint64_t src_size;
+        int64_t src_mtime;
+        uint64_t out_size;
+    };
+    bool _has_previous;
+    std::unordered_map<std::string, entry> _entries;
+    std::ofstream _out;
+};
+
 /**
      * Batch processing operations over all GDAL datasets of a collection
      */
 class image_collection_ops {
    public:
+    /**
+     * Convert all GDAL datasets of a collection to single-band GeoTIFF files in out_dir/<image_id>/<band_id>.tif
+     * and write a copy of the collection that references the new files to out_dir.
+     * Files are processed largest first, GDAL compression threads (NUM_THREADS creation option) are chosen such that
+     * the thread budget is not exceeded. Completed files are recorded in a manifest in out_dir, with overwrite = false,
+     * complete and up to date outputs are kept such that interrupted runs can be resumed.
+     */
     static void translate_gtiff(std::shared_ptr<gdalcubes::image_collection> in, std::string out_dir, uint16_t nthreads = 1, bool overwrite = true, std::vector<std::string> creation_options = {});
 
+    /**
+     * Like translate_gtiff() but produces cloud-optimized GeoTIFF files, requires GDAL >= 3.1
+     */
     static void translate_cog(std::shared_ptr<gdalcubes::image_collection> in, std::string out_dir, uint16_t nthreads = 1, bool overwrite = true, std::vector<std::string> creation_options = {});
 
+    /**
+     * Build overviews for all distinct GDAL datasets of a collection, largest first. Only overview levels that
+     * do not exist yet are built, datasets with all requested levels are skipped.
+     */
     static void create_overviews(std::shared_ptr<image_collection> in, std::vector<int> levels = std::vector<int>{2, 4, 8, 16, 32}, std::string resampling = "NEAREST", uint16_t nthreads = 1);
+
+    /**
+     * Requested overview levels (decimation factors) that are not among the existing overviews of a band
+     * @param xsize number of columns of the band
+     * @param overview_xsize number of columns of existing overviews
+     * @param levels requested levels
+     */
+    static std::vector<int> missing_overview_levels(int xsize, const std::vector<int>& overview_xsize, const std::vector<int>& levels);
+
+    /**
+     * Order of items with given sizes such that larger items come first, items of equal size keep their order
+     */
+    static std::vector<uint32_t> largest_first(const std::vector<uint64_t>& size);
+
+    /**
+     * Derive valid data footprints of all images from the mask band of their first dataset
+     * and store them in the collection, see image_collection::insert_image_footprint().
+     * Masks are read at a reduced resolution with at most max_size pixels per dimension, footprints are
+     * stored as the convex hull of all valid cells, enlarged by one cell.
+     */
+    static void compute_footprints(std::shared_ptr<image_collection> in, uint16_t nthreads = 1, uint16_t max_size = 256);
 };
 
 }  // namespace gdalcubes
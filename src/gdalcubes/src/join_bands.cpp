@@ -25,6 +25,8 @@
 #include "join_bands.h"
 #include <cstring>
 
+#include "thread_pool.h"
+
 namespace gdalcubes {
 
 std::shared_ptr<chunk_data> join_bands_cube::read_chunk(chunkid_t id) {
@@ -35,34 +37,46 @@ std::shared_ptr<chunk_data> join_bands_cube::read_chunk(chunkid_t id) {
 
     coords_nd<uint32_t, 3> size_tyx = chunk_size(id);
     coords_nd<uint32_t, 4> size_btyx = {_bands.count(), size_tyx[0], size_tyx[1], size_tyx[2]};
-    out->size(size_btyx);
-
-    //
-    //    std::shared_ptr<chunk_data> dat_A = _in_A->read_chunk(id);
-    //    std::shared_ptr<chunk_data> dat_B = _in_B->read_chunk(id);
-    //    if (dat_A->empty() && dat_B->empty()) {
-    //        return out;
-    //    }
 
-    // Fill buffers accordingly
-    out->buf(std::calloc(size_btyx[0] * size_btyx[1] * size_btyx[2] * size_btyx[3], sizeof(double)));
-    double *begin = (double *)out->buf();
-    double *end = ((double *)out->buf()) + size_btyx[0] * size_btyx[1] * size_btyx[2] * size_btyx[3];
-    std::fill(begin, end, NAN);
+    // Read input chunks concurrently, chunks of different input cubes are independent
+    // and each read may involve expensive I/O (e.g. warping images), so the total
+    // latency becomes the maximum instead of the sum over inputs.
+    std::vector<std::shared_ptr<chunk_data>> in_dat(_in.size());
+    thread_pool::instance()->parallel_for(
+        _in.size(), [this, id, &in_dat](uint32_t i) {
+            in_dat[i] = _in[i]->read_chunk(id);
+        },
+        _in.size());
 
-    uint32_t offset = 0;
     bool allempty = true;
     for (uint16_t i = 0; i < _in.size(); ++i) {
-        std::shared_ptr<chunk_data> dat = _in[i]->read_chunk(id);
-        if (!dat->empty()) {
+        if (!in_dat[i]->empty()) {
             allempty = false;
-            std::memcpy(((double *)out->buf()) + offset, ((double *)dat->buf()), dat->size()[0] * dat->size()[1] * dat->size()[2] * dat->size()[3] * sizeof(double));
+            break;
         }
-        offset += _in[i]->size_bands() * size_tyx[0] * size_tyx[1] * size_tyx[2];
     }
     if (allempty) {
         // propagated empty chunk if all input chunks are emtpy
-        out = std::make_shared<chunk_data>();
+        return out;
+    }
+
+    out->size(size_btyx);
+    out->buf(std::malloc(size_btyx[0] * size_btyx[1] * size_btyx[2] * size_btyx[3] * sizeof(double)));
+
+    // Bands are the outermost dimension, i.e., each input chunk is a contiguous block
+    // of the output buffer. Empty input chunks are filled with NAN, all other
+    // blocks are written exactly once.
+    uint32_t offset = 0;
+    for (uint16_t i = 0; i < _in.size(); ++i) {
+        uint32_t n = _in[i]->size_bands() * size_tyx[0] * size_tyx[1] * size_tyx[2];
+        double *begin = ((double *)out->buf()) + offset;
+        if (!in_dat[i]->empty()) {
+            std::memcpy(begin, in_dat[i]->buf(), n * sizeof(double));
+            in_dat[i] = nullptr;  // free input buffer as early as possible
+        } else {
+            std::fill(begin, begin + n, NAN);
+        }
+        offset += n;
     }
     return out;
 }
@@ -0,0 +1,96 @@
+/*
+    MIT License
+
+    Copyright (c) 2023 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#ifndef KERNEL_ABI_H
+#define KERNEL_ABI_H
+
+/*
+ * C interface of user kernel plugins
+ *
+ * A kernel plugin is a shared library that exports the function gdalcubes_kernel_v1(), which returns a pointer to a
+ * static gdalcubes_kernel_v1_t structure. Plugins only need this header, they do not link against gdalcubes.
+ *
+ * Kernels operate on double buffers with dimensions (bands, time, y, x), the x dimension is contiguous.
+ * Depending on the mode, the input buffer contains
+ * - "apply_pixel": one chunk of the input cube, the output has the same number of time slices,
+ * - "apply_time": complete time series of one spatial chunk, the output has the same number of time slices,
+ * - "reduce_time": complete time series of one spatial chunk, the output has one time slice.
+ * The output buffer is initialized with NAN before calling process().
+ *
+ * process() is called concurrently from several threads with the same state, i.e., it must not modify the state.
+ * Functions return 0 on success, other values indicate errors; error messages can be written to err
+ * (a buffer of errlen bytes).
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef _WIN32
+#define GDALCUBES_KERNEL_EXPORT __declspec(dllexport)
+#else
+#define GDALCUBES_KERNEL_EXPORT __attribute__((visibility("default")))
+#endif
+
+#define GDALCUBES_KERNEL_ABI_VERSION 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct gdalcubes_kernel_v1_t {
+    /* must be GDALCUBES_KERNEL_ABI_VERSION */
+    uint32_t abi_version;
+
+    /*
+     * Initialize the kernel for an input cube with nbands_in bands named band_names_in, args is a user-defined
+     * string given when the kernel is applied, mode is one of "apply_pixel", "apply_time", "reduce_time".
+     */
+    int (*init)(const char *args, const char *mode, uint16_t nbands_in, const char *const *band_names_in, void **state,
+                char *err, size_t errlen);
+
+    /*
+     * Number and names of output bands, names must remain valid until finalize() is called.
+     */
+    int (*output_bands)(void *state, uint16_t *nbands_out, const char *const **band_names_out, char *err, size_t errlen);
+
+    /*
+     * Process a buffer of size_in[0] * size_in[1] * size_in[2] * size_in[3] values, t contains the dates of
+     * the size_in[1] time slices as seconds since 1970-01-01. The output buffer has size size_out, where
+     * size_out[0] is the number of output bands.
+     */
+    int (*process)(void *state, const double *in, const uint32_t *size_in, const double *t, double *out,
+                   const uint32_t *size_out, char *err, size_t errlen);
+
+    /* Free the state */
+    void (*finalize)(void *state);
+} gdalcubes_kernel_v1_t;
+
+typedef const gdalcubes_kernel_v1_t *(*gdalcubes_kernel_v1_fn)(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // KERNEL_ABI_H
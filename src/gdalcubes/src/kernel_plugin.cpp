@@ -0,0 +1,230 @@
+/*
+    MIT License
+
+    Copyright (c) 2023 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#include "kernel_plugin.h"
+
+#include <map>
+#include <mutex>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+#include "filesystem.h"
+
+namespace gdalcubes {
+
+std::shared_ptr<kernel_plugin> kernel_plugin::load(std::string path) {
+    static std::mutex mtx;
+    static std::map<std::string, std::shared_ptr<kernel_plugin>> loaded;
+
+    std::string p = filesystem::make_absolute(path);
+    std::lock_guard<std::mutex> lock(mtx);
+    auto it = loaded.find(p);
+    if (it != loaded.end()) {
+        return it->second;
+    }
+
+    if (!filesystem::exists(p)) {
+        GCBS_ERROR("Kernel plugin '" + p + "' does not exist");
+        throw std::string("ERROR in kernel_plugin::load(): Kernel plugin '" + p + "' does not exist");
+    }
+
+#ifdef _WIN32
+    HMODULE handle = LoadLibraryA(p.c_str());
+    if (!handle) {
+        GCBS_ERROR("Failed to load kernel plugin '" + p + "' (error code " + std::to_string(GetLastError()) + ")");
+        throw std::string("ERROR in kernel_plugin::load(): Failed to load kernel plugin '" + p + "'");
+    }
+    gdalcubes_kernel_v1_fn f = (gdalcubes_kernel_v1_fn)GetProcAddress(handle, "gdalcubes_kernel_v1");
+#else
+    void *handle = dlopen(p.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!handle) {
+        std::string msg = dlerror();
+        GCBS_ERROR("Failed to load kernel plugin '" + p + "': " + msg);
+        throw std::string("ERROR in kernel_plugin::load(): Failed to load kernel plugin '" + p + "': " + msg);
+    }
+    gdalcubes_kernel_v1_fn f = (gdalcubes_kernel_v1_fn)dlsym(handle, "gdalcubes_kernel_v1");
+#endif
+    if (!f) {
+        GCBS_ERROR("Kernel plugin '" + p + "' does not export gdalcubes_kernel_v1()");
+        throw std::string("ERROR in kernel_plugin::load(): Kernel plugin '" + p + "' does not export gdalcubes_kernel_v1()");
+    }
+    const gdalcubes_kernel_v1_t *api = f();
+    if (!api || api->abi_version != GDALCUBES_KERNEL_ABI_VERSION) {
+        GCBS_ERROR("Kernel plugin '" + p + "' has an incompatible ABI version");
+        throw std::string("ERROR in kernel_plugin::load(): Kernel plugin '" + p + "' has an incompatible ABI version, expected " + std::to_string(GDALCUBES_KERNEL_ABI_VERSION));
+    }
+    if (!api->init || !api->output_bands || !api->process || !api->finalize) {
+        GCBS_ERROR("Kernel plugin '" + p + "' does not implement all required functions");
+        throw std::string("ERROR in kernel_plugin::load(): Kernel plugin '" + p + "' does not implement all required functions");
+    }
+
+    std::shared_ptr<kernel_plugin> out(new kernel_plugin((void *)handle, api));
+    loaded[p] = out;
+    return out;
+}
+
+kernel_plugin_cube::kernel_plugin_cube(std::shared_ptr<cube> in, std::string plugin, std::string mode, std::string args)
+    : cube(in->st_reference()->copy()), _in_cube(in), _plugin_path(plugin), _mode(mode), _args(args), _plugin(), _state(nullptr) {  // it is important to duplicate st reference here, otherwise changes will affect input cube as well
+    if (mode != "apply_pixel" && mode != "apply_time" && mode != "reduce_time") {
+        GCBS_ERROR("Invalid kernel mode '" + mode + "'");
+        throw std::string("ERROR in kernel_plugin_cube::kernel_plugin_cube(): Invalid kernel mode '" + mode + "', expected one of 'apply_pixel', 'apply_time', 'reduce_time'");
+    }
+
+    if (mode == "reduce_time") {
+        if (cube_stref::type_string(_st_ref) == "cube_stref_regular") {
+            std::shared_ptr<cube_stref_regular> stref = std::dynamic_pointer_cast<cube_stref_regular>(_st_ref);
+            duration dt = (stref->t1() - stref->t0() + 1);
+            stref->set_t_axis(stref->t0(), stref->t1(), dt);
+        } else if (cube_stref::type_string(_st_ref) == "cube_stref_labeled_time") {
+            std::shared_ptr<cube_stref_labeled_time> stref = std::dynamic_pointer_cast<cube_stref_labeled_time>(_st_ref);
+            stref->set_time_labels({stref->t0()});
+        }
+        _chunk_size[0] = 1;
+    } else if (mode == "apply_time") {
+        _chunk_size[0] = _in_cube->size_t();
+    } else {
+        _chunk_size[0] = _in_cube->chunk_size()[0];
+    }
+    _chunk_size[1] = _in_cube->chunk_size()[1];
+    _chunk_size[2] = _in_cube->chunk_size()[2];
+
+    _plugin = kernel_plugin::load(plugin);
+
+    std::vector<std::string> names_in;
+    std::vector<const char *> names_in_c;
+    for (uint16_t i = 0; i < _in_cube->bands().count(); ++i) {
+        names_in.push_back(_in_cube->bands().get(i).name);
+    }
+    for (uint16_t i = 0; i < names_in.size(); ++i) {
+        names_in_c.push_back(names_in[i].c_str());
+    }
+
+    char err[1024] = {0};
+    if (_plugin->api()->init(_args.c_str(), _mode.c_str(), uint16_t(names_in_c.size()), names_in_c.data(), &_state, err, sizeof(err)) != 0) {
+        _state = nullptr;
+        GCBS_ERROR("Initialization of kernel plugin failed: " + std::string(err));
+        throw std::string("ERROR in kernel_plugin_cube::kernel_plugin_cube(): Initialization of kernel plugin failed: " + std::string(err));
+    }
+
+    uint16_t nbands_out = 0;
+    const char *const *names_out = nullptr;
+    if (_plugin->api()->output_bands(_state, &nbands_out, &names_out, err, sizeof(err)) != 0 || nbands_out == 0 || !names_out) {
+        _plugin->api()->finalize(_state);
+        _state = nullptr;
+        GCBS_ERROR("Kernel plugin did not provide output bands: " + std::string(err));
+        throw std::string("ERROR in kernel_plugin_cube::kernel_plugin_cube(): Kernel plugin did not provide output bands: " + std::string(err));
+    }
+    for (uint16_t i = 0; i < nbands_out; ++i) {
+        _bands.add(band(names_out[i]));
+    }
+}
+
+kernel_plugin_cube::~kernel_plugin_cube() {
+    if (_state) {
+        _plugin->api()->finalize(_state);
+    }
+}
+
+std::shared_ptr<chunk_data> kernel_plugin_cube::read_chunk(chunkid_t id) {
+    GCBS_TRACE("kernel_plugin_cube::read_chunk(" + std::to_string(id) + ")");
+    std::shared_ptr<chunk_data> out = std::make_shared<chunk_data>();
+    if (id >= count_chunks())
+        return out;  // chunk is outside of the view, we don't need to read anything.
+
+    std::shared_ptr<chunk_data> in;
+    uint32_t it0 = 0;
+    if (_mode == "apply_pixel") {
+        in = _in_cube->read_chunk(id);
+        if (in->empty()) {
+            return out;
+        }
+        it0 = _in_cube->chunk_limits(id).low[0];
+    } else {
+        // combine complete time series
+        coords_nd<uint32_t, 3> size_tyx = _in_cube->chunk_size(id);
+        uint32_t nt = _in_cube->size_t();
+        uint32_t nxy = size_tyx[1] * size_tyx[2];
+        coords_nd<uint32_t, 4> in_size_btyx = {uint32_t(_in_cube->size_bands()), nt, size_tyx[1], size_tyx[2]};
+        in = std::make_shared<chunk_data>();
+        bool empty = true;
+        uint32_t ichunk = 0;
+        for (chunkid_t i = id; i < _in_cube->count_chunks(); i += _in_cube->count_chunks_x() * _in_cube->count_chunks_y()) {
+            std::shared_ptr<chunk_data> x = _in_cube->read_chunk(i);
+            if (!x->empty()) {
+                if (empty) {
+                    in->size(in_size_btyx);
+                    in->buf(std::calloc(in_size_btyx[0] * in_size_btyx[1] * in_size_btyx[2] * in_size_btyx[3], sizeof(double)));
+                    double *begin = (double *)in->buf();
+                    double *end = ((double *)in->buf()) + in_size_btyx[0] * in_size_btyx[1] * in_size_btyx[2] * in_size_btyx[3];
+                    std::fill(begin, end, NAN);
+                    empty = false;
+                }
+                for (uint16_t ib = 0; ib < x->size()[0]; ++ib) {
+                    for (uint32_t it = 0; it < x->size()[1]; ++it) {
+                        const double *src = ((double *)x->buf()) + (uint64_t(ib) * x->size()[1] + it) * nxy;
+                        double *dst = ((double *)in->buf()) + (uint64_t(ib) * nt + ichunk * _in_cube->chunk_size()[0] + it) * nxy;
+                        std::copy(src, src + nxy, dst);
+                    }
+                }
+            }
+            ++ichunk;
+        }
+        if (empty) {
+            return out;
+        }
+    }
+
+    std::vector<double> t(in->size()[1]);
+    for (uint32_t it = 0; it < in->size()[1]; ++it) {
+        t[it] = _in_cube->st_reference()->datetime_at_index(it0 + it).epoch_time();
+    }
+
+    coords_nd<uint32_t, 4> size_btyx = {uint32_t(_bands.count()), _mode == "reduce_time" ? 1 : in->size()[1], in->size()[2], in->size()[3]};
+    out->size(size_btyx);
+    out->buf(std::calloc(size_btyx[0] * size_btyx[1] * size_btyx[2] * size_btyx[3], sizeof(double)));
+    double *begin = (double *)out->buf();
+    double *end = ((double *)out->buf()) + size_btyx[0] * size_btyx[1] * size_btyx[2] * size_btyx[3];
+    std::fill(begin, end, NAN);
+
+    uint32_t size_in[4] = {in->size()[0], in->size()[1], in->size()[2], in->size()[3]};
+    uint32_t size_out[4] = {size_btyx[0], size_btyx[1], size_btyx[2], size_btyx[3]};
+    char err[1024] = {0};
+    if (_plugin->api()->process(_state, (const double *)in->buf(), size_in, t.data(), (double *)out->buf(), size_out, err, sizeof(err)) != 0) {
+        GCBS_ERROR("Kernel plugin failed to process chunk " + std::to_string(id) + ": " + std::string(err));
+        throw std::string("ERROR in kernel_plugin_cube::read_chunk(): Kernel plugin failed to process chunk " + std::to_string(id) + ": " + std::string(err));
+    }
+
+    // check if chunk is completely NAN and if yes, return empty chunk
+    if (out->all_nan()) {
+        out = std::make_shared<chunk_data>();
+    }
+    return out;
+}
+
+}  // namespace gdalcubes
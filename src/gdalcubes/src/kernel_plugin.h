@@ -0,0 +1,110 @@
+/*
+    MIT License
+
+    Copyright (c) 2023 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#ifndef KERNEL_PLUGIN_H
+#define KERNEL_PLUGIN_H
+
+#include "cube.h"
+#include "kernel_abi.h"
+
+namespace gdalcubes {
+
+/**
+ * @brief A loaded kernel plugin (shared library implementing the C interface in kernel_abi.h)
+ * @note Libraries are loaded only once per path and are never unloaded
+ */
+class kernel_plugin {
+   public:
+    /**
+     * @brief Load a kernel plugin from a shared library file
+     * @param path path to the shared library
+     * @return plugin instance, throws an exception if the library cannot be loaded or has an incompatible ABI version
+     */
+    static std::shared_ptr<kernel_plugin> load(std::string path);
+
+    const gdalcubes_kernel_v1_t *api() const { return _api; }
+
+   private:
+    kernel_plugin(void *handle, const gdalcubes_kernel_v1_t *api) : _handle(handle), _api(api) {}
+    void *_handle;
+    const gdalcubes_kernel_v1_t *_api;
+};
+
+/**
+ * @brief A data cube that applies a kernel plugin on chunk buffers of an input cube
+ *
+ * Depending on the mode, the kernel is applied like apply_pixel ("apply_pixel", chunks are passed as they are),
+ * apply_time ("apply_time", complete time series), or reduce_time ("reduce_time", complete time series, one output time slice).
+ * In contrast to stream_cube and related cubes, kernels run in-process without serializing chunks.
+ */
+class kernel_plugin_cube : public cube {
+   public:
+    /**
+     * @brief Create a data cube that applies a kernel plugin on a given input data cube
+     * @note This static creation method should preferably be used instead of the constructors as
+     * the constructors will not set connections between cubes properly.
+     * @param in input data cube
+     * @param plugin path to the shared library of the plugin
+     * @param mode one of "apply_pixel", "apply_time", or "reduce_time"
+     * @param args user-defined arguments passed to the kernel
+     * @return a shared pointer to the created data cube instance
+     */
+    static std::shared_ptr<kernel_plugin_cube> create(std::shared_ptr<cube> in, std::string plugin, std::string mode = "apply_pixel", std::string args = "") {
+        std::shared_ptr<kernel_plugin_cube> out = std::make_shared<kernel_plugin_cube>(in, plugin, mode, args);
+        in->add_child_cube(out);
+        out->add_parent_cube(in);
+        return out;
+    }
+
+   public:
+    kernel_plugin_cube(std::shared_ptr<cube> in, std::string plugin, std::string mode = "apply_pixel", std::string args = "");
+
+   public:
+    ~kernel_plugin_cube();
+
+    std::shared_ptr<chunk_data> read_chunk(chunkid_t id) override;
+
+    json11::Json make_constructible_json() override {
+        json11::Json::object out;
+        out["cube_type"] = "kernel_plugin";
+        out["plugin"] = _plugin_path;
+        out["mode"] = _mode;
+        out["args"] = _args;
+        out["in_cube"] = _in_cube->make_constructible_json();
+        return out;
+    }
+
+   private:
+    std::shared_ptr<cube> _in_cube;
+    std::string _plugin_path;
+    std::string _mode;
+    std::string _args;
+    std::shared_ptr<kernel_plugin> _plugin;
+    void *_state;
+};
+
+}  // namespace gdalcubes
+
+#endif  // KERNEL_PLUGIN_H
@@ -0,0 +1,349 @@
+/*
+    MIT License
+
+    Copyright (c) 2023 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#include "predict_pixel.h"
+
+#include <fstream>
+#include <sstream>
+
+#include "filesystem.h"
+#include "thread_pool.h"
+
+namespace gdalcubes {
+
+struct predict_pixel_cube::tree_ensemble {
+    struct node {
+        int32_t feature;      // negative for leaves
+        int32_t left;         // offset of leaf values for leaves
+        int32_t right;
+        int32_t default_dir;  // direction of missing values: 1 = left, 0 = right, -1 = none
+        double threshold;
+    };
+
+    enum class transform { NONE,
+                           SOFTMAX,
+                           SIGMOID };
+
+    std::vector<node> nodes;  // nodes of all trees
+    std::vector<uint32_t> roots;
+    std::vector<double> values;  // nvalues per leaf
+    std::vector<uint16_t> feature_bands;  // input band index of features
+    std::vector<std::string> classes;
+    std::vector<double> base_score;
+    uint16_t nvalues;
+    bool classification;
+    bool mean;
+    bool le;
+    transform output_transform;
+
+    static std::shared_ptr<tree_ensemble> from_json(const json11::Json &j, std::shared_ptr<cube> in) {
+        std::shared_ptr<tree_ensemble> out = std::make_shared<tree_ensemble>();
+        std::string objective = j["objective"].is_null() ? "regression" : j["objective"].string_value();
+        std::string aggregation = j["aggregation"].is_null() ? "mean" : j["aggregation"].string_value();
+        std::string tf = j["output_transform"].is_null() ? "none" : j["output_transform"].string_value();
+        std::string split = j["split"].is_null() ? "<=" : j["split"].string_value();
+        if (objective != "regression" && objective != "classification") {
+            throw std::string("invalid objective '" + objective + "'");
+        }
+        if (aggregation != "mean" && aggregation != "sum") {
+            throw std::string("invalid aggregation '" + aggregation + "'");
+        }
+        if (tf != "none" && tf != "softmax" && tf != "sigmoid") {
+            throw std::string("invalid output_transform '" + tf + "'");
+        }
+        if (split != "<=" && split != "<") {
+            throw std::string("invalid split '" + split + "'");
+        }
+        out->classification = objective == "classification";
+        out->mean = aggregation == "mean";
+        out->le = split == "<=";
+        out->output_transform = tf == "softmax" ? transform::SOFTMAX : (tf == "sigmoid" ? transform::SIGMOID : transform::NONE);
+
+        for (auto &f : j["features"].array_items()) {
+            if (!in->bands().has(f.string_value())) {
+                throw std::string("input data cube has no band '" + f.string_value() + "'");
+            }
+            out->feature_bands.push_back(in->bands().get_index(f.string_value()));
+        }
+        if (out->feature_bands.empty()) {
+            throw std::string("missing features");
+        }
+
+        if (out->classification) {
+            for (auto &c : j["classes"].array_items()) {
+                out->classes.push_back(c.string_value());
+            }
+            if (out->classes.size() < 2) {
+                throw std::string("classification models need at least two classes");
+            }
+            out->nvalues = (out->classes.size() == 2 && out->output_transform == transform::SIGMOID) ? 1 : out->classes.size();
+        } else {
+            if (out->output_transform == transform::SOFTMAX) {
+                throw std::string("softmax transformation requires a classification model");
+            }
+            out->nvalues = 1;
+        }
+
+        if (j["base_score"].is_number()) {
+            out->base_score.assign(out->nvalues, j["base_score"].number_value());
+        } else if (j["base_score"].is_array()) {
+            for (auto &v : j["base_score"].array_items()) {
+                out->base_score.push_back(v.number_value());
+            }
+            if (out->base_score.size() != out->nvalues) {
+                throw std::string("size of base_score does not match the number of outputs");
+            }
+        } else {
+            out->base_score.assign(out->nvalues, 0.0);
+        }
+
+        if (j["trees"].array_items().empty()) {
+            throw std::string("missing trees");
+        }
+        for (auto &t : j["trees"].array_items()) {
+            const json11::Json::array &feature = t["feature"].array_items();
+            const json11::Json::array &threshold = t["threshold"].array_items();
+            const json11::Json::array &left = t["left"].array_items();
+            const json11::Json::array &right = t["right"].array_items();
+            const json11::Json::array &default_left = t["default_left"].array_items();
+            const json11::Json::array &value = t["value"].array_items();
+            uint32_t n = feature.size();
+            if (n == 0 || threshold.size() != n || left.size() != n || right.size() != n || (!default_left.empty() && default_left.size() != n)) {
+                throw std::string("inconsistent sizes of node arrays in tree " + std::to_string(out->roots.size()));
+            }
+            if (value.size() != uint64_t(n) * out->nvalues) {
+                throw std::string("size of value does not match the number of nodes and outputs in tree " + std::to_string(out->roots.size()));
+            }
+            uint32_t node0 = out->nodes.size();
+            out->roots.push_back(node0);
+            for (uint32_t i = 0; i < n; ++i) {
+                node x;
+                x.feature = feature[i].int_value();
+                x.threshold = threshold[i].number_value();
+                x.default_dir = default_left.empty() ? -1 : (default_left[i].is_bool() ? default_left[i].bool_value() : default_left[i].int_value() != 0);
+                if (x.feature < 0) {
+                    x.left = out->values.size();
+                    x.right = -1;
+                    for (uint16_t k = 0; k < out->nvalues; ++k) {
+                        out->values.push_back(value[uint64_t(i) * out->nvalues + k].number_value());
+                    }
+                } else {
+                    if (x.feature >= int32_t(out->feature_bands.size())) {
+                        throw std::string("invalid feature index in tree " + std::to_string(out->roots.size() - 1));
+                    }
+                    // children must follow their parents, which guarantees that traversals terminate
+                    int32_t l = left[i].int_value();
+                    int32_t r = right[i].int_value();
+                    if (l <= int32_t(i) || r <= int32_t(i) || l >= int32_t(n) || r >= int32_t(n)) {
+                        throw std::string("invalid child node index in tree " + std::to_string(out->roots.size() - 1));
+                    }
+                    x.left = node0 + l;
+                    x.right = node0 + r;
+                }
+                out->nodes.push_back(x);
+            }
+        }
+        return out;
+    }
+};
+
+predict_pixel_cube::predict_pixel_cube(std::shared_ptr<cube> in, std::string model, bool probabilities)
+    : cube(in->st_reference()->copy()), _in_cube(in), _model(model), _probabilities(probabilities), _ensemble() {  // it is important to duplicate st reference here, otherwise changes will affect input cube as well
+    _chunk_size[0] = _in_cube->chunk_size()[0];
+    _chunk_size[1] = _in_cube->chunk_size()[1];
+    _chunk_size[2] = _in_cube->chunk_size()[2];
+
+    std::string str = model;
+    std::size_t first = str.find_first_not_of(" \t\r\n");
+    if (first == std::string::npos || str[first] != '{') {
+        if (!filesystem::exists(model)) {
+            GCBS_ERROR("Model file '" + model + "' does not exist");
+            throw std::string("ERROR in predict_pixel_cube::predict_pixel_cube(): Model file '" + model + "' does not exist");
+        }
+        std::ifstream f(model);
+        std::stringstream ss;
+        ss << f.rdbuf();
+        str = ss.str();
+    }
+
+    std::string err;
+    json11::Json j = json11::Json::parse(str, err);
+    if (!err.empty()) {
+        GCBS_ERROR("Failed to parse model: " + err);
+        throw std::string("ERROR in predict_pixel_cube::predict_pixel_cube(): Failed to parse model: " + err);
+    }
+    try {
+        _ensemble = tree_ensemble::from_json(j, in);
+    } catch (std::string s) {
+        GCBS_ERROR("Invalid model: " + s);
+        throw std::string("ERROR in predict_pixel_cube::predict_pixel_cube(): Invalid model: " + s);
+    }
+
+    if (_ensemble->classification) {
+        _bands.add(band("class"));
+        if (_probabilities) {
+            for (uint16_t i = 0; i < _ensemble->classes.size(); ++i) {
+                _bands.add(band("p_" + _ensemble->classes[i]));
+            }
+        }
+    } else {
+        _bands.add(band("prediction"));
+    }
+}
+
+std::shared_ptr<chunk_data> predict_pixel_cube::read_chunk(chunkid_t id) {
+    GCBS_TRACE("predict_pixel_cube::read_chunk(" + std::to_string(id) + ")");
+    std::shared_ptr<chunk_data> out = std::make_shared<chunk_data>();
+    if (id >= count_chunks())
+        return out;  // chunk is outside of the view, we don't need to read anything.
+
+    std::shared_ptr<chunk_data> in = _in_cube->read_chunk(id);
+    if (in->empty()) {
+        return out;
+    }
+
+    coords_nd<uint32_t, 4> size_btyx = {uint32_t(_bands.count()), in->size()[1], in->size()[2], in->size()[3]};
+    out->size(size_btyx);
+    out->buf(std::calloc(size_btyx[0] * size_btyx[1] * size_btyx[2] * size_btyx[3], sizeof(double)));
+
+    const tree_ensemble &m = *_ensemble;
+    const uint64_t npix = uint64_t(size_btyx[1]) * size_btyx[2] * size_btyx[3];
+    const uint16_t nf = m.feature_bands.size();
+    const uint16_t nv = m.nvalues;
+    const uint16_t nc = m.classification ? m.classes.size() : 1;
+    const double *ibuf = (const double *)in->buf();
+    double *obuf = (double *)out->buf();
+
+    const uint32_t batch = 64;  // pixels evaluated together
+    const uint32_t task = 16 * batch;  // pixels per parallel task
+    thread_pool::instance()->parallel_for((npix + task - 1) / task, [&](uint32_t itask) {
+        std::vector<double> x(batch * nf);
+        std::vector<double> acc(batch * nv);
+        std::vector<uint8_t> invalid(batch);
+        std::vector<double> prob(nc);
+        uint64_t task_end = std::min(npix, uint64_t(itask + 1) * task);
+        for (uint64_t p0 = uint64_t(itask) * task; p0 < task_end; p0 += batch) {
+            uint32_t nb = std::min(uint64_t(batch), task_end - p0);
+
+            // gather features of the batch, pixel-wise
+            for (uint16_t f = 0; f < nf; ++f) {
+                const double *src = ibuf + m.feature_bands[f] * npix + p0;
+                for (uint32_t i = 0; i < nb; ++i) {
+                    x[i * nf + f] = src[i];
+                }
+            }
+            for (uint32_t i = 0; i < nb; ++i) {
+                bool all_nan = true;
+                for (uint16_t f = 0; f < nf; ++f) {
+                    if (!std::isnan(x[i * nf + f])) {
+                        all_nan = false;
+                        break;
+                    }
+                }
+                invalid[i] = all_nan;
+            }
+            std::fill(acc.begin(), acc.end(), 0.0);
+
+            for (uint32_t it = 0; it < m.roots.size(); ++it) {
+                for (uint32_t i = 0; i < nb; ++i) {
+                    if (invalid[i]) continue;
+                    const double *xi = x.data() + i * nf;
+                    const tree_ensemble::node *n = &m.nodes[m.roots[it]];
+                    while (n->feature >= 0) {
+                        double v = xi[n->feature];
+                        bool go_left;
+                        if (std::isnan(v)) {
+                            if (n->default_dir < 0) {
+                                invalid[i] = 1;
+                                break;
+                            }
+                            go_left = n->default_dir == 1;
+                        } else {
+                            go_left = m.le ? v <= n->threshold : v < n->threshold;
+                        }
+                        n = &m.nodes[go_left ? n->left : n->right];
+                    }
+                    if (invalid[i]) continue;
+                    const double *val = m.values.data() + n->left;
+                    for (uint16_t k = 0; k < nv; ++k) {
+                        acc[i * nv + k] += val[k];
+                    }
+                }
+            }
+
+            for (uint32_t i = 0; i < nb; ++i) {
+                uint64_t p = p0 + i;
+                if (invalid[i]) {
+                    for (uint16_t ib = 0; ib < size_btyx[0]; ++ib) {
+                        obuf[ib * npix + p] = NAN;
+                    }
+                    continue;
+                }
+                double *s = acc.data() + i * nv;
+                for (uint16_t k = 0; k < nv; ++k) {
+                    if (m.mean) s[k] /= double(m.roots.size());
+                    s[k] += m.base_score[k];
+                }
+                if (!m.classification) {
+                    obuf[p] = (m.output_transform == tree_ensemble::transform::SIGMOID) ? 1.0 / (1.0 + std::exp(-s[0])) : s[0];
+                    continue;
+                }
+                if (nv == 1) {
+                    // binary classification with a single score
+                    prob[1] = 1.0 / (1.0 + std::exp(-s[0]));
+                    prob[0] = 1.0 - prob[1];
+                } else if (m.output_transform == tree_ensemble::transform::SOFTMAX) {
+                    double smax = *std::max_element(s, s + nv);
+                    double sum = 0;
+                    for (uint16_t k = 0; k < nv; ++k) {
+                        prob[k] = std::exp(s[k] - smax);
+                        sum += prob[k];
+                    }
+                    for (uint16_t k = 0; k < nv; ++k) {
+                        prob[k] /= sum;
+                    }
+                } else {
+                    for (uint16_t k = 0; k < nv; ++k) {
+                        prob[k] = m.output_transform == tree_ensemble::transform::SIGMOID ? 1.0 / (1.0 + std::exp(-s[k])) : s[k];
+                    }
+                }
+                obuf[p] = double(std::max_element(prob.begin(), prob.end()) - prob.begin() + 1);
+                if (_probabilities) {
+                    for (uint16_t k = 0; k < nc; ++k) {
+                        obuf[(k + 1) * npix + p] = prob[k];
+                    }
+                }
+            }
+        }
+    });
+
+    // check if chunk is completely NAN and if yes, return empty chunk
+    if (out->all_nan()) {
+        out = std::make_shared<chunk_data>();
+    }
+    return out;
+}
+
+}  // namespace gdalcubes
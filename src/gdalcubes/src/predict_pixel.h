@@ -0,0 +1,112 @@
+/*
+    MIT License
+
+    Copyright (c) 2023 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#ifndef PREDICT_PIXEL_H
+#define PREDICT_PIXEL_H
+
+#include "cube.h"
+
+namespace gdalcubes {
+
+/**
+ * @brief A data cube that applies a trained tree ensemble model (random forest, gradient boosting) on pixels
+ *
+ * Models are given as JSON (either as a file or as a JSON string) with the following structure:
+ * @code
+ * {
+ *   "objective": "regression",      // or "classification"
+ *   "aggregation": "mean",          // how tree outputs are combined, "mean" (random forests) or "sum" (boosting)
+ *   "base_score": 0.0,              // added after aggregation, a number or an array with one value per output
+ *   "output_transform": "none",     // "none", "softmax" (multiclass boosting), or "sigmoid" (binary boosting)
+ *   "split": "<=",                  // go to the left child if value <= threshold, or value < threshold for "<"
+ *   "features": ["B04", "B05"],     // input band names in the order of feature indexes
+ *   "classes": ["water", "forest"], // class names, classification only
+ *   "trees": [{
+ *      "feature": [0, -1, -1],      // feature index of nodes, negative for leaves
+ *      "threshold": [0.3, 0, 0],
+ *      "left": [1, -1, -1],         // child node indexes
+ *      "right": [2, -1, -1],
+ *      "default_left": [1, 0, 0],   // optional, direction of missing values
+ *      "value": [0, 0.2, 0.8]       // node values, one (regression, binary boosting) or one per class for each node
+ *   }]
+ * }
+ * @endcode
+ *
+ * Regression models produce a band "prediction". Classification models produce a band "class" with the (one-based) index of the
+ * most probable class and optionally one band per class with class probabilities (or scores if no transformation is applied).
+ *
+ * If a split refers to a feature with missing value and no default direction is given, the prediction of the pixel is NAN.
+ * Pixels where all features are NAN are NAN.
+ *
+ * Trees are stored as one flat array of nodes. Pixels are evaluated in batches, all trees are applied on one batch before
+ * processing the next batch such that the nodes of a tree and the features of a batch stay in cache.
+ */
+class predict_pixel_cube : public cube {
+   public:
+    /**
+     * @brief Create a data cube that applies a tree ensemble model on pixels of a given input data cube
+     * @note This static creation method should preferably be used instead of the constructors as
+     * the constructors will not set connections between cubes properly.
+     * @param in input data cube
+     * @param model path to a model JSON file, or JSON model string
+     * @param probabilities for classification models, add bands with class probabilities
+     * @return a shared pointer to the created data cube instance
+     */
+    static std::shared_ptr<predict_pixel_cube> create(std::shared_ptr<cube> in, std::string model, bool probabilities = false) {
+        std::shared_ptr<predict_pixel_cube> out = std::make_shared<predict_pixel_cube>(in, model, probabilities);
+        in->add_child_cube(out);
+        out->add_parent_cube(in);
+        return out;
+    }
+
+   public:
+    predict_pixel_cube(std::shared_ptr<cube> in, std::string model, bool probabilities = false);
+
+   public:
+    ~predict_pixel_cube() {}
+
+    std::shared_ptr<chunk_data> read_chunk(chunkid_t id) override;
+
+    json11::Json make_constructible_json() override {
+        json11::Json::object out;
+        out["cube_type"] = "predict_pixel";
+        out["model"] = _model;
+        out["probabilities"] = _probabilities;
+        out["in_cube"] = _in_cube->make_constructible_json();
+        return out;
+    }
+
+   private:
+    std::shared_ptr<cube> _in_cube;
+    std::string _model;
+    bool _probabilities;
+
+    struct tree_ensemble;
+    std::shared_ptr<tree_ensemble> _ensemble;
+};
+
+}  // namespace gdalcubes
+
+#endif  // PREDICT_PIXEL_H
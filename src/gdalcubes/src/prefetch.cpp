@@ -0,0 +1,203 @@
+/*
+    MIT License
+
+    Copyright (c) 2023 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#include "prefetch.h"
+
+#include "error.h"
+
+namespace gdalcubes {
+
+bool prefetch_queue::push(std::function<void()> task) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_tasks.size() >= MAX_PENDING_TASKS) {
+        return false;
+    }
+    _tasks.push_back(task);
+
+    // start another background thread if needed, the number of threads is limited by the look-ahead depth
+    uint16_t max_threads = config::instance()->get_prefetch_depth();
+    if (max_threads > MAX_THREADS) max_threads = MAX_THREADS;
+    if (max_threads == 0) max_threads = 1;
+    if (_nthreads < max_threads && _nthreads < _tasks.size()) {
+        try {
+            std::thread(&prefetch_queue::work, this).detach();
+            ++_nthreads;
+        } catch (...) {
+            if (_nthreads == 0) {
+                _tasks.clear();
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void prefetch_queue::work() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_tasks.empty()) {
+                --_nthreads;
+                _cv_finished.notify_all();
+                return;
+            }
+            task = _tasks.front();
+            _tasks.pop_front();
+        }
+        try {
+            task();
+        } catch (std::string s) {
+            GCBS_DEBUG("Prefetching failed: " + s);
+        } catch (...) {
+            GCBS_DEBUG("Prefetching failed");
+        }
+    }
+}
+
+void prefetch_queue::clear() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _tasks.clear();
+    _cv_finished.wait(lock, [this] { return _nthreads == 0; });
+}
+
+bool prefetch_queue::reserve(uint64_t bytes) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_reserved + bytes > config::instance()->get_prefetch_memory_max()) {
+        return false;
+    }
+    _reserved += bytes;
+    return true;
+}
+
+void prefetch_queue::release(uint64_t bytes) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _reserved = (bytes > _reserved) ? 0 : _reserved - bytes;
+}
+
+std::vector<chunkid_t> chunk_access_predictor::next(chunkid_t id, chunkid_t nchunks, uint16_t depth) {
+    // Use the stride of the calling thread only if it is regular, e.g. with dynamic
+    // scheduling, threads read chunks in irregular order but chunks are claimed in increasing order.
+    chunkid_t stride = 1;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto it = _last.find(std::this_thread::get_id());
+        if (it != _last.end()) {
+            chunkid_t cur_stride = (id > it->second.first) ? id - it->second.first : 0;
+            if (cur_stride > 0 && cur_stride == it->second.second) {
+                stride = cur_stride;
+            }
+            it->second = std::make_pair(id, cur_stride);
+        } else {
+            _last[std::this_thread::get_id()] = std::make_pair(id, chunkid_t(0));
+        }
+    }
+    std::vector<chunkid_t> out;
+    for (uint16_t k = 1; k <= depth; ++k) {
+        uint64_t next_id = uint64_t(id) + uint64_t(k) * uint64_t(stride);
+        if (next_id >= nchunks) break;
+        out.push_back(chunkid_t(next_id));
+    }
+    return out;
+}
+
+static bool same_extent(const bounds_st &a, const bounds_st &b) {
+    return a.s.left == b.s.left && a.s.right == b.s.right && a.s.bottom == b.s.bottom && a.s.top == b.s.top &&
+           a.t0 == b.t0 && a.t1 == b.t1;
+}
+
+prefetch_plans::~prefetch_plans() {
+    for (auto it = _plans.begin(); it != _plans.end(); ++it) {
+        prefetch_queue::instance()->release(it->second.bytes);
+    }
+}
+
+bool prefetch_plans::add(chunkid_t id, bounds_st extent, uint32_t max_plans) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_plans.find(id) != _plans.end()) {
+        return false;  // already scheduled
+    }
+    if (_plans.size() >= max_plans) {
+        auto it = _plans.begin();
+        while (it != _plans.end() && !it->second.ready) ++it;
+        if (it == _plans.end()) return false;
+        prefetch_queue::instance()->release(it->second.bytes);
+        _plans.erase(it);
+    }
+    plan p;
+    p.ready = false;
+    p.extent = extent;
+    p.bytes = 0;
+    _plans[id] = p;
+    return true;
+}
+
+bool prefetch_plans::complete(chunkid_t id, std::vector<image_collection::find_range_st_row> datasets, uint64_t bytes) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto p = _plans.find(id);
+    if (p == _plans.end()) {
+        // chunk has been read in the meantime
+        prefetch_queue::instance()->release(bytes);
+        return false;
+    }
+    p->second.datasets = std::move(datasets);
+    p->second.bytes = bytes;
+    p->second.ready = true;
+    return true;
+}
+
+bool prefetch_plans::take(chunkid_t id, bounds_st extent, std::vector<image_collection::find_range_st_row> &datasets) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto p = _plans.find(id);
+    if (p == _plans.end()) {
+        return false;
+    }
+    bool ok = p->second.ready && same_extent(p->second.extent, extent);
+    if (ok) {
+        datasets = std::move(p->second.datasets);
+    }
+    prefetch_queue::instance()->release(p->second.bytes);
+    _plans.erase(p);
+    return ok;
+}
+
+void prefetch_plans::remove(chunkid_t id) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto p = _plans.find(id);
+    if (p == _plans.end()) return;
+    prefetch_queue::instance()->release(p->second.bytes);
+    _plans.erase(p);
+}
+
+bool prefetch_window(GDALDataset *dataset, bool advise, int x_off, int y_off, int x_size, int y_size, int buf_x, int buf_y,
+                     GDALDataType type, std::vector<int> band_map) {
+    if (advise) {
+        return dataset->AdviseRead(x_off, y_off, x_size, y_size, buf_x, buf_y, type, band_map.size(), band_map.data(), NULL) == CE_None;
+    }
+    std::vector<char> buf(std::size_t(buf_x) * std::size_t(buf_y) * band_map.size() * GDALGetDataTypeSizeBytes(type));
+    return dataset->RasterIO(GF_Read, x_off, y_off, x_size, y_size, buf.data(), buf_x, buf_y, type, band_map.size(), band_map.data(), 0, 0, 0, NULL) == CE_None;
+}
+
+}  // namespace gdalcubes
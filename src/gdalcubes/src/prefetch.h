@@ -0,0 +1,230 @@
+/*
+    MIT License
+
+    Copyright (c) 2023 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+#include <gdal_priv.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "cube.h"
+#include "image_collection.h"
+
+namespace gdalcubes {
+
+/**
+ * @brief Background queue for asynchronous prefetching of source data
+ *
+ * Prefetch tasks typically announce source windows of chunks that will be read soon to GDAL
+ * (e.g. using GDALDataset::AdviseRead()) such that I/O latency overlaps with the computation of
+ * the current chunk. Tasks are executed by a small number of background threads, which are started
+ * on demand and terminate as soon as the queue is empty. Since prefetching is an optimization only,
+ * tasks are silently dropped if the queue is full and exceptions thrown by tasks are ignored.
+ *
+ * The queue furthermore keeps track of the size of source windows that have been prefetched
+ * but not yet read, which is limited by config::get_prefetch_memory_max(). Notice that prefetched windows
+ * are not held in memory by gdalcubes but by GDAL (in the /vsicurl/ range cache or the block cache of
+ * pooled dataset handles, see prefetch_window()), so the limit bounds the look-ahead rather than actual memory use.
+ */
+class prefetch_queue {
+   public:
+    static prefetch_queue *instance() {
+        static prefetch_queue instance;
+        return &instance;
+    }
+
+    /**
+     * @brief Add a task to the queue
+     * @param task function to be executed by a background thread
+     * @return false if the queue is full and the task has been dropped
+     */
+    bool push(std::function<void()> task);
+
+    /**
+     * @brief Drop all pending tasks and wait until running tasks have finished
+     */
+    void clear();
+
+    /**
+     * @brief Reserve budget for a source window that is announced to GDAL
+     * @param bytes size of the announced window
+     * @return false if the reservation would exceed config::get_prefetch_memory_max()
+     */
+    bool reserve(uint64_t bytes);
+
+    /**
+     * @brief Release budget reserved by reserve(), e.g. after announced windows have been read
+     * @param bytes size as passed to reserve()
+     */
+    void release(uint64_t bytes);
+
+    inline uint64_t reserved() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _reserved;
+    }
+
+   private:
+    prefetch_queue(const prefetch_queue &) = delete;
+    prefetch_queue(prefetch_queue &&) = delete;
+    prefetch_queue &operator=(const prefetch_queue &) = delete;
+    prefetch_queue &operator=(prefetch_queue &&) = delete;
+    prefetch_queue() : _tasks(), _nthreads(0), _reserved(0), _mutex(), _cv_finished() {}
+    ~prefetch_queue() {}
+
+    void work();
+
+    std::deque<std::function<void()>> _tasks;
+    uint16_t _nthreads;
+    uint64_t _reserved;
+    std::mutex _mutex;
+    std::condition_variable _cv_finished;
+
+    static const uint32_t MAX_PENDING_TASKS = 64;
+    static const uint16_t MAX_THREADS = 4;
+};
+
+/**
+ * @brief Predicts which chunks will be read next
+ *
+ * Chunk processors read chunks with a regular pattern per thread or process, e.g. 0, 1, 2, ...
+ * for single-threaded processing or i, i + n, i + 2n, ... for n threads / worker processes.
+ * The predictor remembers the last chunk read by each thread and extrapolates its stride if it is regular,
+ * otherwise (e.g. for dynamically scheduled chunks) the next chunks in order are predicted.
+ */
+class chunk_access_predictor {
+   public:
+    chunk_access_predictor() : _last(), _mutex() {}
+
+    /**
+     * @brief Register that the calling thread reads a chunk and predict the next reads of the same thread
+     * @param id chunk id that is currently read
+     * @param nchunks number of chunks of the cube
+     * @param depth number of chunks to predict
+     * @return ids of up to depth chunks that will probably be read next
+     */
+    std::vector<chunkid_t> next(chunkid_t id, chunkid_t nchunks, uint16_t depth);
+
+   private:
+    std::map<std::thread::id, std::pair<chunkid_t, chunkid_t>> _last;  // last chunk id and stride per thread
+    std::mutex _mutex;
+};
+
+/**
+ * @brief Intersection plans of chunks that are expected to be read soon
+ *
+ * Plans are added before a prefetch task is queued, completed by the task with the datasets intersecting
+ * the chunk and the budget reserved at the prefetch_queue for announced windows, and finally taken by
+ * the thread reading the chunk. Reserved budget of plans is released when plans are taken, removed or
+ * dropped, and when the object is destroyed.
+ */
+class prefetch_plans {
+   public:
+    prefetch_plans() : _plans(), _mutex() {}
+    ~prefetch_plans();
+
+    /**
+     * @brief Add a pending plan for a chunk
+     * @param id chunk id
+     * @param extent spatiotemporal extent of the chunk
+     * @param max_plans maximum number of plans, if reached, the oldest completed plan (of a mispredicted chunk) is dropped
+     * @return false if a plan for the chunk exists already or no plan could be dropped
+     */
+    bool add(chunkid_t id, bounds_st extent, uint32_t max_plans);
+
+    /**
+     * @brief Complete a pending plan
+     * @param id chunk id
+     * @param datasets datasets intersecting with the chunk
+     * @param bytes budget reserved for announced windows
+     * @return false if there is no plan for the chunk (anymore), the budget has then been released
+     */
+    bool complete(chunkid_t id, std::vector<image_collection::find_range_st_row> datasets, uint64_t bytes);
+
+    /**
+     * @brief Take the plan of a chunk that is going to be read
+     *
+     * The plan is removed in any case.
+     *
+     * @param id chunk id
+     * @param extent spatiotemporal extent of the chunk, must match the extent of the plan
+     * @param[out] datasets datasets intersecting with the chunk
+     * @return true if a completed plan with identical extent has been found
+     */
+    bool take(chunkid_t id, bounds_st extent, std::vector<image_collection::find_range_st_row> &datasets);
+
+    /**
+     * @brief Remove the plan of a chunk, e.g. if its prefetch task could not be queued
+     * @param id chunk id
+     */
+    void remove(chunkid_t id);
+
+    inline uint32_t size() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _plans.size();
+    }
+
+   private:
+    struct plan {
+        bool ready;
+        bounds_st extent;
+        std::vector<image_collection::find_range_st_row> datasets;
+        uint64_t bytes;
+    };
+
+    std::map<chunkid_t, plan> _plans;
+    std::mutex _mutex;
+};
+
+/**
+ * @brief Prefetch a window of a source dataset
+ *
+ * Windows of remote datasets are announced with GDALDataset::AdviseRead(), such that GDAL starts fetching
+ * the corresponding byte ranges. Most drivers ignore such advice for local files, the window is then read
+ * and the result is discarded, which leaves its blocks in the block cache of the dataset handle.
+ * In both cases, the result is used only if the window is later read through the same handle, i.e.
+ * the handle should come from gdal_dataset_pool.
+ *
+ * @param dataset dataset handle
+ * @param advise if true, announce the window only, otherwise read it
+ * @param x_off, y_off, x_size, y_size pixel window of the dataset
+ * @param buf_x, buf_y size of the window after resampling, lets GDAL select overviews
+ * @param type data type of the window
+ * @param band_map band numbers (starting with 1)
+ * @return true if the window has been announced or read successfully
+ */
+bool prefetch_window(GDALDataset *dataset, bool advise, int x_off, int y_off, int x_size, int y_size, int buf_x, int buf_y,
+                     GDALDataType type, std::vector<int> band_map);
+
+}  // namespace gdalcubes
+
+#endif  // PREFETCH_H
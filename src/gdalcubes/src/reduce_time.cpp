@@ -23,6 +23,11 @@
 */
 #include "reduce_time.h"
 
+#include <algorithm>
+
+#include "image_collection_cube.h"
+#include "thread_pool.h"
+
 namespace gdalcubes {
 
 struct reducer_singleband {
@@ -43,6 +48,29 @@ struct reducer_singleband {
      */
     virtual void combine(std::shared_ptr<chunk_data> a, std::shared_ptr<chunk_data> b, chunkid_t chunk_id) = 0;
 
+    /**
+     * @brief Combines consecutive time slices of an input chunk with the current state of the result chunk
+     * @details This is used when the input is read slice by slice instead of as complete chunks. Reducers that do not depend
+     * on the date of observations simply combine the slices as if they were a chunk.
+     * @param a output chunk of the reduction
+     * @param b time slices of one input chunk of the input cube, which is aligned with the output chunk in space
+     * @param it0 time index of the first slice of b within the input chunk
+     */
+    virtual void combine_slices(std::shared_ptr<chunk_data> a, std::shared_ptr<chunk_data> b, chunkid_t chunk_id, uint32_t it0) {
+        combine(a, b, chunk_id);
+    }
+
+    /**
+     * @brief Merges the state of another reducer of the same type into the state of this reducer
+     * @details This is used to reduce consecutive segments of the time axis independently. Segments must be merged in
+     * temporal order, i.e., other must have been applied on later time slices than this reducer. The other reducer
+     * releases its state and must not be finalized afterwards.
+     * @param a output chunk of the reduction
+     * @param other reducer of the same type with identical bands
+     * @param b output chunk of the other reducer
+     */
+    virtual void merge(std::shared_ptr<chunk_data> a, reducer_singleband *other, std::shared_ptr<chunk_data> b) = 0;
+
     /**
      * @brief Finallizes the reduction, i.e., frees additional buffers and postprocesses the result (e.g. dividing by n for mean reducer)
      * @param a result chunk
@@ -72,6 +100,15 @@ struct sum_reducer_singleband : public reducer_singleband {
             }
         }
     }
+    void merge(std::shared_ptr<chunk_data> a, reducer_singleband *other, std::shared_ptr<chunk_data> b) override {
+        uint32_t nxy = a->size()[2] * a->size()[3];
+        double *w = ((double *)a->buf()) + _band_idx_out * nxy;
+        const double *v = ((double *)b->buf()) + _band_idx_out * nxy;
+        for (uint32_t ixy = 0; ixy < nxy; ++ixy) {
+            w[ixy] += v[ixy];
+        }
+    }
+
     void finalize(std::shared_ptr<chunk_data> a) override {}
 
    private:
@@ -101,6 +138,15 @@ struct prod_reducer_singleband : public reducer_singleband {
             }
         }
     }
+    void merge(std::shared_ptr<chunk_data> a, reducer_singleband *other, std::shared_ptr<chunk_data> b) override {
+        uint32_t nxy = a->size()[2] * a->size()[3];
+        double *w = ((double *)a->buf()) + _band_idx_out * nxy;
+        const double *v = ((double *)b->buf()) + _band_idx_out * nxy;
+        for (uint32_t ixy = 0; ixy < nxy; ++ixy) {
+            w[ixy] *= v[ixy];
+        }
+    }
+
     void finalize(std::shared_ptr<chunk_data> a) override {}
 
    private:
@@ -134,6 +180,16 @@ struct mean_reducer_singleband : public reducer_singleband {
         }
     }
 
+    void merge(std::shared_ptr<chunk_data> a, reducer_singleband *other, std::shared_ptr<chunk_data> b) override {
+        mean_reducer_singleband *o = static_cast<mean_reducer_singleband *>(other);
+        uint32_t nxy = a->size()[2] * a->size()[3];
+        for (uint32_t ixy = 0; ixy < nxy; ++ixy) {
+            ((double *)a->buf())[_band_idx_out * nxy + ixy] += ((double *)b->buf())[_band_idx_out * nxy + ixy];
+            _count[ixy] += o->_count[ixy];
+        }
+        std::free(o->_count);
+    }
+
     void finalize(std::shared_ptr<chunk_data> a) override {
         // divide by count;
         for (uint32_t ixy = 0; ixy < a->size()[2] * a->size()[3]; ++ixy) {
@@ -175,6 +231,17 @@ struct min_reducer_singleband : public reducer_singleband {
         }
     }
 
+    void merge(std::shared_ptr<chunk_data> a, reducer_singleband *other, std::shared_ptr<chunk_data> b) override {
+        uint32_t nxy = a->size()[2] * a->size()[3];
+        double *w = ((double *)a->buf()) + _band_idx_out * nxy;
+        const double *v = ((double *)b->buf()) + _band_idx_out * nxy;
+        for (uint32_t ixy = 0; ixy < nxy; ++ixy) {
+            if (!std::isnan(v[ixy]) && (std::isnan(w[ixy]) || v[ixy] < w[ixy])) {
+                w[ixy] = v[ixy];
+            }
+        }
+    }
+
     void finalize(std::shared_ptr<chunk_data> a) override {}
 
    private:
@@ -200,10 +267,16 @@ struct which_min_reducer_singleband : public reducer_singleband {
     }
 
     void combine(std::shared_ptr<chunk_data> a, std::shared_ptr<chunk_data> b, chunkid_t chunk_id) override {
+        combine_slices(a, b, chunk_id, 0);
+    }
+
+    void combine_slices(std::shared_ptr<chunk_data> a, std::shared_ptr<chunk_data> b, chunkid_t chunk_id, uint32_t it0) override {
         std::shared_ptr<cube> in = _in_cube.lock();
         // we don't check if pointer is expired here since the reducers live only within the read_chunk function of the reducer cube object that has shared ownership with the input cube
+        datetime t0 = in->bounds_from_chunk(chunk_id).t0;
 
         for (uint32_t it = 0; it < b->size()[1]; ++it) {
+            double t = (t0 + (in->st_reference()->dt() * (it0 + it))).to_double();
             for (uint32_t ixy = 0; ixy < b->size()[2] * b->size()[3]; ++ixy) {
                 double v = ((double *)b->buf())[_band_idx_in * b->size()[1] * b->size()[2] * b->size()[3] + it * b->size()[2] * b->size()[3] + ixy];
                 if (!std::isnan(v)) {
@@ -212,11 +285,11 @@ struct which_min_reducer_singleband : public reducer_singleband {
                     if (std::isnan(*w)) {
                         *w = v;
                         // set date in output chunk
-                        ((double *)a->buf())[_band_idx_out * a->size()[1] * a->size()[2] * a->size()[3] + ixy] = (in->bounds_from_chunk(chunk_id).t0 + (in->st_reference()->dt() * it)).to_double();
+                        ((double *)a->buf())[_band_idx_out * a->size()[1] * a->size()[2] * a->size()[3] + ixy] = t;
                     } else {
                         if (v < *w) {
                             *w = v;
-                            ((double *)a->buf())[_band_idx_out * a->size()[1] * a->size()[2] * a->size()[3] + ixy] = (in->bounds_from_chunk(chunk_id).t0 + (in->st_reference()->dt() * it)).to_double();
+                            ((double *)a->buf())[_band_idx_out * a->size()[1] * a->size()[2] * a->size()[3] + ixy] = t;
                         }
                     }
                 }
@@ -224,6 +297,19 @@ struct which_min_reducer_singleband : public reducer_singleband {
         }
     }
 
+    void merge(std::shared_ptr<chunk_data> a, reducer_singleband *other, std::shared_ptr<chunk_data> b) override {
+        // ties are resolved in favor of the earlier date, as in combine_slices()
+        which_min_reducer_singleband *o = static_cast<which_min_reducer_singleband *>(other);
+        uint32_t nxy = a->size()[2] * a->size()[3];
+        for (uint32_t ixy = 0; ixy < nxy; ++ixy) {
+            if (!std::isnan(o->_cur_min[ixy]) && (std::isnan(_cur_min[ixy]) || o->_cur_min[ixy] < _cur_min[ixy])) {
+                _cur_min[ixy] = o->_cur_min[ixy];
+                ((double *)a->buf())[_band_idx_out * nxy + ixy] = ((double *)b->buf())[_band_idx_out * nxy + ixy];
+            }
+        }
+        std::free(o->_cur_min);
+    }
+
     void finalize(std::shared_ptr<chunk_data> a) override {
         std::free(_cur_min);
     }
@@ -262,6 +348,17 @@ struct max_reducer_singleband : public reducer_singleband {
         }
     }
 
+    void merge(std::shared_ptr<chunk_data> a, reducer_singleband *other, std::shared_ptr<chunk_data> b) override {
+        uint32_t nxy = a->size()[2] * a->size()[3];
+        double *w = ((double *)a->buf()) + _band_idx_out * nxy;
+        const double *v = ((double *)b->buf()) + _band_idx_out * nxy;
+        for (uint32_t ixy = 0; ixy < nxy; ++ixy) {
+            if (!std::isnan(v[ixy]) && (std::isnan(w[ixy]) || v[ixy] > w[ixy])) {
+                w[ixy] = v[ixy];
+            }
+        }
+    }
+
     void finalize(std::shared_ptr<chunk_data> a) override {}
 
    private:
@@ -287,10 +384,16 @@ struct which_max_reducer_singleband : public reducer_singleband {
     }
 
     void combine(std::shared_ptr<chunk_data> a, std::shared_ptr<chunk_data> b, chunkid_t chunk_id) override {
+        combine_slices(a, b, chunk_id, 0);
+    }
+
+    void combine_slices(std::shared_ptr<chunk_data> a, std::shared_ptr<chunk_data> b, chunkid_t chunk_id, uint32_t it0) override {
         std::shared_ptr<cube> in = _in_cube.lock();
         // we don't check if pointer is expired here since the reducers live only within the read_chunk function of the reducer cube object that has shared ownership with the input cube
+        datetime t0 = in->bounds_from_chunk(chunk_id).t0;
 
         for (uint32_t it = 0; it < b->size()[1]; ++it) {
+            double t = (t0 + (in->st_reference()->dt() * (it0 + it))).to_double();
             for (uint32_t ixy = 0; ixy < b->size()[2] * b->size()[3]; ++ixy) {
                 double v = ((double *)b->buf())[_band_idx_in * b->size()[1] * b->size()[2] * b->size()[3] + it * b->size()[2] * b->size()[3] + ixy];
                 if (!std::isnan(v)) {
@@ -299,11 +402,11 @@ struct which_max_reducer_singleband : public reducer_singleband {
                     if (std::isnan(*w)) {
                         *w = v;
                         // set date in output chunk
-                        ((double *)a->buf())[_band_idx_out * a->size()[1] * a->size()[2] * a->size()[3] + ixy] = (in->bounds_from_chunk(chunk_id).t0 + (in->st_reference()->dt() * it)).to_double();
+                        ((double *)a->buf())[_band_idx_out * a->size()[1] * a->size()[2] * a->size()[3] + ixy] = t;
                     } else {
                         if (v > *w) {
                             *w = v;
-                            ((double *)a->buf())[_band_idx_out * a->size()[1] * a->size()[2] * a->size()[3] + ixy] = (in->bounds_from_chunk(chunk_id).t0 + (in->st_reference()->dt() * it)).to_double();
+                            ((double *)a->buf())[_band_idx_out * a->size()[1] * a->size()[2] * a->size()[3] + ixy] = t;
                         }
                     }
                 }
@@ -311,6 +414,19 @@ struct which_max_reducer_singleband : public reducer_singleband {
         }
     }
 
+    void merge(std::shared_ptr<chunk_data> a, reducer_singleband *other, std::shared_ptr<chunk_data> b) override {
+        // ties are resolved in favor of the earlier date, as in combine_slices()
+        which_max_reducer_singleband *o = static_cast<which_max_reducer_singleband *>(other);
+        uint32_t nxy = a->size()[2] * a->size()[3];
+        for (uint32_t ixy = 0; ixy < nxy; ++ixy) {
+            if (!std::isnan(o->_cur_max[ixy]) && (std::isnan(_cur_max[ixy]) || o->_cur_max[ixy] > _cur_max[ixy])) {
+                _cur_max[ixy] = o->_cur_max[ixy];
+                ((double *)a->buf())[_band_idx_out * nxy + ixy] = ((double *)b->buf())[_band_idx_out * nxy + ixy];
+            }
+        }
+        std::free(o->_cur_max);
+    }
+
     void finalize(std::shared_ptr<chunk_data> a) override {
         std::free(_cur_max);
     }
@@ -343,6 +459,15 @@ struct count_reducer_singleband : public reducer_singleband {
         }
     }
 
+    void merge(std::shared_ptr<chunk_data> a, reducer_singleband *other, std::shared_ptr<chunk_data> b) override {
+        uint32_t nxy = a->size()[2] * a->size()[3];
+        double *w = ((double *)a->buf()) + _band_idx_out * nxy;
+        const double *v = ((double *)b->buf()) + _band_idx_out * nxy;
+        for (uint32_t ixy = 0; ixy < nxy; ++ixy) {
+            w[ixy] += v[ixy];
+        }
+    }
+
     void finalize(std::shared_ptr<chunk_data> a) override {}
 
    private:
@@ -373,6 +498,14 @@ struct median_reducer_singleband : public reducer_singleband {
         }
     }
 
+    void merge(std::shared_ptr<chunk_data> a, reducer_singleband *other, std::shared_ptr<chunk_data> b) override {
+        median_reducer_singleband *o = static_cast<median_reducer_singleband *>(other);
+        for (uint32_t ixy = 0; ixy < _m_buckets.size(); ++ixy) {
+            _m_buckets[ixy].insert(_m_buckets[ixy].end(), o->_m_buckets[ixy].begin(), o->_m_buckets[ixy].end());
+        }
+        std::vector<std::vector<double>>().swap(o->_m_buckets);
+    }
+
     void finalize(std::shared_ptr<chunk_data> a) override {
         for (uint32_t ixy = 0; ixy < a->size()[2] * a->size()[3]; ++ixy) {
             std::vector<double> &list = _m_buckets[ixy];
@@ -423,6 +556,14 @@ struct quantile_reducer_singleband : public reducer_singleband {
         _p = p;
     }
 
+    void merge(std::shared_ptr<chunk_data> a, reducer_singleband *other, std::shared_ptr<chunk_data> b) override {
+        quantile_reducer_singleband *o = static_cast<quantile_reducer_singleband *>(other);
+        for (uint32_t ixy = 0; ixy < _m_buckets.size(); ++ixy) {
+            _m_buckets[ixy].insert(_m_buckets[ixy].end(), o->_m_buckets[ixy].begin(), o->_m_buckets[ixy].end());
+        }
+        std::vector<std::vector<double>>().swap(o->_m_buckets);
+    }
+
     void finalize(std::shared_ptr<chunk_data> a) override {
         for (uint32_t ixy = 0; ixy < a->size()[2] * a->size()[3]; ++ixy) {
             std::vector<double> &list = _m_buckets[ixy];
@@ -493,6 +634,24 @@ struct var_reducer_singleband : public reducer_singleband {
         }
     }
 
+    void merge(std::shared_ptr<chunk_data> a, reducer_singleband *other, std::shared_ptr<chunk_data> b) override {
+        // pairwise combination of means and sums of squared differences (Chan et al.)
+        var_reducer_singleband *o = static_cast<var_reducer_singleband *>(other);
+        uint32_t nxy = a->size()[2] * a->size()[3];
+        double *m2 = ((double *)a->buf()) + _band_idx_out * nxy;
+        const double *m2_o = ((double *)b->buf()) + _band_idx_out * nxy;
+        for (uint32_t ixy = 0; ixy < nxy; ++ixy) {
+            if (o->_count[ixy] == 0) continue;
+            double n = double(_count[ixy]) + double(o->_count[ixy]);
+            double delta = o->_mean[ixy] - _mean[ixy];
+            m2[ixy] += m2_o[ixy] + delta * delta * double(_count[ixy]) * double(o->_count[ixy]) / n;
+            _mean[ixy] += delta * double(o->_count[ixy]) / n;
+            _count[ixy] += o->_count[ixy];
+        }
+        std::free(o->_count);
+        std::free(o->_mean);
+    }
+
     virtual void finalize(std::shared_ptr<chunk_data> a) override {
         // divide by count - 1;
         for (uint32_t ixy = 0; ixy < a->size()[2] * a->size()[3]; ++ixy) {
@@ -523,6 +682,352 @@ struct sd_reducer_singleband : public var_reducer_singleband {
     }
 };
 
+/**
+ * @brief Base class for reducers that relate pixel values to the dates of observations
+ * @details Dates are given as (fractional) years since the first date of the input cube, i.e., slopes are given per year.
+ */
+struct temporal_reducer_singleband : public reducer_singleband {
+    void combine(std::shared_ptr<chunk_data> a, std::shared_ptr<chunk_data> b, chunkid_t chunk_id) override {
+        combine_slices(a, b, chunk_id, 0);
+    }
+
+    void combine_slices(std::shared_ptr<chunk_data> a, std::shared_ptr<chunk_data> b, chunkid_t chunk_id, uint32_t it0) override {
+        std::shared_ptr<cube> in = _in_cube.lock();
+        // we don't check if pointer is expired here since the reducers live only within the read_chunk function of the reducer cube object that has shared ownership with the input cube
+        uint32_t it_chunk = in->chunk_coords_from_id(chunk_id)[0] * in->chunk_size()[0] + it0;
+        uint32_t nxy = b->size()[2] * b->size()[3];
+        for (uint32_t it = 0; it < b->size()[1]; ++it) {
+            double t = (in->st_reference()->datetime_at_index(it_chunk + it).epoch_time() - _t0) / (365.25 * 86400.0);
+            add(t, ((double *)b->buf()) + (_band_idx_in * b->size()[1] + it) * nxy, nxy);
+        }
+    }
+
+   protected:
+    void init_time(uint16_t band_idx_in, uint16_t band_idx_out, std::shared_ptr<cube> in_cube) {
+        _band_idx_in = band_idx_in;
+        _band_idx_out = band_idx_out;
+        _in_cube = in_cube;
+        _t0 = in_cube->st_reference()->datetime_at_index(0).epoch_time();
+    }
+
+    /**
+     * @brief Add values of one time slice
+     * @param t date of the slice in years since the first date of the input cube
+     * @param v values of all pixels of the slice
+     * @param n number of pixels
+     */
+    virtual void add(double t, const double *v, uint32_t n) = 0;
+
+    uint16_t _band_idx_in;
+    uint16_t _band_idx_out;
+    std::weak_ptr<cube> _in_cube;
+    double _t0;
+};
+
+/**
+ * @brief Implementation of reducers to calculate the slope or intercept of ordinary least squares linear regression over time
+ * @note The intercept refers to the first date of the input cube
+ */
+struct lm_reducer_singleband : public temporal_reducer_singleband {
+    lm_reducer_singleband(bool slope) : _slope(slope) {}
+
+    void init(std::shared_ptr<chunk_data> a, uint16_t band_idx_in, uint16_t band_idx_out, std::shared_ptr<cube> in_cube) override {
+        init_time(band_idx_in, band_idx_out, in_cube);
+        uint32_t nxy = a->size()[2] * a->size()[3];
+        _n.assign(nxy, 0);
+        _st.assign(nxy, 0);
+        _sy.assign(nxy, 0);
+        _stt.assign(nxy, 0);
+        _sty.assign(nxy, 0);
+    }
+
+    void merge(std::shared_ptr<chunk_data> a, reducer_singleband *other, std::shared_ptr<chunk_data> b) override {
+        lm_reducer_singleband *o = static_cast<lm_reducer_singleband *>(other);
+        for (uint32_t ixy = 0; ixy < _n.size(); ++ixy) {
+            _n[ixy] += o->_n[ixy];
+            _st[ixy] += o->_st[ixy];
+            _sy[ixy] += o->_sy[ixy];
+            _stt[ixy] += o->_stt[ixy];
+            _sty[ixy] += o->_sty[ixy];
+        }
+        o->_n.clear();
+        o->_st.clear();
+        o->_sy.clear();
+        o->_stt.clear();
+        o->_sty.clear();
+    }
+
+    void finalize(std::shared_ptr<chunk_data> a) override {
+        uint32_t nxy = a->size()[2] * a->size()[3];
+        double *out = ((double *)a->buf()) + _band_idx_out * nxy;
+        for (uint32_t ixy = 0; ixy < nxy; ++ixy) {
+            double n = _n[ixy];
+            double den = n * _stt[ixy] - _st[ixy] * _st[ixy];
+            if (n < 2 || den <= 1e-12 * n * _stt[ixy]) {
+                out[ixy] = NAN;
+                continue;
+            }
+            double slope = (n * _sty[ixy] - _st[ixy] * _sy[ixy]) / den;
+            out[ixy] = _slope ? slope : (_sy[ixy] - slope * _st[ixy]) / n;
+        }
+    }
+
+   protected:
+    void add(double t, const double *v, uint32_t n) override {
+        for (uint32_t ixy = 0; ixy < n; ++ixy) {
+            if (!std::isnan(v[ixy])) {
+                _n[ixy] += 1;
+                _st[ixy] += t;
+                _sy[ixy] += v[ixy];
+                _stt[ixy] += t * t;
+                _sty[ixy] += t * v[ixy];
+            }
+        }
+    }
+
+   private:
+    bool _slope;
+    std::vector<double> _n, _st, _sy, _stt, _sty;
+};
+
+/**
+ * @brief Implementation of reducers to calculate coefficients of a harmonic regression over time
+ * @details The model y = c0 + c1 * t + a * cos(2 * pi * t) + b * sin(2 * pi * t) with t in years is fitted by ordinary least squares.
+ * Depending on the output, the reducer returns a, b, the amplitude sqrt(a^2 + b^2), or the phase atan2(b, a) in radians.
+ */
+struct harmonic_reducer_singleband : public temporal_reducer_singleband {
+    enum class output { COS,
+                        SIN,
+                        AMPLITUDE,
+                        PHASE };
+
+    harmonic_reducer_singleband(output o) : _output(o) {}
+
+    void init(std::shared_ptr<chunk_data> a, uint16_t band_idx_in, uint16_t band_idx_out, std::shared_ptr<cube> in_cube) override {
+        init_time(band_idx_in, band_idx_out, in_cube);
+        _sums.assign(uint64_t(a->size()[2]) * a->size()[3] * NSUMS, 0);
+    }
+
+    void merge(std::shared_ptr<chunk_data> a, reducer_singleband *other, std::shared_ptr<chunk_data> b) override {
+        harmonic_reducer_singleband *o = static_cast<harmonic_reducer_singleband *>(other);
+        for (uint64_t i = 0; i < _sums.size(); ++i) {
+            _sums[i] += o->_sums[i];
+        }
+        std::vector<double>().swap(o->_sums);
+    }
+
+    void finalize(std::shared_ptr<chunk_data> a) override {
+        uint32_t nxy = a->size()[2] * a->size()[3];
+        double *out = ((double *)a->buf()) + _band_idx_out * nxy;
+        for (uint32_t ixy = 0; ixy < nxy; ++ixy) {
+            const double *s = _sums.data() + uint64_t(ixy) * NSUMS;
+            double coef[4];
+            if (s[0] < 4 || !solve(s, coef)) {  // s[0] is the number of observations
+                out[ixy] = NAN;
+                continue;
+            }
+            switch (_output) {
+                case output::COS:
+                    out[ixy] = coef[2];
+                    break;
+                case output::SIN:
+                    out[ixy] = coef[3];
+                    break;
+                case output::AMPLITUDE:
+                    out[ixy] = std::sqrt(coef[2] * coef[2] + coef[3] * coef[3]);
+                    break;
+                case output::PHASE:
+                    out[ixy] = std::atan2(coef[3], coef[2]);
+                    break;
+            }
+        }
+    }
+
+   protected:
+    // upper triangle of X'X (10 values) followed by X'y (4 values)
+    static const uint16_t NSUMS = 14;
+
+    void add(double t, const double *v, uint32_t n) override {
+        double x[4] = {1.0, t, std::cos(2 * M_PI * t), std::sin(2 * M_PI * t)};
+        double xx[10];
+        uint16_t k = 0;
+        for (uint16_t i = 0; i < 4; ++i) {
+            for (uint16_t j = i; j < 4; ++j) {
+                xx[k++] = x[i] * x[j];
+            }
+        }
+        for (uint32_t ixy = 0; ixy < n; ++ixy) {
+            if (std::isnan(v[ixy])) continue;
+            double *s = _sums.data() + uint64_t(ixy) * NSUMS;
+            for (uint16_t i = 0; i < 10; ++i) {
+                s[i] += xx[i];
+            }
+            for (uint16_t i = 0; i < 4; ++i) {
+                s[10 + i] += x[i] * v[ixy];
+            }
+        }
+    }
+
+    // solves the normal equations with Gaussian elimination and partial pivoting, returns false if the system is singular
+    static bool solve(const double *s, double *coef) {
+        double m[4][5];
+        uint16_t k = 0;
+        for (uint16_t i = 0; i < 4; ++i) {
+            for (uint16_t j = i; j < 4; ++j) {
+                m[i][j] = m[j][i] = s[k++];
+            }
+        }
+        for (uint16_t i = 0; i < 4; ++i) {
+            m[i][4] = s[10 + i];
+        }
+        for (uint16_t c = 0; c < 4; ++c) {
+            uint16_t p = c;
+            for (uint16_t r = c + 1; r < 4; ++r) {
+                if (std::fabs(m[r][c]) > std::fabs(m[p][c])) p = r;
+            }
+            if (std::fabs(m[p][c]) < 1e-10 * s[0]) return false;
+            if (p != c) {
+                for (uint16_t j = 0; j < 5; ++j) std::swap(m[p][j], m[c][j]);
+            }
+            for (uint16_t r = c + 1; r < 4; ++r) {
+                double f = m[r][c] / m[c][c];
+                for (uint16_t j = c; j < 5; ++j) m[r][j] -= f * m[c][j];
+            }
+        }
+        for (int16_t i = 3; i >= 0; --i) {
+            double x = m[i][4];
+            for (uint16_t j = i + 1; j < 4; ++j) x -= m[i][j] * coef[j];
+            coef[i] = x / m[i][i];
+        }
+        return true;
+    }
+
+   private:
+    output _output;
+    std::vector<double> _sums;
+};
+
+/**
+ * @brief Base class for reducers that need complete pixel time series (dates and values), e.g. nonparametric trend tests
+ * @details Time series are collected as in the median reducer, finalization runs in parallel over pixels.
+ */
+struct series_reducer_singleband : public temporal_reducer_singleband {
+    void init(std::shared_ptr<chunk_data> a, uint16_t band_idx_in, uint16_t band_idx_out, std::shared_ptr<cube> in_cube) override {
+        init_time(band_idx_in, band_idx_out, in_cube);
+        _series.resize(a->size()[2] * a->size()[3], std::vector<std::pair<double, double>>());
+    }
+
+    void merge(std::shared_ptr<chunk_data> a, reducer_singleband *other, std::shared_ptr<chunk_data> b) override {
+        series_reducer_singleband *o = static_cast<series_reducer_singleband *>(other);
+        for (uint32_t ixy = 0; ixy < _series.size(); ++ixy) {
+            _series[ixy].insert(_series[ixy].end(), o->_series[ixy].begin(), o->_series[ixy].end());
+        }
+        std::vector<std::vector<std::pair<double, double>>>().swap(o->_series);
+    }
+
+    void finalize(std::shared_ptr<chunk_data> a) override {
+        uint32_t nxy = a->size()[2] * a->size()[3];
+        double *out = ((double *)a->buf()) + _band_idx_out * nxy;
+        const uint32_t block = 256;
+        thread_pool::instance()->parallel_for((nxy + block - 1) / block, [this, out, nxy, block](uint32_t ib) {
+            for (uint32_t ixy = ib * block; ixy < std::min(nxy, (ib + 1) * block); ++ixy) {
+                std::vector<std::pair<double, double>> &x = _series[ixy];
+                std::sort(x.begin(), x.end());  // slices of images may arrive out of order
+                out[ixy] = reduce(x);
+                std::vector<std::pair<double, double>>().swap(x);
+            }
+        });
+    }
+
+   protected:
+    void add(double t, const double *v, uint32_t n) override {
+        for (uint32_t ixy = 0; ixy < n; ++ixy) {
+            if (!std::isnan(v[ixy])) {
+                _series[ixy].push_back(std::make_pair(t, v[ixy]));
+            }
+        }
+    }
+
+    /**
+     * @brief Compute the result for one pixel time series
+     * @param x pairs of date and value without NAN values, sorted by date
+     */
+    virtual double reduce(const std::vector<std::pair<double, double>> &x) = 0;
+
+   private:
+    std::vector<std::vector<std::pair<double, double>>> _series;
+};
+
+/**
+ * @brief Implementation of reducer to calculate the Theil-Sen slope estimator (median of pairwise slopes) over time
+ */
+struct theil_sen_reducer_singleband : public series_reducer_singleband {
+   protected:
+    double reduce(const std::vector<std::pair<double, double>> &x) override {
+        std::vector<double> slopes;
+        slopes.reserve(x.size() * x.size() / 2);
+        for (uint32_t i = 0; i < x.size(); ++i) {
+            for (uint32_t j = i + 1; j < x.size(); ++j) {
+                if (x[j].first > x[i].first) {
+                    slopes.push_back((x[j].second - x[i].second) / (x[j].first - x[i].first));
+                }
+            }
+        }
+        if (slopes.empty()) return NAN;
+        std::size_t m = slopes.size() / 2;
+        std::nth_element(slopes.begin(), slopes.begin() + m, slopes.end());
+        double med = slopes[m];
+        if (slopes.size() % 2 == 0) {
+            med = (med + *std::max_element(slopes.begin(), slopes.begin() + m)) / 2.0;
+        }
+        return med;
+    }
+};
+
+/**
+ * @brief Implementation of reducers for the Mann-Kendall trend test, returning either Kendall's tau or the two-sided p-value
+ * @note The p-value uses the normal approximation with continuity and ties correction
+ */
+struct mann_kendall_reducer_singleband : public series_reducer_singleband {
+    mann_kendall_reducer_singleband(bool p) : _p(p) {}
+
+   protected:
+    double reduce(const std::vector<std::pair<double, double>> &x) override {
+        uint64_t n = x.size();
+        if (n < 3) return NAN;
+        int64_t s = 0;
+        for (uint64_t i = 0; i < n; ++i) {
+            for (uint64_t j = i + 1; j < n; ++j) {
+                s += (x[j].second > x[i].second) - (x[j].second < x[i].second);
+            }
+        }
+        if (!_p) {
+            return double(s) / (double(n) * double(n - 1) / 2.0);
+        }
+
+        std::vector<double> v(n);
+        for (uint64_t i = 0; i < n; ++i) v[i] = x[i].second;
+        std::sort(v.begin(), v.end());
+        double var = double(n) * (n - 1) * (2 * n + 5);
+        for (uint64_t i = 0; i < n;) {
+            uint64_t j = i;
+            while (j < n && v[j] == v[i]) ++j;
+            double tp = double(j - i);
+            var -= tp * (tp - 1) * (2 * tp + 5);
+            i = j;
+        }
+        var /= 18.0;
+        if (var <= 0) return NAN;
+        double z = 0;
+        if (s > 0) z = (s - 1) / std::sqrt(var);
+        if (s < 0) z = (s + 1) / std::sqrt(var);
+        return std::erfc(std::fabs(z) / std::sqrt(2.0));
+    }
+
+   private:
+    bool _p;
+};
+
 std::shared_ptr<chunk_data> reduce_time_cube::read_chunk(chunkid_t id) {
     GCBS_TRACE("reduce_time_cube::read_chunk(" + std::to_string(id) + ")");
     std::shared_ptr<chunk_data> out = std::make_shared<chunk_data>();
@@ -538,77 +1043,161 @@ std::shared_ptr<chunk_data> reduce_time_cube::read_chunk(chunkid_t id) {
     coords_nd<uint32_t, 4> size_btyx = {uint32_t(_reducer_bands.size()), 1, size_tyx[1], size_tyx[2]};
     out->size(size_btyx);
 
-    std::vector<reducer_singleband *> reducers;
-    for (uint16_t i = 0; i < _reducer_bands.size(); ++i) {
-        reducer_singleband *r = nullptr;
-        if (_reducer_bands[i].first == "min") {
-            r = new min_reducer_singleband();
-        } else if (_reducer_bands[i].first == "max") {
-            r = new max_reducer_singleband();
-        } else if (_reducer_bands[i].first == "mean") {
-            r = new mean_reducer_singleband();
-        } else if (_reducer_bands[i].first == "median") {
-            r = new median_reducer_singleband();
-        } else if (_reducer_bands[i].first == "sum") {
-            r = new sum_reducer_singleband();
-        } else if (_reducer_bands[i].first == "count") {
-            r = new count_reducer_singleband();
-        } else if (_reducer_bands[i].first == "prod") {
-            r = new prod_reducer_singleband();
-        } else if (_reducer_bands[i].first == "var") {
-            r = new var_reducer_singleband();
-        } else if (_reducer_bands[i].first == "sd") {
-            r = new sd_reducer_singleband();
-        } else if (_reducer_bands[i].first == "which_min") {
-            r = new which_min_reducer_singleband();
-        } else if (_reducer_bands[i].first == "which_max") {
-            r = new which_max_reducer_singleband();
-        } else if (_reducer_bands[i].first == "Q1") {
-            r = new quantile_reducer_singleband();
-            dynamic_cast<quantile_reducer_singleband*>(r)->set_p(0.25);
-        } else if (_reducer_bands[i].first == "Q3") {
-            r = new quantile_reducer_singleband();
-            dynamic_cast<quantile_reducer_singleband*>(r)->set_p(0.75);
-        } else
-            throw std::string("ERROR in reduce_time_cube::read_chunk(): Unknown reducer given");
-
-        reducers.push_back(r);
-    }
-
-    // iterate over all chunks that must be read from the input cube to compute this chunk
-    bool empty = true;
-    bool initialized = false; // lazy initialization after the first non-empty chunk
-    for (chunkid_t i = id; i < _in_cube->count_chunks(); i += _in_cube->count_chunks_x() * _in_cube->count_chunks_y()) {
-        std::shared_ptr<chunk_data> x = _in_cube->read_chunk(i);
-        if (!x->empty()) {
-            if (!initialized) {
+    auto create_reducers = [this]() {
+        std::vector<reducer_singleband *> reducers;
+        for (uint16_t i = 0; i < _reducer_bands.size(); ++i) {
+            reducer_singleband *r = nullptr;
+            if (_reducer_bands[i].first == "min") {
+                r = new min_reducer_singleband();
+            } else if (_reducer_bands[i].first == "max") {
+                r = new max_reducer_singleband();
+            } else if (_reducer_bands[i].first == "mean") {
+                r = new mean_reducer_singleband();
+            } else if (_reducer_bands[i].first == "median") {
+                r = new median_reducer_singleband();
+            } else if (_reducer_bands[i].first == "sum") {
+                r = new sum_reducer_singleband();
+            } else if (_reducer_bands[i].first == "count") {
+                r = new count_reducer_singleband();
+            } else if (_reducer_bands[i].first == "prod") {
+                r = new prod_reducer_singleband();
+            } else if (_reducer_bands[i].first == "var") {
+                r = new var_reducer_singleband();
+            } else if (_reducer_bands[i].first == "sd") {
+                r = new sd_reducer_singleband();
+            } else if (_reducer_bands[i].first == "which_min") {
+                r = new which_min_reducer_singleband();
+            } else if (_reducer_bands[i].first == "which_max") {
+                r = new which_max_reducer_singleband();
+            } else if (_reducer_bands[i].first == "Q1") {
+                r = new quantile_reducer_singleband();
+                dynamic_cast<quantile_reducer_singleband*>(r)->set_p(0.25);
+            } else if (_reducer_bands[i].first == "Q3") {
+                r = new quantile_reducer_singleband();
+                dynamic_cast<quantile_reducer_singleband*>(r)->set_p(0.75);
+            } else if (_reducer_bands[i].first == "lm_slope") {
+                r = new lm_reducer_singleband(true);
+            } else if (_reducer_bands[i].first == "lm_intercept") {
+                r = new lm_reducer_singleband(false);
+            } else if (_reducer_bands[i].first == "harmonic_cos") {
+                r = new harmonic_reducer_singleband(harmonic_reducer_singleband::output::COS);
+            } else if (_reducer_bands[i].first == "harmonic_sin") {
+                r = new harmonic_reducer_singleband(harmonic_reducer_singleband::output::SIN);
+            } else if (_reducer_bands[i].first == "harmonic_amplitude") {
+                r = new harmonic_reducer_singleband(harmonic_reducer_singleband::output::AMPLITUDE);
+            } else if (_reducer_bands[i].first == "harmonic_phase") {
+                r = new harmonic_reducer_singleband(harmonic_reducer_singleband::output::PHASE);
+            } else if (_reducer_bands[i].first == "theil_sen") {
+                r = new theil_sen_reducer_singleband();
+            } else if (_reducer_bands[i].first == "mk_tau") {
+                r = new mann_kendall_reducer_singleband(false);
+            } else if (_reducer_bands[i].first == "mk_p") {
+                r = new mann_kendall_reducer_singleband(true);
+            } else
+                throw std::string("ERROR in reduce_time_cube::read_chunk(): Unknown reducer given");
+
+            reducers.push_back(r);
+        }
+        return reducers;
+    };
+
+    // The time axis is split into consecutive segments of input chunks, which are reduced concurrently with separate
+    // reducer states and merged afterwards. Segments are only used if there are fewer spatial chunks than threads,
+    // otherwise parallel processing of chunks already keeps all threads busy. Segments run on the worker threads of the
+    // global pool and the calling thread. The number of threads refers to the configured size of the pool, threads that
+    // have not been started yet are started by parallel_for().
+    uint32_t nct = _in_cube->count_chunks_t();
+    uint32_t ncxy = _in_cube->count_chunks_x() * _in_cube->count_chunks_y();
+    uint32_t nthreads = uint32_t(thread_pool::instance()->default_size()) + 1;
+    uint32_t nseg = std::max(uint32_t(1), std::min(nct, nthreads / ncxy));
+
+    struct segment {
+        std::shared_ptr<chunk_data> out;
+        std::vector<reducer_singleband *> reducers;
+        bool initialized = false;  // lazy initialization after the first non-empty chunk
+    };
+    std::vector<segment> segments(nseg);
+
+    auto reduce_segment = [&](uint32_t iseg) {
+        segment &seg = segments[iseg];
+        seg.out = std::make_shared<chunk_data>();
+        seg.out->size(size_btyx);
+        seg.reducers = create_reducers();
+        auto combine = [&](std::shared_ptr<chunk_data> x, chunkid_t i, uint32_t it0) {
+            if (!seg.initialized) {
                 // Fill buffers with NAN
-                out->buf(std::calloc(size_btyx[0] * size_btyx[1] * size_btyx[2] * size_btyx[3], sizeof(double)));
-                double *begin = (double *)out->buf();
-                double *end = ((double *)out->buf()) + size_btyx[0] * size_btyx[1] * size_btyx[2] * size_btyx[3];
+                seg.out->buf(std::calloc(size_btyx[0] * size_btyx[1] * size_btyx[2] * size_btyx[3], sizeof(double)));
+                double *begin = (double *)seg.out->buf();
+                double *end = ((double *)seg.out->buf()) + size_btyx[0] * size_btyx[1] * size_btyx[2] * size_btyx[3];
                 std::fill(begin, end, NAN);
                 for (uint16_t ib = 0; ib < _reducer_bands.size(); ++ib) {
                     uint16_t band_idx_in = _in_cube->bands().get_index(_reducer_bands[ib].second);
-                    reducers[ib]->init(out, band_idx_in, ib, _in_cube);
+                    seg.reducers[ib]->init(seg.out, band_idx_in, ib, _in_cube);
                 }
-                initialized = true;
+                seg.initialized = true;
             }
             for (uint16_t ib = 0; ib < _reducer_bands.size(); ++ib) {
-                reducers[ib]->combine(out, x, i);
+                seg.reducers[ib]->combine_slices(seg.out, x, i, it0);
+            }
+        };
+
+        // If the input cube reads images directly, time slices are passed to the reducers as soon as they
+        // have been read and the (possibly large) input chunks are never allocated
+        std::shared_ptr<image_collection_cube> icc = std::dynamic_pointer_cast<image_collection_cube>(_in_cube);
+        uint32_t ict_begin = uint64_t(iseg) * nct / nseg;
+        uint32_t ict_end = uint64_t(iseg + 1) * nct / nseg;
+        for (uint32_t ict = ict_begin; ict < ict_end; ++ict) {
+            chunkid_t i = id + ict * ncxy;
+            if (icc) {
+                icc->read_chunk_slices(i, [&](uint32_t it, std::shared_ptr<chunk_data> x) {
+                    combine(x, i, it);
+                });
+            } else {
+                std::shared_ptr<chunk_data> x = _in_cube->read_chunk(i);
+                if (!x->empty()) {
+                    combine(x, i, 0);
+                }
             }
-            empty = false;
         }
-    }
-    if (empty) {
-       out =  std::make_shared<chunk_data>();
-    }
-    else {
-        for (uint16_t i = 0; i < _reducer_bands.size(); ++i) {
-            reducers[i]->finalize(out);
+    };
+
+    try {
+        if (nseg == 1) {
+            reduce_segment(0);
+        } else {
+            thread_pool::instance()->parallel_for(nseg, reduce_segment);
+        }
+
+        // merge segments in temporal order into the first non-empty segment
+        segment *first = nullptr;
+        for (uint32_t iseg = 0; iseg < nseg; ++iseg) {
+            if (!segments[iseg].initialized) continue;
+            if (!first) {
+                first = &segments[iseg];
+                continue;
+            }
+            for (uint16_t ib = 0; ib < _reducer_bands.size(); ++ib) {
+                first->reducers[ib]->merge(first->out, segments[iseg].reducers[ib], segments[iseg].out);
+            }
+        }
+        if (first) {
+            out = first->out;
+            for (uint16_t i = 0; i < _reducer_bands.size(); ++i) {
+                first->reducers[i]->finalize(out);
+            }
         }
+    } catch (...) {
+        for (uint32_t iseg = 0; iseg < nseg; ++iseg) {
+            for (uint16_t i = 0; i < segments[iseg].reducers.size(); ++i) {
+                delete segments[iseg].reducers[i];
+            }
+        }
+        throw;
     }
-    for (uint16_t i = 0; i < reducers.size(); ++i) {
-        if (reducers[i]) delete reducers[i];
+    for (uint32_t iseg = 0; iseg < nseg; ++iseg) {
+        for (uint16_t i = 0; i < segments[iseg].reducers.size(); ++i) {
+            delete segments[iseg].reducers[i];
+        }
     }
     return out;
 }
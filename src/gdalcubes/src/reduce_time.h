@@ -86,7 +86,16 @@ class reduce_time_cube : public cube {
                   reducerstr == "which_min" ||
                   reducerstr == "which_max" ||
                   reducerstr == "Q1" ||
-                  reducerstr == "Q3"))
+                  reducerstr == "Q3" ||
+                  reducerstr == "lm_slope" ||
+                  reducerstr == "lm_intercept" ||
+                  reducerstr == "harmonic_cos" ||
+                  reducerstr == "harmonic_sin" ||
+                  reducerstr == "harmonic_amplitude" ||
+                  reducerstr == "harmonic_phase" ||
+                  reducerstr == "theil_sen" ||
+                  reducerstr == "mk_tau" ||
+                  reducerstr == "mk_p"))
                 throw std::string("ERROR in reduce_time_cube::reduce_time_cube(): Unknown reducer '" + reducerstr + "'");
 
             if (!(in->bands().has(bandstr))) {
@@ -0,0 +1,475 @@
+/*
+    MIT License
+
+    Copyright (c) 2023 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#include "remote_cache.h"
+
+#include <cpl_vsi.h>
+#include <gdal.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <sys/utime.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#include <utime.h>
+#endif
+
+#include "config.h"
+#include "error.h"
+#include "filesystem.h"
+#include "utils.h"
+
+namespace gdalcubes {
+
+static const char *VSI_CACHE_PREFIX = "/vsigccache/";
+
+std::size_t remote_block_cache::remote_prefix_pos(const std::string &descriptor) {
+    if (descriptor.find(VSI_CACHE_PREFIX) != std::string::npos) {
+        return std::string::npos;  // already wrapped
+    }
+    std::size_t out = std::string::npos;
+    for (std::string prefix : {"/vsicurl/", "/vsis3/", "/vsigs/", "/vsiaz/", "/vsiadls/", "/vsioss/", "/vsiswift/", "/vsiwebhdfs/"}) {
+        std::size_t pos = descriptor.find(prefix);
+        while (pos != std::string::npos) {
+            // remote file may be at the beginning or chained, e.g. /vsizip//vsicurl/... or /vsizip/{/vsicurl/...}
+            if (pos == 0 || descriptor[pos - 1] == '/' || descriptor[pos - 1] == '{') {
+                out = std::min(out, pos);
+                break;
+            }
+            pos = descriptor.find(prefix, pos + 1);
+        }
+    }
+    return out;
+}
+
+std::string remote_block_cache::wrap(std::string descriptor) {
+    if (config::instance()->get_remote_cache_dir().empty() || config::instance()->get_remote_cache_max() == 0) {
+        return descriptor;
+    }
+    std::size_t pos = remote_prefix_pos(descriptor);
+    if (pos == std::string::npos) {
+        return descriptor;
+    }
+    std::call_once(_install_once, &remote_block_cache::install, this);
+    if (!_installed) {
+        return descriptor;
+    }
+    return descriptor.substr(0, pos) + VSI_CACHE_PREFIX + descriptor.substr(pos + 1);
+}
+
+remote_block_cache::cache_stats remote_block_cache::stats() {
+    cache_stats s;
+    s.hits = _hits;
+    s.misses = _misses;
+    s.bytes_hit = _bytes_hit;
+    s.bytes_fetched = _bytes_fetched;
+    return s;
+}
+
+void remote_block_cache::reset_stats() {
+    _hits = 0;
+    _misses = 0;
+    _bytes_hit = 0;
+    _bytes_fetched = 0;
+}
+
+bool remote_block_cache::read_cached(const std::string &key, uint64_t index, uint32_t len, std::vector<char> &out) {
+    out.resize(len);
+    std::string block_file = filesystem::join(filesystem::join(config::instance()->get_remote_cache_dir(), key), std::to_string(index) + ".blk");
+    std::ifstream is(block_file, std::ios::in | std::ios::binary);
+    if (!is || !is.read(out.data(), len) || is.gcount() != (std::streamsize)len) {
+        return false;
+    }
+    // update the modification time, which is used to evict least recently used blocks
+#ifdef _WIN32
+    _utime(block_file.c_str(), NULL);
+#else
+    utime(block_file.c_str(), NULL);
+#endif
+    ++_hits;
+    _bytes_hit += len;
+    return true;
+}
+
+void remote_block_cache::store(const std::string &key, uint64_t index, const char *data, uint32_t len) {
+    ++_misses;
+    _bytes_fetched += len;
+
+    std::string block_dir = filesystem::join(config::instance()->get_remote_cache_dir(), key);
+    std::string block_file = filesystem::join(block_dir, std::to_string(index) + ".blk");
+    if (!filesystem::is_directory(block_dir)) {
+        filesystem::mkdir_recursive(block_dir);
+    }
+    // write to a temporary file first such that concurrent readers never see incomplete blocks
+    std::string tmp = block_file + utils::generate_unique_filename(8, ".", ".tmp");
+    {
+        std::ofstream os(tmp, std::ios::out | std::ios::binary);
+        if (!os || !os.write(data, len)) {
+            GCBS_DEBUG("Cannot write remote block to '" + tmp + "'");
+            os.close();
+            std::remove(tmp.c_str());
+            return;
+        }
+    }
+    if (std::rename(tmp.c_str(), block_file.c_str()) != 0) {
+        std::remove(tmp.c_str());
+    }
+
+    uint64_t max_bytes = config::instance()->get_remote_cache_max();
+    if ((_bytes_since_evict += len) > max_bytes / 16) {
+        _bytes_since_evict = 0;
+        evict(max_bytes);
+    }
+}
+
+bool remote_block_cache::get_block(const std::string &key, uint64_t index, uint32_t len, std::vector<char> &out,
+                                   std::function<bool(std::vector<char> &)> fetch) {
+    if (read_cached(key, index, len, out)) {
+        return true;
+    }
+    out.resize(len);
+    if (!fetch(out)) {
+        return false;
+    }
+    store(key, index, out.data(), len);
+    return true;
+}
+
+uint32_t remote_block_cache::get_blocks(const std::string &key, uint64_t first, uint32_t count, uint64_t file_size,
+                                        std::vector<std::vector<char>> &out, std::function<bool(uint64_t, std::vector<char> &)> fetch) {
+    out.resize(count);
+    std::vector<bool> cached(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        uint64_t start = (first + i) * BLOCK_SIZE;
+        uint32_t len = (start >= file_size) ? 0 : (uint32_t)std::min((uint64_t)BLOCK_SIZE, file_size - start);
+        cached[i] = read_cached(key, first + i, len, out[i]);
+    }
+
+    // fetch runs of consecutive missing blocks at once
+    std::vector<char> buf;
+    uint32_t i = 0;
+    while (i < count) {
+        if (cached[i]) {
+            ++i;
+            continue;
+        }
+        uint32_t j = i + 1;
+        while (j < count && !cached[j]) ++j;
+        uint64_t bytes = 0;
+        for (uint32_t k = i; k < j; ++k) bytes += out[k].size();
+        buf.resize(bytes);
+        if (!fetch(first + i, buf)) {
+            return i;
+        }
+        const char *p = buf.data();
+        for (uint32_t k = i; k < j; ++k) {
+            std::memcpy(out[k].data(), p, out[k].size());
+            store(key, first + k, p, (uint32_t)out[k].size());
+            p += out[k].size();
+        }
+        i = j;
+    }
+    return count;
+}
+
+/**
+ * Exclusive, nonblocking lock on a file, released on destruction.
+ * Locks are held per open file (handle), such that they also exclude other threads of the same process.
+ */
+class remote_cache_lock {
+   public:
+    remote_cache_lock(std::string file) : _locked(false) {
+#ifdef _WIN32
+        _h = CreateFileA(file.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (_h != INVALID_HANDLE_VALUE) {
+            std::memset(&_ov, 0, sizeof(_ov));
+            _locked = LockFileEx(_h, LOCKFILE_EXCLUSIVE_LOCK | LOCKFILE_FAIL_IMMEDIATELY, 0, 1, 0, &_ov) != 0;
+        }
+#else
+        _fd = open(file.c_str(), O_RDWR | O_CREAT, 0666);
+        if (_fd >= 0) {
+            _locked = flock(_fd, LOCK_EX | LOCK_NB) == 0;
+        }
+#endif
+    }
+    ~remote_cache_lock() {
+#ifdef _WIN32
+        if (_h != INVALID_HANDLE_VALUE) {
+            if (_locked) UnlockFileEx(_h, 0, 1, 0, &_ov);
+            CloseHandle(_h);
+        }
+#else
+        if (_fd >= 0) {
+            if (_locked) flock(_fd, LOCK_UN);
+            close(_fd);
+        }
+#endif
+    }
+    remote_cache_lock(const remote_cache_lock &) = delete;
+    remote_cache_lock &operator=(const remote_cache_lock &) = delete;
+
+    inline bool locked() { return _locked; }
+
+   private:
+    bool _locked;
+#ifdef _WIN32
+    HANDLE _h;
+    OVERLAPPED _ov;
+#else
+    int _fd;
+#endif
+};
+
+void remote_block_cache::evict(uint64_t max_bytes) {
+    std::string dir = config::instance()->get_remote_cache_dir();
+    if (dir.empty() || !filesystem::is_directory(dir)) {
+        return;
+    }
+    remote_cache_lock lock(filesystem::join(dir, ".lock"));
+    if (!lock.locked()) {
+        return;  // another process or thread is evicting blocks
+    }
+
+    struct block_file {
+        std::string path;
+        int64_t mtime;
+        uint64_t size;
+    };
+    std::vector<block_file> blocks;
+    uint64_t total = 0;
+    int64_t now = (int64_t)std::time(nullptr);
+    filesystem::iterate_directory_recursive(dir, [&blocks, &total, now](const std::string &p) {
+        VSIStatBufL stat;
+        if (VSIStatL(p.c_str(), &stat) != 0 || VSI_ISDIR(stat.st_mode)) {
+            return;
+        }
+        if (filesystem::extension(p) == "tmp") {
+            // leftovers of processes that died while writing a block
+            if (now - (int64_t)stat.st_mtime > 3600) {
+                filesystem::remove(p);
+            }
+            return;
+        }
+        if (filesystem::extension(p) != "blk") {
+            return;
+        }
+        block_file b;
+        b.path = p;
+        b.mtime = (int64_t)stat.st_mtime;
+        b.size = (uint64_t)stat.st_size;
+        total += b.size;
+        blocks.push_back(b);
+    });
+    if (total <= max_bytes) {
+        return;
+    }
+
+    // remove least recently used blocks until 90% of the maximum size is reached to avoid evicting after each write
+    std::sort(blocks.begin(), blocks.end(), [](const block_file &a, const block_file &b) { return a.mtime < b.mtime; });
+    uint64_t target = max_bytes - max_bytes / 10;
+    uint32_t nremoved = 0;
+    for (uint32_t i = 0; i < blocks.size() && total > target; ++i) {
+        if (VSIUnlink(blocks[i].path.c_str()) == 0) {
+            total -= blocks[i].size;
+            ++nremoved;
+        }
+    }
+    GCBS_DEBUG("Removed " + std::to_string(nremoved) + " least recently used block(s) from remote cache '" + dir + "', " +
+               std::to_string(total / (1024 * 1024)) + " MiB remaining");
+}
+
+#if GDAL_VERSION_MAJOR >= 3
+
+/*
+ * GDAL virtual file system handler for /vsigccache/, reads the underlying remote file
+ * (e.g. /vsigccache/vsicurl/https://... -> /vsicurl/https://...) block by block through the cache.
+ * Handles are read-only and, as all GDAL file handles, used by one thread at a time.
+ */
+struct remote_cache_handle {
+    std::string path;
+    std::string key;
+    vsi_l_offset size;
+    vsi_l_offset pos;
+    bool eof;
+    VSILFILE *remote;    // opened lazily, on the first cache miss
+    int64_t block_index;  // index of the block in block, or -1
+    std::vector<char> block;
+};
+
+static std::string remote_cache_underlying_path(const char *filename) {
+    std::string f(filename);
+    if (f.compare(0, std::strlen(VSI_CACHE_PREFIX), VSI_CACHE_PREFIX) == 0) {
+        f = f.substr(std::strlen(VSI_CACHE_PREFIX));
+    }
+    return (!f.empty() && f[0] == '/') ? f : "/" + f;
+}
+
+static int remote_cache_stat(void *, const char *filename, VSIStatBufL *stat, int flags) {
+    return VSIStatExL(remote_cache_underlying_path(filename).c_str(), stat, flags);
+}
+
+static char **remote_cache_read_dir(void *, const char *dirname, int max_files) {
+    return VSIReadDirEx(remote_cache_underlying_path(dirname).c_str(), max_files);
+}
+
+static void *remote_cache_open(void *, const char *filename, const char *access) {
+    std::string a(access);
+    if (a.find_first_of("wa+") != std::string::npos) {
+        return nullptr;
+    }
+    std::string path = remote_cache_underlying_path(filename);
+    VSIStatBufL stat;
+    if (VSIStatExL(path.c_str(), &stat, VSI_STAT_EXISTS_FLAG | VSI_STAT_SIZE_FLAG) != 0 || VSI_ISDIR(stat.st_mode)) {
+        return nullptr;
+    }
+    remote_cache_handle *h = new remote_cache_handle();
+    h->path = path;
+    h->size = (vsi_l_offset)stat.st_size;
+    h->key = utils::hash(path + "\n" + std::to_string((int64_t)stat.st_size) + "\n" + std::to_string((int64_t)stat.st_mtime));
+    h->pos = 0;
+    h->eof = false;
+    h->remote = nullptr;
+    h->block_index = -1;
+    return h;
+}
+
+static vsi_l_offset remote_cache_tell(void *file) {
+    return ((remote_cache_handle *)file)->pos;
+}
+
+static int remote_cache_seek(void *file, vsi_l_offset offset, int whence) {
+    remote_cache_handle *h = (remote_cache_handle *)file;
+    if (whence == SEEK_SET) {
+        h->pos = offset;
+    } else if (whence == SEEK_CUR) {
+        h->pos += offset;
+    } else if (whence == SEEK_END) {
+        h->pos = h->size + offset;
+    } else {
+        return -1;
+    }
+    h->eof = false;
+    return 0;
+}
+
+static size_t remote_cache_read(void *file, void *buffer, size_t size, size_t count) {
+    remote_cache_handle *h = (remote_cache_handle *)file;
+    if (size == 0 || count == 0) {
+        return 0;
+    }
+    vsi_l_offset requested = (vsi_l_offset)size * count;
+    vsi_l_offset n = (h->pos >= h->size) ? 0 : std::min(requested, h->size - h->pos);
+    vsi_l_offset done = 0;
+    while (done < n) {
+        uint64_t index = (h->pos + done) / remote_block_cache::BLOCK_SIZE;
+        if ((int64_t)index != h->block_index) {
+            // all remaining blocks of the request are read together, such that consecutive missing blocks are fetched with one read
+            uint64_t last = (h->pos + n - 1) / remote_block_cache::BLOCK_SIZE;
+            std::vector<std::vector<char>> blocks;
+            h->block_index = -1;
+            uint32_t nblocks = remote_block_cache::instance()->get_blocks(h->key, index, (uint32_t)(last - index + 1), h->size, blocks, [h](uint64_t first, std::vector<char> &out) {
+                if (!h->remote) {
+                    h->remote = VSIFOpenL(h->path.c_str(), "rb");
+                    if (!h->remote) return false;
+                }
+                return VSIFSeekL(h->remote, first * remote_block_cache::BLOCK_SIZE, SEEK_SET) == 0 && VSIFReadL(out.data(), 1, out.size(), h->remote) == out.size();
+            });
+            if (nblocks == 0) {
+                break;
+            }
+            // copy all but the last available block, which is kept for subsequent reads
+            for (uint32_t k = 0; k + 1 < nblocks; ++k) {
+                vsi_l_offset offset = (h->pos + done) - (vsi_l_offset)(index + k) * remote_block_cache::BLOCK_SIZE;
+                vsi_l_offset m = std::min(n - done, (vsi_l_offset)blocks[k].size() - offset);
+                std::memcpy((char *)buffer + done, blocks[k].data() + offset, (size_t)m);
+                done += m;
+            }
+            index += nblocks - 1;
+            h->block.swap(blocks[nblocks - 1]);
+            h->block_index = (int64_t)index;
+        }
+        vsi_l_offset offset = (h->pos + done) - (vsi_l_offset)index * remote_block_cache::BLOCK_SIZE;
+        vsi_l_offset m = std::min(n - done, (vsi_l_offset)h->block.size() - offset);
+        std::memcpy((char *)buffer + done, h->block.data() + offset, (size_t)m);
+        done += m;
+    }
+    h->pos += done;
+    if (done < requested) {
+        h->eof = true;
+    }
+    return (size_t)(done / size);
+}
+
+static int remote_cache_eof(void *file) {
+    return ((remote_cache_handle *)file)->eof ? 1 : 0;
+}
+
+static int remote_cache_close(void *file) {
+    remote_cache_handle *h = (remote_cache_handle *)file;
+    if (h->remote) {
+        VSIFCloseL(h->remote);
+    }
+    delete h;
+    return 0;
+}
+
+void remote_block_cache::install() {
+    VSIFilesystemPluginCallbacksStruct *cb = VSIAllocFilesystemPluginCallbacksStruct();
+    cb->stat = remote_cache_stat;
+    cb->read_dir = remote_cache_read_dir;
+    cb->open = remote_cache_open;
+    cb->tell = remote_cache_tell;
+    cb->seek = remote_cache_seek;
+    cb->read = remote_cache_read;
+    cb->eof = remote_cache_eof;
+    cb->close = remote_cache_close;
+    _installed = VSIInstallPluginHandler(VSI_CACHE_PREFIX, cb) == 0;
+    VSIFreeFilesystemPluginCallbacksStruct(cb);
+    if (!_installed) {
+        GCBS_WARN("Failed to install GDAL virtual file system handler for the remote block cache, remote files will be read directly");
+    }
+}
+
+#else
+
+void remote_block_cache::install() {
+    GCBS_WARN("The remote block cache requires GDAL >= 3.0, remote files will be read directly");
+    _installed = false;
+}
+
+#endif
+
+}  // namespace gdalcubes
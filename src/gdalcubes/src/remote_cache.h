@@ -0,0 +1,153 @@
+/*
+    MIT License
+
+    Copyright (c) 2023 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#ifndef REMOTE_CACHE_H
+#define REMOTE_CACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace gdalcubes {
+
+/**
+ * @brief Persistent local cache of blocks of remote source files
+ *
+ * GDAL's own cache of /vsicurl/ (and /vsis3/, /vsigs/, ...) byte ranges lives in memory of a single
+ * process, such that repeated analyses and every worker process fetch the same ranges again.
+ * If config::get_remote_cache_dir() is not empty, remote descriptors are wrapped by a GDAL virtual
+ * file system handler (prefix /vsigccache/) that reads remote files in blocks of fixed size and stores
+ * each block as a file in the cache directory. Blocks are keyed by the file descriptor, its size, and
+ * modification time as well as the block's byte range, i.e. changed remote files are never served from stale blocks.
+ *
+ * The cache is shared by all processes using the same directory. Blocks are written atomically,
+ * reading a block updates its modification time, and if the total size exceeds config::get_remote_cache_max(),
+ * least recently used blocks are removed by the process holding an exclusive lock on the directory.
+ *
+ * @note Requires GDAL >= 3.0, descriptors are not wrapped with older versions.
+ */
+class remote_block_cache {
+   public:
+    static remote_block_cache *instance() {
+        static remote_block_cache instance;
+        return &instance;
+    }
+
+    /**
+     * @brief Size of cached blocks in bytes
+     */
+    static const uint32_t BLOCK_SIZE = 256 * 1024;
+
+    /**
+     * @brief Wrap a GDAL dataset descriptor such that reads from remote files go through the cache
+     * @param descriptor GDAL dataset descriptor, e.g. /vsicurl/https://example.com/a.tif or /vsizip//vsis3/bucket/x.zip/a.tif
+     * @return descriptor with the remote part prefixed by /vsigccache/, or the unchanged descriptor if the cache is disabled or
+     * the descriptor does not refer to a remote file
+     */
+    std::string wrap(std::string descriptor);
+
+    /**
+     * @brief Check whether a descriptor refers to a remote file
+     * @param descriptor GDAL dataset descriptor
+     * @return position of the remote virtual file system prefix in the descriptor or std::string::npos
+     */
+    static std::size_t remote_prefix_pos(const std::string &descriptor);
+
+    struct cache_stats {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t bytes_hit;
+        uint64_t bytes_fetched;
+    };
+
+    /**
+     * @brief Get block hit / miss counters of the current process
+     */
+    cache_stats stats();
+
+    /**
+     * @brief Reset block hit / miss counters of the current process
+     */
+    void reset_stats();
+
+    /**
+     * @brief Remove least recently used blocks until the cache is smaller than the given size
+     * @param max_bytes target size in bytes
+     * @note Does nothing if another process is currently evicting blocks from the same directory
+     */
+    void evict(uint64_t max_bytes);
+
+    /**
+     * @brief Get a block of a remote file, either from the cache or from the remote file
+     * @param key identifier of the remote file version (descriptor, size, modification time)
+     * @param fetch function reading the block from the remote file to the given buffer, returns false on errors
+     * @param index block index
+     * @param len expected length of the block, smaller than BLOCK_SIZE only for the last block of a file
+     * @param out output buffer
+     * @return true if out contains the block
+     */
+    bool get_block(const std::string &key, uint64_t index, uint32_t len, std::vector<char> &out,
+                   std::function<bool(std::vector<char> &)> fetch);
+
+    /**
+     * @brief Get consecutive blocks of a remote file, consecutive missing blocks are fetched with a single read
+     * @param key identifier of the remote file version (descriptor, size, modification time)
+     * @param first index of the first block
+     * @param count number of blocks
+     * @param file_size size of the remote file in bytes, defines the length of the last block
+     * @param out output buffers, one per block
+     * @param fetch function reading blocks from the remote file, starting at the block with the given index, to the given buffer,
+     * whose size is a multiple of BLOCK_SIZE unless it contains the last block of the file; returns false on errors
+     * @return number of leading blocks available in out, smaller than count only if fetching failed
+     */
+    uint32_t get_blocks(const std::string &key, uint64_t first, uint32_t count, uint64_t file_size, std::vector<std::vector<char>> &out,
+                        std::function<bool(uint64_t, std::vector<char> &)> fetch);
+
+   private:
+    remote_block_cache(const remote_block_cache &) = delete;
+    remote_block_cache(remote_block_cache &&) = delete;
+    remote_block_cache &operator=(const remote_block_cache &) = delete;
+    remote_block_cache &operator=(remote_block_cache &&) = delete;
+    remote_block_cache() : _installed(false), _install_once(), _hits(0), _misses(0), _bytes_hit(0), _bytes_fetched(0), _bytes_since_evict(0) {}
+
+    void install();
+    bool read_cached(const std::string &key, uint64_t index, uint32_t len, std::vector<char> &out);
+    void store(const std::string &key, uint64_t index, const char *data, uint32_t len);
+
+    bool _installed;
+    std::once_flag _install_once;
+    std::atomic<uint64_t> _hits;
+    std::atomic<uint64_t> _misses;
+    std::atomic<uint64_t> _bytes_hit;
+    std::atomic<uint64_t> _bytes_fetched;
+    std::atomic<uint64_t> _bytes_since_evict;
+};
+
+}  // namespace gdalcubes
+
+#endif  //REMOTE_CACHE_H
@@ -0,0 +1,240 @@
+/*
+    MIT License
+
+    Copyright (c) 2023 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#include "resample.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace gdalcubes {
+
+// GDAL's warp kernels only use the 4-sample bilinear formula if the target resolution is not
+// considerably coarser than the source resolution, otherwise the kernel is widened
+static const double BILINEAR_MIN_SCALE = 0.95;
+
+std::shared_ptr<gather_map> gather_map::create(pixel_transform f, uint32_t src_nx, uint32_t src_ny, uint32_t ts_x, uint32_t ts_y, method m) {
+    std::shared_ptr<gather_map> out(new gather_map());
+    out->_method = m;
+    out->_ts_x = ts_x;
+    out->_ts_y = ts_y;
+
+    // transform target pixel centers to source pixel coordinates
+    uint64_t n = uint64_t(ts_x) * uint64_t(ts_y);
+    std::vector<double> sx(n);
+    std::vector<double> sy(n);
+    std::vector<int> success(n, 1);
+    for (uint32_t iy = 0; iy < ts_y; ++iy) {
+        for (uint32_t ix = 0; ix < ts_x; ++ix) {
+            sx[uint64_t(iy) * ts_x + ix] = ix + 0.5;
+            sy[uint64_t(iy) * ts_x + ix] = iy + 0.5;
+        }
+    }
+    if (n > 0) {
+        f(uint32_t(n), sx.data(), sy.data(), success.data());
+    }
+
+    // a target pixel is computed if its center falls within the source image
+    std::vector<bool> valid(n, false);
+    for (uint64_t i = 0; i < n; ++i) {
+        if (!success[i] || !std::isfinite(sx[i]) || !std::isfinite(sy[i])) continue;
+        if (sx[i] < 0 || sy[i] < 0) continue;
+        if (sx[i] + 1.0e-10 >= double(src_nx) || sy[i] + 1.0e-10 >= double(src_ny)) continue;
+        valid[i] = true;
+    }
+
+    if (m == method::BILINEAR) {
+        // estimate the average distance of neighboring target pixels in source pixels
+        double dx_sum = 0, dy_sum = 0;
+        uint64_t dx_n = 0, dy_n = 0;
+        for (uint32_t iy = 0; iy < ts_y; ++iy) {
+            for (uint32_t ix = 0; ix < ts_x; ++ix) {
+                uint64_t i = uint64_t(iy) * ts_x + ix;
+                if (!valid[i]) continue;
+                if (ix + 1 < ts_x && valid[i + 1]) {
+                    dx_sum += std::hypot(sx[i + 1] - sx[i], sy[i + 1] - sy[i]);
+                    ++dx_n;
+                }
+                if (iy + 1 < ts_y && valid[i + ts_x]) {
+                    dy_sum += std::hypot(sx[i + ts_x] - sx[i], sy[i + ts_x] - sy[i]);
+                    ++dy_n;
+                }
+            }
+        }
+        if ((dx_n > 0 && dx_sum / double(dx_n) > 1.0 / BILINEAR_MIN_SCALE) ||
+            (dy_n > 0 && dy_sum / double(dy_n) > 1.0 / BILINEAR_MIN_SCALE)) {
+            return nullptr;
+        }
+    }
+
+    // derive the source window
+    int64_t xmin = src_nx, xmax = -1, ymin = src_ny, ymax = -1;
+    for (uint64_t i = 0; i < n; ++i) {
+        if (!valid[i]) continue;
+        int64_t x0, x1, y0, y1;
+        if (m == method::BILINEAR) {
+            x0 = std::max(int64_t(std::floor(sx[i] - 0.5)), int64_t(0));
+            y0 = std::max(int64_t(std::floor(sy[i] - 0.5)), int64_t(0));
+            x1 = std::min(int64_t(std::floor(sx[i] - 0.5)) + 1, int64_t(src_nx) - 1);
+            y1 = std::min(int64_t(std::floor(sy[i] - 0.5)) + 1, int64_t(src_ny) - 1);
+        } else {
+            x0 = x1 = int64_t(sx[i] + 1.0e-10);
+            y0 = y1 = int64_t(sy[i] + 1.0e-10);
+        }
+        xmin = std::min(xmin, x0);
+        xmax = std::max(xmax, x1);
+        ymin = std::min(ymin, y0);
+        ymax = std::max(ymax, y1);
+    }
+    if (xmax < xmin || ymax < ymin) {
+        return out;  // empty
+    }
+    out->_win_xoff = uint32_t(xmin);
+    out->_win_yoff = uint32_t(ymin);
+    out->_win_nx = uint32_t(xmax - xmin + 1);
+    out->_win_ny = uint32_t(ymax - ymin + 1);
+
+    int64_t w = out->_win_nx;
+    out->_idx.resize(n, -1);
+    if (m == method::BILINEAR) {
+        out->_wx.resize(n, 0);
+        out->_wy.resize(n, 0);
+        out->_corners.resize(n, 0);
+        for (uint64_t i = 0; i < n; ++i) {
+            if (!valid[i]) continue;
+            int64_t x0 = int64_t(std::floor(sx[i] - 0.5));
+            int64_t y0 = int64_t(std::floor(sy[i] - 0.5));
+            bool left = x0 >= 0, right = x0 + 1 < int64_t(src_nx);
+            bool top = y0 >= 0, bottom = y0 + 1 < int64_t(src_ny);
+            out->_corners[i] = uint8_t((top && left ? 1 : 0) | (top && right ? 2 : 0) | (bottom && left ? 4 : 0) | (bottom && right ? 8 : 0));
+            out->_idx[i] = int32_t((y0 - ymin) * w + (x0 - xmin));
+            out->_wx[i] = float(sx[i] - 0.5 - double(x0));
+            out->_wy[i] = float(sy[i] - 0.5 - double(y0));
+        }
+    } else {
+        for (uint64_t i = 0; i < n; ++i) {
+            if (!valid[i]) continue;
+            int64_t x = int64_t(sx[i] + 1.0e-10);
+            int64_t y = int64_t(sy[i] + 1.0e-10);
+            out->_idx[i] = int32_t((y - ymin) * w + (x - xmin));
+        }
+    }
+    return out;
+}
+
+void gather_map::apply(const double *src, double *dst) const {
+    uint64_t n = uint64_t(_ts_x) * uint64_t(_ts_y);
+    if (empty()) {
+        std::fill(dst, dst + n, NAN);
+        return;
+    }
+    if (_method == method::NEAR) {
+        for (uint64_t i = 0; i < n; ++i) {
+            int32_t k = _idx[i];
+            dst[i] = (k < 0) ? NAN : src[k];
+        }
+        return;
+    }
+
+    // bilinear
+    const int64_t offset[4] = {0, 1, int64_t(_win_nx), int64_t(_win_nx) + 1};
+    for (uint64_t i = 0; i < n; ++i) {
+        uint8_t corners = _corners[i];
+        if (corners == 0) {
+            dst[i] = NAN;
+            continue;
+        }
+        double wx = _wx[i];
+        double wy = _wy[i];
+        const double weight[4] = {(1 - wx) * (1 - wy), wx * (1 - wy), (1 - wx) * wy, wx * wy};
+        double sum = 0, div = 0;
+        for (uint8_t c = 0; c < 4; ++c) {
+            if (!(corners & (1 << c))) continue;
+            double v = src[_idx[i] + offset[c]];
+            if (std::isnan(v)) continue;
+            sum += weight[c] * v;
+            div += weight[c];
+        }
+        dst[i] = (div < 0.00001) ? NAN : sum / div;
+    }
+}
+
+uint64_t gather_map::size_bytes() const {
+    return sizeof(gather_map) + _idx.size() * sizeof(int32_t) + _wx.size() * sizeof(float) + _wy.size() * sizeof(float) + _corners.size() * sizeof(uint8_t);
+}
+
+uint64_t gather_map_cache::entry_bytes(const entry &e) {
+    return e.first.size() + (e.second ? e.second->size_bytes() : 0);
+}
+
+bool gather_map_cache::get(const std::string &key, std::shared_ptr<gather_map> &map) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _index.find(key);
+    if (it == _index.end()) {
+        return false;
+    }
+    _lru.splice(_lru.begin(), _lru, it->second);
+    map = it->second->second;
+    return true;
+}
+
+void gather_map_cache::put(const std::string &key, std::shared_ptr<gather_map> map) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    entry e(key, map);
+    if (entry_bytes(e) > _max_bytes) {
+        return;
+    }
+    auto it = _index.find(key);
+    if (it != _index.end()) {
+        // another thread computed the same map concurrently
+        _bytes -= entry_bytes(*(it->second));
+        _lru.erase(it->second);
+        _index.erase(it);
+    }
+    _lru.push_front(e);
+    _index[key] = _lru.begin();
+    _bytes += entry_bytes(e);
+    shrink(_max_bytes);
+}
+
+void gather_map_cache::clear() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    shrink(0);
+}
+
+void gather_map_cache::set_max_bytes(uint64_t bytes) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _max_bytes = bytes;
+    shrink(_max_bytes);
+}
+
+void gather_map_cache::shrink(uint64_t bytes) {
+    while (!_lru.empty() && _bytes > bytes) {
+        _bytes -= entry_bytes(_lru.back());
+        _index.erase(_lru.back().first);
+        _lru.pop_back();
+    }
+}
+
+}  // namespace gdalcubes
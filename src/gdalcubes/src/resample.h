@@ -0,0 +1,180 @@
+/*
+    MIT License
+
+    Copyright (c) 2023 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#ifndef RESAMPLE_H
+#define RESAMPLE_H
+
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace gdalcubes {
+
+/**
+ * @brief Precomputed mapping from pixels of a target grid to pixels of a source image for nearest neighbor and bilinear resampling
+ *
+ * The mapping only depends on the source grid, the target grid, and the pair of spatial reference systems but not
+ * on pixel values. It is typically shared by many images (e.g. all images of the same tile at different dates) and
+ * applied to all of their bands with simple gather (nearest neighbor) or blend (bilinear) loops over a source window.
+ *
+ * Results follow GDAL's warp kernels, i.e., target pixel centers are transformed to the source grid, target pixels whose
+ * center falls outside of the source image are NAN, and bilinear interpolation ignores neighbors that are NAN
+ * by renormalizing the weights of the remaining neighbors.
+ */
+class gather_map {
+   public:
+    enum class method {
+        NEAR,
+        BILINEAR
+    };
+
+    /**
+     * Transformation of n target pixel coordinates to source pixel coordinates (in place), success[i] must be set
+     * to 0 for points that cannot be transformed
+     */
+    typedef std::function<void(uint32_t n, double *x, double *y, int *success)> pixel_transform;
+
+    /**
+     * @brief Compute the gather map of a source image and a target grid
+     * @param f transformation from target pixel coordinates to source pixel coordinates
+     * @param src_nx number of columns of the source image
+     * @param src_ny number of rows of the source image
+     * @param ts_x number of columns of the target grid
+     * @param ts_y number of rows of the target grid
+     * @param m resampling method
+     * @return gather map or nullptr if the resampling cannot be expressed as a gather map (bilinear downsampling,
+     * where GDAL widens the interpolation kernel)
+     */
+    static std::shared_ptr<gather_map> create(pixel_transform f, uint32_t src_nx, uint32_t src_ny, uint32_t ts_x, uint32_t ts_y, method m);
+
+    /**
+     * @brief Resample one band
+     * @param src pixels of the source window (see win_xoff(), win_yoff(), win_nx(), win_ny()), no data values must be NAN
+     * @param dst output buffer with ts_y rows of ts_x pixels
+     */
+    void apply(const double *src, double *dst) const;
+
+    // window of the source image that is needed to compute all target pixels
+    inline uint32_t win_xoff() const { return _win_xoff; }
+    inline uint32_t win_yoff() const { return _win_yoff; }
+    inline uint32_t win_nx() const { return _win_nx; }
+    inline uint32_t win_ny() const { return _win_ny; }
+
+    /**
+     * @brief Check whether no target pixel intersects with the source image
+     */
+    inline bool empty() const { return _win_nx == 0 || _win_ny == 0; }
+
+    /**
+     * @brief Approximate memory consumption in bytes
+     */
+    uint64_t size_bytes() const;
+
+   private:
+    gather_map() : _method(method::NEAR), _ts_x(0), _ts_y(0), _win_xoff(0), _win_yoff(0), _win_nx(0), _win_ny(0), _idx(), _wx(), _wy(), _corners() {}
+
+    method _method;
+    uint32_t _ts_x;
+    uint32_t _ts_y;
+    uint32_t _win_xoff;
+    uint32_t _win_yoff;
+    uint32_t _win_nx;
+    uint32_t _win_ny;
+
+    // per target pixel: index of the (upper left) source pixel within the source window, -1 if there is no source pixel
+    std::vector<int32_t> _idx;
+
+    // bilinear only: interpolation weights and bitmask of upper left, upper right, lower left, lower right neighbors inside the window
+    std::vector<float> _wx;
+    std::vector<float> _wy;
+    std::vector<uint8_t> _corners;
+};
+
+/**
+ * @brief Least recently used cache of gather maps, limited by the total size of cached maps
+ */
+class gather_map_cache {
+   public:
+    static gather_map_cache *instance() {
+        static gather_map_cache instance;
+        return &instance;
+    }
+
+    /**
+     * @brief Lookup a gather map
+     * @param key key identifying source grid, target grid, and resampling method
+     * @param map cached gather map, which may be nullptr if resampling cannot be expressed as gather map
+     * @return true if the key has been found
+     */
+    bool get(const std::string &key, std::shared_ptr<gather_map> &map);
+
+    /**
+     * @brief Add a gather map and evict least recently used maps if needed
+     * @param key key identifying source grid, target grid, and resampling method
+     * @param map gather map, may be nullptr
+     */
+    void put(const std::string &key, std::shared_ptr<gather_map> map);
+
+    /**
+     * @brief Remove all cached gather maps
+     */
+    void clear();
+
+    /**
+     * @brief Set the maximum total size of cached gather maps, 0 disables caching
+     * @param bytes size in bytes
+     */
+    void set_max_bytes(uint64_t bytes);
+
+    inline uint64_t get_max_bytes() { return _max_bytes; }
+
+   private:
+    gather_map_cache(const gather_map_cache &) = delete;
+    gather_map_cache(gather_map_cache &&) = delete;
+    gather_map_cache &operator=(const gather_map_cache &) = delete;
+    gather_map_cache &operator=(gather_map_cache &&) = delete;
+    gather_map_cache() : _lru(), _index(), _bytes(0), _max_bytes(64 * 1024 * 1024), _mutex() {}
+
+    typedef std::pair<std::string, std::shared_ptr<gather_map>> entry;
+    static uint64_t entry_bytes(const entry &e);
+
+    void shrink(uint64_t bytes);
+
+    // most recently used first
+    std::list<entry> _lru;
+    std::unordered_map<std::string, std::list<entry>::iterator> _index;
+    uint64_t _bytes;
+    uint64_t _max_bytes;
+    std::mutex _mutex;
+};
+
+}  // namespace gdalcubes
+
+#endif  // RESAMPLE_H
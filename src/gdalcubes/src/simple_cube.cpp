@@ -25,10 +25,24 @@
 
 #include <set>
 
+#include "dataset_pool.h"
 #include "datetime.h"
 
 namespace gdalcubes {
 
+/**
+ * Find a multiple of a source block size that is close to a given default chunk size, blocks
+ * much larger than the default (e.g. strips covering complete rows) are ignored
+ */
+static uint32_t block_aligned_chunk_size(int block_size, uint32_t default_size) {
+    if (block_size <= 0 || (uint32_t)block_size > 4 * default_size) {
+        return default_size;
+    }
+    uint32_t n = (uint32_t)std::round((double)default_size / (double)block_size);
+    if (n < 1) n = 1;
+    return n * block_size;
+}
+
 simple_cube::simple_cube(std::vector<std::string> files, std::vector<std::string> datetime_values, std::vector<std::string> bands,
                          std::vector<std::string> band_names, double dx, double dy) : cube(), _in_files(files), _in_datetime(datetime_values), _in_bands(bands), _in_band_names(band_names), _in_dx(dx), _in_dy(dy), _orig_bands(), _band_selection() {
     if (files.size() != datetime_values.size()) {
@@ -83,6 +97,7 @@ simple_cube::simple_cube(std::vector<std::string> files, std::vector<std::string
             } else {
                 stref->set_y_axis(bbox.bottom, bbox.top, dy);
             }
+            set_block_aligned_chunk_size(dataset, dx, dy);
             if (!band_names.empty() && ((int32_t)band_names.size() != dataset->GetRasterCount())) {
                 GDALClose(dataset);
                 GCBS_ERROR("Number of provided band names does not match the number of bands in files");
@@ -179,6 +194,9 @@ simple_cube::simple_cube(std::vector<std::string> files, std::vector<std::string
                 } else {
                     stref->set_y_axis(bbox.bottom, bbox.top, dy);
                 }
+                if (bands_processed.empty()) {
+                    set_block_aligned_chunk_size(dataset, dx, dy);
+                }
                 if (dataset->GetRasterCount() > 1) {
                     GCBS_WARN("Assuming a 1:1 relationship between files and bands but at least one file contains > 1 band that will be ignored.'");
                 }
@@ -220,6 +238,61 @@ simple_cube::simple_cube(std::vector<std::string> files, std::vector<std::string
     _st_ref = stref;
 }
 
+void simple_cube::set_block_aligned_chunk_size(GDALDataset *dataset, double dx, double dy) {
+    // Each time slice comes from different files, hence chunks contain a single time slice
+    _chunk_size[0] = 1;
+    if (dataset->GetRasterCount() < 1) return;
+
+    // Chunk boundaries only coincide with block boundaries if the cube uses the original pixel grid
+    int block_x = 0;
+    int block_y = 0;
+    dataset->GetRasterBand(1)->GetBlockSize(&block_x, &block_y);
+    if (dx <= 0) {
+        _chunk_size[2] = block_aligned_chunk_size(block_x, _chunk_size[2]);
+    }
+    if (dy <= 0) {
+        _chunk_size[1] = block_aligned_chunk_size(block_y, _chunk_size[1]);
+    }
+}
+
+bool simple_cube::source_window(GDALDataset *dataset, double affine_in[6], bounds_2d<double> extent,
+                                int32_t &left, int32_t &top, int32_t &right, int32_t &bottom) {
+    bounds_2d<double> bbox;
+    bbox.left = affine_in[0];
+    bbox.right = affine_in[0] + affine_in[1] * dataset->GetRasterXSize() + affine_in[2] * dataset->GetRasterYSize();
+    bbox.top = affine_in[3];
+    bbox.bottom = affine_in[3] + affine_in[4] * dataset->GetRasterXSize() + affine_in[5] * dataset->GetRasterYSize();
+
+    left = (extent.left - bbox.left) / affine_in[1];
+    bottom = dataset->GetRasterYSize() - (extent.bottom - bbox.bottom) / std::abs(affine_in[5]);
+    top = dataset->GetRasterYSize() - (extent.top - bbox.bottom) / std::abs(affine_in[5]);
+    right = (extent.right - bbox.left) / affine_in[1];
+
+    // If dx and dy have been user-defined, we need to handle
+    // cubes with extent larger than the images
+    if (_in_dx > 0.0) {
+        if (right > dataset->GetRasterXSize()) {
+            right = dataset->GetRasterXSize();
+        }
+        if (left < 0) {
+            left = 0;
+        }
+    }
+    if (_in_dy > 0.0) {
+        if (bottom > dataset->GetRasterYSize()) {
+            bottom = dataset->GetRasterYSize();
+        }
+        if (top < 0) {
+            top = 0;
+        }
+    }
+
+    return !(left < 0 || left > dataset->GetRasterXSize() ||
+             right < 0 || right > dataset->GetRasterXSize() ||
+             top < 0 || top > dataset->GetRasterYSize() ||
+             bottom < 0 || bottom > dataset->GetRasterYSize());
+}
+
 std::string simple_cube::to_string() {
     std::stringstream out;
     std::shared_ptr<cube_view> x = std::dynamic_pointer_cast<cube_view>(_st_ref);
@@ -251,15 +324,18 @@ std::shared_ptr<chunk_data> simple_cube::read_chunk(chunkid_t id) {
     bounds_st cextent = bounds_from_chunk(id);
 
     auto climits = chunk_limits(id);
-    //////
-    /*
-     * 1. if each image contains all bands: find out which images are between start and end date,
-     * 2. read images with rasterIO and copy to correct slice in buffer, read band-wise
-     *
-     */
-    //////
-
-    //
+    // If the next chunk covers the same time slices, its source windows are announced to GDAL
+    // (AdviseRead) after reading, such that drivers may prefetch blocks, e.g. with multi-range requests
+    // for remote files. Handles are given back to the pool and are likely to be reused for the next chunk.
+    bool prefetch_next = false;
+    bounds_st next_extent;
+    if (id + 1 < count_chunks()) {
+        if (chunk_limits(id + 1).low[0] == climits.low[0]) {
+            prefetch_next = true;
+            next_extent = bounds_from_chunk(id + 1);
+        }
+    }
+    coords_nd<uint32_t, 3> next_size_tyx = prefetch_next ? chunk_size(id + 1) : size_tyx;
 
     for (uint32_t it = 0; it < size_btyx[1]; ++it) {
         datetime dt = _st_ref->datetime_at_index(climits.low[0] + it);
@@ -267,16 +343,31 @@ std::shared_ptr<chunk_data> simple_cube::read_chunk(chunkid_t id) {
         if (iter == _index.end()) {
             continue;
         }
+
+        // Group consecutive output bands that come from the same file, such that
+        // they can be read with a single (pixel-interleaved if possible) RasterIO call
+        std::vector<std::pair<std::string, std::vector<uint16_t>>> reads;  // file -> output band indexes
+        std::vector<std::vector<int>> reads_band_map;
         for (uint16_t ib = 0; ib < _bands.count(); ++ib) {
-            if (iter->second.find(_bands.get(ib).name) == iter->second.end()) {
+            auto file_band = iter->second.find(_bands.get(ib).name);
+            if (file_band == iter->second.end()) {
                 continue;
             }
-            auto file_band = iter->second[_bands.get(ib).name];
+            if (reads.empty() || reads.back().first != file_band->second.first ||
+                reads.back().second.back() + 1 != ib) {
+                reads.push_back(std::make_pair(file_band->second.first, std::vector<uint16_t>()));
+                reads_band_map.push_back(std::vector<int>());
+            }
+            reads.back().second.push_back(ib);
+            reads_band_map.back().push_back(file_band->second.second);
+        }
 
-            std::string gdal_file = file_band.first;
-            uint16_t gdal_band = file_band.second;
+        for (uint16_t ir = 0; ir < reads.size(); ++ir) {
+            std::string gdal_file = reads[ir].first;
+            std::vector<int> &band_map = reads_band_map[ir];
+            uint16_t ib = reads[ir].second[0];
 
-            GDALDataset *dataset = (GDALDataset *)GDALOpen(gdal_file.c_str(), GA_ReadOnly);
+            pooled_dataset dataset(gdal_file);
             if (!dataset) {
                 GCBS_DEBUG("GDAL failed to open '" + gdal_file + "'");
                 continue;
@@ -284,63 +375,33 @@ std::shared_ptr<chunk_data> simple_cube::read_chunk(chunkid_t id) {
 
             double affine_in[6] = {0, 0, 1, 0, 0, 1};
             if (dataset->GetGeoTransform(affine_in) != CE_None) {
-                GDALClose(dataset);
                 GCBS_DEBUG("GDAL failed to fetch geotransform parameters for '" + gdal_file + "'");
                 continue;
             }
 
-            bounds_2d<double> bbox;
-            bbox.left = affine_in[0];
-            bbox.right = affine_in[0] + affine_in[1] * dataset->GetRasterXSize() + affine_in[2] * dataset->GetRasterYSize();
-            bbox.top = affine_in[3];
-            bbox.bottom = affine_in[3] + affine_in[4] * dataset->GetRasterXSize() + affine_in[5] * dataset->GetRasterYSize();
-
-            int32_t left = (cextent.s.left - bbox.left) / affine_in[1];
-            int32_t bottom = dataset->GetRasterYSize() - (cextent.s.bottom - bbox.bottom) / std::abs(affine_in[5]);
-            int32_t top = dataset->GetRasterYSize() - (cextent.s.top - bbox.bottom) / std::abs(affine_in[5]);
-            int32_t right = (cextent.s.right - bbox.left) / affine_in[1];
-
-            // If dx and dy have been user-defined, we need to handle
-            // cubes with extent larger than the images
-            if (_in_dx > 0.0 ) {
-                if (right > dataset->GetRasterXSize()) {
-                    right = dataset->GetRasterXSize();
-                }
-                if (left < 0) {
-                    left = 0;
-                }
-
-            }
-            if (_in_dy > 0.0) {
-                if (bottom > dataset->GetRasterYSize() ) {
-                    bottom = dataset->GetRasterYSize();
-                }
-                if (top < 0) {
-                   top = 0;
-                }
-            }
-
-
-
-            CPLErr res;
+            int32_t left, top, right, bottom;
             // TODO: add resampling parameter?!
-
-            if (left < 0 || left > dataset->GetRasterXSize() ||
-                right < 0 || right > dataset->GetRasterXSize() ||
-                top < 0 || top > dataset->GetRasterYSize() ||
-                bottom < 0 || bottom > dataset->GetRasterYSize()) {
+            if (!source_window(dataset.get(), affine_in, cextent.s, left, top, right, bottom)) {
                 GCBS_WARN("RasterIO (read) request out of bounds, skipping " + gdal_file);
             } else {
-                // TODO: time index?!
-                res = dataset->GetRasterBand(gdal_band)->RasterIO(GF_Read, left, top, right - left, bottom - top,
-                                                                  (double *)(out->buf()) + ib * size_btyx[1] * size_btyx[2] * size_btyx[3] +
-                                                                      it * size_btyx[2] * size_btyx[3],
-                                                                  size_btyx[3], size_btyx[2], GDT_Float64, 0, 0, NULL);
+                // bands are the outermost dimension of the chunk buffer
+                GSpacing band_space = (GSpacing)size_btyx[1] * size_btyx[2] * size_btyx[3] * sizeof(double);
+                CPLErr res = dataset->RasterIO(GF_Read, left, top, right - left, bottom - top,
+                                               (double *)(out->buf()) + ib * size_btyx[1] * size_btyx[2] * size_btyx[3] +
+                                                   it * size_btyx[2] * size_btyx[3],
+                                               size_btyx[3], size_btyx[2], GDT_Float64, band_map.size(), band_map.data(),
+                                               0, 0, band_space, NULL);
                 if (res != CE_None) {
                     GCBS_WARN("RasterIO (read) failed for " + gdal_file);
                 }
             }
-            GDALClose(dataset);
+
+            if (prefetch_next && it < next_size_tyx[0]) {
+                if (source_window(dataset.get(), affine_in, next_extent.s, left, top, right, bottom)) {
+                    dataset->AdviseRead(left, top, right - left, bottom - top, next_size_tyx[2], next_size_tyx[1],
+                                        GDT_Float64, band_map.size(), band_map.data(), NULL);
+                }
+            }
         }
     }
     return out;
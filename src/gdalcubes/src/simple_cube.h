@@ -43,6 +43,7 @@ class simple_cube : public cube {
       * @param band_names vector of names for bands, applicalbe only if all images contain the same bands (bands is empty)
       * @param dx target pixel size in x direction; if <= 0 (default), highest original resolution from files is used automatically
       * @param dy target pixel size in y direction; if <= 0 (default), highest original resolution from files is used automatically
+      * @note Chunks contain one time slice and are by default aligned with the internal block size of the images, see set_chunk_size()
       * @note Notice that all images must have identical spatial reference systems and spatial extents. No
       * automatic check is performed whether this assumption is fulfilled.
       * @return a shared pointer to the created data cube instance
@@ -138,6 +139,18 @@ class simple_cube : public cube {
     }
 
    private:
+    /**
+     * @brief Set the default chunk size to (multiples of) the block size of a source dataset
+     */
+    void set_block_aligned_chunk_size(GDALDataset *dataset, double dx, double dy);
+
+    /**
+     * @brief Compute the pixel window of a source dataset that corresponds to a given spatial extent
+     * @return false, if the window is out of the dataset's bounds
+     */
+    bool source_window(GDALDataset *dataset, double affine_in[6], bounds_2d<double> extent,
+                       int32_t &left, int32_t &top, int32_t &right, int32_t &bottom);
+
     // Input arguments
     std::vector<std::string> _in_files;
     std::vector<std::string> _in_datetime;
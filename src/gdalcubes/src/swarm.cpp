@@ -29,6 +29,8 @@
 #include <fstream>
 #include <thread>
 
+#include "thread_pool.h"
+
 namespace gdalcubes {
 
 size_t post_file_read_callback(char *buffer, size_t size, size_t nitems, void *userdata) {
@@ -279,21 +281,17 @@ void gdalcubes_swarm::apply(std::shared_ptr<cube> c, std::function<void(chunkid_
         chunk_distr[i % _server_uris.size()].push_back(i);
     }
     std::mutex mutex;
-    std::vector<std::thread> workers;
-    for (uint16_t it = 0; it < nthreads; ++it) {
-        workers.push_back(std::thread([this, c, &chunk_distr, &f, it, &mutex](void) {
-            // One remote server is processed by a single thread for now, changing this will require to using the multi interface of curl
-            for (uint32_t iserver = it; iserver < _server_uris.size(); iserver += _server_uris.size()) {
-                for (uint32_t ichunk = 0; ichunk < chunk_distr[iserver].size(); ++ichunk) {
-                    std::shared_ptr<chunk_data> dat = get_download(chunk_distr[iserver][ichunk], iserver);
-                    f(chunk_distr[iserver][ichunk], dat, mutex);
-                }
+    // One remote server is processed by a single task for now, changing this will require to using the multi interface of curl
+    thread_pool::instance()->parallel_for(
+        _server_uris.size(), [this, &chunk_distr, &f, &mutex](uint32_t iserver) {
+            auto chunks = chunk_distr.find(iserver);
+            if (chunks == chunk_distr.end()) return;
+            for (uint32_t ichunk = 0; ichunk < chunks->second.size(); ++ichunk) {
+                std::shared_ptr<chunk_data> dat = get_download(chunks->second[ichunk], iserver);
+                f(chunks->second[ichunk], dat, mutex);
             }
-        }));
-    }
-    for (uint16_t it = 0; it < nthreads; ++it) {
-        workers[it].join();
-    }
+        },
+        nthreads);
 }
 
 }  // namespace gdalcubes
@@ -0,0 +1,147 @@
+/*
+    MIT License
+
+    Copyright (c) 2023 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+/*
+ * Kernel plugin used by test_kernel_plugin.cpp, depending on the mode it computes
+ * - "apply_pixel": the sum of all input bands,
+ * - "apply_time": the cumulative sum of the first band over time,
+ * - "reduce_time": the sum of the first band over time and the date of its last available value.
+ * Missing values are ignored. The arguments "fail_init", "fail_output_bands", and "fail_process" make the
+ * corresponding function fail. If compiled with TEST_KERNEL_ABI_VERSION, the plugin reports a different ABI version.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../kernel_abi.h"
+
+#ifndef TEST_KERNEL_ABI_VERSION
+#define TEST_KERNEL_ABI_VERSION GDALCUBES_KERNEL_ABI_VERSION
+#endif
+
+typedef struct {
+    int mode; /* 0: apply_pixel, 1: apply_time, 2: reduce_time */
+    int fail_output_bands;
+    int fail_process;
+} test_kernel_state;
+
+static const char *const names_apply_pixel[] = {"sum"};
+static const char *const names_apply_time[] = {"cumsum"};
+static const char *const names_reduce_time[] = {"sum", "t_last"};
+
+static int test_kernel_init(const char *args, const char *mode, uint16_t nbands_in, const char *const *band_names_in, void **state,
+                            char *err, size_t errlen) {
+    test_kernel_state *s;
+    (void)band_names_in;
+    if (strcmp(args, "fail_init") == 0) {
+        snprintf(err, errlen, "init failed as requested");
+        return 1;
+    }
+    if (nbands_in == 0) {
+        snprintf(err, errlen, "no input bands");
+        return 1;
+    }
+    s = (test_kernel_state *)malloc(sizeof(test_kernel_state));
+    s->mode = strcmp(mode, "apply_pixel") == 0 ? 0 : (strcmp(mode, "apply_time") == 0 ? 1 : 2);
+    s->fail_output_bands = strcmp(args, "fail_output_bands") == 0;
+    s->fail_process = strcmp(args, "fail_process") == 0;
+    *state = s;
+    return 0;
+}
+
+static int test_kernel_output_bands(void *state, uint16_t *nbands_out, const char *const **band_names_out, char *err, size_t errlen) {
+    test_kernel_state *s = (test_kernel_state *)state;
+    if (s->fail_output_bands) {
+        snprintf(err, errlen, "output_bands failed as requested");
+        return 1;
+    }
+    if (s->mode == 0) {
+        *nbands_out = 1;
+        *band_names_out = names_apply_pixel;
+    } else if (s->mode == 1) {
+        *nbands_out = 1;
+        *band_names_out = names_apply_time;
+    } else {
+        *nbands_out = 2;
+        *band_names_out = names_reduce_time;
+    }
+    return 0;
+}
+
+static int test_kernel_process(void *state, const double *in, const uint32_t *size_in, const double *t, double *out,
+                               const uint32_t *size_out, char *err, size_t errlen) {
+    const test_kernel_state *s = (const test_kernel_state *)state;
+    uint64_t nxy = (uint64_t)size_in[2] * size_in[3];
+    uint64_t it, ib, i;
+    if (s->fail_process) {
+        snprintf(err, errlen, "process failed as requested");
+        return 1;
+    }
+    if (size_out[2] != size_in[2] || size_out[3] != size_in[3] || size_out[1] != (s->mode == 2 ? 1 : size_in[1])) {
+        snprintf(err, errlen, "unexpected output size");
+        return 1;
+    }
+    for (i = 0; i < nxy; ++i) {
+        double sum = NAN;
+        double t_last = NAN;
+        for (it = 0; it < size_in[1]; ++it) {
+            if (s->mode == 0) {
+                double x = NAN;
+                for (ib = 0; ib < size_in[0]; ++ib) {
+                    double v = in[(ib * size_in[1] + it) * nxy + i];
+                    if (!isnan(v)) x = isnan(x) ? v : x + v;
+                }
+                out[it * nxy + i] = x;
+                continue;
+            }
+            double v = in[it * nxy + i];
+            if (!isnan(v)) {
+                sum = isnan(sum) ? v : sum + v;
+                t_last = t[it];
+            }
+            if (s->mode == 1) {
+                out[it * nxy + i] = isnan(v) ? NAN : sum;
+            }
+        }
+        if (s->mode == 2) {
+            out[i] = sum;
+            out[nxy + i] = t_last;
+        }
+    }
+    return 0;
+}
+
+static void test_kernel_finalize(void *state) {
+    free(state);
+}
+
+static const gdalcubes_kernel_v1_t test_kernel = {TEST_KERNEL_ABI_VERSION, test_kernel_init, test_kernel_output_bands, test_kernel_process,
+                                                  test_kernel_finalize};
+
+GDALCUBES_KERNEL_EXPORT const gdalcubes_kernel_v1_t *gdalcubes_kernel_v1(void) {
+    return &test_kernel;
+}
@@ -22,10 +22,16 @@
     SOFTWARE.
 */
 
+#include <cpl_vsi.h>
+#include <gdal_priv.h>
+
+#include <cstdio>  // std::remove
 #include <string>
 
 #include "../external/catch.hpp"
+#include "../filesystem.h"
 #include "../gdalcubes.h"
+#include "test_cubes.h"
 
 using namespace gdalcubes;
 
@@ -44,3 +50,163 @@ TEST_CASE("aggregate_time_create", "[aggregate_time]") {
 
 
 }
+
+namespace {
+
+// single-band images covering [left, right] x [0, 1] in EPSG:4326
+std::shared_ptr<image_collection> test_collection(std::vector<std::string> dates, std::vector<double> left, std::vector<double> right,
+                                                  std::vector<std::string> files = {}) {
+    uint32_t n = dates.size();
+    std::vector<std::string> names;
+    for (uint32_t i = 0; i < n; ++i) {
+        names.push_back("img" + std::to_string(i));
+        if (files.size() < n) files.push_back(names.back() + ".tif");
+    }
+    return image_collection::create_from_tables(std::vector<std::string>(n, "B1"), names, std::vector<std::string>(n, "EPSG:4326"), dates,
+                                                left, std::vector<double>(n, 1.0), std::vector<double>(n, 0.0), right, files,
+                                                std::vector<uint16_t>(n, 1));
+}
+
+// daily view with 4 x 4 pixels from 2020-01-01 to 2020-01-04
+cube_view test_view(std::string aggregation) {
+    cube_view v;
+    v.srs("EPSG:4326");
+    v.set_x_axis(0.0, 1.0, uint32_t(4));
+    v.set_y_axis(0.0, 1.0, uint32_t(4));
+    v.set_t_axis(datetime::from_string("2020-01-01"), datetime::from_string("2020-01-04"), duration::from_string("P1D"));
+    v.aggregation_method() = aggregation::from_string(aggregation);
+    return v;
+}
+
+}  // namespace
+
+TEST_CASE("Aggregation of image collection cubes is rewritten as view", "[aggregate_time]") {
+    // one image per day
+    std::shared_ptr<image_collection> ic = test_collection({"2020-01-01", "2020-01-02", "2020-01-03", "2020-01-04"}, {0, 0, 0, 0}, {1, 1, 1, 1});
+    auto icc = image_collection_cube::create(ic, test_view("first"));
+    for (std::string f : {"min", "max", "mean", "median", "count"}) {
+        INFO(f);
+        auto c = aggregate_time_cube::create(icc, "P2D", f);
+        std::shared_ptr<image_collection_cube> r = std::dynamic_pointer_cast<image_collection_cube>(c->rewrite_as_view());
+        REQUIRE(r);
+        REQUIRE(r->view()->nt() == 2);
+        REQUIRE(r->view()->aggregation_method() == aggregation::from_string(f == "count" ? "count_values" : f));
+        REQUIRE(r->chunk_size()[0] == c->chunk_size()[0]);
+    }
+    for (std::string f : {"sum", "prod", "var", "sd"}) {
+        INFO(f);
+        REQUIRE(!aggregate_time_cube::create(icc, "P2D", f)->rewrite_as_view());
+    }
+
+    // misaligned periods
+    REQUIRE(!aggregate_time_cube::create(icc, "P3D", "mean")->rewrite_as_view());
+    REQUIRE(!aggregate_time_cube::create(icc, "P1M", "mean")->rewrite_as_view());
+    REQUIRE(aggregate_time_cube::create(icc, "P4D", "mean")->rewrite_as_view());
+
+    // counts of counts
+    auto icc_count = image_collection_cube::create(ic, test_view("count_values"));
+    REQUIRE(!aggregate_time_cube::create(icc_count, "P2D", "count")->rewrite_as_view());
+    REQUIRE(!aggregate_time_cube::create(icc_count, "P2D", "max")->rewrite_as_view());
+    REQUIRE(!aggregate_time_cube::create(image_collection_cube::create(ic, test_view("count_images")), "P2D", "mean")->rewrite_as_view());
+
+    // other input cubes
+    REQUIRE(!aggregate_time_cube::create(std::make_shared<passthrough_cube>(icc), "P2D", "mean")->rewrite_as_view());
+}
+
+TEST_CASE("Aggregation of overlapping images is not rewritten as view", "[aggregate_time]") {
+    // two overlapping images on the first day
+    std::shared_ptr<image_collection> ic = test_collection({"2020-01-01", "2020-01-01", "2020-01-02"}, {0, 0.2, 0}, {0.8, 1, 1});
+    REQUIRE(!aggregate_time_cube::create(image_collection_cube::create(ic, test_view("mean")), "P2D", "mean")->rewrite_as_view());
+    REQUIRE(!aggregate_time_cube::create(image_collection_cube::create(ic, test_view("first")), "P2D", "median")->rewrite_as_view());
+    REQUIRE(!aggregate_time_cube::create(image_collection_cube::create(ic, test_view("min")), "P2D", "count")->rewrite_as_view());
+    REQUIRE(!aggregate_time_cube::create(image_collection_cube::create(ic, test_view("min")), "P2D", "max")->rewrite_as_view());
+
+    // min of min and max of max do not depend on the number of images per cell
+    REQUIRE(aggregate_time_cube::create(image_collection_cube::create(ic, test_view("min")), "P2D", "min")->rewrite_as_view());
+    REQUIRE(aggregate_time_cube::create(image_collection_cube::create(ic, test_view("max")), "P2D", "max")->rewrite_as_view());
+
+    // adjacent images on the same day do not overlap
+    ic = test_collection({"2020-01-01", "2020-01-01", "2020-01-02"}, {0, 0.55, 0}, {0.45, 1, 1});
+    REQUIRE(aggregate_time_cube::create(image_collection_cube::create(ic, test_view("mean")), "P2D", "mean")->rewrite_as_view());
+}
+
+TEST_CASE("Aggregation is rewritten with image metadata filters", "[aggregate_time]") {
+    // two overlapping images on the first day, one of them cloudy
+    std::shared_ptr<image_collection> ic = test_collection({"2020-01-01", "2020-01-01", "2020-01-02"}, {0, 0.2, 0}, {0.8, 1, 1});
+    ic->insert_image_md({1, 2, 3}, {"eo:cloud_cover", "eo:cloud_cover", "eo:cloud_cover"}, {"10", "90", "20"});
+    std::vector<image_collection::image_md_predicate> filter = {image_collection::image_md_predicate::from_string("eo:cloud_cover < 50")};
+    auto icc = image_collection_cube::create(ic, test_view("mean"));
+    REQUIRE(!aggregate_time_cube::create(icc, "P2D", "mean")->rewrite_as_view());
+
+    // filtered images are not checked for overlaps
+    icc->set_image_md_filter(filter);
+    icc->set_image_md_order("eo:cloud_cover");
+    REQUIRE(icc->image_md_filter().size() == 1);
+    REQUIRE(icc->image_md_order() == "eo:cloud_cover");
+    REQUIRE(aggregate_time_cube::create(icc, "P2D", "mean")->rewrite_as_view());
+
+    // snapshots only answer queries with the predicates and order they have been created with
+    std::string f = "test_aggregate_time.snapshot";
+    icc->write_snapshot(f);
+    auto snap = image_collection_cube::create(std::make_shared<image_collection>(f), test_view("mean"));
+    snap->set_image_md_filter(filter);
+    snap->set_image_md_order("eo:cloud_cover");
+    std::shared_ptr<image_collection_cube> r;
+    REQUIRE_NOTHROW(r = std::dynamic_pointer_cast<image_collection_cube>(aggregate_time_cube::create(snap, "P2D", "mean")->rewrite_as_view()));
+    REQUIRE(r);
+    REQUIRE(r->image_md_filter().size() == 1);
+    REQUIRE(r->image_md_order() == "eo:cloud_cover");
+    snap.reset();
+    r.reset();
+    std::remove(f.c_str());
+}
+
+TEST_CASE("Rewritten aggregation equals aggregation of chunks", "[aggregate_time]") {
+    GDALAllRegister();
+    std::string dir = "test_aggregate_time";
+    VSIRmdirRecursive(dir.c_str());
+    filesystem::mkdir(dir);
+
+    // 4 x 4 pixels with different values per day and pixel
+    std::vector<std::string> dates = {"2020-01-01", "2020-01-02", "2020-01-03", "2020-01-04"};
+    std::vector<std::string> files;
+    for (uint16_t i = 0; i < dates.size(); ++i) {
+        files.push_back(filesystem::join(dir, "img" + std::to_string(i) + ".tif"));
+        GDALDriver *drv = GetGDALDriverManager()->GetDriverByName("GTiff");
+        GDALDataset *ds = drv->Create(files.back().c_str(), 4, 4, 1, GDT_Float64, nullptr);
+        double gt[6] = {0.0, 0.25, 0.0, 1.0, 0.0, -0.25};
+        ds->SetGeoTransform(gt);
+        std::vector<double> values(16);
+        for (uint16_t k = 0; k < 16; ++k) {
+            values[k] = (k * 7 + i * 5) % 11 + 0.5 * i;
+        }
+        REQUIRE(ds->GetRasterBand(1)->RasterIO(GF_Write, 0, 0, 4, 4, values.data(), 4, 4, GDT_Float64, 0, 0, nullptr) == CE_None);
+        GDALClose((GDALDatasetH)ds);
+    }
+    std::shared_ptr<image_collection> ic = test_collection(dates, {0, 0, 0, 0}, {1, 1, 1, 1}, files);
+
+    for (std::string agg : {"first", "mean"}) {
+        auto icc = image_collection_cube::create(ic, test_view(agg));
+        icc->set_chunk_size(1, 2, 2);
+        for (std::string f : {"min", "max", "mean", "median", "count"}) {
+            for (std::string dt : {"P2D", "P4D"}) {
+                INFO(agg << " " << f << " " << dt);
+                auto rewritten = aggregate_time_cube::create(icc, dt, f);
+                REQUIRE(rewritten->rewrite_as_view());
+                auto chunked = aggregate_time_cube::create(std::make_shared<passthrough_cube>(icc), dt, f);
+                REQUIRE(!chunked->rewrite_as_view());
+
+                std::vector<double> a = read_dense(rewritten);
+                std::vector<double> b = read_dense(chunked);
+                REQUIRE(a.size() == b.size());
+                for (uint32_t i = 0; i < a.size(); ++i) {
+                    REQUIRE(!std::isnan(b[i]));
+                    REQUIRE(a[i] == Approx(b[i]));
+                }
+            }
+        }
+    }
+
+    ic.reset();
+    VSIRmdirRecursive(dir.c_str());
+}
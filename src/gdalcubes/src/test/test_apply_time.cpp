@@ -0,0 +1,130 @@
+/*
+    MIT License
+
+    Copyright (c) 2023 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#include <cmath>
+#include <functional>
+#include <string>
+
+#include "../external/catch.hpp"
+#include "../gdalcubes.h"
+#include "test_cubes.h"
+
+using namespace gdalcubes;
+
+namespace {
+
+// monthly time series of 2 x 2 pixels, where each chunk contains a single pixel and three time slices
+std::shared_ptr<function_cube> monthly_cube() {
+    cube_view v;
+    v.srs("EPSG:3857");
+    v.set_x_axis(0.0, uint32_t(2), 1.0);
+    v.set_y_axis(0.0, uint32_t(2), 1.0);
+    v.set_t_axis(datetime::from_string("2001-01"), datetime::from_string("2001-08"), duration::from_string("P1M"));
+    std::vector<std::vector<double>> series = {
+        {1, NAN, 3, NAN, NAN, 6, 7, NAN},
+        {NAN, 2, NAN, 4, 5, 6, 7, 8},
+        {1, 2, 4, 8, 16, 32, 64, 128},
+        std::vector<double>(8, NAN)};
+    auto out = std::make_shared<function_cube>(v, [series](uint32_t it, uint32_t iy, uint32_t ix) { return series[iy * 2 + ix][it]; });
+    out->set_chunk_size(3, 1, 1);
+    return out;
+}
+
+// time series of one pixel with all bands of the cube
+std::vector<std::vector<double>> read_pixel(std::shared_ptr<cube> c, uint32_t y, uint32_t x) {
+    std::vector<double> d = read_dense(c);
+    std::vector<std::vector<double>> out(c->size_bands(), std::vector<double>(c->size_t(), NAN));
+    for (uint16_t ib = 0; ib < c->size_bands(); ++ib) {
+        for (uint32_t it = 0; it < c->size_t(); ++it) {
+            out[ib][it] = d[((uint64_t(ib) * c->size_t() + it) * c->size_y() + y) * c->size_x() + x];
+        }
+    }
+    return out;
+}
+
+bool same_series(const std::vector<double> &a, const std::vector<double> &b) {
+    if (a.size() != b.size()) return false;
+    for (uint32_t i = 0; i < a.size(); ++i) {
+        if (std::isnan(a[i]) != std::isnan(b[i])) return false;
+        if (!std::isnan(a[i]) && std::fabs(a[i] - b[i]) > 1e-12 * std::max(1.0, std::fabs(b[i]))) return false;
+    }
+    return true;
+}
+
+}  // namespace
+
+TEST_CASE("Time series operations", "[apply_time]") {
+    auto in = monthly_cube();
+    auto c = apply_time_cube::create(in, {{"cumsum", "v"}, {"lag", "v"}, {"lag", "v"}, {"diff", "v"}, {"diff", "v"}, {"interpolate", "v"}}, {1, 1, -2, 1, 2, 1});
+    REQUIRE(c->size_t() == 8);
+    REQUIRE(c->chunk_size()[0] == 8);
+    REQUIRE(c->bands().get(0).name == "v_cumsum");
+    REQUIRE(c->bands().get(1).name == "v_lag");
+    REQUIRE(c->bands().get(2).name == "v_lead2");
+    REQUIRE(c->bands().get(3).name == "v_diff");
+    REQUIRE(c->bands().get(4).name == "v_diff2");
+    REQUIRE(c->bands().get(5).name == "v_interpolate");
+
+    std::vector<std::vector<double>> p = read_pixel(c, 0, 0);
+    REQUIRE(same_series(p[0], {1, NAN, 4, NAN, NAN, 10, 17, NAN}));
+    REQUIRE(same_series(p[1], {NAN, 1, NAN, 3, NAN, NAN, 6, 7}));
+    REQUIRE(same_series(p[2], {3, NAN, NAN, 6, 7, NAN, NAN, NAN}));
+    REQUIRE(same_series(p[3], {NAN, NAN, NAN, NAN, NAN, NAN, 1, NAN}));
+    REQUIRE(same_series(p[4], {NAN, NAN, 2, NAN, NAN, NAN, NAN, NAN}));
+
+    // interpolation uses dates, i.e. the number of days per month (Jan 1: 0, Feb 1: 31, Mar 1: 59, Apr 1: 90, May 1: 120, Jun 1: 151)
+    REQUIRE(same_series(p[5], {1, 1 + 2.0 * 31 / 59, 3, 3 + 3.0 * 31 / 92, 3 + 3.0 * 61 / 92, 6, 7, NAN}));
+
+    // leading gaps are not interpolated
+    p = read_pixel(c, 0, 1);
+    REQUIRE(same_series(p[0], {NAN, 2, NAN, 6, 11, 17, 24, 32}));
+    REQUIRE(same_series(p[3], {NAN, NAN, NAN, NAN, 1, 1, 1, 1}));
+    REQUIRE(same_series(p[5], {NAN, 2, 2 + 2.0 * 28 / 59, 4, 5, 6, 7, 8}));
+
+    p = read_pixel(c, 1, 0);
+    REQUIRE(same_series(p[0], {1, 3, 7, 15, 31, 63, 127, 255}));
+    REQUIRE(same_series(p[2], {4, 8, 16, 32, 64, 128, NAN, NAN}));
+    REQUIRE(same_series(p[4], {NAN, NAN, 3, 6, 12, 24, 48, 96}));
+    REQUIRE(same_series(p[5], {1, 2, 4, 8, 16, 32, 64, 128}));
+
+    // pixels without any values
+    p = read_pixel(c, 1, 1);
+    for (uint16_t ib = 0; ib < p.size(); ++ib) {
+        REQUIRE(same_series(p[ib], std::vector<double>(8, NAN)));
+    }
+
+    // lags larger than the time series
+    auto c2 = apply_time_cube::create(in, {{"lag", "v"}, {"diff", "v"}}, {10, 10}, {"a", "b"});
+    REQUIRE(c2->bands().get(0).name == "a");
+    p = read_pixel(c2, 1, 0);
+    REQUIRE(same_series(p[0], std::vector<double>(8, NAN)));
+    REQUIRE(same_series(p[1], std::vector<double>(8, NAN)));
+
+    REQUIRE_THROWS(apply_time_cube::create(in, {{"cumprod", "v"}}));
+    REQUIRE_THROWS(apply_time_cube::create(in, {{"cumsum", "x"}}));
+    REQUIRE_THROWS(apply_time_cube::create(in, {{"diff", "v"}}, {0}));
+    REQUIRE_THROWS(apply_time_cube::create(in, {{"diff", "v"}}, {1, 2}));
+    REQUIRE_THROWS(apply_time_cube::create(in, {{"diff", "v"}, {"diff", "v"}}));
+}
@@ -0,0 +1,155 @@
+/*
+    MIT License
+
+    Copyright (c) 2023 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../collection_format.h"
+#include "../external/catch.hpp"
+
+using namespace gdalcubes;
+
+static collection_format sentinel2_format() {
+    collection_format f;
+    f.load_string(R"({
+      "pattern" : ".+/IMG_DATA/.+\\.jp2",
+      "images" : { "pattern" : ".*/(.+)\\.SAFE.*" },
+      "datetime" : { "pattern" : ".*MSIL2A_(.+?)_.*", "format" : "%Y%m%dT%H%M%S" },
+      "bands" : {
+        "B02" : { "pattern" : ".+_B02_10m\\.jp2" },
+        "B03" : { "pattern" : ".+_B03_10m\\.jp2" },
+        "B04" : { "pattern" : ".+_B04_10m\\.jp2" },
+        "B08" : { "pattern" : ".+_B08_10m\\.jp2" },
+        "SCL" : { "pattern" : ".+_SCL_20m\\.jp2" }
+      }
+    })");
+    return f;
+}
+
+// Synthetic Sentinel-2 like file listing, every fourth file is not an image
+static std::vector<std::string> sentinel2_paths(uint32_t n) {
+    std::vector<std::string> bands = {"B02_10m", "B03_10m", "B04_10m", "B08_10m", "SCL_20m", "B05_20m", "TCI_10m"};
+    std::vector<std::string> out;
+    for (uint32_t i = 0; i < n; ++i) {
+        std::string day = std::to_string(10 + (i / 100) % 18);
+        std::string id = "S2A_MSIL2A_201806" + day + "T101031_N0208_R022_T32U" + std::to_string(i % 100) + "_" + std::to_string(i / 700);
+        std::string b = bands[i % bands.size()];
+        if (i % 4 == 3) {
+            out.push_back("/data/" + id + ".SAFE/GRANULE/QI_DATA/MSK_CLOUDS_" + b + ".gml");
+        } else {
+            out.push_back("/data/" + id + ".SAFE/GRANULE/L2A/IMG_DATA/R10m/T32U_" + b + ".jp2");
+        }
+    }
+    return out;
+}
+
+TEST_CASE("Required literals of regular expressions", "[collection_format]") {
+    REQUIRE(collection_format_matcher::required_literals(".+/IMG_DATA/.+\\.jp2") == std::vector<std::string>{"/IMG_DATA/", ".jp2"});
+    REQUIRE(collection_format_matcher::required_literals(".*MSIL2A_(.+?)_.*") == std::vector<std::string>{"MSIL2A_", "_"});
+    REQUIRE(collection_format_matcher::required_literals("abc?d") == std::vector<std::string>{"ab", "d"});
+    REQUIRE(collection_format_matcher::required_literals("ab+c") == std::vector<std::string>{"ab", "c"});
+    REQUIRE(collection_format_matcher::required_literals("x{0,3}yz[a-c]w") == std::vector<std::string>{"yz", "w"});
+    REQUIRE(collection_format_matcher::required_literals("a\\x41b\\dc") == std::vector<std::string>{"a", "b", "c"});
+    REQUIRE(collection_format_matcher::required_literals("(a|b)_x").size() == 1);
+    REQUIRE(collection_format_matcher::required_literals("abc|def").empty());
+    REQUIRE(collection_format_matcher::required_literals("(?i)abc").empty());
+}
+
+TEST_CASE("Matching paths against a collection format", "[collection_format]") {
+    collection_format f = sentinel2_format();
+    collection_format_matcher m(f);
+    std::vector<std::string> paths = sentinel2_paths(5000);
+    std::vector<collection_format_matcher::result> res = m.match(paths, 4);
+    REQUIRE(res.size() == paths.size());
+
+    // compare with separate evaluation of all patterns
+    boost::regex global(f.json()["pattern"].string_value());
+    boost::regex images(f.json()["images"]["pattern"].string_value());
+    boost::regex dt(f.json()["datetime"]["pattern"].string_value());
+    std::vector<boost::regex> bands;
+    for (auto it = f.json()["bands"].object_items().begin(); it != f.json()["bands"].object_items().end(); ++it) {
+        bands.push_back(boost::regex(it->second["pattern"].string_value()));
+    }
+    for (uint32_t i = 0; i < paths.size(); ++i) {
+        bool g = boost::regex_match(paths[i], global);
+        REQUIRE(res[i].global == g);
+        if (!g) continue;
+        boost::smatch s;
+        REQUIRE(res[i].image == boost::regex_match(paths[i], s, images));
+        REQUIRE(res[i].image_name == s[1].str());
+        REQUIRE(res[i].datetime == boost::regex_match(paths[i], s, dt));
+        REQUIRE(res[i].datetime_str == s[1].str());
+        std::vector<uint16_t> b;
+        for (uint16_t ib = 0; ib < bands.size(); ++ib) {
+            if (boost::regex_match(paths[i], bands[ib])) b.push_back(ib);
+        }
+        REQUIRE(res[i].bands == b);
+    }
+}
+
+// Not run by default, use ./gdalcubes_test "[benchmark]"
+TEST_CASE("Benchmark collection format matching", "[.][benchmark]") {
+    collection_format f = sentinel2_format();
+    std::vector<std::string> paths = sentinel2_paths(1000000);
+
+    auto t0 = std::chrono::steady_clock::now();
+    boost::regex global(f.json()["pattern"].string_value());
+    boost::regex images(f.json()["images"]["pattern"].string_value());
+    boost::regex dt(f.json()["datetime"]["pattern"].string_value());
+    std::vector<boost::regex> bands;
+    for (auto it = f.json()["bands"].object_items().begin(); it != f.json()["bands"].object_items().end(); ++it) {
+        bands.push_back(boost::regex(it->second["pattern"].string_value()));
+    }
+    uint32_t nmatch_regex = 0;
+    for (uint32_t i = 0; i < paths.size(); ++i) {
+        if (!boost::regex_match(paths[i], global)) continue;
+        boost::smatch s;
+        boost::regex_match(paths[i], s, images);
+        boost::regex_match(paths[i], s, dt);
+        for (uint16_t ib = 0; ib < bands.size(); ++ib) {
+            if (boost::regex_match(paths[i], bands[ib])) ++nmatch_regex;
+        }
+    }
+    auto t1 = std::chrono::steady_clock::now();
+
+    collection_format_matcher m(f);
+    std::vector<collection_format_matcher::result> res = m.match(paths, 1);
+    auto t2 = std::chrono::steady_clock::now();
+    res = m.match(paths, 0);
+    auto t3 = std::chrono::steady_clock::now();
+
+    uint32_t nmatch = 0;
+    for (uint32_t i = 0; i < res.size(); ++i) {
+        nmatch += res[i].bands.size();
+    }
+    REQUIRE(nmatch == nmatch_regex);
+
+    std::cout << "Matching " << paths.size() << " paths:" << std::endl;
+    std::cout << "  separate regex_match calls: " << std::chrono::duration<double>(t1 - t0).count() << "s" << std::endl;
+    std::cout << "  matcher, 1 thread: " << std::chrono::duration<double>(t2 - t1).count() << "s" << std::endl;
+    std::cout << "  matcher, parallel: " << std::chrono::duration<double>(t3 - t2).count() << "s" << std::endl;
+}
@@ -0,0 +1,152 @@
+/*
+    MIT License
+
+    Copyright (c) 2023 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#include <cstdio>  // std::remove
+#include <string>
+
+#include "../collection_snapshot.h"
+#include "../external/catch.hpp"
+
+using namespace gdalcubes;
+
+static image_collection::find_range_st_row snapshot_test_row(uint32_t id, std::string datetime, std::string band, double left) {
+    image_collection::find_range_st_row r;
+    r.image_id = id;
+    r.image_name = "img" + std::to_string(id);
+    r.descriptor = r.image_name + "_" + band + ".tif";
+    r.datetime = datetime;
+    r.band_name = band;
+    r.srs = "EPSG:4326";
+    r.left = left;
+    r.right = left + 1;
+    r.bottom = 50;
+    r.top = 51;
+    return r;
+}
+
+TEST_CASE("Write and query collection snapshots", "[collection_snapshot]") {
+    std::vector<image_collection::bands_row> bands(2);
+    bands[0].id = 0;
+    bands[0].name = "B01";
+    bands[0].type = GDT_UInt16;
+    bands[0].offset = 0;
+    bands[0].scale = 1;
+    bands[0].image_count = 3;
+    bands[1] = bands[0];
+    bands[1].id = 1;
+    bands[1].name = "B02";
+
+    // rows are ordered by image id but not by datetime
+    std::vector<image_collection::find_range_st_row> rows;
+    rows.push_back(snapshot_test_row(1, "2020-03-01", "B01", 7));
+    rows.push_back(snapshot_test_row(1, "2020-03-01", "B02", 7));
+    rows.push_back(snapshot_test_row(2, "2020-01-01T10:00:00", "B01", 7));
+    rows.push_back(snapshot_test_row(3, "2020-02-01", "B01", 9));
+    rows.push_back(snapshot_test_row(3, "2020-02-01", "B02", 9));
+
+    std::string f = "test_collection_snapshot.snapshot";
+    collection_snapshot::write(f, bands, rows, {}, {}, "", {"gdalrefs.image_id", "gdalrefs.descriptor"});
+    REQUIRE(collection_snapshot::is_snapshot(f));
+    REQUIRE(!collection_snapshot(f).has_footprints());
+    REQUIRE(collection_snapshot::is_snapshot(f));
+
+    collection_snapshot s(f);
+    REQUIRE(s.count_images() == 3);
+    REQUIRE(s.count_gdalrefs() == 5);
+    REQUIRE(s.get_bands().size() == 2);
+    REQUIRE(s.get_bands()[1].name == "B02");
+    REQUIRE(s.order_by().size() == 2);
+
+    bounds_2d<double> everywhere;
+    everywhere.left = -180;
+    everywhere.right = 180;
+    everywhere.bottom = -90;
+    everywhere.top = 90;
+    auto all = s.find_range_st(everywhere, "2020-01-01T00:00:00", "2020-12-31T00:00:00", {}, {}, "");
+    REQUIRE(all.size() == 5);
+    REQUIRE(all[0].image_id == 1);  // order of the snapshot is kept
+    REQUIRE(all[4].descriptor == "img3_B02.tif");
+
+    auto feb = s.find_range_st(everywhere, "2020-01-15T00:00:00", "2020-02-15T00:00:00", {"B02"}, {}, "");
+    REQUIRE(feb.size() == 1);
+    REQUIRE(feb[0].image_id == 3);
+    REQUIRE(feb[0].left == 9);
+
+    bounds_2d<double> west = everywhere;
+    west.right = 7.5;
+    auto w = s.find_range_st(west, "2020-01-01T00:00:00", "2020-12-31T00:00:00", {"B01"}, {}, "");
+    REQUIRE(w.size() == 2);
+    REQUIRE(w[0].image_id == 1);
+    REQUIRE(w[1].image_id == 2);
+
+    std::vector<image_collection::image_md_predicate> filter(1);
+    filter[0] = image_collection::image_md_predicate{"eo:cloud_cover", "<", "10"};
+    REQUIRE_THROWS(s.find_range_st(everywhere, "2020-01-01T00:00:00", "2020-12-31T00:00:00", {}, filter, ""));
+    std::remove(f.c_str());
+}
+
+TEST_CASE("Footprints in collection snapshots", "[collection_snapshot]") {
+    std::vector<image_collection::bands_row> bands(1);
+    bands[0].id = 0;
+    bands[0].name = "B01";
+    bands[0].type = GDT_UInt16;
+    bands[0].offset = 0;
+    bands[0].scale = 1;
+    bands[0].image_count = 2;
+
+    // both images cover (7, 50) - (8, 51), image 1 has valid data in the western half only
+    std::vector<image_collection::find_range_st_row> rows;
+    rows.push_back(snapshot_test_row(1, "2020-01-01", "B01", 7));
+    rows.push_back(snapshot_test_row(2, "2020-01-01", "B01", 7));
+    OGRGeometry* fp = nullptr;
+    REQUIRE(OGRGeometryFactory::createFromWkt("POLYGON((7 50, 7.4 50, 7.4 51, 7 51, 7 50))", nullptr, &fp) == OGRERR_NONE);
+    std::string wkb(fp->WkbSize(), '\0');
+    fp->exportToWkb(wkbNDR, reinterpret_cast<unsigned char*>(&wkb[0]));
+    OGRGeometryFactory::destroyGeometry(fp);
+
+    std::string f = "test_collection_snapshot_footprints.snapshot";
+    collection_snapshot::write(f, bands, rows, {{1, wkb}}, {}, "", {"gdalrefs.image_id", "gdalrefs.descriptor"});
+    collection_snapshot s(f);
+    REQUIRE(s.has_footprints());
+    std::unordered_map<uint32_t, std::string> footprints = s.get_image_footprints({1, 2, 3});
+    REQUIRE(footprints.size() == 1);
+    REQUIRE(footprints[1] == wkb);
+
+    bounds_2d<double> east;
+    east.left = 7.6;
+    east.right = 7.9;
+    east.bottom = 50.2;
+    east.top = 50.8;
+    OGRGeometry* east_poly = nullptr;
+    REQUIRE(OGRGeometryFactory::createFromWkt("POLYGON((7.6 50.2, 7.9 50.2, 7.9 50.8, 7.6 50.8, 7.6 50.2))", nullptr, &east_poly) == OGRERR_NONE);
+
+    // without a range polygon, only bounding boxes are tested
+    REQUIRE(s.find_range_st(east, "2020-01-01T00:00:00", "2020-01-01T00:00:00", {}, {}, "").size() == 2);
+    auto x = s.find_range_st(east, "2020-01-01T00:00:00", "2020-01-01T00:00:00", {}, {}, "", east_poly);
+    REQUIRE(x.size() == 1);
+    REQUIRE(x[0].image_id == 2);
+    OGRGeometryFactory::destroyGeometry(east_poly);
+    std::remove(f.c_str());
+}
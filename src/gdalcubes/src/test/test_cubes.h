@@ -0,0 +1,156 @@
+/*
+    MIT License
+
+    Copyright (c) 2023 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#ifndef TEST_CUBES_H
+#define TEST_CUBES_H
+
+/*
+ * In-memory data cubes and helper functions shared by tests of cube operations
+ */
+
+#include <cmath>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "../cube.h"
+#include "../thread_pool.h"
+
+namespace gdalcubes {
+
+// bands with values given by a function of band, time, y, and x indexes; chunks without any value are empty
+class function_cube : public cube {
+   public:
+    typedef std::function<double(uint16_t, uint32_t, uint32_t, uint32_t)> value_function;
+
+    function_cube(cube_view v, std::vector<std::string> bands, value_function f) : cube(std::make_shared<cube_view>(v)), _f(f) {
+        for (uint16_t i = 0; i < bands.size(); ++i) {
+            _bands.add(band(bands[i]));
+        }
+        _chunk_size = {size_t(), size_y(), size_x()};
+    }
+
+    // single band "v" with values given by a function of time, y, and x indexes
+    function_cube(cube_view v, std::function<double(uint32_t, uint32_t, uint32_t)> f)
+        : function_cube(v, {"v"}, [f](uint16_t, uint32_t it, uint32_t iy, uint32_t ix) { return f(it, iy, ix); }) {}
+
+    void set_chunk_size(uint32_t t, uint32_t y, uint32_t x) {
+        _chunk_size = {t, y, x};
+    }
+
+    std::shared_ptr<chunk_data> read_chunk(chunkid_t id) override {
+        std::shared_ptr<chunk_data> out = std::make_shared<chunk_data>();
+        if (id >= count_chunks()) return out;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            ++reads[id];
+        }
+        bounds_nd<uint32_t, 3> lim = chunk_limits(id);
+        coords_nd<uint32_t, 3> s = chunk_size(id);
+        uint16_t nb = uint16_t(size_bands());
+        out->size({nb, s[0], s[1], s[2]});
+        out->buf(std::calloc(uint64_t(nb) * s[0] * s[1] * s[2], sizeof(double)));
+        double *buf = (double *)out->buf();
+        for (uint16_t ib = 0; ib < nb; ++ib) {
+            for (uint32_t it = 0; it < s[0]; ++it) {
+                for (uint32_t iy = 0; iy < s[1]; ++iy) {
+                    for (uint32_t ix = 0; ix < s[2]; ++ix) {
+                        buf[((uint64_t(ib) * s[0] + it) * s[1] + iy) * s[2] + ix] = _f(ib, lim.low[0] + it, lim.low[1] + iy, lim.low[2] + ix);
+                    }
+                }
+            }
+        }
+        if (out->all_nan()) {
+            out = std::make_shared<chunk_data>();
+        }
+        return out;
+    }
+
+    json11::Json make_constructible_json() override {
+        return json11::Json::object{};
+    }
+
+    // number of reads per chunk
+    std::map<chunkid_t, uint32_t> reads;
+
+   private:
+    value_function _f;
+    std::mutex _mutex;
+};
+
+// passes through chunks of another cube, e.g. to prevent operations from being rewritten for specific input cubes
+class passthrough_cube : public cube {
+   public:
+    passthrough_cube(std::shared_ptr<cube> in) : cube(in->st_reference()->copy()), _in_cube(in) {
+        _chunk_size = in->chunk_size();
+        for (uint16_t i = 0; i < in->bands().count(); ++i) {
+            _bands.add(in->bands().get(i));
+        }
+    }
+
+    std::shared_ptr<chunk_data> read_chunk(chunkid_t id) override {
+        return _in_cube->read_chunk(id);
+    }
+
+    json11::Json make_constructible_json() override {
+        return _in_cube->make_constructible_json();
+    }
+
+   private:
+    std::shared_ptr<cube> _in_cube;
+};
+
+// read all chunks of a cube into a single buffer with dimensions (b, t, y, x), values of empty chunks are NAN
+inline std::vector<double> read_dense(std::shared_ptr<cube> c, bool parallel = false) {
+    std::vector<double> out(uint64_t(c->size_bands()) * c->size_t() * c->size_y() * c->size_x(), NAN);
+    auto copy_chunk = [&c, &out](uint32_t id) {
+        std::shared_ptr<chunk_data> x = c->read_chunk(id);
+        if (x->empty()) return;
+        bounds_nd<uint32_t, 3> lim = c->chunk_limits(id);
+        const double *buf = (const double *)x->buf();
+        for (uint32_t ib = 0; ib < x->size()[0]; ++ib) {
+            for (uint32_t it = 0; it < x->size()[1]; ++it) {
+                for (uint32_t iy = 0; iy < x->size()[2]; ++iy) {
+                    for (uint32_t ix = 0; ix < x->size()[3]; ++ix) {
+                        uint64_t i = ((uint64_t(ib) * c->size_t() + lim.low[0] + it) * c->size_y() + lim.low[1] + iy) * c->size_x() + lim.low[2] + ix;
+                        out[i] = buf[((uint64_t(ib) * x->size()[1] + it) * x->size()[2] + iy) * x->size()[3] + ix];
+                    }
+                }
+            }
+        }
+    };
+    if (parallel) {
+        thread_pool::instance()->parallel_for(c->count_chunks(), copy_chunk, 4);
+    } else {
+        for (uint32_t id = 0; id < c->count_chunks(); ++id) copy_chunk(id);
+    }
+    return out;
+}
+
+}  // namespace gdalcubes
+
+#endif  // TEST_CUBES_H
@@ -0,0 +1,176 @@
+/*
+    MIT License
+
+    Copyright (c) 2019 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#include <cpl_vsi.h>
+#include <utime.h>
+
+#include <algorithm>
+#include <cstdio>  // std::remove
+#include <fstream>
+#include <string>
+
+#include "../config.h"
+#include "../dataset_pool.h"
+#include "../external/catch.hpp"
+#include "../filesystem.h"
+#include "../utils.h"
+
+using namespace gdalcubes;
+
+TEST_CASE("Archive of dataset descriptors", "[dataset_pool]") {
+    REQUIRE(archive_listing_cache::archive_of("/vsizip/x.zip/a.tif") == "x.zip");
+    REQUIRE(archive_listing_cache::archive_of("/vsizip//data/x.ZIP/dir/a.tif") == "/data/x.ZIP");
+    REQUIRE(archive_listing_cache::archive_of("/vsitar/x.tar/a.tif") == "x.tar");
+    REQUIRE(archive_listing_cache::archive_of("/vsitar/x.tar.gz/dir/a.tif") == "x.tar.gz");
+    REQUIRE(archive_listing_cache::archive_of("/vsitar/x.tgz/a.tif") == "x.tgz");
+
+    // the first archive extension ends the archive filename
+    REQUIRE(archive_listing_cache::archive_of("/vsizip/outer.zip/inner.zip/a.tif") == "outer.zip");
+    REQUIRE(archive_listing_cache::archive_of("/vsizip/{/data/x.y}/a.tif") == "/data/x.y");
+    REQUIRE(archive_listing_cache::archive_of("/vsizip/{/data/x.y/a.tif") == "");
+
+    REQUIRE(archive_listing_cache::archive_of("/vsizip/x/a.tif") == "");
+    REQUIRE(archive_listing_cache::archive_of("/vsigzip/x.gz") == "");
+    REQUIRE(archive_listing_cache::archive_of("x.zip/a.tif") == "");
+    REQUIRE(archive_listing_cache::archive_of("/vsicurl/https://example.com/x.zip/a.tif") == "");
+}
+
+static void test_zip_add(std::string archive, std::string name) {
+    VSILFILE *f = VSIFOpenL(("/vsizip/" + archive + "/" + name).c_str(), "wb");
+    REQUIRE(f != nullptr);
+    VSIFWriteL("x", 1, 1, f);
+    VSIFCloseL(f);
+}
+
+static std::vector<std::string> test_sorted(std::vector<std::string> x) {
+    std::sort(x.begin(), x.end());
+    return x;
+}
+
+TEST_CASE("Archive listing cache", "[dataset_pool]") {
+    std::string dir = "test_archive_listing_cache";
+    std::string cache_dir = filesystem::join(dir, "cache");
+    std::string archive = filesystem::join(dir, "x.zip");
+    VSIRmdirRecursive(dir.c_str());
+    filesystem::mkdir(dir);
+    std::string prev_cache_dir = config::instance()->get_archive_cache_dir();
+    config::instance()->set_archive_cache_dir(cache_dir);
+    archive_listing_cache::instance()->clear();
+
+    test_zip_add(archive, "a.tif");
+    std::vector<std::string> x = archive_listing_cache::instance()->list(archive, "/vsizip/");
+    REQUIRE(x == std::vector<std::string>{"/vsizip/" + archive + "/a.tif"});
+
+    // listings are written atomically, no temporary files remain
+    std::string cache_file = filesystem::join(cache_dir, "archive_" + utils::hash("/vsizip/" + archive) + ".txt");
+    REQUIRE(filesystem::exists(cache_file));
+    uint16_t nfiles = 0;
+    filesystem::iterate_directory(cache_dir, [&nfiles](const std::string &f) {
+        std::string name = filesystem::filename(f);
+        if (name == "." || name == "..") return;
+        REQUIRE(filesystem::extension(f) == "txt");
+        ++nfiles;
+    });
+    REQUIRE(nfiles == 1);
+    std::ifstream is(cache_file);
+    std::string line;
+    std::getline(is, line);
+    REQUIRE(line == "/vsizip/" + archive);
+    is.close();
+
+    // in-memory listings are reused without reading the cache file
+    std::remove(cache_file.c_str());
+    REQUIRE(archive_listing_cache::instance()->list(archive, "/vsizip/") == x);
+    REQUIRE(!filesystem::exists(cache_file));
+
+    // adding a file changes the size of the archive and invalidates the listing
+    test_zip_add(archive, "b.tif");
+    x = archive_listing_cache::instance()->list(archive, "/vsizip/");
+    REQUIRE(test_sorted(x) == std::vector<std::string>{"/vsizip/" + archive + "/a.tif", "/vsizip/" + archive + "/b.tif"});
+    REQUIRE(filesystem::exists(cache_file));
+
+    // listing files are reused across sessions if size and modification time are unchanged
+    VSIStatBufL s;
+    REQUIRE(VSIStatL(archive.c_str(), &s) == 0);
+    {
+        std::ofstream os(cache_file);
+        os << "/vsizip/" << archive << "\n"
+           << s.st_size << "\t" << s.st_mtime << "\n"
+           << "c.tif\n";
+    }
+    archive_listing_cache::instance()->clear();
+    REQUIRE(archive_listing_cache::instance()->list(archive, "/vsizip/") == std::vector<std::string>{"/vsizip/" + archive + "/c.tif"});
+
+    // a changed modification time invalidates listings in memory and on disk
+    struct utimbuf t;
+    t.actime = s.st_mtime + 10;
+    t.modtime = s.st_mtime + 10;
+    REQUIRE(utime(archive.c_str(), &t) == 0);
+    x = archive_listing_cache::instance()->list(archive, "/vsizip/");
+    REQUIRE(test_sorted(x) == std::vector<std::string>{"/vsizip/" + archive + "/a.tif", "/vsizip/" + archive + "/b.tif"});
+
+    config::instance()->set_archive_cache_dir(prev_cache_dir);
+    archive_listing_cache::instance()->clear();
+    VSIRmdirRecursive(dir.c_str());
+}
+
+TEST_CASE("Archive members are looked up in cached listings", "[dataset_pool]") {
+    std::string dir = "test_archive_lookup";
+    std::string archive = filesystem::join(dir, "x.zip");
+    VSIRmdirRecursive(dir.c_str());
+    filesystem::mkdir(dir);
+    std::string prev_cache_dir = config::instance()->get_archive_cache_dir();
+    config::instance()->set_archive_cache_dir(filesystem::join(dir, "cache"));
+    archive_listing_cache::instance()->clear();
+    test_zip_add(archive, "a.tif");
+
+    // nothing is known before the archive has been listed
+    bool contained = false;
+    REQUIRE(!archive_listing_cache::instance()->lookup("/vsizip/" + archive + "/a.tif", contained));
+
+    archive_listing_cache::instance()->list(archive, "/vsizip/");
+    REQUIRE(archive_listing_cache::instance()->lookup("/vsizip/" + archive + "/a.tif", contained));
+    REQUIRE(contained);
+    REQUIRE(archive_listing_cache::instance()->lookup("/vsizip/{" + archive + "}/a.tif", contained));
+    REQUIRE(contained);
+    REQUIRE(archive_listing_cache::instance()->lookup("/vsizip/" + archive + "/b.tif", contained));
+    REQUIRE(!contained);
+
+    // listings in the cache directory are used after a restart
+    archive_listing_cache::instance()->clear();
+    REQUIRE(archive_listing_cache::instance()->lookup("/vsizip/" + archive + "/b.tif", contained));
+    REQUIRE(!contained);
+
+    // members missing in the listing are not opened
+    REQUIRE(gdal_dataset_pool::instance()->acquire("/vsizip/" + archive + "/b.tif") == nullptr);
+
+    // outdated listings are ignored
+    test_zip_add(archive, "b.tif");
+    REQUIRE(!archive_listing_cache::instance()->lookup("/vsizip/" + archive + "/b.tif", contained));
+
+    config::instance()->set_archive_cache_dir(prev_cache_dir);
+    archive_listing_cache::instance()->clear();
+    VSIRmdirRecursive(dir.c_str());
+}
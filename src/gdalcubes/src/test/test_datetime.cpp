@@ -21,9 +21,12 @@
     OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
     SOFTWARE.
 */
+#include <iostream>
 #include <string>
+#include <vector>
 
 #include "../datetime.h"
+#include "../timer.h"
 #include "../external/catch.hpp"
 
 using namespace gdalcubes;
@@ -125,4 +128,69 @@ TEST_CASE("Datetime Access Functions", "[datetime]") {
     REQUIRE(xxx.month() == 4);
     REQUIRE(xxx.dayofmonth() == 30);
 
-}
\ No newline at end of file
+}
+
+
+TEST_CASE("Fixed-format datetime parsing", "[datetime]") {
+    // fast path must agree with the generic digit parser
+    std::vector<std::string> s = {"2002", "2002-03", "2002-03-04", "20020304", "2002-03-04T12", "2002-03-04 12:13",
+                                  "2002-03-04T12:13:14", "20020304T121314", "2021-06-29T10:03:38.494534Z",
+                                  "2021-06-29T10:03:38+01:00", "2021-06-29T10:03:38-0100", "2021-06-29T10:03Z"};
+    for (uint32_t i = 0; i < s.size(); ++i) {
+        datetime a = datetime::from_string(s[i]);
+        datetime b = datetime::from_YmdHMS_digits(s[i]);
+        REQUIRE(a.unit() == b.unit());
+        REQUIRE(a.to_string() == b.to_string());
+    }
+
+    // day of year
+    datetime x = datetime::from_string("2020-061");
+    REQUIRE(x.unit() == datetime_unit::DAY);
+    REQUIRE(x.to_string() == "2020-03-01");
+    REQUIRE(datetime::from_string("2019-365").to_string() == "2019-12-31");
+
+    // fast path of tryparse
+    REQUIRE(date::format("%Y-%m-%dT%H:%M:%S", datetime::tryparse("%Y%m%d", "20180401")) == "2018-04-01T00:00:00");
+    REQUIRE(date::format("%Y-%m-%dT%H:%M:%S", datetime::tryparse("%Y-%m-%dT%H:%M:%S", "2018-04-01T12:30:59")) == "2018-04-01T12:30:59");
+    REQUIRE(date::format("%Y-%m-%d", datetime::tryparse("%Y%j", "2018032")) == "2018-02-01");
+    REQUIRE(date::format("%Y-%m-%d", datetime::tryparse("%Y_%m_%d", "2018_4_1")) == "2018-04-01");  // generic fallback
+
+    // integer time index arithmetic
+    datetime t0 = datetime::from_string("2018-01-01");
+    datetime t = datetime::from_string("2018-03-05T13:14:15");
+    t.unit(datetime_unit::DAY);
+    REQUIRE(t.to_string() == "2018-03-05");
+    duration dt = duration::from_string("P8D");
+    REQUIRE((t - t0) / dt == 7);
+    t = datetime::from_string("2018-03-05T13:14:15");
+    t.unit(datetime_unit::MONTH);
+    REQUIRE(t.to_string() == "2018-03-01");
+    t0.unit(datetime_unit::MONTH);
+    dt = duration::from_string("P1M");
+    REQUIRE((t - t0) / dt == 2);
+}
+
+TEST_CASE("Datetime parsing throughput", "[.][benchmark]") {
+    const uint32_t n = 1000000;
+    std::vector<std::string> s = {"2018-04-01T10:03:38Z", "2018-04-01", "20180401T100338", "2018-091"};
+    for (uint32_t j = 0; j < s.size(); ++j) {
+        int64_t checksum = 0;
+        timer t;
+        for (uint32_t i = 0; i < n; ++i) {
+            checksum += datetime::from_string(s[j]).dayofmonth();
+        }
+        double t_fast = t.time();
+        t.start();
+        for (uint32_t i = 0; i < n; ++i) {
+            checksum += datetime::from_YmdHMS_digits(s[j]).dayofmonth();
+        }
+        double t_digits = t.time();
+        t.start();
+        for (uint32_t i = 0; i < n / 10; ++i) {
+            checksum += date::floor<date::days>(datetime::tryparse("%Y-%m-%dT%H:%M:%S", "2018-04-01T10:03:38")).time_since_epoch().count() > 0;
+        }
+        double t_generic = t.time() * 10;
+        std::cout << "'" << s[j] << "': from_string " << (n / t_fast) / 1e6 << " M/s, from_YmdHMS_digits " << (n / t_digits) / 1e6
+                  << " M/s, tryparse " << (n / t_generic) / 1e6 << " M/s (" << checksum << ")" << std::endl;
+    }
+}
@@ -0,0 +1,331 @@
+/*
+    MIT License
+
+    Copyright (c) 2023 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#include <sqlite3.h>
+
+#include <cstdio>  // std::remove
+#include <string>
+
+#include "../external/catch.hpp"
+#include "../image_collection.h"
+#include "../image_collection_cube.h"
+
+using namespace gdalcubes;
+
+static std::string test_sqlite_value(sqlite3 *db, std::string sql) {
+    std::string out = "";
+    sqlite3_stmt *stmt;
+    sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, NULL);
+    if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_text(stmt, 0)) {
+        out = std::string(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0)));
+    }
+    sqlite3_finalize(stmt);
+    return out;
+}
+
+TEST_CASE("Bulk insert rollback", "[image_collection]") {
+    std::shared_ptr<image_collection> ic = image_collection::create();
+    sqlite3 *db = ic->get_db_handle();
+    sqlite3_exec(db, "PRAGMA synchronous = NORMAL;", NULL, NULL, NULL);
+    std::string journal_mode = test_sqlite_value(db, "PRAGMA journal_mode;");
+
+    ic->bulk_insert_start();
+    REQUIRE(test_sqlite_value(db, "PRAGMA synchronous;") == "0");
+    ic->insert_bands({1, 2}, {"B1", "B2"});
+    ic->insert_images({1}, {"img1"}, {0}, {1}, {0}, {1}, {"2020-01-01"}, {"EPSG:4326"});
+
+    // image 5 does not exist, the foreign key constraint fails and the whole bulk insert is rolled back
+    REQUIRE_THROWS(ic->insert_datasets({1, 5}, {1, 1}, {"img1_B1.tif", "img5_B1.tif"}, {1, 1}));
+    REQUIRE(sqlite3_get_autocommit(db) != 0);
+    REQUIRE(ic->count_bands() == 0);
+    REQUIRE(ic->count_images() == 0);
+    REQUIRE(ic->count_gdalrefs() == 0);
+    REQUIRE(test_sqlite_value(db, "SELECT count(*) FROM sqlite_master WHERE type = 'index' AND name = 'idx_gdalrefs_imageid';") == "1");
+    REQUIRE(test_sqlite_value(db, "PRAGMA synchronous;") == "1");
+    REQUIRE(test_sqlite_value(db, "PRAGMA journal_mode;") == journal_mode);
+
+    // aborting again has no effect
+    ic->bulk_insert_abort();
+
+    // collection is still usable
+    ic->bulk_insert_start();
+    ic->insert_bands({1, 2}, {"B1", "B2"});
+    ic->insert_images({1}, {"img1"}, {0}, {1}, {0}, {1}, {"2020-01-01"}, {"EPSG:4326"});
+    ic->insert_datasets({1, 1}, {1, 2}, {"img1_B1.tif", "img1_B2.tif"}, {1, 1});
+    ic->bulk_insert_end();
+    REQUIRE(ic->count_bands() == 2);
+    REQUIRE(ic->count_images() == 1);
+    REQUIRE(ic->count_gdalrefs() == 2);
+    REQUIRE(test_sqlite_value(db, "PRAGMA synchronous;") == "1");
+}
+
+TEST_CASE("Bulk insert restores journal mode", "[image_collection]") {
+    std::string f = "test_image_collection_bulk.db";
+    std::remove(f.c_str());
+    image_collection::create()->write(f);
+    {
+        image_collection ic(f);
+        sqlite3 *db = ic.get_db_handle();
+        sqlite3_exec(db, "PRAGMA journal_mode = WAL;", NULL, NULL, NULL);
+        REQUIRE(test_sqlite_value(db, "PRAGMA journal_mode;") == "wal");
+
+        ic.bulk_insert_start();
+        REQUIRE(test_sqlite_value(db, "PRAGMA journal_mode;") == "memory");
+        ic.insert_bands({1}, {"B1"});
+        ic.bulk_insert_end();
+        REQUIRE(test_sqlite_value(db, "PRAGMA journal_mode;") == "wal");
+        REQUIRE(ic.count_bands() == 1);
+
+        ic.bulk_insert_start();
+        REQUIRE_THROWS(ic.insert_bands({1}, {"B1"}));  // duplicate primary key
+        REQUIRE(test_sqlite_value(db, "PRAGMA journal_mode;") == "wal");
+        REQUIRE(ic.count_bands() == 1);
+    }
+    std::remove(f.c_str());
+    std::remove((f + "-wal").c_str());
+    std::remove((f + "-shm").c_str());
+}
+
+TEST_CASE("Create collections from tables", "[image_collection]") {
+    // row 2 duplicates row 1 and is skipped
+    std::shared_ptr<image_collection> ic = image_collection::create_from_tables(
+        {"B1", "B1", "B2", "B3"},
+        {"img1", "img1", "img1", "img2"},
+        {"EPSG:4326", "EPSG:4326", "EPSG:4326", "EPSG:4326"},
+        {"2020-01-01", "2020-01-01", "2020-01-01", "2020-01-02"},
+        {0, 0, 0, 0}, {1, 1, 1, 1}, {0, 0, 0, 0}, {1, 1, 1, 1},
+        {"img1_B1.tif", "img1_B1.tif", "img1_B2.tif", "img2_B3.tif"},
+        {1, 1, 1, 1});
+    REQUIRE(ic->count_images() == 2);
+    REQUIRE(ic->count_bands() == 3);
+    REQUIRE(ic->count_gdalrefs() == 3);
+    REQUIRE(sqlite3_get_autocommit(ic->get_db_handle()) != 0);
+}
+
+// two images with identical bounding box (0,0)-(2,2) but valid data in the left and right half only
+static std::shared_ptr<image_collection> test_footprint_collection() {
+    std::shared_ptr<image_collection> ic = image_collection::create_from_tables(
+        {"B1", "B1"}, {"img1", "img2"}, {"EPSG:4326", "EPSG:4326"}, {"2020-01-01", "2020-01-01"},
+        {0, 0}, {2, 2}, {0, 0}, {2, 2}, {"img1_B1.tif", "img2_B1.tif"}, {1, 1});
+    return ic;
+}
+
+TEST_CASE("Footprint insertion", "[image_collection]") {
+    std::shared_ptr<image_collection> ic = test_footprint_collection();
+    REQUIRE(!ic->has_footprints());
+    REQUIRE(!ic->has_footprints());  // cached
+
+    bounds_st range;
+    range.s.left = 1.5;
+    range.s.right = 1.9;
+    range.s.bottom = 0.5;
+    range.s.top = 1.5;
+    range.t0 = datetime::from_string("2020-01-01");
+    range.t1 = datetime::from_string("2020-01-01");
+    REQUIRE(ic->find_range_st(range, "EPSG:4326").size() == 2);
+
+    // the cached result must be updated on insertion
+    ic->insert_image_footprint(1, "POLYGON((0 0, 1 0, 1 2, 0 2, 0 0))");
+    REQUIRE(ic->has_footprints());
+    std::vector<image_collection::find_range_st_row> x = ic->find_range_st(range, "EPSG:4326");
+    REQUIRE(x.size() == 1);
+    REQUIRE(x[0].image_name == "img2");
+
+    // invalid geometries are ignored, images without footprint are never excluded
+    ic->insert_image_footprints({2}, {"POINT(0 0)"});
+    REQUIRE(ic->find_range_st(range, "EPSG:4326").size() == 1);
+
+    // footprints inserted within a bulk insert that is rolled back
+    std::shared_ptr<image_collection> ic2 = test_footprint_collection();
+    REQUIRE(!ic2->has_footprints());
+    ic2->bulk_insert_start();
+    ic2->insert_image_footprints({1}, {"POLYGON((0 0, 1 0, 1 2, 0 2, 0 0))"});
+    REQUIRE(ic2->has_footprints());
+    REQUIRE_THROWS(ic2->insert_image_footprints({1, 2}, {"POLYGON((0 0, 1 0, 1 2, 0 2, 0 0))"}));
+    REQUIRE(!ic2->has_footprints());
+    REQUIRE(ic2->find_range_st(range, "EPSG:4326").size() == 2);
+}
+
+TEST_CASE("Chunks are tested against footprints", "[image_collection]") {
+    std::shared_ptr<image_collection> ic = test_footprint_collection();
+    ic->insert_image_footprints({1, 2}, {"POLYGON((0 0, 0.9 0, 0.9 2, 0 2, 0 0))", "POLYGON((1.1 0, 2 0, 2 2, 1.1 2, 1.1 0))"});
+
+    cube_view v;
+    v.srs("EPSG:4326");
+    v.set_x_axis(0.0, 2.0, uint32_t(4));
+    v.set_y_axis(0.0, 2.0, uint32_t(4));
+    v.set_t_axis(datetime::from_string("2020-01-01"), datetime::from_string("2020-01-01"), duration::from_string("P1D"));
+    std::shared_ptr<image_collection_cube> c = image_collection_cube::create(ic, v);
+    c->set_chunk_size(1, 2, 2);
+    REQUIRE(c->count_chunks() == 4);
+
+    // chunks cover the left or right half of the images, each intersects with the footprint of one image only
+    for (chunkid_t id = 0; id < c->count_chunks(); ++id) {
+        bounds_st b = c->bounds_from_chunk(id);
+        std::vector<image_collection::find_range_st_row> x = ic->find_range_st(b, v.srs(), std::vector<std::string>{"B1"}, std::vector<std::string>{});
+        REQUIRE(x.size() == 1);
+        REQUIRE(x[0].image_name == (b.s.right <= 1 ? "img1" : "img2"));
+    }
+
+    // snapshots of worker processes keep the footprints and test each chunk against them
+    std::string f = "test_footprint_collection.snapshot";
+    bounds_st extent;
+    extent.s.left = 0;
+    extent.s.right = 2;
+    extent.s.bottom = 0;
+    extent.s.top = 2;
+    extent.t0 = v.t0();
+    extent.t1 = v.t1();
+    ic->write_snapshot(f, extent, v.srs(), {"B1"}, {}, "");
+    std::shared_ptr<image_collection> snap = std::make_shared<image_collection>(f);
+    REQUIRE(snap->is_snapshot());
+    REQUIRE(snap->has_footprints());
+    REQUIRE(snap->get_image_footprints({1, 2}).size() == 2);
+    for (chunkid_t id = 0; id < c->count_chunks(); ++id) {
+        bounds_st b = c->bounds_from_chunk(id);
+        std::vector<image_collection::find_range_st_row> x = snap->find_range_st(b, v.srs(), std::vector<std::string>{"B1"}, std::vector<std::string>{"gdalrefs.image_id", "gdalrefs.descriptor"});
+        REQUIRE(x.size() == 1);
+        REQUIRE(x[0].image_name == (b.s.right <= 1 ? "img1" : "img2"));
+    }
+    std::remove(f.c_str());
+}
+
+TEST_CASE("Image metadata predicates", "[image_collection]") {
+    image_collection::image_md_predicate p = image_collection::image_md_predicate::from_string("eo:cloud_cover <= 30");
+    REQUIRE(p.key == "eo:cloud_cover");
+    REQUIRE(p.op == "<=");
+    REQUIRE(p.value == "30");
+    REQUIRE(!p.quoted);
+    REQUIRE(p.to_string() == "eo:cloud_cover <= 30");
+    REQUIRE(image_collection::image_md_predicate_sql(p) == "images.id IN (SELECT image_id FROM image_md WHERE key = 'eo:cloud_cover' AND CAST(value AS REAL) <= 30)");
+
+    p = image_collection::image_md_predicate::from_string("tile=='07'");
+    REQUIRE(p.key == "tile");
+    REQUIRE(p.op == "=");
+    REQUIRE(p.value == "07");
+    REQUIRE(p.quoted);
+    REQUIRE(p.to_string() == "tile = '07'");
+    REQUIRE(image_collection::image_md_predicate_sql(p) == "images.id IN (SELECT image_id FROM image_md WHERE key = 'tile' AND value = '07')");
+    REQUIRE(image_collection::image_md_predicate::from_string(p.to_string()).quoted);
+
+    p = image_collection::image_md_predicate::from_string("name != \"it's\"");
+    REQUIRE(p.value == "it's");
+    REQUIRE(p.to_string() == "name != \"it's\"");
+    REQUIRE(image_collection::image_md_predicate_sql(p) == "images.id IN (SELECT image_id FROM image_md WHERE key = 'name' AND value != 'it''s')");
+
+    p = image_collection::image_md_predicate::from_string("platform = sentinel-2a");
+    REQUIRE(!p.quoted);
+    REQUIRE(image_collection::image_md_predicate_sql(p) == "images.id IN (SELECT image_id FROM image_md WHERE key = 'platform' AND value = 'sentinel-2a')");
+
+    REQUIRE_THROWS(image_collection::image_md_predicate::from_string("eo:cloud_cover 30"));
+    REQUIRE_THROWS(image_collection::image_md_predicate::from_string("= 30"));
+    REQUIRE_THROWS(image_collection::image_md_predicate::from_string("eo:cloud_cover ! 30"));
+}
+
+TEST_CASE("Filter and order images by metadata", "[image_collection]") {
+    std::shared_ptr<image_collection> ic = image_collection::create_from_tables(
+        {"B1", "B1", "B1", "B1"}, {"img1", "img2", "img3", "img4"},
+        {"EPSG:4326", "EPSG:4326", "EPSG:4326", "EPSG:4326"}, {"2020-01-01", "2020-01-01", "2020-01-01", "2020-01-01"},
+        {0, 0, 0, 0}, {1, 1, 1, 1}, {0, 0, 0, 0}, {1, 1, 1, 1},
+        {"img1_B1.tif", "img2_B1.tif", "img3_B1.tif", "img4_B1.tif"}, {1, 1, 1, 1});
+    ic->insert_image_md({1, 2, 3, 1, 2, 3, 4}, {"eo:cloud_cover", "eo:cloud_cover", "eo:cloud_cover", "tile", "tile", "tile", "tile"},
+                        {"20", "5", "100", "07", "7", "07", "7.0"});
+
+    bounds_st range;
+    range.s.left = 0.2;
+    range.s.right = 0.8;
+    range.s.bottom = 0.2;
+    range.s.top = 0.8;
+    range.t0 = datetime::from_string("2020-01-01");
+    range.t1 = datetime::from_string("2020-01-01");
+    auto names = [](const std::vector<image_collection::find_range_st_row>& x) {
+        std::string out;
+        for (uint32_t i = 0; i < x.size(); ++i) out += x[i].image_name + ";";
+        return out;
+    };
+
+    // quoted values are compared as strings, unquoted numbers numerically
+    std::vector<image_collection::image_md_predicate> f = {image_collection::image_md_predicate::from_string("tile = '07'")};
+    REQUIRE(names(ic->find_range_st(range, "EPSG:4326", {}, {"gdalrefs.image_id"}, f)) == "img1;img3;");
+    f = {image_collection::image_md_predicate::from_string("tile = 7")};
+    REQUIRE(names(ic->find_range_st(range, "EPSG:4326", {}, {"gdalrefs.image_id"}, f)) == "img1;img2;img3;img4;");
+    f = {image_collection::image_md_predicate::from_string("eo:cloud_cover < 30")};
+    REQUIRE(names(ic->find_range_st(range, "EPSG:4326", {}, {"gdalrefs.image_id"}, f)) == "img1;img2;");
+
+    // numeric order (100 after 20), images without the key come last in both directions
+    std::vector<image_collection::image_md_predicate> none;
+    REQUIRE(names(ic->find_range_st(range, "EPSG:4326", {}, {}, none, "eo:cloud_cover")) == "img2;img1;img3;img4;");
+    REQUIRE(names(ic->find_range_st(range, "EPSG:4326", {}, {}, none, "-eo:cloud_cover")) == "img3;img1;img2;img4;");
+    f = {image_collection::image_md_predicate::from_string("tile = '07'")};
+    REQUIRE(names(ic->find_range_st(range, "EPSG:4326", {}, {}, f, "-eo:cloud_cover")) == "img3;img1;");
+}
+
+TEST_CASE("Sharded collections open intersecting shards only", "[image_collection]") {
+    std::string manifest = "test_image_collection_shards.db";
+    std::string shard2020 = "test_image_collection_shards_2020.db";
+    std::string shard2021 = "test_image_collection_shards_2021.db";
+    std::remove(manifest.c_str());
+    std::remove(shard2020.c_str());
+    std::remove(shard2021.c_str());
+
+    std::shared_ptr<image_collection> ic = image_collection::create_from_tables(
+        {"B1", "B2", "B1", "B2", "B1"}, {"img1", "img1", "img2", "img2", "img3"},
+        {"EPSG:4326", "EPSG:4326", "EPSG:4326", "EPSG:4326", "EPSG:4326"},
+        {"2020-06-01", "2020-06-01", "2021-06-01", "2021-06-01", "2021-07-01"},
+        {0, 0, 0, 0, 0}, {2, 2, 2, 2, 2}, {0, 0, 0, 0, 0}, {2, 2, 2, 2, 2},
+        {"img1_B1.tif", "img1_B2.tif", "img2_B1.tif", "img2_B2.tif", "img3_B1.tif"}, {1, 1, 1, 1, 1});
+    ic->partition(manifest, "year", 0).reset();
+
+    // shards that are opened fail after removing their file
+    std::remove(shard2020.c_str());
+    {
+        std::shared_ptr<image_collection> sc = std::make_shared<image_collection>(manifest);
+        REQUIRE(sc->is_sharded());
+        REQUIRE(sc->count_images() == 3);
+        REQUIRE(sc->distinct_srs() == "EPSG:4326");
+        REQUIRE(sc->is_aligned());
+        std::vector<image_collection::bands_row> bands = sc->get_all_bands();
+        REQUIRE(bands.size() == 2);
+        REQUIRE(bands[0].name == "B1");
+        REQUIRE(bands[0].image_count == 3);
+        REQUIRE(bands[1].image_count == 2);
+
+        cube_view v;
+        v.srs("EPSG:4326");
+        v.set_x_axis(0.0, 2.0, uint32_t(4));
+        v.set_y_axis(0.0, 2.0, uint32_t(4));
+        v.set_t_axis(datetime::from_string("2021-06"), datetime::from_string("2021-07"), duration::from_string("P1M"));
+        std::shared_ptr<image_collection_cube> c = image_collection_cube::create(sc, v);
+        REQUIRE(c->bands().count() == 2);
+        std::vector<image_collection::find_range_st_row> x = sc->find_range_st(c->bounds_from_chunk(0), v.srs(), std::vector<std::string>{}, std::vector<std::string>{"gdalrefs.image_id"});
+        REQUIRE(x.size() == 3);
+
+        bounds_st range = c->bounds_from_chunk(0);
+        range.t0 = datetime::from_string("2020-06-01");
+        REQUIRE_THROWS(sc->find_range_st(range, v.srs(), std::vector<std::string>{}, std::vector<std::string>{"gdalrefs.image_id"}));
+    }
+    std::remove(manifest.c_str());
+    std::remove(shard2021.c_str());
+}
@@ -0,0 +1,174 @@
+/*
+    MIT License
+
+    Copyright (c) 2023 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#include <cpl_vsi.h>
+#include <gdal_priv.h>
+
+#include <cstdio>  // std::remove
+#include <fstream>
+#include <string>
+
+#include "../external/catch.hpp"
+#include "../filesystem.h"
+#include "../image_collection_ops.h"
+
+using namespace gdalcubes;
+
+TEST_CASE("Largest first ordering", "[image_collection_ops]") {
+    std::vector<uint32_t> order = image_collection_ops::largest_first({10, 30, 20, 30, 0});
+    REQUIRE(order == std::vector<uint32_t>{1, 3, 2, 0, 4});
+    REQUIRE(image_collection_ops::largest_first({}).empty());
+}
+
+TEST_CASE("Missing overview levels", "[image_collection_ops]") {
+    REQUIRE(image_collection_ops::missing_overview_levels(1000, {}, {2, 4, 8}) == std::vector<int>{2, 4, 8});
+    REQUIRE(image_collection_ops::missing_overview_levels(1000, {500, 250, 125}, {2, 4, 8}).empty());
+
+    // as many overviews as requested levels but with different factors
+    REQUIRE(image_collection_ops::missing_overview_levels(1000, {250, 125}, {2, 4}) == std::vector<int>{2});
+    REQUIRE(image_collection_ops::missing_overview_levels(1000, {500, 250}, {2, 4, 8, 16}) == std::vector<int>{8, 16});
+
+    // overview sizes are rounded up
+    REQUIRE(image_collection_ops::missing_overview_levels(1001, {501, 251, 126}, {2, 4, 8}).empty());
+    REQUIRE(image_collection_ops::missing_overview_levels(1001, {500}, {2}).empty());
+    REQUIRE(image_collection_ops::missing_overview_levels(1000, {}, {1}).empty());
+}
+
+TEST_CASE("Translate manifest", "[image_collection_ops]") {
+    std::string dir = "test_translate_manifest";
+    filesystem::mkdir(dir);
+    std::string file = filesystem::join(dir, translate_manifest::FILENAME);
+    std::remove(file.c_str());
+    {
+        // without manifest of a previous run, existing outputs are up to date if newer than the source
+        translate_manifest m(dir, false);
+        REQUIRE(m.up_to_date("1/1.tif", 100, 50, 80, 60));
+        REQUIRE(!m.up_to_date("1/1.tif", 100, 50, 80, 40));
+        m.add("1/1.tif", 100, 50, 80);
+        m.add("1/2.tif", 200, 50, 160);
+    }
+    {
+        // resume: only recorded outputs with identical source and output are up to date
+        translate_manifest m(dir, false);
+        REQUIRE(m.up_to_date("1/1.tif", 100, 50, 80, 0));
+        REQUIRE(!m.up_to_date("1/1.tif", 100, 51, 80, 60));  // source modified
+        REQUIRE(!m.up_to_date("1/1.tif", 101, 50, 80, 60));
+        REQUIRE(!m.up_to_date("1/2.tif", 200, 50, 100, 60));  // incomplete output
+        REQUIRE(!m.up_to_date("2/1.tif", 100, 50, 80, 60));   // not recorded, e.g. interrupted
+        m.add("2/1.tif", 100, 50, 80);
+    }
+    {
+        translate_manifest m(dir, false);
+        REQUIRE(m.up_to_date("2/1.tif", 100, 50, 80, 60));
+    }
+    {
+        // overwrite discards all entries
+        translate_manifest m(dir, true);
+        REQUIRE(!m.up_to_date("1/1.tif", 100, 50, 80, 0));
+    }
+    std::ifstream is(file);
+    REQUIRE(is.peek() == std::ifstream::traits_type::eof());
+    is.close();
+    std::remove(file.c_str());
+    filesystem::remove(dir);
+}
+
+// single-band GeoTIFF with n x n pixels
+static void test_create_gtiff(std::string file, int n) {
+    GDALDriver* drv = GetGDALDriverManager()->GetDriverByName("GTiff");
+    GDALDataset* ds = drv->Create(file.c_str(), n, n, 1, GDT_Float64, nullptr);
+    double gt[6] = {0.0, 1.0 / n, 0.0, 1.0, 0.0, -1.0 / n};
+    ds->SetGeoTransform(gt);
+    ds->GetRasterBand(1)->Fill(1.0);
+    GDALClose((GDALDatasetH)ds);
+}
+
+static std::vector<int> test_overview_xsize(std::string file) {
+    std::vector<int> out;
+    GDALDataset* ds = (GDALDataset*)GDALOpen(file.c_str(), GA_ReadOnly);
+    for (int i = 0; i < ds->GetRasterBand(1)->GetOverviewCount(); ++i) {
+        out.push_back(ds->GetRasterBand(1)->GetOverview(i)->GetXSize());
+    }
+    GDALClose((GDALDatasetH)ds);
+    return out;
+}
+
+TEST_CASE("Translate images and create overviews", "[image_collection_ops]") {
+    GDALAllRegister();
+    std::string dir = "test_image_collection_ops";
+    std::string out_dir = filesystem::join(dir, "out");
+    VSIRmdirRecursive(dir.c_str());
+    filesystem::mkdir(dir);
+
+    std::vector<std::string> files = {filesystem::join(dir, "a.tif"), filesystem::join(dir, "b.tif"), filesystem::join(dir, "c.tif")};
+    test_create_gtiff(files[0], 64);
+    test_create_gtiff(files[1], 256);
+    test_create_gtiff(files[2], 128);
+    std::shared_ptr<image_collection> ic = image_collection::create_from_tables(
+        {"B1", "B1", "B1"}, {"a", "b", "c"}, {"EPSG:4326", "EPSG:4326", "EPSG:4326"}, {"2020-01-01", "2020-01-02", "2020-01-03"},
+        {0, 0, 0}, {1, 1, 1}, {0, 0, 0}, {1, 1, 1}, files, {1, 1, 1});
+    std::string icfile = filesystem::join(dir, "ic.db");
+    ic->write(icfile);
+
+    // outputs are written largest first and recorded in the manifest
+    image_collection_ops::translate_gtiff(ic, out_dir, 1, true);
+    std::ifstream is(filesystem::join(out_dir, translate_manifest::FILENAME));
+    std::vector<std::string> names;
+    std::string line;
+    while (std::getline(is, line)) names.push_back(line.substr(0, line.find('\t')));
+    is.close();
+    REQUIRE(names == std::vector<std::string>{"2/1.tif", "3/1.tif", "1/1.tif"});
+
+    // resume without changes keeps all outputs and does not add entries
+    image_collection_ops::translate_gtiff(std::make_shared<image_collection>(icfile), out_dir, 1, false);
+    is.open(filesystem::join(out_dir, translate_manifest::FILENAME));
+    uint16_t nlines = 0;
+    while (std::getline(is, line)) ++nlines;
+    is.close();
+    REQUIRE(nlines == 3);
+
+    // existing overviews with other factors do not prevent building the requested levels
+    std::string out_b = filesystem::join(out_dir, "2/1.tif");
+    GDALDataset* ds = (GDALDataset*)GDALOpen(out_b.c_str(), GA_Update);
+    int existing[2] = {4, 8};
+    ds->BuildOverviews("NEAREST", 2, existing, 0, nullptr, nullptr, nullptr);
+    GDALClose((GDALDatasetH)ds);
+    REQUIRE(test_overview_xsize(out_b).size() == 2);
+
+    std::shared_ptr<image_collection> out = std::make_shared<image_collection>(filesystem::join(out_dir, "ic.db"));
+    image_collection_ops::create_overviews(out, {2, 4}, "NEAREST", 1);
+    std::vector<int> ov = test_overview_xsize(out_b);
+    REQUIRE(ov.size() == 3);
+    REQUIRE(image_collection_ops::missing_overview_levels(256, ov, {2, 4, 8}).empty());
+    REQUIRE(image_collection_ops::missing_overview_levels(64, test_overview_xsize(filesystem::join(out_dir, "1/1.tif")), {2, 4}).empty());
+
+    // datasets with all levels are skipped
+    image_collection_ops::create_overviews(out, {2, 4}, "NEAREST", 1);
+    REQUIRE(test_overview_xsize(out_b).size() == 3);
+
+    out.reset();
+    ic.reset();
+    VSIRmdirRecursive(dir.c_str());
+}
@@ -0,0 +1,180 @@
+/*
+    MIT License
+
+    Copyright (c) 2023 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#include <atomic>
+#include <cmath>
+
+#include "../external/catch.hpp"
+#include "../image_collection_cube.h"
+
+using namespace gdalcubes;
+
+// masks values in [lo, hi] and counts evaluations of is_masked()
+struct counting_mask : public image_mask {
+    counting_mask(double lo, double hi) : _lo(lo), _hi(hi), calls(0) {}
+
+    bool is_masked(double v) const override {
+        ++calls;
+        return v >= _lo && v <= _hi;
+    }
+
+    json11::Json as_json() override {
+        return json11::Json::object{};
+    }
+
+    using image_mask::build_lut;
+
+    double _lo;
+    double _hi;
+    mutable std::atomic<uint32_t> calls;
+};
+
+static std::vector<uint8_t> evaluate_all(std::shared_ptr<image_mask> m, std::vector<double> v) {
+    std::vector<uint8_t> out(v.size(), 2);
+    m->evaluate(v.data(), out.data(), v.size());
+    return out;
+}
+
+TEST_CASE("Masks are tabulated on first evaluation", "[image_mask]") {
+    auto m = std::make_shared<counting_mask>(10, 20);
+    REQUIRE(m->calls == 0);
+
+    std::vector<double> v = {0, 10, 15.5, 20, 21, 65535, 65536, -1, NAN};
+    REQUIRE(evaluate_all(m, v) == std::vector<uint8_t>({0, 1, 1, 1, 0, 0, 0, 0, 0}));
+    // 65536 table entries plus direct evaluation of 15.5, 65536, -1, and NAN
+    REQUIRE(m->calls == 65536 + 4);
+
+    m->calls = 0;
+    REQUIRE(evaluate_all(m, v) == std::vector<uint8_t>({0, 1, 1, 1, 0, 0, 0, 0, 0}));
+    REQUIRE(m->calls == 4);
+
+    // the table agrees with is_masked() for all tabulated values
+    std::vector<double> all(65536);
+    for (uint32_t i = 0; i < all.size(); ++i) all[i] = i;
+    std::vector<uint8_t> res = evaluate_all(m, all);
+    for (uint32_t i = 0; i < all.size(); ++i) {
+        REQUIRE(res[i] == (m->is_masked(all[i]) ? 1 : 0));
+    }
+
+    // rebuilding the table gives the same results
+    m->build_lut();
+    REQUIRE(evaluate_all(m, v) == std::vector<uint8_t>({0, 1, 1, 1, 0, 0, 0, 0, 0}));
+}
+
+TEST_CASE("Value and range masks", "[image_mask]") {
+    std::vector<double> v = {0, 1, 3, 8, 9, 10, 255, 3.5, NAN};
+
+    auto vm = std::make_shared<value_mask>(std::unordered_set<double>{8, 9, 3.5});
+    REQUIRE(evaluate_all(vm, v) == std::vector<uint8_t>({0, 0, 0, 1, 1, 0, 0, 1, 0}));
+    auto vmi = std::make_shared<value_mask>(std::unordered_set<double>{8, 9, 3.5}, true);
+    REQUIRE(evaluate_all(vmi, v) == std::vector<uint8_t>({1, 1, 1, 0, 0, 1, 1, 0, 1}));
+
+    auto rm = std::make_shared<range_mask>(3, 9);
+    REQUIRE(evaluate_all(rm, v) == std::vector<uint8_t>({0, 0, 1, 1, 1, 0, 0, 1, 0}));
+    auto rmi = std::make_shared<range_mask>(3, 9, true);
+    REQUIRE(evaluate_all(rmi, v) == std::vector<uint8_t>({1, 1, 0, 0, 0, 1, 1, 0, 0}));
+
+    // bits 0 and 1 only, e.g. 255 -> 3 and 10 -> 2
+    auto bm = std::make_shared<value_mask>(std::unordered_set<double>{3}, false, std::vector<uint8_t>{0, 1});
+    REQUIRE(evaluate_all(bm, v) == std::vector<uint8_t>({0, 0, 1, 0, 0, 0, 1, 1, 0}));
+    auto brm = std::make_shared<range_mask>(2, 3, false, std::vector<uint8_t>{0, 1});
+    REQUIRE(evaluate_all(brm, v) == std::vector<uint8_t>({0, 0, 1, 0, 0, 1, 1, 1, 0}));
+
+    // masked pixels are set to NAN in all bands
+    std::vector<double> mask_buf = {0, 8, 9, 1};
+    std::vector<double> pixel_buf = {1, 2, 3, 4, 5, 6, 7, 8};
+    vm->apply(mask_buf.data(), pixel_buf.data(), 2, 2, 2);
+    REQUIRE(pixel_buf[0] == 1);
+    REQUIRE(std::isnan(pixel_buf[1]));
+    REQUIRE(std::isnan(pixel_buf[2]));
+    REQUIRE(pixel_buf[3] == 4);
+    REQUIRE(pixel_buf[4] == 5);
+    REQUIRE(std::isnan(pixel_buf[5]));
+    REQUIRE(std::isnan(pixel_buf[6]));
+    REQUIRE(pixel_buf[7] == 8);
+}
+
+TEST_CASE("Mask combinations", "[image_mask]") {
+    std::vector<double> v = {0, 5, 10, 15, 20, 25, 12.5, NAN};
+    auto a = std::make_shared<counting_mask>(0, 15);
+    auto b = std::make_shared<counting_mask>(10, 20);
+
+    auto m_and = std::make_shared<mask_combination>(mask_combination::op::AND, std::vector<std::shared_ptr<image_mask>>{a, b});
+    REQUIRE(evaluate_all(m_and, v) == std::vector<uint8_t>({0, 0, 1, 1, 0, 0, 1, 0}));
+
+    auto m_or = std::make_shared<mask_combination>(mask_combination::op::OR, std::vector<std::shared_ptr<image_mask>>{a, b});
+    REQUIRE(evaluate_all(m_or, v) == std::vector<uint8_t>({1, 1, 1, 1, 1, 0, 1, 0}));
+
+    // combined masks are evaluated through the tables of the combinations only and are never tabulated themselves,
+    // b is only evaluated by AND where a is masked and by OR where a is not masked
+    REQUIRE(a->calls == 2 * (65536 + 2));
+    REQUIRE(b->calls == 17 + 65521);
+    a->calls = 0;
+    b->calls = 0;
+    REQUIRE(evaluate_all(m_and, {12, 12.5}) == std::vector<uint8_t>({1, 1}));
+    REQUIRE(a->calls == 1);
+    REQUIRE(b->calls == 1);
+
+    auto empty_and = std::make_shared<mask_combination>(mask_combination::op::AND, std::vector<std::shared_ptr<image_mask>>{});
+    REQUIRE(evaluate_all(empty_and, {0, 1}) == std::vector<uint8_t>({0, 0}));
+}
+
+TEST_CASE("Masks from JSON", "[image_mask]") {
+    std::vector<double> v = {0, 3, 8, 9, 255, 1000};
+
+    auto vm = std::make_shared<value_mask>(std::unordered_set<double>{8, 9}, true, std::vector<uint8_t>{0, 1, 2, 3});
+    auto vm2 = image_mask::from_json(vm->as_json());
+    REQUIRE(vm2);
+    REQUIRE(evaluate_all(vm2, v) == evaluate_all(vm, v));
+
+    auto rm = std::make_shared<range_mask>(3, 9);
+    auto rm2 = image_mask::from_json(rm->as_json());
+    REQUIRE(rm2);
+    REQUIRE(rm2->as_json().dump() == rm->as_json().dump());
+    REQUIRE(evaluate_all(rm2, v) == evaluate_all(rm, v));
+
+    std::string err;
+    json11::Json j = json11::Json::parse(R"({"mask_type": "mask_combination", "op": "and", "masks": [
+        {"mask_type": "range_mask", "min": 0, "max": 8},
+        {"mask_type": "mask_combination", "op": "or", "masks": [
+            {"mask_type": "value_mask", "values": [3]},
+            {"mask_type": "value_mask", "values": [8, 9]}
+        ]}
+    ]})",
+                                         err);
+    REQUIRE(err.empty());
+    auto cm = image_mask::from_json(j);
+    REQUIRE(cm);
+    REQUIRE(std::dynamic_pointer_cast<mask_combination>(cm));
+    REQUIRE(evaluate_all(cm, v) == std::vector<uint8_t>({0, 1, 1, 0, 0, 0}));
+    auto cm2 = image_mask::from_json(cm->as_json());
+    REQUIRE(cm2);
+    REQUIRE(evaluate_all(cm2, v) == evaluate_all(cm, v));
+
+    REQUIRE(!image_mask::from_json(json11::Json::object{}));
+    REQUIRE(!image_mask::from_json(json11::Json::object{{"mask_type", "unknown"}}));
+    REQUIRE(!image_mask::from_json(json11::Json::parse(R"({"mask_type": "mask_combination", "op": "xor", "masks": []})", err)));
+    REQUIRE(!image_mask::from_json(json11::Json::parse(R"({"mask_type": "mask_combination", "op": "or", "masks": [{"mask_type": "unknown"}]})", err)));
+}
@@ -0,0 +1,153 @@
+/*
+    MIT License
+
+    Copyright (c) 2023 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+
+#include <cmath>
+#include <functional>
+#include <string>
+
+#include "../external/catch.hpp"
+#include "../kernel_plugin.h"
+#include "test_cubes.h"
+
+using namespace gdalcubes;
+
+// plugins are built from test/plugin/test_kernel.c by CMake
+#if defined(GDALCUBES_TEST_KERNEL) && defined(GDALCUBES_TEST_KERNEL_ABI)
+
+namespace {
+
+// bands a = 1 + it + iy and b = 10 * ix for 5 days of 2 x 3 pixels, a is missing on the second and last day of pixel (0, 0)
+std::shared_ptr<function_cube> kernel_input_cube() {
+    cube_view v;
+    v.srs("EPSG:3857");
+    v.set_x_axis(0.0, uint32_t(3), 1.0);
+    v.set_y_axis(0.0, uint32_t(2), 1.0);
+    v.set_t_axis(datetime::from_string("2020-01-01"), datetime::from_string("2020-01-05"), duration::from_string("P1D"));
+    auto out = std::make_shared<function_cube>(v, std::vector<std::string>{"a", "b"}, [](uint16_t ib, uint32_t it, uint32_t iy, uint32_t ix) {
+        if (ib == 1) return 10.0 * ix;
+        if (iy == 0 && ix == 0 && (it == 1 || it == 4)) return double(NAN);
+        return 1.0 + it + iy;
+    });
+    out->set_chunk_size(2, 1, 2);
+    return out;
+}
+
+// message of the exception thrown by f
+std::string error_message(std::function<void()> f) {
+    try {
+        f();
+    } catch (std::string s) {
+        return s;
+    }
+    return "";
+}
+
+}  // namespace
+
+TEST_CASE("Kernel plugins", "[kernel_plugin]") {
+    auto in = kernel_input_cube();
+    std::vector<double> x = read_dense(in);
+    const uint32_t nt = 5, ny = 2, nx = 3, nxy = ny * nx;
+    auto a = [&x, nxy](uint32_t it, uint32_t i) { return x[uint64_t(it) * nxy + i]; };
+    auto b = [&x, nt, nxy](uint32_t it, uint32_t i) { return x[(uint64_t(nt) + it) * nxy + i]; };
+
+    // chunks are passed as they are
+    auto c = kernel_plugin_cube::create(in, GDALCUBES_TEST_KERNEL, "apply_pixel");
+    REQUIRE(c->bands().count() == 1);
+    REQUIRE(c->bands().get(0).name == "sum");
+    REQUIRE(c->chunk_size()[0] == 2);
+    std::vector<double> res = read_dense(c);
+    for (uint32_t it = 0; it < nt; ++it) {
+        for (uint32_t i = 0; i < nxy; ++i) {
+            INFO("apply_pixel, time " << it << ", pixel " << i);
+            REQUIRE(res[uint64_t(it) * nxy + i] == (std::isnan(a(it, i)) ? b(it, i) : a(it, i) + b(it, i)));
+        }
+    }
+
+    // complete time series across chunks
+    c = kernel_plugin_cube::create(in, GDALCUBES_TEST_KERNEL, "apply_time");
+    REQUIRE(c->bands().get(0).name == "cumsum");
+    REQUIRE(c->chunk_size()[0] == nt);
+    res = read_dense(c);
+    for (uint32_t i = 0; i < nxy; ++i) {
+        double sum = 0;
+        for (uint32_t it = 0; it < nt; ++it) {
+            INFO("apply_time, time " << it << ", pixel " << i);
+            if (std::isnan(a(it, i))) {
+                REQUIRE(std::isnan(res[uint64_t(it) * nxy + i]));
+            } else {
+                sum += a(it, i);
+                REQUIRE(res[uint64_t(it) * nxy + i] == sum);
+            }
+        }
+    }
+
+    // one output time slice, the kernel gets the dates of all input time slices
+    c = kernel_plugin_cube::create(in, GDALCUBES_TEST_KERNEL, "reduce_time");
+    REQUIRE(c->size_t() == 1);
+    REQUIRE(c->bands().count() == 2);
+    REQUIRE(c->bands().get(1).name == "t_last");
+    res = read_dense(c);
+    for (uint32_t i = 0; i < nxy; ++i) {
+        double sum = 0;
+        uint32_t it_last = 0;
+        for (uint32_t it = 0; it < nt; ++it) {
+            if (!std::isnan(a(it, i))) {
+                sum += a(it, i);
+                it_last = it;
+            }
+        }
+        INFO("reduce_time, pixel " << i);
+        REQUIRE(res[i] == sum);
+        REQUIRE(res[nxy + i] == in->st_reference()->datetime_at_index(it_last).epoch_time());
+    }
+    REQUIRE(res[nxy] == datetime::from_string("2020-01-04").epoch_time());
+
+    REQUIRE(c->make_constructible_json()["cube_type"].string_value() == "kernel_plugin");
+    REQUIRE(c->make_constructible_json()["mode"].string_value() == "reduce_time");
+}
+
+TEST_CASE("Invalid kernel plugins", "[kernel_plugin]") {
+    auto in = kernel_input_cube();
+
+    REQUIRE(error_message([&in]() { kernel_plugin_cube::create(in, "does_not_exist.so"); }).find("does not exist") != std::string::npos);
+    REQUIRE(error_message([&in]() { kernel_plugin_cube::create(in, GDALCUBES_TEST_KERNEL, "reduce_space"); }).find("Invalid kernel mode") != std::string::npos);
+
+    // plugins built against another version of kernel_abi.h are rejected
+    REQUIRE(error_message([&in]() { kernel_plugin_cube::create(in, GDALCUBES_TEST_KERNEL_ABI); }).find("incompatible ABI version") != std::string::npos);
+    REQUIRE_THROWS(kernel_plugin::load(GDALCUBES_TEST_KERNEL_ABI));
+
+    // errors of the kernel functions, including their messages
+    REQUIRE(error_message([&in]() { kernel_plugin_cube::create(in, GDALCUBES_TEST_KERNEL, "apply_pixel", "fail_init"); }).find("init failed as requested") != std::string::npos);
+    REQUIRE(error_message([&in]() { kernel_plugin_cube::create(in, GDALCUBES_TEST_KERNEL, "apply_time", "fail_output_bands"); }).find("output_bands failed as requested") != std::string::npos);
+    auto c = kernel_plugin_cube::create(in, GDALCUBES_TEST_KERNEL, "apply_pixel", "fail_process");
+    REQUIRE(error_message([&c]() { c->read_chunk(0); }).find("process failed as requested") != std::string::npos);
+
+    // the library is loaded once
+    REQUIRE(kernel_plugin::load(GDALCUBES_TEST_KERNEL) == kernel_plugin::load(GDALCUBES_TEST_KERNEL));
+}
+
+#endif
@@ -0,0 +1,237 @@
+/*
+    MIT License
+
+    Copyright (c) 2023 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#include <cmath>
+#include <functional>
+#include <string>
+
+#include "../external/catch.hpp"
+#include "../gdalcubes.h"
+#include "test_cubes.h"
+
+using namespace gdalcubes;
+
+namespace {
+
+const uint32_t N = 4;
+
+// features a = ix and b = iy for 4 x 4 pixels in chunks of 2 x 2 pixels, a is NAN in the first row, b is NAN in the first column
+std::shared_ptr<cube> feature_cube() {
+    cube_view v;
+    v.srs("EPSG:3857");
+    v.set_x_axis(0.0, N, 1.0);
+    v.set_y_axis(0.0, N, 1.0);
+    v.set_t_axis(datetime::from_string("2020-01-01"), datetime::from_string("2020-01-01"), duration::from_string("P1D"));
+    auto out = std::make_shared<function_cube>(v, std::vector<std::string>{"a", "b"}, [](uint16_t ib, uint32_t it, uint32_t iy, uint32_t ix) {
+        if (ib == 0) return iy < 1 ? NAN : double(ix);
+        return ix < 1 ? NAN : double(iy);
+    });
+    out->set_chunk_size(1, 2, 2);
+    return out;
+}
+
+// compares band ib of a cube with expected values for all pixels, given as a function of the features
+void check_band(const std::vector<double> &res, uint16_t ib, std::function<double(double, double)> expected) {
+    for (uint32_t iy = 0; iy < N; ++iy) {
+        for (uint32_t ix = 0; ix < N; ++ix) {
+            double a = iy < 1 ? NAN : ix;
+            double b = ix < 1 ? NAN : iy;
+            double e = expected(a, b);
+            double r = res[(uint64_t(ib) * N + iy) * N + ix];
+            INFO("band " << ib << ", pixel (" << iy << ", " << ix << ")");
+            if (std::isnan(e)) {
+                REQUIRE(std::isnan(r));
+            } else {
+                REQUIRE(r == Approx(e).epsilon(1e-12));
+            }
+        }
+    }
+}
+
+double sigmoid(double x) {
+    return 1.0 / (1.0 + std::exp(-x));
+}
+
+// two regression trees (a <= 1.5 ? 1 : 3) and (b <= 1.5 ? 10 : 20), missing values of the first tree have no direction if default_left is empty
+std::string regression_model(std::string aggregation, std::string default_left, double base_score = 0) {
+    return R"({
+        "objective": "regression",
+        "aggregation": ")" + aggregation + R"(",
+        "base_score": )" + std::to_string(base_score) + R"(,
+        "features": ["a", "b"],
+        "trees": [
+            {"feature": [0, -1, -1], "threshold": [1.5, 0, 0], "left": [1, -1, -1], "right": [2, -1, -1], "value": [0, 1, 3])" +
+           (default_left.empty() ? "" : R"(, "default_left": [)" + default_left + "]") + R"(},
+            {"feature": [1, -1, -1], "threshold": [1.5, 0, 0], "left": [1, -1, -1], "right": [2, -1, -1], "value": [0, 10, 20],
+             "default_left": [true, false, false]}
+        ]
+    })";
+}
+
+}  // namespace
+
+TEST_CASE("Regression models", "[predict_pixel]") {
+    auto mean = predict_pixel_cube::create(feature_cube(), regression_model("mean", "0, 0, 0"));
+    REQUIRE(mean->size_bands() == 1);
+    REQUIRE(mean->bands().get(0).name == "prediction");
+    std::vector<double> res = read_dense(mean);
+
+    // missing a goes right in the first tree, missing b goes left in the second tree, pixels without any features are NAN
+    auto t1 = [](double a) { return std::isnan(a) ? 3 : (a <= 1.5 ? 1 : 3); };
+    auto t2 = [](double b) { return std::isnan(b) ? 10 : (b <= 1.5 ? 10 : 20); };
+    check_band(res, 0, [&](double a, double b) {
+        return (std::isnan(a) && std::isnan(b)) ? NAN : (t1(a) + t2(b)) / 2.0;
+    });
+    REQUIRE(std::isnan(res[0]));
+    REQUIRE(res[N + 1] == 5.5);
+
+    auto sum = predict_pixel_cube::create(feature_cube(), regression_model("sum", "0, 0, 0", 0.25));
+    check_band(read_dense(sum), 0, [&](double a, double b) {
+        return (std::isnan(a) && std::isnan(b)) ? NAN : t1(a) + t2(b) + 0.25;
+    });
+
+    // without default direction, pixels reaching a split on a missing feature are NAN
+    auto nodefault = predict_pixel_cube::create(feature_cube(), regression_model("sum", ""));
+    check_band(read_dense(nodefault), 0, [&](double a, double b) {
+        return std::isnan(a) ? NAN : t1(a) + t2(b);
+    });
+
+    // strict splits
+    std::string model = regression_model("sum", "");
+    model.insert(model.find('{') + 1, R"("split": "<", )");
+    std::size_t pos = model.find("1.5");
+    model.replace(pos, 3, "2.0");
+    auto strict = predict_pixel_cube::create(feature_cube(), model);
+    check_band(read_dense(strict), 0, [&](double a, double b) {
+        return std::isnan(a) ? NAN : (a < 2 ? 1 : 3) + t2(b);
+    });
+}
+
+TEST_CASE("Classification models", "[predict_pixel]") {
+    // binary classification with a single score (a <= 1.5 ? -2 : 2) + (b <= 2.5 ? -1 : 1) + 0.5
+    std::string binary = R"({
+        "objective": "classification",
+        "aggregation": "sum",
+        "output_transform": "sigmoid",
+        "base_score": 0.5,
+        "features": ["a", "b"],
+        "classes": ["no", "yes"],
+        "trees": [
+            {"feature": [0, -1, -1], "threshold": [1.5, 0, 0], "left": [1, -1, -1], "right": [2, -1, -1], "value": [0, -2, 2], "default_left": [1, 0, 0]},
+            {"feature": [1, -1, -1], "threshold": [2.5, 0, 0], "left": [1, -1, -1], "right": [2, -1, -1], "value": [0, -1, 1], "default_left": [0, 0, 0]}
+        ]
+    })";
+    auto score = [](double a, double b) {
+        return (std::isnan(a) || a <= 1.5 ? -2 : 2) + (std::isnan(b) || b > 2.5 ? 1 : -1) + 0.5;
+    };
+    auto c = predict_pixel_cube::create(feature_cube(), binary, true);
+    REQUIRE(c->size_bands() == 3);
+    REQUIRE(c->bands().get(0).name == "class");
+    REQUIRE(c->bands().get(1).name == "p_no");
+    REQUIRE(c->bands().get(2).name == "p_yes");
+    std::vector<double> res = read_dense(c);
+    check_band(res, 0, [&](double a, double b) {
+        return (std::isnan(a) && std::isnan(b)) ? NAN : (sigmoid(score(a, b)) > 0.5 ? 2 : 1);
+    });
+    check_band(res, 1, [&](double a, double b) {
+        return (std::isnan(a) && std::isnan(b)) ? NAN : 1 - sigmoid(score(a, b));
+    });
+    check_band(res, 2, [&](double a, double b) {
+        return (std::isnan(a) && std::isnan(b)) ? NAN : sigmoid(score(a, b));
+    });
+    REQUIRE(predict_pixel_cube::create(feature_cube(), binary, false)->size_bands() == 1);
+
+    // multiclass boosting with softmax, one score per class and node
+    std::string multiclass = R"({
+        "objective": "classification",
+        "aggregation": "sum",
+        "output_transform": "softmax",
+        "base_score": [0.1, 0.2, 0.3],
+        "features": ["a", "b"],
+        "classes": ["x", "y", "z"],
+        "trees": [
+            {"feature": [1, -1, -1], "threshold": [1.5, 0, 0], "left": [1, -1, -1], "right": [2, -1, -1],
+             "value": [0, 0, 0, 1, 0, 0, 0, 0, 2], "default_left": [1, 0, 0]},
+            {"feature": [0, -1, 0, -1, -1], "threshold": [2.5, 0, 0.5, 0, 0], "left": [1, -1, 3, -1, -1], "right": [2, -1, 4, -1, -1],
+             "value": [0, 0, 0, 0, 0.5, 0, 0, 0, 0, 3, 0, 0, 0, 3, 0], "default_left": [1, 0, 0, 0, 0]}
+        ]
+    })";
+    auto scores = [](double a, double b) {
+        std::vector<double> s = {0.1, 0.2, 0.3};
+        if (std::isnan(b) || b <= 1.5) {
+            s[0] += 1;
+        } else {
+            s[2] += 2;
+        }
+        if (std::isnan(a) || a <= 2.5) {
+            s[1] += 0.5;
+        } else {
+            s[1] += 3;  // both children of the second split have the same values
+        }
+        double sum = std::exp(s[0]) + std::exp(s[1]) + std::exp(s[2]);
+        return std::vector<double>{std::exp(s[0]) / sum, std::exp(s[1]) / sum, std::exp(s[2]) / sum};
+    };
+    c = predict_pixel_cube::create(feature_cube(), multiclass, true);
+    REQUIRE(c->size_bands() == 4);
+    res = read_dense(c);
+    check_band(res, 0, [&](double a, double b) {
+        if (std::isnan(a) && std::isnan(b)) return (double)NAN;
+        std::vector<double> p = scores(a, b);
+        return double(std::max_element(p.begin(), p.end()) - p.begin() + 1);
+    });
+    for (uint16_t k = 0; k < 3; ++k) {
+        check_band(res, k + 1, [&](double a, double b) {
+            return (std::isnan(a) && std::isnan(b)) ? NAN : scores(a, b)[k];
+        });
+    }
+    // classes differ between pixels
+    REQUIRE(res[N + 1] == 1);
+    REQUIRE(res[2 * N + 3] == 2);
+    REQUIRE(res[3 * N + 1] == 3);
+}
+
+TEST_CASE("Invalid models", "[predict_pixel]") {
+    auto tree = [](std::string left, std::string right) {
+        return R"({"features": ["a"], "trees": [{"feature": [0, 0, -1, -1], "threshold": [1, 2, 0, 0], "left": [)" + left +
+               R"(], "right": [)" + right + R"(], "value": [0, 0, 1, 2]}]})";
+    };
+    REQUIRE_NOTHROW(predict_pixel_cube::create(feature_cube(), tree("1, 2, -1, -1", "3, 3, -1, -1")));
+
+    // children must follow their parents and must be in the tree
+    REQUIRE_THROWS(predict_pixel_cube::create(feature_cube(), tree("0, 2, -1, -1", "3, 3, -1, -1")));
+    REQUIRE_THROWS(predict_pixel_cube::create(feature_cube(), tree("1, 0, -1, -1", "3, 3, -1, -1")));
+    REQUIRE_THROWS(predict_pixel_cube::create(feature_cube(), tree("1, 1, -1, -1", "3, 3, -1, -1")));
+    REQUIRE_THROWS(predict_pixel_cube::create(feature_cube(), tree("1, 2, -1, -1", "4, 3, -1, -1")));
+    REQUIRE_THROWS(predict_pixel_cube::create(feature_cube(), tree("1, 2, -1, -1", "-1, 3, -1, -1")));
+    REQUIRE_THROWS(predict_pixel_cube::create(feature_cube(), tree("1, 2, -1", "3, 3, -1, -1")));
+
+    REQUIRE_THROWS(predict_pixel_cube::create(feature_cube(), R"({"features": ["a"], "trees": [{"feature": [1, -1, -1], "threshold": [1, 0, 0], "left": [1, -1, -1], "right": [2, -1, -1], "value": [0, 1, 2]}]})"));
+    REQUIRE_THROWS(predict_pixel_cube::create(feature_cube(), R"({"features": ["a"], "trees": [{"feature": [0, -1, -1], "threshold": [1, 0, 0], "left": [1, -1, -1], "right": [2, -1, -1], "value": [0, 1]}]})"));
+    REQUIRE_THROWS(predict_pixel_cube::create(feature_cube(), R"({"features": ["c"], "trees": [{"feature": [-1], "threshold": [0], "left": [-1], "right": [-1], "value": [1]}]})"));
+    REQUIRE_THROWS(predict_pixel_cube::create(feature_cube(), R"({"features": ["a"], "trees": []})"));
+    REQUIRE_THROWS(predict_pixel_cube::create(feature_cube(), R"({"objective": "ranking", "features": ["a"], "trees": [{"feature": [-1], "threshold": [0], "left": [-1], "right": [-1], "value": [1]}]})"));
+    REQUIRE_THROWS(predict_pixel_cube::create(feature_cube(), R"({"features": ["a"], )"));
+    REQUIRE_THROWS(predict_pixel_cube::create(feature_cube(), "does_not_exist.json"));
+}
@@ -0,0 +1,223 @@
+/*
+    MIT License
+
+    Copyright (c) 2023 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#include <gdal_priv.h>
+
+#include <atomic>
+#include <cstdio>  // std::remove
+#include <string>
+#include <thread>
+
+#include "../config.h"
+#include "../dataset_pool.h"
+#include "../external/catch.hpp"
+#include "../filesystem.h"
+#include "../prefetch.h"
+
+using namespace gdalcubes;
+
+TEST_CASE("Prefetch queue", "[prefetch]") {
+    std::atomic<uint32_t> count(0);
+    for (uint32_t i = 0; i < 10; ++i) {
+        prefetch_queue::instance()->push([&count]() { ++count; });
+    }
+    // failing tasks are ignored
+    prefetch_queue::instance()->push([]() { throw std::string("error"); });
+    prefetch_queue::instance()->clear();
+    REQUIRE(count <= 10);
+
+    std::atomic<bool> run(false);
+    REQUIRE(prefetch_queue::instance()->push([&run]() { run = true; }));
+    while (!run) std::this_thread::yield();
+    prefetch_queue::instance()->clear();
+    REQUIRE(run);
+}
+
+TEST_CASE("Prefetch budget", "[prefetch]") {
+    uint64_t max = config::instance()->get_prefetch_memory_max();
+    config::instance()->set_prefetch_memory_max(1000);
+    REQUIRE(prefetch_queue::instance()->reserved() == 0);
+    REQUIRE(prefetch_queue::instance()->reserve(600));
+    REQUIRE(!prefetch_queue::instance()->reserve(600));
+    REQUIRE(prefetch_queue::instance()->reserve(400));
+    REQUIRE(prefetch_queue::instance()->reserved() == 1000);
+    prefetch_queue::instance()->release(600);
+    REQUIRE(prefetch_queue::instance()->reserved() == 400);
+    prefetch_queue::instance()->release(1000);
+    REQUIRE(prefetch_queue::instance()->reserved() == 0);
+    config::instance()->set_prefetch_memory_max(max);
+}
+
+TEST_CASE("Chunk access prediction", "[prefetch]") {
+    chunk_access_predictor p;
+
+    // first read of a thread, chunks in order are predicted
+    std::vector<chunkid_t> next = p.next(0, 100, 2);
+    REQUIRE(next.size() == 2);
+    REQUIRE(next[0] == 1);
+    REQUIRE(next[1] == 2);
+
+    // stride is used only if it is regular
+    next = p.next(4, 100, 2);
+    REQUIRE(next[0] == 5);
+    next = p.next(8, 100, 2);
+    REQUIRE(next.size() == 2);
+    REQUIRE(next[0] == 12);
+    REQUIRE(next[1] == 16);
+    next = p.next(9, 100, 2);
+    REQUIRE(next[0] == 10);
+
+    // no chunks beyond the cube
+    next = p.next(98, 100, 3);
+    REQUIRE(next.size() == 1);
+    REQUIRE(next[0] == 99);
+
+    // threads are independent
+    std::vector<chunkid_t> other;
+    std::thread t([&p, &other]() { other = p.next(50, 100, 1); });
+    t.join();
+    REQUIRE(other.size() == 1);
+    REQUIRE(other[0] == 51);
+}
+
+TEST_CASE("Prefetch plans", "[prefetch]") {
+    bounds_st e1;
+    e1.s.left = 0;
+    e1.s.right = 10;
+    e1.s.bottom = 0;
+    e1.s.top = 10;
+    e1.t0 = datetime::from_string("2020-01-01");
+    e1.t1 = datetime::from_string("2020-01-31");
+    bounds_st e2 = e1;
+    e2.s.right = 20;
+
+    std::vector<image_collection::find_range_st_row> rows(2);
+    rows[0].image_id = 1;
+    rows[1].image_id = 2;
+
+    prefetch_plans plans;
+    REQUIRE(plans.add(1, e1, 2));
+    REQUIRE(!plans.add(1, e1, 2));  // already scheduled
+    REQUIRE(plans.add(2, e1, 2));
+    REQUIRE(!plans.add(3, e1, 2));  // full and no completed plan to drop
+
+    // pending plans are not used but removed when taken
+    std::vector<image_collection::find_range_st_row> out;
+    REQUIRE(!plans.take(2, e1, out));
+    REQUIRE(plans.size() == 1);
+
+    // completed plans
+    REQUIRE(prefetch_queue::instance()->reserve(100));
+    REQUIRE(plans.complete(1, rows, 100));
+    REQUIRE(prefetch_queue::instance()->reserved() == 100);
+    REQUIRE(plans.take(1, e1, out));
+    REQUIRE(out.size() == 2);
+    REQUIRE(out[1].image_id == 2);
+    REQUIRE(prefetch_queue::instance()->reserved() == 0);
+    REQUIRE(plans.size() == 0);
+
+    // extent must match
+    REQUIRE(plans.add(4, e1, 2));
+    REQUIRE(plans.complete(4, rows, 0));
+    out.clear();
+    REQUIRE(!plans.take(4, e2, out));
+    REQUIRE(out.empty());
+
+    // plans that have been taken or removed in the meantime release their budget on completion
+    REQUIRE(prefetch_queue::instance()->reserve(50));
+    REQUIRE(!plans.complete(5, rows, 50));
+    REQUIRE(prefetch_queue::instance()->reserved() == 0);
+
+    // completed plans of mispredicted chunks are dropped if the maximum number of plans is reached
+    REQUIRE(plans.add(6, e1, 2));
+    REQUIRE(plans.add(7, e1, 2));
+    REQUIRE(prefetch_queue::instance()->reserve(10));
+    REQUIRE(plans.complete(6, rows, 10));
+    REQUIRE(plans.add(8, e1, 2));
+    REQUIRE(prefetch_queue::instance()->reserved() == 0);
+    REQUIRE(plans.size() == 2);
+    plans.remove(7);
+    plans.remove(8);
+    REQUIRE(plans.size() == 0);
+}
+
+TEST_CASE("Prefetched blocks are reused", "[prefetch]") {
+    // tiled 64x64 GeoTIFF with 16x16 blocks
+    std::string file = filesystem::join(filesystem::get_working_dir(), "test_prefetch.tif");
+    GDALDriver *gtiff = GetGDALDriverManager()->GetDriverByName("GTiff");
+    REQUIRE(gtiff != nullptr);
+    char **create_opts = nullptr;
+    create_opts = CSLAddString(create_opts, "TILED=YES");
+    create_opts = CSLAddString(create_opts, "BLOCKXSIZE=16");
+    create_opts = CSLAddString(create_opts, "BLOCKYSIZE=16");
+    GDALDataset *d = gtiff->Create(file.c_str(), 64, 64, 1, GDT_Byte, create_opts);
+    CSLDestroy(create_opts);
+    REQUIRE(d != nullptr);
+    std::vector<uint8_t> values(64 * 64);
+    for (uint32_t i = 0; i < values.size(); ++i) values[i] = uint8_t(i % 251);
+    REQUIRE(d->GetRasterBand(1)->RasterIO(GF_Write, 0, 0, 64, 64, values.data(), 64, 64, GDT_Byte, 0, 0, nullptr) == CE_None);
+    GDALClose(d);
+    gdal_dataset_pool::instance()->clear();
+
+    // announcing a local window does not read anything
+    {
+        pooled_dataset g(file);
+        REQUIRE(g);
+        prefetch_window(g.get(), true, 0, 0, 16, 16, 16, 16, GDT_Byte, {1});
+        GDALRasterBlock *block = g->GetRasterBand(1)->TryGetLockedBlockRef(0, 0);
+        REQUIRE(block == nullptr);
+    }
+
+    // reading a window leaves its blocks in the block cache of the pooled handle
+    GDALDataset *prefetched = nullptr;
+    {
+        pooled_dataset g(file);
+        REQUIRE(g);
+        prefetched = g.get();
+        REQUIRE(prefetch_window(g.get(), false, 16, 16, 32, 32, 32, 32, GDT_Byte, {1}));
+    }
+
+    // the chunk is read afterwards through the same handle and finds the blocks
+    {
+        pooled_dataset g(file);
+        REQUIRE(g.get() == prefetched);
+        GDALRasterBand *band = g->GetRasterBand(1);
+        for (int by = 0; by < 4; ++by) {
+            for (int bx = 0; bx < 4; ++bx) {
+                GDALRasterBlock *block = band->TryGetLockedBlockRef(bx, by);
+                bool in_window = bx >= 1 && bx <= 2 && by >= 1 && by <= 2;
+                REQUIRE((block != nullptr) == in_window);
+                if (block) block->DropLock();
+            }
+        }
+        std::vector<uint8_t> x(32 * 32);
+        REQUIRE(band->RasterIO(GF_Read, 16, 16, 32, 32, x.data(), 32, 32, GDT_Byte, 0, 0, nullptr) == CE_None);
+        REQUIRE(x[0] == values[16 * 64 + 16]);
+        REQUIRE(x[32 * 32 - 1] == values[47 * 64 + 47]);
+    }
+
+    gdal_dataset_pool::instance()->clear();
+    std::remove(file.c_str());
+}
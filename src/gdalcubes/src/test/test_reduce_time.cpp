@@ -0,0 +1,179 @@
+/*
+    MIT License
+
+    Copyright (c) 2023 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#include <cmath>
+#include <functional>
+#include <string>
+
+#include "../external/catch.hpp"
+#include "../gdalcubes.h"
+#include "../thread_pool.h"
+#include "test_cubes.h"
+
+using namespace gdalcubes;
+
+namespace {
+
+// daily time series of ny x nx pixels over the years 2001 and 2002 (730 days)
+std::shared_ptr<function_cube> daily_cube(uint32_t ny, uint32_t nx, std::function<double(uint32_t, uint32_t, uint32_t)> f) {
+    cube_view v;
+    v.srs("EPSG:3857");
+    v.set_x_axis(0.0, nx, 1.0);
+    v.set_y_axis(0.0, ny, 1.0);
+    v.set_t_axis(datetime::from_string("2001-01-01"), datetime::from_string("2002-12-31"), duration::from_string("P1D"));
+    return std::make_shared<function_cube>(v, f);
+}
+
+}  // namespace
+
+TEST_CASE("Temporal trend reducers", "[reduce_time]") {
+    const double PI = 3.141592653589793;
+    const std::vector<double> mk_ties = {1, 2, 2, 3, 1, 4};
+    const std::vector<double> mk_ties_decreasing = {5, 4, 4, 4, 2, 1, 0};
+
+    // dates in years since the first date are it / 365.25
+    auto f = [&](uint32_t it, uint32_t iy, uint32_t ix) -> double {
+        double t = it / 365.25;
+        switch (iy * 2 + ix) {
+            case 0:  // linear with gaps
+                return (it % 50 == 7) ? NAN : 2 + 3 * it;
+            case 1:  // linear with a single outlier
+                return 2 + 3 * it + (it == 100 ? 10000 : 0);
+            case 2:  // annual harmonic with linear trend
+                return 5 + 0.5 * t + 2 * std::cos(2 * PI * t) + std::sin(2 * PI * t);
+            case 3:  // short series with ties
+                return it < mk_ties.size() ? mk_ties[it] : NAN;
+            case 4:
+                return it < mk_ties_decreasing.size() ? mk_ties_decreasing[it] : NAN;
+            default:
+                return NAN;
+        }
+    };
+    auto in = daily_cube(3, 2, f);
+    in->set_chunk_size(100, 3, 2);
+
+    std::vector<std::string> reducers = {"lm_slope", "lm_intercept", "harmonic_cos", "harmonic_sin", "harmonic_amplitude",
+                                         "harmonic_phase", "theil_sen", "mk_tau", "mk_p"};
+    std::vector<std::pair<std::string, std::string>> reducer_bands;
+    for (auto &r : reducers) reducer_bands.push_back({r, "v"});
+    auto c = reduce_time_cube::create(in, reducer_bands);
+    std::vector<double> res = read_dense(c);
+    uint32_t npixels = 6;
+    auto value = [&res, &reducers, &npixels](std::string reducer, uint32_t pixel) {
+        uint16_t ib = std::find(reducers.begin(), reducers.end(), reducer) - reducers.begin();
+        return res[ib * npixels + pixel];
+    };
+
+    // slopes are given per year
+    REQUIRE(value("lm_slope", 0) == Approx(3 * 365.25).epsilon(1e-9));
+    REQUIRE(value("lm_intercept", 0) == Approx(2).epsilon(1e-9));
+    REQUIRE(value("theil_sen", 0) == Approx(3 * 365.25).epsilon(1e-9));
+    REQUIRE(value("mk_tau", 0) == Approx(1));
+    REQUIRE(value("mk_p", 0) < 1e-10);
+
+    // Theil-Sen is robust against the outlier, OLS is not
+    REQUIRE(value("theil_sen", 1) == Approx(3 * 365.25).epsilon(1e-9));
+    REQUIRE(std::fabs(value("lm_slope", 1) - 3 * 365.25) > 1);
+    REQUIRE(value("lm_intercept", 1) > 2);
+
+    REQUIRE(value("harmonic_cos", 2) == Approx(2).epsilon(1e-6));
+    REQUIRE(value("harmonic_sin", 2) == Approx(1).epsilon(1e-6));
+    REQUIRE(value("harmonic_amplitude", 2) == Approx(std::sqrt(5.0)).epsilon(1e-6));
+    REQUIRE(value("harmonic_phase", 2) == Approx(std::atan2(1.0, 2.0)).epsilon(1e-6));
+
+    // Mann-Kendall with ties, S = 7 with n = 6 and Var(S) = (6 * 5 * 17 - 2 * 2 * 1 * 9) / 18
+    REQUIRE(value("mk_tau", 3) == Approx(7.0 / 15.0).epsilon(1e-12));
+    REQUIRE(value("mk_p", 3) == Approx(0.24231273167227863).epsilon(1e-9));
+    // S = -18 with n = 7 and Var(S) = (7 * 6 * 19 - 3 * 2 * 11) / 18
+    REQUIRE(value("mk_tau", 4) == Approx(-18.0 / 21.0).epsilon(1e-12));
+    REQUIRE(value("mk_p", 4) == Approx(0.007680246786159433).epsilon(1e-9));
+
+    // pixels without values
+    for (auto &r : reducers) {
+        INFO(r);
+        REQUIRE(std::isnan(value(r, 5)));
+    }
+
+    // too few observations
+    auto c2 = reduce_time_cube::create(daily_cube(1, 1, [](uint32_t it, uint32_t iy, uint32_t ix) { return it < 2 ? it : NAN; }), reducer_bands);
+    res = read_dense(c2);
+    npixels = 1;
+    REQUIRE(value("lm_slope", 0) == Approx(365.25));
+    REQUIRE(value("lm_intercept", 0) == Approx(0).margin(1e-9));
+    REQUIRE(value("theil_sen", 0) == Approx(365.25));
+    for (auto &r : reducers) {
+        INFO(r);
+        if (r == "lm_slope" || r == "lm_intercept" || r == "theil_sen") continue;
+        REQUIRE(std::isnan(value(r, 0)));
+    }
+}
+
+TEST_CASE("Reducing time segments concurrently", "[reduce_time]") {
+    // values close to 1 keep products finite, there are gaps, a pixel without values, and no values at all in chunks 2 and 3
+    auto f = [](uint32_t it, uint32_t iy, uint32_t ix) -> double {
+        if (iy == 2 && ix == 1) return NAN;
+        if (it >= 200 && it < 400) return NAN;
+        if ((it + 3 * ix + 5 * iy) % 17 == 0) return NAN;
+        return 1 + 0.01 * std::sin(0.37 * it + ix) + 0.001 * iy + 0.0001 * std::cos(1.1 * it);
+    };
+    std::vector<std::string> reducers = {"min", "max", "mean", "median", "sum", "count", "prod", "var", "sd",
+                                         "which_min", "which_max", "Q1", "Q3", "lm_slope", "lm_intercept",
+                                         "harmonic_cos", "harmonic_sin", "harmonic_amplitude", "harmonic_phase",
+                                         "theil_sen", "mk_tau", "mk_p"};
+    std::vector<std::pair<std::string, std::string>> reducer_bands;
+    for (auto &r : reducers) reducer_bands.push_back({r, "v"});
+
+    // a single chunk in time is always reduced as one segment
+    auto in1 = daily_cube(3, 2, f);
+    in1->set_chunk_size(730, 3, 2);
+    std::vector<double> ref = read_dense(reduce_time_cube::create(in1, reducer_bands));
+
+    // with a single spatial chunk, the 8 chunks in time are split into as many segments as there are threads,
+    // even if no worker threads have been started before
+    thread_pool::instance()->clear();
+    thread_pool::instance()->set_default_size(4);
+    REQUIRE(thread_pool::instance()->size() == 0);
+    for (uint32_t ct : {100, 50, 1}) {
+        auto in = daily_cube(3, 2, f);
+        in->set_chunk_size(ct, 3, 2);
+        std::vector<double> res = read_dense(reduce_time_cube::create(in, reducer_bands));
+        for (uint16_t ib = 0; ib < reducers.size(); ++ib) {
+            for (uint32_t i = 0; i < 6; ++i) {
+                double a = ref[ib * 6 + i];
+                double b = res[ib * 6 + i];
+                INFO(reducers[ib] << ", pixel " << i << ", chunk size " << ct);
+                REQUIRE(std::isnan(a) == std::isnan(b));
+                if (!std::isnan(a)) {
+                    REQUIRE(b == Approx(a).epsilon(1e-9).margin(1e-12));
+                }
+            }
+        }
+        if (ct == 100) {
+            REQUIRE(thread_pool::instance()->size() == 4);
+        }
+    }
+    thread_pool::instance()->clear();
+    thread_pool::instance()->set_default_size(0);
+}
@@ -0,0 +1,256 @@
+/*
+    MIT License
+
+    Copyright (c) 2023 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#include <cpl_vsi.h>
+#include <utime.h>
+
+#include <algorithm>
+#include <ctime>
+#include <fstream>
+#include <string>
+#include <utility>
+
+#include "../config.h"
+#include "../external/catch.hpp"
+#include "../filesystem.h"
+#include "../remote_cache.h"
+
+using namespace gdalcubes;
+
+// fills blocks with a pattern depending on the block index and counts calls
+struct test_fetch {
+    test_fetch(uint64_t index, bool ok = true) : index(index), ok(ok), calls(0) {}
+    bool operator()(std::vector<char> &out) {
+        ++calls;
+        for (uint32_t i = 0; i < out.size(); ++i) out[i] = char((index * 31 + i) % 251);
+        return ok;
+    }
+    uint64_t index;
+    bool ok;
+    uint32_t calls;
+};
+
+static bool test_block_ok(const std::vector<char> &x, uint64_t index) {
+    for (uint32_t i = 0; i < x.size(); ++i) {
+        if (x[i] != char((index * 31 + i) % 251)) return false;
+    }
+    return true;
+}
+
+static void test_write_file(std::string path, uint32_t size, int64_t age) {
+    std::ofstream os(path, std::ios::out | std::ios::binary);
+    os << std::string(size, 'x');
+    os.close();
+    struct utimbuf t;
+    t.actime = std::time(nullptr) - age;
+    t.modtime = t.actime;
+    REQUIRE(utime(path.c_str(), &t) == 0);
+}
+
+static std::vector<std::string> test_list_files(std::string dir) {
+    std::vector<std::string> out;
+    filesystem::iterate_directory(dir, [&out](const std::string &p) {
+        std::string name = filesystem::filename(p);
+        if (name != "." && name != "..") out.push_back(name);
+    });
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+TEST_CASE("Remote cache blocks", "[remote_cache]") {
+    std::string dir = filesystem::join(filesystem::get_working_dir(), "test_remote_cache");
+    VSIRmdirRecursive(dir.c_str());
+    filesystem::mkdir(dir);
+    std::string prev_dir = config::instance()->get_remote_cache_dir();
+    uint64_t prev_max = config::instance()->get_remote_cache_max();
+    config::instance()->set_remote_cache_dir(dir);
+    config::instance()->set_remote_cache_max(uint64_t(1024) * 1024 * 1024);
+    remote_block_cache *cache = remote_block_cache::instance();
+    cache->reset_stats();
+
+    // the first read fetches and stores the block, the second read is a hit
+    std::vector<char> out;
+    test_fetch f0(0);
+    REQUIRE(cache->get_block("key", 0, 1000, out, std::ref(f0)));
+    REQUIRE(f0.calls == 1);
+    REQUIRE(out.size() == 1000);
+    REQUIRE(test_block_ok(out, 0));
+    REQUIRE(cache->stats().misses == 1);
+    REQUIRE(cache->stats().hits == 0);
+    REQUIRE(cache->stats().bytes_fetched == 1000);
+
+    std::string block_dir = filesystem::join(dir, "key");
+    REQUIRE(filesystem::file_size(filesystem::join(block_dir, "0.blk")) == 1000);
+
+    out.assign(10, 0);
+    REQUIRE(cache->get_block("key", 0, 1000, out, std::ref(f0)));
+    REQUIRE(f0.calls == 1);
+    REQUIRE(test_block_ok(out, 0));
+    REQUIRE(cache->stats().misses == 1);
+    REQUIRE(cache->stats().hits == 1);
+    REQUIRE(cache->stats().bytes_hit == 1000);
+
+    // blocks are written through temporary files that are renamed, no temporary files remain
+    test_fetch f1(1);
+    REQUIRE(cache->get_block("key", 1, 500, out, std::ref(f1)));
+    REQUIRE(test_list_files(block_dir) == std::vector<std::string>{"0.blk", "1.blk"});
+
+    // truncated blocks are fetched again and replaced
+    test_write_file(filesystem::join(block_dir, "1.blk"), 100, 0);
+    REQUIRE(cache->get_block("key", 1, 500, out, std::ref(f1)));
+    REQUIRE(f1.calls == 2);
+    REQUIRE(test_block_ok(out, 1));
+    REQUIRE(cache->stats().misses == 3);
+    REQUIRE(filesystem::file_size(filesystem::join(block_dir, "1.blk")) == 500);
+    REQUIRE(test_list_files(block_dir) == std::vector<std::string>{"0.blk", "1.blk"});
+
+    // failed fetches are neither counted nor stored
+    test_fetch f2(2, false);
+    REQUIRE(!cache->get_block("key", 2, 500, out, std::ref(f2)));
+    REQUIRE(f2.calls == 1);
+    REQUIRE(cache->stats().misses == 3);
+    REQUIRE(!filesystem::exists(filesystem::join(block_dir, "2.blk")));
+
+    // blocks of other file versions are independent
+    test_fetch g0(5);
+    REQUIRE(cache->get_block("other", 0, 1000, out, std::ref(g0)));
+    REQUIRE(g0.calls == 1);
+    REQUIRE(test_block_ok(out, 5));
+
+    cache->reset_stats();
+    REQUIRE(cache->stats().hits == 0);
+    REQUIRE(cache->stats().misses == 0);
+
+    config::instance()->set_remote_cache_dir(prev_dir);
+    config::instance()->set_remote_cache_max(prev_max);
+    VSIRmdirRecursive(dir.c_str());
+}
+
+TEST_CASE("Consecutive missing remote blocks are fetched at once", "[remote_cache]") {
+    std::string dir = filesystem::join(filesystem::get_working_dir(), "test_remote_cache_runs");
+    VSIRmdirRecursive(dir.c_str());
+    filesystem::mkdir(dir);
+    std::string prev_dir = config::instance()->get_remote_cache_dir();
+    uint64_t prev_max = config::instance()->get_remote_cache_max();
+    config::instance()->set_remote_cache_dir(dir);
+    config::instance()->set_remote_cache_max(uint64_t(1024) * 1024 * 1024);
+    remote_block_cache *cache = remote_block_cache::instance();
+    cache->reset_stats();
+
+    // file of 5.5 blocks, block 2 is cached already
+    const uint32_t bs = remote_block_cache::BLOCK_SIZE;
+    uint64_t file_size = 5 * uint64_t(bs) + bs / 2;
+    std::vector<char> out;
+    test_fetch f2(2);
+    REQUIRE(cache->get_block("key", 2, bs, out, std::ref(f2)));
+
+    // reads return consecutive blocks, filled with the pattern of test_fetch
+    std::vector<std::pair<uint64_t, uint64_t>> reads;
+    auto fetch = [&reads](uint64_t first, std::vector<char> &buf) {
+        reads.push_back({first, buf.size()});
+        for (uint64_t i = 0; i < buf.size(); ++i) {
+            buf[i] = char(((first + i / bs) * 31 + i % bs) % 251);
+        }
+        return true;
+    };
+    std::vector<std::vector<char>> blocks;
+    REQUIRE(cache->get_blocks("key", 0, 6, file_size, blocks, fetch) == 6);
+    REQUIRE(reads.size() == 2);
+    REQUIRE(reads[0] == std::pair<uint64_t, uint64_t>(0, 2 * uint64_t(bs)));
+    REQUIRE(reads[1] == std::pair<uint64_t, uint64_t>(3, file_size - 3 * uint64_t(bs)));
+    REQUIRE(blocks.size() == 6);
+    for (uint64_t i = 0; i < 6; ++i) {
+        REQUIRE(blocks[i].size() == (i < 5 ? bs : bs / 2));
+        REQUIRE(test_block_ok(blocks[i], i));
+    }
+    REQUIRE(cache->stats().misses == 6);
+    REQUIRE(cache->stats().hits == 1);
+    REQUIRE(filesystem::file_size(filesystem::join(filesystem::join(dir, "key"), "5.blk")) == bs / 2);
+
+    // all blocks are cached now
+    reads.clear();
+    REQUIRE(cache->get_blocks("key", 1, 5, file_size, blocks, fetch) == 5);
+    REQUIRE(reads.empty());
+    REQUIRE(test_block_ok(blocks[0], 1));
+    REQUIRE(cache->stats().hits == 6);
+
+    // a failed fetch returns the blocks before the missing run only
+    test_fetch f(0);
+    REQUIRE(cache->get_blocks("other", 0, 3, file_size, blocks, [](uint64_t, std::vector<char> &) { return false; }) == 0);
+    REQUIRE(cache->get_block("other", 1, bs, out, std::ref(f)));
+    REQUIRE(cache->get_blocks("other", 1, 3, file_size, blocks, [](uint64_t, std::vector<char> &) { return false; }) == 1);
+
+    config::instance()->set_remote_cache_dir(prev_dir);
+    config::instance()->set_remote_cache_max(prev_max);
+    VSIRmdirRecursive(dir.c_str());
+}
+
+TEST_CASE("Remote cache eviction", "[remote_cache]") {
+    std::string dir = filesystem::join(filesystem::get_working_dir(), "test_remote_cache_evict");
+    VSIRmdirRecursive(dir.c_str());
+    filesystem::mkdir(dir);
+    std::string prev_dir = config::instance()->get_remote_cache_dir();
+    uint64_t prev_max = config::instance()->get_remote_cache_max();
+    config::instance()->set_remote_cache_dir(dir);
+    config::instance()->set_remote_cache_max(uint64_t(1024) * 1024 * 1024);
+    remote_block_cache *cache = remote_block_cache::instance();
+
+    // 10 blocks of 1000 bytes, block 0 is the least recently used
+    std::string block_dir = filesystem::join(dir, "key");
+    filesystem::mkdir(block_dir);
+    for (uint16_t i = 0; i < 10; ++i) {
+        test_write_file(filesystem::join(block_dir, std::to_string(i) + ".blk"), 1000, (10 - i) * 100);
+    }
+    // leftovers of interrupted writes, only old ones are removed
+    test_write_file(filesystem::join(block_dir, "3.blk.old.tmp"), 1000, 7200);
+    test_write_file(filesystem::join(block_dir, "4.blk.new.tmp"), 1000, 0);
+
+    // nothing is removed below the maximum size
+    cache->evict(10000);
+    REQUIRE(test_list_files(block_dir).size() == 11);
+
+    // reading a block makes it the most recently used one
+    std::vector<char> out;
+    test_fetch f(2);
+    REQUIRE(cache->get_block("key", 2, 1000, out, std::ref(f)));
+    REQUIRE(f.calls == 0);
+
+    // blocks are removed until 90% of the maximum size (7200 bytes) is reached
+    cache->evict(8000);
+    REQUIRE(test_list_files(block_dir) == std::vector<std::string>{"2.blk", "4.blk", "4.blk.new.tmp", "5.blk", "6.blk", "7.blk", "8.blk", "9.blk"});
+
+    // writing blocks evicts automatically once a sixteenth of the maximum size has been written
+    config::instance()->set_remote_cache_max(7000);
+    test_fetch g(10);
+    REQUIRE(cache->get_block("key", 10, 1000, out, std::ref(g)));
+    REQUIRE(g.calls == 1);
+    std::vector<std::string> files = test_list_files(block_dir);
+    REQUIRE(std::count(files.begin(), files.end(), "10.blk") == 1);
+    REQUIRE(files.size() <= 7);  // at most 6300 bytes of blocks plus the temporary file
+
+    config::instance()->set_remote_cache_dir(prev_dir);
+    config::instance()->set_remote_cache_max(prev_max);
+    VSIRmdirRecursive(dir.c_str());
+}
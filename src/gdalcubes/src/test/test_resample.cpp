@@ -0,0 +1,224 @@
+/*
+    MIT License
+
+    Copyright (c) 2023 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#include <cmath>
+#include <vector>
+
+#include <gdal_priv.h>
+
+#include "../external/catch.hpp"
+#include "../resample.h"
+#include "../warp.h"
+
+using namespace gdalcubes;
+
+// affine transformation from target to source pixel coordinates
+static gather_map::pixel_transform affine(double scale, double xoff, double yoff) {
+    return [scale, xoff, yoff](uint32_t n, double *x, double *y, int *success) {
+        for (uint32_t i = 0; i < n; ++i) {
+            x[i] = x[i] * scale + xoff;
+            y[i] = y[i] * scale + yoff;
+        }
+    };
+}
+
+// source image with values f(x, y) = x + 100 * y
+static std::vector<double> source_window(const gather_map &m) {
+    std::vector<double> src(m.win_nx() * m.win_ny());
+    for (uint32_t iy = 0; iy < m.win_ny(); ++iy) {
+        for (uint32_t ix = 0; ix < m.win_nx(); ++ix) {
+            src[iy * m.win_nx() + ix] = double(m.win_xoff() + ix) + 100 * double(m.win_yoff() + iy);
+        }
+    }
+    return src;
+}
+
+TEST_CASE("Nearest neighbor gather map", "[resample]") {
+    std::shared_ptr<gather_map> m = gather_map::create(affine(1, 2, 1), 20, 10, 5, 4, gather_map::method::NEAR);
+    REQUIRE(m);
+    REQUIRE(m->win_xoff() == 2);
+    REQUIRE(m->win_yoff() == 1);
+    REQUIRE(m->win_nx() == 5);
+    REQUIRE(m->win_ny() == 4);
+
+    std::vector<double> src = source_window(*m);
+    std::vector<double> dst(5 * 4);
+    m->apply(src.data(), dst.data());
+    for (uint32_t iy = 0; iy < 4; ++iy) {
+        for (uint32_t ix = 0; ix < 5; ++ix) {
+            REQUIRE(dst[iy * 5 + ix] == double(ix + 2) + 100 * double(iy + 1));
+        }
+    }
+
+    // target grid partially outside of the source image
+    m = gather_map::create(affine(1, -2, 8), 20, 10, 5, 4, gather_map::method::NEAR);
+    REQUIRE(m);
+    REQUIRE(m->win_xoff() == 0);
+    REQUIRE(m->win_yoff() == 8);
+    src = source_window(*m);
+    m->apply(src.data(), dst.data());
+    for (uint32_t iy = 0; iy < 4; ++iy) {
+        for (uint32_t ix = 0; ix < 5; ++ix) {
+            if (ix < 2 || iy >= 2) {
+                REQUIRE(std::isnan(dst[iy * 5 + ix]));
+            } else {
+                REQUIRE(dst[iy * 5 + ix] == double(ix - 2) + 100 * double(iy + 8));
+            }
+        }
+    }
+
+    // no intersection
+    m = gather_map::create(affine(1, 50, 50), 20, 10, 5, 4, gather_map::method::NEAR);
+    REQUIRE(m);
+    REQUIRE(m->empty());
+    m->apply(nullptr, dst.data());
+    for (uint32_t i = 0; i < dst.size(); ++i) {
+        REQUIRE(std::isnan(dst[i]));
+    }
+}
+
+TEST_CASE("Bilinear gather map", "[resample]") {
+    // upsampling by factor 2
+    std::shared_ptr<gather_map> m = gather_map::create(affine(0.5, 0, 0), 10, 10, 20, 20, gather_map::method::BILINEAR);
+    REQUIRE(m);
+    std::vector<double> src = source_window(*m);
+    std::vector<double> dst(20 * 20);
+    m->apply(src.data(), dst.data());
+    for (uint32_t iy = 1; iy < 19; ++iy) {
+        for (uint32_t ix = 1; ix < 19; ++ix) {
+            // bilinear interpolation reproduces linear functions
+            double sx = (ix + 0.5) * 0.5 - 0.5;
+            double sy = (iy + 0.5) * 0.5 - 0.5;
+            REQUIRE(dst[iy * 20 + ix] == Approx(sx + 100 * sy));
+        }
+    }
+    // at the image border, only neighbors inside the image are used
+    REQUIRE(dst[0] == Approx(0));
+    REQUIRE(dst[19] == Approx(9));
+
+    // missing neighbors are ignored
+    std::vector<double> src_nan = src;
+    src_nan[1 * m->win_nx() + 1] = NAN;
+    m->apply(src_nan.data(), dst.data());
+    REQUIRE(!std::isnan(dst[2 * 20 + 2]));
+    REQUIRE(dst[2 * 20 + 2] != Approx(1 + 100 * 1));
+
+    // downsampling needs a wider kernel
+    REQUIRE(!gather_map::create(affine(2, 0, 0), 40, 40, 20, 20, gather_map::method::BILINEAR));
+    REQUIRE(gather_map::create(affine(2, 0, 0), 40, 40, 20, 20, gather_map::method::NEAR));
+}
+
+TEST_CASE("Gather map cache", "[resample]") {
+    gather_map_cache *cache = gather_map_cache::instance();
+    uint64_t max_bytes = cache->get_max_bytes();
+    cache->clear();
+
+    std::shared_ptr<gather_map> m;
+    REQUIRE(!cache->get("a", m));
+    cache->put("a", gather_map::create(affine(1, 0, 0), 100, 100, 100, 100, gather_map::method::NEAR));
+    cache->put("b", nullptr);
+    REQUIRE(cache->get("a", m));
+    REQUIRE(m);
+    REQUIRE(cache->get("b", m));
+    REQUIRE(!m);
+
+    // least recently used maps are evicted first
+    uint64_t size = gather_map::create(affine(1, 0, 0), 100, 100, 100, 100, gather_map::method::NEAR)->size_bytes();
+    cache->set_max_bytes(2 * size + 10);
+    cache->put("c", gather_map::create(affine(1, 0, 0), 100, 100, 100, 100, gather_map::method::NEAR));
+    REQUIRE(cache->get("a", m));
+    cache->put("d", gather_map::create(affine(1, 0, 0), 100, 100, 100, 100, gather_map::method::NEAR));
+    REQUIRE(cache->get("a", m));
+    REQUIRE(!cache->get("c", m));
+    REQUIRE(cache->get("d", m));
+
+    cache->set_max_bytes(max_bytes);
+    cache->clear();
+    REQUIRE(!cache->get("a", m));
+}
+
+// in-memory dataset with nb bands of 4 x 4 pixels covering (0, 0) - (4, 4) in EPSG:4326, pixel values equal the band number
+static GDALDataset *mem_dataset(int nb) {
+    GDALDriver *drv = GetGDALDriverManager()->GetDriverByName("MEM");
+    GDALDataset *ds = drv->Create("", 4, 4, nb, GDT_Float64, nullptr);
+    double gt[6] = {0.0, 1.0, 0.0, 4.0, 0.0, -1.0};
+    ds->SetGeoTransform(gt);
+    for (int b = 1; b <= nb; ++b) {
+        ds->GetRasterBand(b)->Fill(double(b));
+    }
+    return ds;
+}
+
+TEST_CASE("Gather maps respect mask bands", "[resample]") {
+    GDALAllRegister();
+
+    // without masks, nearest neighbor resampling to the identical grid uses a gather map
+    GDALDataset *in = mem_dataset(2);
+    GDALDataset *out = mem_dataset(2);
+    REQUIRE(in->GetRasterBand(1)->GetMaskFlags() == GMF_ALL_VALID);
+    auto t = gdalwarp_client::create_transform(in, out, "EPSG:4326", "EPSG:4326");
+    REQUIRE(gdalwarp_client::warp_gather(in, out, "EPSG:4326", "EPSG:4326", t, gather_map::method::NEAR, {}));
+    gdalwarp_client::destroy_transform(t);
+    GDALClose(in);
+    GDALClose(out);
+
+    // a per-dataset mask without no data value of a multiband image is applied by GDAL only
+    in = mem_dataset(2);
+    REQUIRE(in->CreateMaskBand(GMF_PER_DATASET) == CE_None);
+    std::vector<uint8_t> mask(16, 255);
+    mask[0] = 0;
+    mask[5] = 0;
+    REQUIRE(in->GetRasterBand(1)->GetMaskBand()->RasterIO(GF_Write, 0, 0, 4, 4, mask.data(), 4, 4, GDT_Byte, 0, 0, nullptr) == CE_None);
+    REQUIRE(in->GetRasterBand(2)->GetMaskFlags() == GMF_PER_DATASET);
+    out = mem_dataset(2);
+    REQUIRE(!gdalwarp_client::warp_gather(in, out, "EPSG:4326", "EPSG:4326", nullptr, gather_map::method::NEAR, {}));
+    REQUIRE(!gdalwarp_client::warp_gather(in, out, "EPSG:4326", "EPSG:4326", nullptr, gather_map::method::NEAR, {-9999.0}));
+    GDALClose(out);
+
+    // masked pixels are missing in the warp result of all bands
+    out = gdalwarp_client::warp(in, "EPSG:4326", "EPSG:4326", 0.0, 4.0, 4.0, 0.0, 4, 4, "near", {});  // closes in
+    REQUIRE(out != nullptr);
+    for (int b = 1; b <= 2; ++b) {
+        std::vector<double> v(16);
+        REQUIRE(out->GetRasterBand(b)->RasterIO(GF_Read, 0, 0, 4, 4, v.data(), 4, 4, GDT_Float64, 0, 0, nullptr) == CE_None);
+        REQUIRE(std::isnan(v[0]));
+        REQUIRE(std::isnan(v[5]));
+        REQUIRE(v[1] == double(b));
+        REQUIRE(v[15] == double(b));
+    }
+    GDALClose(out);
+
+    // masks derived from no data values are handled by gather maps if srcnodata is given
+    in = mem_dataset(1);
+    in->GetRasterBand(1)->SetNoDataValue(1.0);
+    REQUIRE(in->GetRasterBand(1)->GetMaskFlags() == GMF_NODATA);
+    out = mem_dataset(1);
+    REQUIRE(!gdalwarp_client::warp_gather(in, out, "EPSG:4326", "EPSG:4326", nullptr, gather_map::method::NEAR, {}));
+    t = gdalwarp_client::create_transform(in, out, "EPSG:4326", "EPSG:4326");
+    REQUIRE(gdalwarp_client::warp_gather(in, out, "EPSG:4326", "EPSG:4326", t, gather_map::method::NEAR, {1.0}));
+    gdalwarp_client::destroy_transform(t);
+    GDALClose(in);
+    GDALClose(out);
+}
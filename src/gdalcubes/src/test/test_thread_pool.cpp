@@ -0,0 +1,102 @@
+/*
+    MIT License
+
+    Copyright (c) 2023 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include "../external/catch.hpp"
+#include "../thread_pool.h"
+
+using namespace gdalcubes;
+
+TEST_CASE("Parallel loop", "[thread_pool]") {
+    std::vector<int> x(1000, 0);
+    thread_pool::instance()->parallel_for(
+        x.size(), [&x](uint32_t i) { x[i] = i; }, 4);
+    for (uint32_t i = 0; i < x.size(); ++i) {
+        REQUIRE(x[i] == (int)i);
+    }
+
+    std::atomic<uint32_t> count(0);
+    thread_pool::instance()->parallel_for(0, [&count](uint32_t i) { ++count; });
+    REQUIRE(count == 0);
+    thread_pool::instance()->parallel_for(1, [&count](uint32_t i) { ++count; });
+    REQUIRE(count == 1);
+}
+
+TEST_CASE("Nested parallel loops", "[thread_pool]") {
+    std::atomic<uint64_t> sum(0);
+    thread_pool::instance()->parallel_for(
+        100, [&sum](uint32_t i) {
+            thread_pool::instance()->parallel_for(
+                100, [&sum](uint32_t j) { sum += j; }, 4);
+        },
+        4);
+    REQUIRE(sum == 100 * 4950);
+}
+
+TEST_CASE("Parallel loops do not grow the pool beyond its default size", "[thread_pool]") {
+    thread_pool::instance()->clear();
+    thread_pool::instance()->set_default_size(2);
+    std::atomic<uint32_t> count(0);
+    thread_pool::instance()->parallel_for(
+        100, [&count](uint32_t i) { ++count; }, 8);
+    REQUIRE(count == 100);
+    REQUIRE(thread_pool::instance()->size() == 2);
+    REQUIRE(thread_pool::instance()->default_size() == 2);
+
+    // requested parallelism below the default size
+    thread_pool::instance()->clear();
+    thread_pool::instance()->parallel_for(
+        100, [&count](uint32_t i) { ++count; }, 2);
+    REQUIRE(thread_pool::instance()->size() == 1);
+
+    // without a default size, explicit parallelism is used as is, even beyond the number of cores
+    thread_pool::instance()->clear();
+    thread_pool::instance()->set_default_size(0);
+    REQUIRE(thread_pool::instance()->default_size() == std::max(1u, std::thread::hardware_concurrency()));
+    uint32_t nthreads = std::thread::hardware_concurrency() + 2;
+    thread_pool::instance()->parallel_for(
+        100, [&count](uint32_t i) { ++count; }, nthreads + 1);
+    REQUIRE(thread_pool::instance()->size() == nthreads);
+
+    thread_pool::instance()->clear();
+}
+
+TEST_CASE("Exceptions in parallel loops", "[thread_pool]") {
+    REQUIRE_THROWS_AS(thread_pool::instance()->parallel_for(
+                          100, [](uint32_t i) {
+                              if (i == 42) throw std::string("error in iteration 42");
+                          },
+                          4),
+                      std::string);
+
+    // pool is still usable afterwards
+    std::atomic<uint32_t> count(0);
+    thread_pool::instance()->parallel_for(
+        100, [&count](uint32_t i) { ++count; }, 4);
+    REQUIRE(count == 100);
+}
@@ -112,3 +112,44 @@ TEST_CASE("Create", "[view]") {
     datetime t1 = v1.t1();
     REQUIRE((t1 - t0).dt_interval > 0);
 }
+
+TEST_CASE("Labeled time axis", "[view]") {
+    cube_stref_labeled_time s;
+    std::vector<datetime> t;
+    for (std::string d : {"2018-01-01", "2018-01-05", "2018-01-06", "2018-02-11", "2018-03-01"}) {
+        t.push_back(datetime::from_string(d));
+    }
+    s.set_time_labels(t);
+    REQUIRE(s.nt() == 5);
+    REQUIRE(s.index_at_datetime(datetime::from_string("2018-01-01")) == 0);
+    REQUIRE(s.index_at_datetime(datetime::from_string("2018-02-11")) == 3);
+    REQUIRE(s.index_at_datetime(datetime::from_string("2018-03-01T12:00:00")) == 4);
+    REQUIRE_THROWS(s.index_at_datetime(datetime::from_string("2018-01-02")));
+
+    REQUIRE(s.index_nearest(datetime::from_string("2017-06-01")) == 0);
+    REQUIRE(s.index_nearest(datetime::from_string("2018-01-03")) == 0);
+    REQUIRE(s.index_nearest(datetime::from_string("2018-01-04")) == 1);
+    REQUIRE(s.index_nearest(datetime::from_string("2019-01-01")) == 4);
+
+    REQUIRE(s.index_range(datetime::from_string("2018-01-01"), datetime::from_string("2018-02-01")) == std::make_pair(uint32_t(0), uint32_t(3)));
+    REQUIRE(s.index_range(datetime::from_string("2018-01-02"), datetime::from_string("2018-01-05")) == std::make_pair(uint32_t(1), uint32_t(1)));
+    REQUIRE(s.index_range(datetime::from_string("2018-02-01"), datetime::from_string("2019-01-01")) == std::make_pair(uint32_t(3), uint32_t(5)));
+
+    // labels cover their full day, partial days at the end of the interval are included
+    REQUIRE(s.index_range(datetime::from_string("2018-01-02"), datetime::from_string("2018-01-05T12:00:00")) == std::make_pair(uint32_t(1), uint32_t(2)));
+    REQUIRE(s.index_range(datetime::from_string("2018-01-05T12:00:00"), datetime::from_string("2018-01-06T00:00:01")) == std::make_pair(uint32_t(1), uint32_t(3)));
+    REQUIRE(s.index_range(datetime::from_string("2018-01-02"), datetime::from_string("2018-01-05T00:00:00")) == std::make_pair(uint32_t(1), uint32_t(1)));
+
+    // monthly labels
+    cube_stref_labeled_time m;
+    m.set_time_labels(std::vector<std::string>{"2018-01", "2018-02", "2018-03"});
+    REQUIRE(m.index_range(datetime::from_string("2018-01-01"), datetime::from_string("2018-02-01")) == std::make_pair(uint32_t(0), uint32_t(1)));
+    REQUIRE(m.index_range(datetime::from_string("2018-01-01"), datetime::from_string("2018-02-02")) == std::make_pair(uint32_t(0), uint32_t(2)));
+    REQUIRE(m.index_range(datetime::from_string("2018-01-15"), datetime::from_string("2018-02-01T06:00:00")) == std::make_pair(uint32_t(0), uint32_t(2)));
+
+    // labels are replaced, not added
+    s.set_time_labels(std::vector<std::string>{"2018-01-05"});
+    REQUIRE(s.nt() == 1);
+    REQUIRE(s.index_at_datetime(datetime::from_string("2018-01-05")) == 0);
+    REQUIRE_THROWS(s.index_at_datetime(datetime::from_string("2018-01-01")));
+}
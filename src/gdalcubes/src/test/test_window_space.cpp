@@ -0,0 +1,273 @@
+/*
+    MIT License
+
+    Copyright (c) 2023 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <string>
+
+#include "../external/catch.hpp"
+#include "../gdalcubes.h"
+#include "test_cubes.h"
+
+using namespace gdalcubes;
+
+static const uint32_t NX = 11;
+static const uint32_t NY = 9;
+static const uint32_t NT = 2;
+
+// a single band with smooth but irregular values and some NAN pixels
+static std::shared_ptr<function_cube> test_cube(uint32_t ct, uint32_t cy, uint32_t cx, bool with_nan = true) {
+    cube_view v;
+    v.srs("EPSG:3857");
+    v.set_x_axis(0.0, NX, 1.0);
+    v.set_y_axis(0.0, NY, 1.0);
+    v.set_t_axis(datetime::from_string("2014-01-01"), datetime::from_string("2014-01-02"), duration::from_string("P1D"));
+    auto out = std::make_shared<function_cube>(v, [with_nan](uint32_t it, uint32_t iy, uint32_t ix) {
+        if (with_nan && std::sin(0.9 * ix + 1.7 * iy + 2 * it) + 0.8 < 0) return double(NAN);
+        return 10 * std::sin(0.7 * ix) + 5 * std::cos(1.3 * iy) + 3 * it;
+    });
+    out->set_chunk_size(ct, cy, cx);
+    return out;
+}
+
+static bool same_values(const std::vector<double> &a, const std::vector<double> &b) {
+    if (a.size() != b.size()) return false;
+    for (uint64_t i = 0; i < a.size(); ++i) {
+        if (std::isnan(a[i]) != std::isnan(b[i])) return false;
+        if (!std::isnan(a[i]) && std::fabs(a[i] - b[i]) > 1e-9 * std::max(1.0, std::fabs(a[i]))) return false;
+    }
+    return true;
+}
+
+// value of the padded input at global coordinates (y, x), directly following the definition of the padding methods
+static double padded_value(const std::vector<double> &in, uint32_t it, int64_t y, int64_t x, const std::string &pad, double pad_fill) {
+    int64_t ny = NY, nx = NX;
+    if (y < 0 || y >= ny || x < 0 || x >= nx) {
+        if (pad == "NA") return NAN;
+        if (pad == "constant") return pad_fill;
+        if (pad == "reflect") {
+            if (y < 0) y = -y - 1;
+            if (y >= ny) y = 2 * ny - y - 1;
+            if (x < 0) x = -x - 1;
+            if (x >= nx) x = 2 * nx - x - 1;
+        }
+        y = std::min(std::max(y, int64_t(0)), ny - 1);
+        x = std::min(std::max(x, int64_t(0)), nx - 1);
+    }
+    return in[(uint64_t(it) * NY + y) * NX + x];
+}
+
+// naive reducer / kernel over a window of the single band input
+static std::vector<double> naive_window(const std::vector<double> &in, const std::string &reducer, const std::vector<double> &kernel,
+                                        uint16_t wy, uint16_t wx, const std::string &pad, double pad_fill) {
+    std::vector<double> out(uint64_t(NT) * NY * NX, NAN);
+    for (uint32_t it = 0; it < NT; ++it) {
+        for (int64_t y = 0; y < NY; ++y) {
+            for (int64_t x = 0; x < NX; ++x) {
+                std::vector<double> w;
+                double ks = 0;
+                for (int64_t ky = 0; ky < wy; ++ky) {
+                    for (int64_t kx = 0; kx < wx; ++kx) {
+                        double v = padded_value(in, it, y + ky - wy / 2, x + kx - wx / 2, pad, pad_fill);
+                        if (!kernel.empty()) ks += kernel[ky * wx + kx] * v;
+                        if (!std::isnan(v)) w.push_back(v);
+                    }
+                }
+                double &o = out[(uint64_t(it) * NY + y) * NX + x];
+                if (!kernel.empty()) {
+                    o = ks;
+                    continue;
+                }
+                if (reducer == "count") {
+                    o = w.size();
+                    continue;
+                }
+                if (w.empty()) continue;
+                double sum = 0, prod = 1;
+                for (double v : w) {
+                    sum += v;
+                    prod *= v;
+                }
+                if (reducer == "sum") {
+                    o = sum;
+                } else if (reducer == "prod") {
+                    o = prod;
+                } else if (reducer == "mean") {
+                    o = sum / w.size();
+                } else if (reducer == "min") {
+                    o = *std::min_element(w.begin(), w.end());
+                } else if (reducer == "max") {
+                    o = *std::max_element(w.begin(), w.end());
+                } else if (reducer == "median") {
+                    std::sort(w.begin(), w.end());
+                    o = w.size() % 2 == 1 ? w[w.size() / 2] : (w[w.size() / 2 - 1] + w[w.size() / 2]) / 2;
+                } else if (w.size() > 1) {
+                    double mean = sum / w.size(), q = 0;
+                    for (double v : w) q += (v - mean) * (v - mean);
+                    o = reducer == "var" ? q / (w.size() - 1) : std::sqrt(q / (w.size() - 1));
+                }
+            }
+        }
+    }
+    return out;
+}
+
+TEST_CASE("Window reducers across chunk boundaries", "[window_space]") {
+    std::vector<double> in = read_dense(test_cube(NT, NY, NX));
+    uint32_t nnan = std::count_if(in.begin(), in.end(), [](double v) { return std::isnan(v); });
+    REQUIRE(nnan > 0);
+    REQUIRE(nnan < in.size() / 2);
+
+    std::vector<std::string> reducers = {"sum", "mean", "count", "var", "sd", "min", "max", "prod", "median"};
+    std::vector<std::pair<std::string, std::string>> reducer_bands;
+    for (auto &r : reducers) reducer_bands.push_back({r, "v"});
+
+    // windows smaller and larger than chunks
+    std::vector<std::pair<uint16_t, uint16_t>> windows = {{3, 3}, {1, 5}, {5, 3}, {7, 7}};
+    for (auto &w : windows) {
+        auto single = window_space_cube::create(test_cube(NT, NY, NX), reducer_bands, w.first, w.second);
+        std::vector<double> ref = read_dense(single);
+        for (uint16_t ir = 0; ir < reducers.size(); ++ir) {
+            std::vector<double> expected = naive_window(in, reducers[ir], {}, w.first, w.second, "NA", 0);
+            std::vector<double> res(ref.begin() + ir * expected.size(), ref.begin() + (ir + 1) * expected.size());
+            INFO(reducers[ir] << " " << w.first << "x" << w.second);
+            REQUIRE(same_values(res, expected));
+        }
+        for (auto cs : std::vector<std::array<uint32_t, 3>>{{1, 4, 3}, {2, 2, 2}, {1, 1, 1}, {2, 9, 4}}) {
+            auto chunked = window_space_cube::create(test_cube(cs[0], cs[1], cs[2]), reducer_bands, w.first, w.second);
+            REQUIRE(chunked->count_chunks() > 1);
+            INFO("chunk size " << cs[0] << "x" << cs[1] << "x" << cs[2] << ", window " << w.first << "x" << w.second);
+            REQUIRE(same_values(read_dense(chunked), ref));
+        }
+    }
+}
+
+TEST_CASE("Window padding", "[window_space]") {
+    std::vector<double> in = read_dense(test_cube(NT, NY, NX, false));
+    std::vector<std::string> reducers = {"sum", "count", "min", "median"};
+    std::vector<std::pair<std::string, std::string>> reducer_bands;
+    for (auto &r : reducers) reducer_bands.push_back({r, "v"});
+
+    for (std::string pad : {"NA", "constant", "replicate", "reflect"}) {
+        for (auto &w : std::vector<std::pair<uint16_t, uint16_t>>{{3, 3}, {5, 7}}) {
+            auto single = window_space_cube::create(test_cube(NT, NY, NX, false), reducer_bands, w.first, w.second, pad, -100);
+            std::vector<double> ref = read_dense(single);
+            for (uint16_t ir = 0; ir < reducers.size(); ++ir) {
+                std::vector<double> expected = naive_window(in, reducers[ir], {}, w.first, w.second, pad, -100);
+                std::vector<double> res(ref.begin() + ir * expected.size(), ref.begin() + (ir + 1) * expected.size());
+                INFO(pad << " " << reducers[ir] << " " << w.first << "x" << w.second);
+                REQUIRE(same_values(res, expected));
+            }
+            auto chunked = window_space_cube::create(test_cube(1, 2, 3, false), reducer_bands, w.first, w.second, pad, -100);
+            INFO(pad << " " << w.first << "x" << w.second);
+            REQUIRE(same_values(read_dense(chunked), ref));
+        }
+    }
+
+    // padded values at the upper left corner, window 3x3
+    std::vector<double> kernel(9, 0.0);
+    kernel[0] = 1;  // pixel at (y - 1, x - 1)
+    for (std::string pad : {"NA", "constant", "replicate", "reflect"}) {
+        auto c = window_space_cube::create(test_cube(1, 2, 2, false), kernel, 3, 3, pad, -100);
+        std::vector<double> res = read_dense(c);
+        double v00 = in[0], v01 = in[1], v11 = in[NX + 1];
+        if (pad == "NA") {
+            REQUIRE(std::isnan(res[0]));
+            REQUIRE(std::isnan(res[1]));
+        } else if (pad == "constant") {
+            REQUIRE(res[0] == -100);
+            REQUIRE(res[NX + 1] == v00);
+        } else if (pad == "replicate") {
+            REQUIRE(res[0] == v00);
+            REQUIRE(res[1] == v00);
+            REQUIRE(res[2] == v01);
+        } else {
+            // reflect repeats the boundary pixel, (-1, -1) -> (0, 0)
+            REQUIRE(res[0] == v00);
+            REQUIRE(res[NX + 1] == v00);
+            REQUIRE(res[NX + 2] == v01);
+            REQUIRE(res[2 * NX + 2] == v11);
+        }
+    }
+}
+
+TEST_CASE("Window kernels", "[window_space]") {
+    std::vector<double> in = read_dense(test_cube(NT, NY, NX));
+
+    std::vector<std::vector<double>> kernels = {
+        // 3x3 Gaussian and Sobel (separable)
+        {1.0 / 16, 2.0 / 16, 1.0 / 16, 2.0 / 16, 4.0 / 16, 2.0 / 16, 1.0 / 16, 2.0 / 16, 1.0 / 16},
+        {-1, 0, 1, -2, 0, 2, -1, 0, 1},
+        // 3x3 Laplacian (not separable)
+        {0, 1, 0, 1, -4, 1, 0, 1, 0}};
+    for (auto &k : kernels) {
+        for (std::string pad : {"NA", "replicate"}) {
+            std::vector<double> expected = naive_window(in, "", k, 3, 3, pad, 0);
+            auto single = window_space_cube::create(test_cube(NT, NY, NX), k, 3, 3, pad);
+            REQUIRE(same_values(read_dense(single), expected));
+            auto chunked = window_space_cube::create(test_cube(1, 4, 3), k, 3, 3, pad);
+            REQUIRE(same_values(read_dense(chunked), expected));
+        }
+    }
+
+    // 5x3 separable kernel with windows larger than chunks
+    std::vector<double> col = {1, -2, 3, 0.5, 1}, row = {2, 1, -1};
+    std::vector<double> k;
+    for (double a : col) {
+        for (double b : row) k.push_back(a * b);
+    }
+    std::vector<double> expected = naive_window(in, "", k, 5, 3, "reflect", 0);
+    auto chunked = window_space_cube::create(test_cube(1, 2, 1), k, 5, 3, "reflect");
+    REQUIRE(same_values(read_dense(chunked), expected));
+
+    REQUIRE_THROWS(window_space_cube::create(test_cube(1, 4, 3), k, 3, 3));
+    REQUIRE_THROWS(window_space_cube::create(test_cube(1, 4, 3), std::vector<double>(4, 1.0), 2, 2));
+    REQUIRE_THROWS(window_space_cube::create(test_cube(1, 4, 3), std::vector<double>(9, 1.0), 3, 3, "wrap"));
+    REQUIRE_THROWS(window_space_cube::create(test_cube(1, 4, 3), {{"mode", "v"}}, 3, 3));
+    REQUIRE_THROWS(window_space_cube::create(test_cube(1, 4, 3), {{"mean", "x"}}, 3, 3));
+}
+
+TEST_CASE("Window halo cache", "[window_space]") {
+    std::vector<std::pair<std::string, std::string>> reducer_bands = {{"mean", "v"}, {"median", "v"}};
+    auto ref = read_dense(window_space_cube::create(test_cube(NT, NY, NX), reducer_bands, 5, 3));
+
+    // each input chunk is read once, although it is needed by up to 9 output chunks
+    for (bool parallel : {false, true}) {
+        auto in = test_cube(1, 2, 3);
+        auto c = window_space_cube::create(in, reducer_bands, 5, 3);
+        REQUIRE(same_values(read_dense(c, parallel), ref));
+        REQUIRE(in->reads.size() == in->count_chunks());
+        for (auto &r : in->reads) {
+            INFO("chunk " << r.first << (parallel ? " (parallel)" : ""));
+            REQUIRE(r.second == 1);
+        }
+
+        // chunks are removed from the cache after all dependent chunks have been computed
+        in->reads.clear();
+        c->read_chunk(0);
+        REQUIRE(in->reads.size() == 4);
+    }
+}
@@ -0,0 +1,207 @@
+/*
+    MIT License
+
+    Copyright (c) 2023 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+
+namespace gdalcubes {
+
+// index of the pool worker running on the current thread, -1 for threads outside of the pool
+static thread_local int32_t current_worker = -1;
+
+void thread_pool::set_default_size(uint16_t nthreads) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _default_size = nthreads;
+}
+
+uint16_t thread_pool::default_size() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_default_size > 0) return _default_size;
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+uint16_t thread_pool::size() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _threads.size();
+}
+
+void thread_pool::ensure_threads(uint16_t nthreads) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stop = false;
+    while (_threads.size() < nthreads) {
+        int32_t self = _threads.size();
+        _queues.push_back(std::unique_ptr<task_queue>(new task_queue()));
+        _threads.push_back(std::thread(&thread_pool::work, this, self));
+    }
+}
+
+void thread_pool::clear() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _cv.notify_all();
+    for (uint16_t i = 0; i < _threads.size(); ++i) {
+        if (_threads[i].joinable()) _threads[i].join();
+    }
+    std::lock_guard<std::mutex> lock(_mutex);
+    _threads.clear();
+    _queues.clear();
+    _global.clear();
+    _ntasks = 0;
+    _stop = false;
+}
+
+void thread_pool::submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        task_queue *q = (current_worker >= 0 && current_worker < (int32_t)_queues.size()) ? _queues[current_worker].get() : &_global;
+        q->push_back(task);
+        ++_ntasks;
+    }
+    _cv.notify_one();
+}
+
+bool thread_pool::try_run_task(int32_t self) {
+    std::function<void()> task;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_ntasks == 0) return false;
+
+        // 1. own queue (most recently added first), 2. tasks from outside of the pool, 3. steal from other workers (oldest first)
+        if (self >= 0 && self < (int32_t)_queues.size() && !_queues[self]->empty()) {
+            task = std::move(_queues[self]->back());
+            _queues[self]->pop_back();
+        }
+        if (!task && !_global.empty()) {
+            task = std::move(_global.front());
+            _global.pop_front();
+        }
+        for (uint16_t k = 1; !task && k <= _queues.size(); ++k) {
+            uint16_t victim = (uint16_t)((std::max(self, 0) + k) % _queues.size());
+            if (!_queues[victim]->empty()) {
+                task = std::move(_queues[victim]->front());
+                _queues[victim]->pop_front();
+            }
+        }
+        if (!task) return false;
+        --_ntasks;
+    }
+    task();
+    return true;
+}
+
+void thread_pool::work(int32_t self) {
+    current_worker = self;
+    while (true) {
+        if (try_run_task(self)) continue;
+        std::unique_lock<std::mutex> lock(_mutex);
+        _cv.wait(lock, [this] { return _stop || _ntasks > 0; });
+        if (_stop) return;
+    }
+}
+
+namespace {
+// shared state of a parallel loop
+struct loop_state {
+    loop_state(uint32_t n, std::function<void(uint32_t)> f) : n(n), f(f), next(0), running(0), closed(false), err(nullptr), mutex(), cv() {}
+
+    // execute iterations until all have been claimed
+    void run() {
+        while (true) {
+            uint32_t i = next.fetch_add(1);
+            if (i >= n) break;
+            try {
+                f(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!err) err = std::current_exception();
+                next.store(n);  // skip remaining iterations
+            }
+        }
+    }
+
+    const uint32_t n;
+    std::function<void(uint32_t)> f;
+    std::atomic<uint32_t> next;
+    uint32_t running;  // number of helper tasks currently executing iterations
+    bool closed;       // set when the calling thread has finished, helper tasks started afterwards return immediately
+    std::exception_ptr err;
+    std::mutex mutex;
+    std::condition_variable cv;
+};
+}  // namespace
+
+void thread_pool::parallel_for(uint32_t n, std::function<void(uint32_t)> f, uint32_t max_parallel) {
+    if (n == 0) return;
+
+    // threads are started lazily, only as many as requested by callers from outside of the pool
+    // explicit parallelism is bounded by the default size only if it has been set (e.g. by a thread budget)
+    if (current_worker < 0) {
+        uint32_t nthreads;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            nthreads = _default_size;
+        }
+        if (max_parallel > 0) {
+            nthreads = (nthreads > 0) ? std::min(nthreads, max_parallel - 1) : max_parallel - 1;
+        } else if (nthreads == 0) {
+            nthreads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        ensure_threads(std::min(nthreads, n - 1));
+    }
+    uint32_t nparallel = size() + 1;
+    if (max_parallel > 0 && max_parallel < nparallel) nparallel = max_parallel;
+    if (nparallel > n) nparallel = n;
+
+    std::shared_ptr<loop_state> state = std::make_shared<loop_state>(n, f);
+    for (uint32_t k = 1; k < nparallel; ++k) {
+        submit([state]() {
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                if (state->closed) return;
+                ++state->running;
+            }
+            state->run();
+            std::lock_guard<std::mutex> lock(state->mutex);
+            --state->running;
+            state->cv.notify_all();
+        });
+    }
+    state->run();
+
+    // Wait only for helpers that have already started, helpers still waiting in a queue will do nothing
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->closed = true;
+    state->cv.wait(lock, [&state] { return state->running == 0; });
+    if (state->err) {
+        std::rethrow_exception(state->err);
+    }
+}
+
+}  // namespace gdalcubes
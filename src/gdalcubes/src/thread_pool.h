@@ -0,0 +1,128 @@
+/*
+    MIT License
+
+    Copyright (c) 2023 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace gdalcubes {
+
+/**
+ * @brief Process-wide work-stealing thread pool
+ *
+ * All parallel code paths of the library (chunk processing, vector queries, image collection operations, ...)
+ * submit their work to this pool instead of starting their own threads. Each worker thread has its own task queue;
+ * tasks submitted from a worker are added to its own queue, idle workers steal tasks from other queues.
+ *
+ * Parallel loops (see parallel_for()) may be nested, e.g. intra-chunk parallelism from within chunk tasks.
+ * The calling thread always participates in executing its loop and nested loops never start additional threads,
+ * such that the number of busy threads is bounded by the size of the pool plus the number of external callers.
+ */
+class thread_pool {
+   public:
+    static thread_pool *instance() {
+        static thread_pool instance;
+        return &instance;
+    }
+
+    /**
+     * @brief Execute f(i) for i = 0, ..., n - 1 in parallel and wait until all iterations have finished
+     *
+     * Iterations are distributed dynamically, i.e., threads fetch the next iteration as soon as they are finished
+     * with the previous one. If an iteration throws an exception, remaining iterations are skipped and the exception is rethrown
+     * by the calling thread.
+     * @param n number of iterations
+     * @param f function to be executed for each iteration
+     * @param max_parallel maximum number of iterations executed concurrently, including the calling thread,
+     * 0 means the default size of the pool plus one; if called from outside of the pool, the pool is
+     * enlarged if needed to achieve the requested parallelism, but never beyond a non-zero default size
+     */
+    void parallel_for(uint32_t n, std::function<void(uint32_t)> f, uint32_t max_parallel = 0);
+
+    /**
+     * @brief Set the number of worker threads that are started for parallel loops without explicit parallelism
+     *
+     * A non-zero size (e.g. derived from config::set_thread_budget()) also limits loops with explicit parallelism.
+     * @param nthreads number of threads, 0 means the number of available cores for loops without explicit parallelism
+     * and no limit otherwise
+     * @note Already running threads are not stopped before calling clear()
+     */
+    void set_default_size(uint16_t nthreads);
+
+    /**
+     * @brief Get the number of worker threads used by parallel loops without explicit parallelism
+     *
+     * In contrast to size(), this does not depend on how many threads have been started lazily so far.
+     * @return the default size if set, otherwise the number of available cores
+     */
+    uint16_t default_size();
+
+    /**
+     * @brief Get the number of currently running worker threads
+     */
+    uint16_t size();
+
+    /**
+     * @brief Stop all worker threads, the pool is restarted automatically when needed
+     * @note Must not be called while parallel loops are running
+     */
+    void clear();
+
+   private:
+    thread_pool(const thread_pool &) = delete;
+    thread_pool(thread_pool &&) = delete;
+    thread_pool &operator=(const thread_pool &) = delete;
+    thread_pool &operator=(thread_pool &&) = delete;
+    thread_pool() : _queues(), _threads(), _global(), _ntasks(0), _stop(false), _default_size(0), _mutex(), _cv() {}
+    ~thread_pool() { clear(); }
+
+    typedef std::deque<std::function<void()>> task_queue;
+
+    void submit(std::function<void()> task);
+    void ensure_threads(uint16_t nthreads);
+    bool try_run_task(int32_t self);
+    void work(int32_t self);
+
+    std::vector<std::unique_ptr<task_queue>> _queues;  // one per worker thread
+    std::vector<std::thread> _threads;
+    task_queue _global;  // tasks submitted from outside of the pool
+    uint32_t _ntasks;    // number of queued tasks
+    bool _stop;
+    uint16_t _default_size;
+    std::mutex _mutex;  // protects all of the above
+    std::condition_variable _cv;
+};
+
+}  // namespace gdalcubes
+
+#endif  // THREAD_POOL_H
@@ -24,6 +24,8 @@
 #ifndef TIMER_H
 #define TIMER_H
 
+#include <time.h>
+
 #include <chrono>
 
 namespace gdalcubes {
@@ -57,6 +59,21 @@ class timer {
         return time_span.count();
     }
 
+    /**
+     * Measure CPU time consumed by the calling thread, which can be compared to real elapsed time
+     * to find out how much time a thread spent waiting (e.g. for I/O or locks).
+     * @return CPU time of the calling thread in seconds or a negative value if not supported on this platform
+     */
+    static double thread_cpu_time() {
+#if defined(CLOCK_THREAD_CPUTIME_ID)
+        struct timespec ts;
+        if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0) {
+            return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+        }
+#endif
+        return -1;
+    }
+
    private:
     std::chrono::high_resolution_clock::time_point t;
 };
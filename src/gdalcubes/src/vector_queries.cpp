@@ -27,10 +27,11 @@
 #include <gdal_utils.h>
 #include <ogrsf_frmts.h>
 
-#include <thread>
 #include <unordered_map>
 #include <cstring>
 
+#include "thread_pool.h"
+
 namespace gdalcubes {
 
 std::vector<std::vector<double>> vector_queries::query_points(std::shared_ptr<cube> cube, std::vector<double> x,
@@ -65,11 +66,10 @@ std::vector<std::vector<double>> vector_queries::query_points(std::shared_ptr<cu
         srs_out.SetFromUserInput(cube->st_reference()->srs().c_str());
 
         if (!srs_in.IsSame(&srs_out)) {
-            std::vector<std::thread> workers_transform;
             uint32_t n = (uint32_t)std::ceil(double(x.size()) / double(nthreads));  // points per thread
 
-            for (uint32_t ithread = 0; ithread < nthreads; ++ithread) {
-                workers_transform.push_back(std::thread([&cube, &srs, &srs_in, &srs_out, &x, &y, ithread, n](void) {
+            thread_pool::instance()->parallel_for(
+                nthreads, [&cube, &srs, &srs_in, &srs_out, &x, &y, n](uint32_t ithread) {
                     OGRCoordinateTransformation *coord_transform = OGRCreateCoordinateTransformation(&srs_in, &srs_out);
 
                     int begin = ithread * n;
@@ -84,11 +84,8 @@ std::vector<std::vector<double>> vector_queries::query_points(std::shared_ptr<cu
                         }
                     }
                     OCTDestroyCoordinateTransformation(coord_transform);
-                }));
-            }
-            for (uint32_t ithread = 0; ithread < nthreads; ++ithread) {
-                workers_transform[ithread].join();
-            }
+                },
+                nthreads);
         }
     }
 
@@ -100,10 +97,9 @@ std::vector<std::vector<double>> vector_queries::query_points(std::shared_ptr<cu
 
     std::map<chunkid_t, std::vector<uint32_t>> chunk_index;
 
-    std::vector<std::thread> workers_preprocess;
     std::mutex mtx;
-    for (uint32_t ithread = 0; ithread < nthreads; ++ithread) {
-        workers_preprocess.push_back(std::thread([&mtx, &cube, &x, &y, &t, &it, &chunk_index, ithread, nthreads](void) {
+    thread_pool::instance()->parallel_for(
+        nthreads, [&mtx, &cube, &x, &y, &t, &it, &chunk_index, nthreads](uint32_t ithread) {
             for (uint32_t i = ithread; i < x.size(); i += nthreads) {
                 coords_st st;
 
@@ -136,11 +132,8 @@ std::vector<std::vector<double>> vector_queries::query_points(std::shared_ptr<cu
                 chunk_index[c].push_back(i);
                 mtx.unlock();
             }
-        }));
-    }
-    for (uint32_t ithread = 0; ithread < nthreads; ++ithread) {
-        workers_preprocess[ithread].join();
-    }
+        },
+        nthreads);
 
     std::vector<std::vector<double>> out;
     out.resize(cube->bands().count());
@@ -153,49 +146,41 @@ std::vector<std::vector<double>> vector_queries::query_points(std::shared_ptr<cu
         chunks.push_back(iter->first);
     }
 
-    std::vector<std::thread> workers;
-    for (uint32_t ithread = 0; ithread < nthreads; ++ithread) {
-        workers.push_back(std::thread([&prg, &cube, &out, &chunk_index, &chunks, &x, &it, &y, ithread, nthreads](void) {
-            for (uint32_t ic = ithread; ic < chunks.size(); ic += nthreads) {
-                try {
-                    if (chunks[ic] < cube->count_chunks()) {  // if chunk exists
-                        std::shared_ptr<chunk_data> dat = cube->read_chunk(chunks[ic]);
-                        if (!dat->empty()) {  // if chunk is not empty
-                            // iterate over all query points within the current chunk
-                            for (uint32_t i = 0; i < chunk_index[chunks[ic]].size(); ++i) {
-                                double ixc = x[chunk_index[chunks[ic]][i]];
-                                double iyc = y[chunk_index[chunks[ic]][i]];
-                                double itc = it[chunk_index[chunks[ic]][i]];
-
-                                int iix = ((int)std::floor(ixc)) % cube->chunk_size()[2];
-                                int iiy = dat->size()[2] - 1 - (((int)std::floor(iyc)) % cube->chunk_size()[1]);
-                                int iit = ((int)std::floor(itc)) % cube->chunk_size()[0];
-
-                                // check to prevent out of bounds faults
-                                if (iix < 0 || uint32_t(iix) >= dat->size()[3]) continue;
-                                if (iiy < 0 || uint32_t(iiy) >= dat->size()[2]) continue;
-                                if (iit < 0 || uint32_t(iit) >= dat->size()[1]) continue;
-
-                                for (uint16_t ib = 0; ib < out.size(); ++ib) {
-                                    out[ib][chunk_index[chunks[ic]][i]] = ((double *)dat->buf())[ib * dat->size()[1] * dat->size()[2] * dat->size()[3] + iit * dat->size()[2] * dat->size()[3] + iiy * dat->size()[3] + iix];
-                                }
+    thread_pool::instance()->parallel_for(
+        chunks.size(), [&prg, &cube, &out, &chunk_index, &chunks, &x, &it, &y](uint32_t ic) {
+            try {
+                if (chunks[ic] < cube->count_chunks()) {  // if chunk exists
+                    std::shared_ptr<chunk_data> dat = cube->read_chunk(chunks[ic]);
+                    if (!dat->empty()) {  // if chunk is not empty
+                        // iterate over all query points within the current chunk
+                        for (uint32_t i = 0; i < chunk_index[chunks[ic]].size(); ++i) {
+                            double ixc = x[chunk_index[chunks[ic]][i]];
+                            double iyc = y[chunk_index[chunks[ic]][i]];
+                            double itc = it[chunk_index[chunks[ic]][i]];
+
+                            int iix = ((int)std::floor(ixc)) % cube->chunk_size()[2];
+                            int iiy = dat->size()[2] - 1 - (((int)std::floor(iyc)) % cube->chunk_size()[1]);
+                            int iit = ((int)std::floor(itc)) % cube->chunk_size()[0];
+
+                            // check to prevent out of bounds faults
+                            if (iix < 0 || uint32_t(iix) >= dat->size()[3]) continue;
+                            if (iiy < 0 || uint32_t(iiy) >= dat->size()[2]) continue;
+                            if (iit < 0 || uint32_t(iit) >= dat->size()[1]) continue;
+
+                            for (uint16_t ib = 0; ib < out.size(); ++ib) {
+                                out[ib][chunk_index[chunks[ic]][i]] = ((double *)dat->buf())[ib * dat->size()[1] * dat->size()[2] * dat->size()[3] + iit * dat->size()[2] * dat->size()[3] + iiy * dat->size()[3] + iix];
                             }
                         }
                     }
-                    prg->increment((double)1 / (double)chunks.size());
-                } catch (std::string s) {
-                    GCBS_ERROR(s);
-                    continue;
-                } catch (...) {
-                    GCBS_ERROR("unexpected exception while processing chunk " + std::to_string(chunks[ic]));
-                    continue;
                 }
+                prg->increment((double)1 / (double)chunks.size());
+            } catch (std::string s) {
+                GCBS_ERROR(s);
+            } catch (...) {
+                GCBS_ERROR("unexpected exception while processing chunk " + std::to_string(chunks[ic]));
             }
-        }));
-    }
-    for (uint32_t ithread = 0; ithread < nthreads; ++ithread) {
-        workers[ithread].join();
-    }
+        },
+        nthreads);
     prg->finalize();
 
     return out;
@@ -233,11 +218,10 @@ std::vector<std::vector<std::vector<double>>> vector_queries::query_timeseries(s
         srs_out.SetFromUserInput(srs.c_str());
 
         if (!srs_in.IsSame(&srs_out)) {
-            std::vector<std::thread> workers_transform;
             uint32_t n = (uint32_t)std::ceil(double(x.size()) / double(nthreads));  // points per thread
 
-            for (uint32_t ithread = 0; ithread < nthreads; ++ithread) {
-                workers_transform.push_back(std::thread([&cube, &srs, &srs_in, &srs_out, &x, &y, ithread, n](void) {
+            thread_pool::instance()->parallel_for(
+                nthreads, [&cube, &srs, &srs_in, &srs_out, &x, &y, n](uint32_t ithread) {
                     OGRCoordinateTransformation *coord_transform = OGRCreateCoordinateTransformation(&srs_in, &srs_out);
 
                     int begin = ithread * n;
@@ -252,11 +236,8 @@ std::vector<std::vector<std::vector<double>>> vector_queries::query_timeseries(s
                         }
                     }
                     OCTDestroyCoordinateTransformation(coord_transform);
-                }));
-            }
-            for (uint32_t ithread = 0; ithread < nthreads; ++ithread) {
-                workers_transform[ithread].join();
-            }
+                },
+                nthreads);
         }
     }
 
@@ -267,10 +248,9 @@ std::vector<std::vector<std::vector<double>>> vector_queries::query_timeseries(s
     ipoints.resize(x.size());
 
     std::map<chunkid_t, std::vector<uint32_t>> chunk_index;
-    std::vector<std::thread> workers_preprocess;
     std::mutex mtx;
-    for (uint32_t ithread = 0; ithread < nthreads; ++ithread) {
-        workers_preprocess.push_back(std::thread([&mtx, &cube, &x, &y, &chunk_index, ithread, nthreads](void) {
+    thread_pool::instance()->parallel_for(
+        nthreads, [&mtx, &cube, &x, &y, &chunk_index, nthreads](uint32_t ithread) {
             for (uint32_t i = ithread; i < x.size(); i += nthreads) {
                 coords_st st;
 
@@ -296,11 +276,8 @@ std::vector<std::vector<std::vector<double>>> vector_queries::query_timeseries(s
                 chunk_index[c].push_back(i);
                 mtx.unlock();
             }
-        }));
-    }
-    for (uint32_t ithread = 0; ithread < nthreads; ++ithread) {
-        workers_preprocess[ithread].join();
-    }
+        },
+        nthreads);
 
     std::vector<std::vector<std::vector<double>>> out;
     out.resize(cube->bands().count());
@@ -316,54 +293,46 @@ std::vector<std::vector<std::vector<double>>> vector_queries::query_timeseries(s
         chunks.push_back(iter->first);
     }
 
-    std::vector<std::thread> workers;
-    for (uint32_t ithread = 0; ithread < nthreads; ++ithread) {
-        workers.push_back(std::thread([&prg, &cube, &out, &chunk_index, &chunks, &x, &y, ithread, nthreads](void) {
-            for (uint32_t ic = ithread; ic < chunks.size(); ic += nthreads) {
-                try {
-                    for (uint32_t ct = 0; ct < cube->count_chunks_t(); ct++) {
-                        chunkid_t cur_chunk = chunks[ic] + ct * (cube->count_chunks_x() * cube->count_chunks_y());
-                        if (cur_chunk < cube->count_chunks()) {  // if chunk exists
-                            uint32_t nt_in_chunk = cube->chunk_size(cur_chunk)[0];
-                            std::shared_ptr<chunk_data> dat = cube->read_chunk(cur_chunk);
-                            if (!dat->empty()) {  // if chunk is not empty
-                                // iterate over all query points within the current chunk
-                                for (uint32_t i = 0; i < chunk_index[chunks[ic]].size(); ++i) {
-                                    double ixc = x[chunk_index[chunks[ic]][i]];
-                                    double iyc = y[chunk_index[chunks[ic]][i]];
-
-                                    int iix = (ixc - cube->bounds_from_chunk(cur_chunk).s.left) /
-                                              cube->st_reference()->dx();
-                                    int iiy = (cube->bounds_from_chunk(cur_chunk).s.top - iyc) /
-                                              cube->st_reference()->dy();
-
-                                    // check to prevent out of bounds faults
-                                    if (iix < 0 || uint32_t(iix) >= dat->size()[3]) continue;
-                                    if (iiy < 0 || uint32_t(iiy) >= dat->size()[2]) continue;
-
-                                    for (uint16_t ib = 0; ib < out.size(); ++ib) {
-                                        for (uint32_t it = 0; it < nt_in_chunk; ++it) {
-                                            out[ib][ct * cube->chunk_size()[0] + it][chunk_index[chunks[ic]][i]] = ((double *)dat->buf())[ib * dat->size()[1] * dat->size()[2] * dat->size()[3] + it * dat->size()[2] * dat->size()[3] + iiy * dat->size()[3] + iix];
-                                        }
+    thread_pool::instance()->parallel_for(
+        chunks.size(), [&prg, &cube, &out, &chunk_index, &chunks, &x, &y](uint32_t ic) {
+            try {
+                for (uint32_t ct = 0; ct < cube->count_chunks_t(); ct++) {
+                    chunkid_t cur_chunk = chunks[ic] + ct * (cube->count_chunks_x() * cube->count_chunks_y());
+                    if (cur_chunk < cube->count_chunks()) {  // if chunk exists
+                        uint32_t nt_in_chunk = cube->chunk_size(cur_chunk)[0];
+                        std::shared_ptr<chunk_data> dat = cube->read_chunk(cur_chunk);
+                        if (!dat->empty()) {  // if chunk is not empty
+                            // iterate over all query points within the current chunk
+                            for (uint32_t i = 0; i < chunk_index[chunks[ic]].size(); ++i) {
+                                double ixc = x[chunk_index[chunks[ic]][i]];
+                                double iyc = y[chunk_index[chunks[ic]][i]];
+
+                                int iix = (ixc - cube->bounds_from_chunk(cur_chunk).s.left) /
+                                          cube->st_reference()->dx();
+                                int iiy = (cube->bounds_from_chunk(cur_chunk).s.top - iyc) /
+                                          cube->st_reference()->dy();
+
+                                // check to prevent out of bounds faults
+                                if (iix < 0 || uint32_t(iix) >= dat->size()[3]) continue;
+                                if (iiy < 0 || uint32_t(iiy) >= dat->size()[2]) continue;
+
+                                for (uint16_t ib = 0; ib < out.size(); ++ib) {
+                                    for (uint32_t it = 0; it < nt_in_chunk; ++it) {
+                                        out[ib][ct * cube->chunk_size()[0] + it][chunk_index[chunks[ic]][i]] = ((double *)dat->buf())[ib * dat->size()[1] * dat->size()[2] * dat->size()[3] + it * dat->size()[2] * dat->size()[3] + iiy * dat->size()[3] + iix];
                                     }
                                 }
                             }
                         }
-                        prg->increment((double)1 / ((double)chunks.size() * (double)cube->count_chunks_t()));
                     }
-                } catch (std::string s) {
-                    GCBS_ERROR(s);
-                    continue;
-                } catch (...) {
-                    GCBS_ERROR("unexpected exception while processing chunk " + std::to_string(chunks[ic]));
-                    continue;
+                    prg->increment((double)1 / ((double)chunks.size() * (double)cube->count_chunks_t()));
                 }
+            } catch (std::string s) {
+                GCBS_ERROR(s);
+            } catch (...) {
+                GCBS_ERROR("unexpected exception while processing chunk " + std::to_string(chunks[ic]));
             }
-        }));
-    }
-    for (uint32_t ithread = 0; ithread < nthreads; ++ithread) {
-        workers[ithread].join();
-    }
+        },
+        nthreads);
     prg->finalize();
 
     return out;
@@ -845,10 +814,9 @@ void vector_queries::zonal_statistics(std::shared_ptr<cube> cube, std::string og
     uint16_t nthreads = config::instance()->get_default_chunk_processor()->max_threads();
 
     std::mutex mutex;
-    std::vector<std::thread> workers;
     std::vector<std::string> out_temp_files;
-    for (uint16_t ithread = 0; ithread < nthreads; ++ithread) {
-        workers.push_back(std::thread([ithread, nthreads, &cube, &agg_func_names, &agg_func_creators, nfeatures, &features_in_chunk, &fid_column, &band_index, &output_file, &index_of_FID, FID_of_index, &mutex, &prg, &out_temp_files, &ogr_dataset, &ogr_layer](void) {
+    thread_pool::instance()->parallel_for(
+        nthreads, [nthreads, &cube, &agg_func_names, &agg_func_creators, nfeatures, &features_in_chunk, &fid_column, &band_index, &output_file, &index_of_FID, FID_of_index, &mutex, &prg, &out_temp_files, &ogr_dataset, &ogr_layer](uint32_t ithread) {
             GDALDriver *gpkg_driver = GetGDALDriverManager()->GetDriverByName("GPKG");
             //            if (gpkg_driver == NULL) {
             //                GCBS_ERROR("OGR GeoPackage driver not found");
@@ -1073,11 +1041,8 @@ void vector_queries::zonal_statistics(std::shared_ptr<cube> cube, std::string og
                 GDALClose(gpkg_out);
             }
             GDALClose(in_ogr_dataset);
-        }));
-    }
-    for (uint16_t ithread = 0; ithread < nthreads; ++ithread) {
-        workers[ithread].join();
-    }
+        },
+        nthreads);
 
     // Combine layers with ogr2ogr
     CPLStringList ogr2ogr_args;
@@ -825,18 +825,15 @@ class cube_stref_labeled_time : public cube_stref_regular {
     void set_time_labels(std::vector<datetime> t) {
         // TODO: if t.empty()
         _t_values = t;
-
-        // TODO: what if not sorted?
-        for (uint32_t i = 0; i < _t_values.size(); ++i) {
-            _t_index.insert(std::make_pair(t[i], i));
-        }
+        build_time_index();
     }
 
     void set_time_labels(std::vector<std::string> t) {
-        // TODO: what if not sorted?
-        for (uint32_t i = 0; i < _t_values.size(); ++i) {
-            _t_index.insert(std::make_pair(datetime::from_string(t[i]), i));
+        _t_values.clear();
+        for (uint32_t i = 0; i < t.size(); ++i) {
+            _t_values.push_back(datetime::from_string(t[i]));
         }
+        build_time_index();
     }
 
     std::vector<datetime> get_time_labels() {
@@ -872,12 +869,41 @@ class cube_stref_labeled_time : public cube_stref_regular {
     }
 
     virtual uint32_t index_at_datetime(datetime t) override {
-        auto res = _t_index.find(t);
-        if (res == _t_index.end()) {
+        int64_t k = time_key(t);
+        uint32_t i = lower_bound(k);
+        if (i == _t_keys.size() || _t_keys[i] != k) {
             GCBS_ERROR("Data cubes does not contain time slice for requested datetime");
             throw std::string("Data cubes does not contain time slice for requested datetime");
         }
-        return res->second;
+        return _t_index[i];
+    }
+
+    /**
+     * @brief Get the index of the time label closest to t, ties are resolved towards the earlier label
+     */
+    uint32_t index_nearest(datetime t) {
+        if (_t_keys.empty()) {
+            throw std::string("ERROR in cube_stref_labeled_time::index_nearest(): data cube has no time labels");
+        }
+        int64_t k = time_key(t);
+        uint32_t i = lower_bound(k);
+        if (i == _t_keys.size()) return _t_index[i - 1];
+        if (i > 0 && k - _t_keys[i - 1] <= _t_keys[i] - k) return _t_index[i - 1];
+        return _t_index[i];
+    }
+
+    /**
+     * @brief Get the range of time indexes with labels in the half-open interval [t0, t1)
+     *
+     * Labels are compared at their own unit, i.e. a label covers its full day, month, etc. and is included
+     * if this period intersects with the interval (e.g. a daily label 2018-01-05 is included for t1 = 2018-01-05T12:00).
+     * @return pair of the first index and one past the last index, both are equal if no label is in the interval
+     * @note Requires labels to be sorted in ascending order, which is the case for all cubes created by gdalcubes
+     */
+    std::pair<uint32_t, uint32_t> index_range(datetime t0, datetime t1) {
+        uint32_t first = lower_bound(time_key(t0));
+        uint32_t last = lower_bound(time_key_ceil(t1));
+        return std::make_pair(first, std::max(first, last));
     }
 
     friend bool operator==(const cube_stref_labeled_time &l, const cube_stref_labeled_time &r) {
@@ -917,13 +943,95 @@ class cube_stref_labeled_time : public cube_stref_regular {
         x->_srs = _srs;
 
         x->_t_values = _t_values;
+        x->_t_keys = _t_keys;
         x->_t_index = _t_index;
+        x->_t_unit = _t_unit;
         return x;
     }
 
    protected:
     std::vector<datetime> _t_values;
-    std::map<datetime, uint32_t> _t_index;
+
+    // Labels are indexed as sorted integer counts of the labels' datetime unit since the epoch, such that
+    // lookups are binary searches over integers instead of datetime comparisons.
+    std::vector<int64_t> _t_keys;    // sorted keys
+    std::vector<uint32_t> _t_index;  // time index of the label with key _t_keys[i]
+    datetime_unit _t_unit = datetime_unit::DAY;
+
+    void build_time_index() {
+        _t_unit = _t_values.empty() ? datetime_unit::DAY : _t_values[0].unit();
+        std::vector<std::pair<int64_t, uint32_t>> k(_t_values.size());
+        for (uint32_t i = 0; i < _t_values.size(); ++i) {
+            k[i] = std::make_pair(time_key(_t_values[i]), i);
+        }
+        std::stable_sort(k.begin(), k.end(), [](const std::pair<int64_t, uint32_t>& a, const std::pair<int64_t, uint32_t>& b) {
+            return a.first < b.first;
+        });
+        _t_keys.resize(k.size());
+        _t_index.resize(k.size());
+        for (uint32_t i = 0; i < k.size(); ++i) {
+            _t_keys[i] = k[i].first;
+            _t_index[i] = k[i].second;
+        }
+    }
+
+    static int64_t floor_div(int64_t a, int64_t b) {
+        return a / b - (a % b != 0 && (a < 0) != (b < 0));
+    }
+
+    // Number of full time units (of the labels) since the epoch, where t is converted to the unit of the labels
+    int64_t time_key(datetime t) {
+        int64_t s = (int64_t)t.epoch_time();
+        switch (_t_unit) {
+            case datetime_unit::MINUTE:
+                return floor_div(s, 60);
+            case datetime_unit::HOUR:
+                return floor_div(s, 3600);
+            case datetime_unit::DAY:
+            case datetime_unit::WEEK:
+                return floor_div(s, 86400);
+            case datetime_unit::MONTH:
+                return int64_t(t.year()) * 12 + t.month() - 1;
+            case datetime_unit::YEAR:
+                return t.year();
+            default:
+                return s;
+        }
+    }
+
+    // Like time_key() but counts partial time units, i.e. rounds up if t is not at the start of a time unit
+    int64_t time_key_ceil(datetime t) {
+        int64_t s = (int64_t)t.epoch_time();
+        bool partial_day = s - floor_div(s, 86400) * 86400 != 0;
+        switch (_t_unit) {
+            case datetime_unit::MINUTE:
+                return -floor_div(-s, 60);
+            case datetime_unit::HOUR:
+                return -floor_div(-s, 3600);
+            case datetime_unit::DAY:
+            case datetime_unit::WEEK:
+                return -floor_div(-s, 86400);
+            case datetime_unit::MONTH:
+                return time_key(t) + ((partial_day || t.dayofmonth() != 1) ? 1 : 0);
+            case datetime_unit::YEAR:
+                return time_key(t) + ((partial_day || t.dayofmonth() != 1 || t.month() != 1) ? 1 : 0);
+            default:
+                return s;
+        }
+    }
+
+    // Index of the first key that is not less than k (branch-free binary search)
+    uint32_t lower_bound(int64_t k) {
+        uint32_t n = _t_keys.size();
+        if (n == 0) return 0;
+        const int64_t* base = _t_keys.data();
+        while (n > 1) {
+            uint32_t half = n / 2;
+            base = (base[half] < k) ? base + half : base;
+            n -= half;
+        }
+        return (base - _t_keys.data()) + (*base < k);
+    }
 };
 
 }  // namespace gdalcubes
@@ -26,7 +26,10 @@
 
 #include <gdalwarper.h>
 
+#include <cstdio>
+
 #include "config.h"
+#include "resample.h"
 
 namespace gdalcubes {
 
@@ -138,15 +141,20 @@ GDALDataset *gdalwarp_client::warp(GDALDataset *in, std::string s_srs, std::stri
             char **oo = nullptr;
             oo = CSLAddString(oo, ("OVERVIEW_LEVEL=" + std::to_string(ilevel)).c_str());
 
-            std::string descr = in->GetDescription();
-            GDALClose(in);
-            in = (GDALDataset *)GDALOpenEx(descr.c_str(), GDAL_OF_RASTER | GDAL_OF_READONLY, NULL, oo, NULL);
-            if (in != NULL) {
+#if GDAL_VERSION_MAJOR > 2 || (GDAL_VERSION_MAJOR == 2 && GDAL_VERSION_MINOR >= 2)
+            // the overview dataset references in and shares its handle, e.g. blocks prefetched to its block cache
+            GDALDataset *in_ov = GDALCreateOverviewDataset(in, ilevel, TRUE);
+#else
+            GDALDataset *in_ov = (GDALDataset *)GDALOpenEx(in->GetDescription(), GDAL_OF_RASTER | GDAL_OF_READONLY, NULL, oo, NULL);
+#endif
+            if (in_ov != NULL) {
+                in->ReleaseRef();
+                in = in_ov;
                 destroy_transform((gdalwarp_client::gdalcubes_transform_info *)psWarpOptions->pTransformerArg);
                 psWarpOptions->pTransformerArg = create_transform(in, out, s_srs, t_srs);
-                psWarpOptions->hSrcDS = in;  // TODO: close in_ov
+                psWarpOptions->hSrcDS = in;
             } else {
-                GCBS_WARN("Failed to open GDAL overview dataset for '" + descr + "', using original full resolution image.");
+                GCBS_WARN("Failed to open GDAL overview dataset for '" + std::string(in->GetDescription()) + "', using original full resolution image.");
             }
             CSLDestroy(oo);
         }
@@ -156,6 +164,20 @@ GDALDataset *gdalwarp_client::warp(GDALDataset *in, std::string s_srs, std::stri
         std::free(succ);
     }
 
+    // Nearest neighbor and bilinear resampling use precomputed gather maps if possible
+    if (resampling == "near" || resampling == "bilinear") {
+        if (warp_gather(in, out, s_srs, t_srs, psWarpOptions->pTransformerArg,
+                        resampling == "near" ? gather_map::method::NEAR : gather_map::method::BILINEAR, srcnodata)) {
+            destroy_transform((gdalwarp_client::gdalcubes_transform_info *)psWarpOptions->pTransformerArg);
+            GDALDestroyWarpOptions(psWarpOptions);
+            CPLFree(wkt_out);
+            if (in) {
+                in->ReleaseRef();
+            }
+            return out;
+        }
+    }
+
     psWarpOptions->eResampleAlg = GDALResampleAlg::GRA_NearestNeighbour;
     if (resampling == "bilinear") {
         psWarpOptions->eResampleAlg = GDALResampleAlg::GRA_Bilinear;
@@ -226,8 +248,11 @@ GDALDataset *gdalwarp_client::warp(GDALDataset *in, std::string s_srs, std::stri
 
     char **wo = nullptr;
     wo = CSLAddString(wo, "INIT_DEST=nan");
-    wo = CSLAddString(wo, ("NUM_THREADS=" + std::to_string(config::instance()->get_gdal_num_threads())).c_str());
+    wo = CSLAddString(wo, ("NUM_THREADS=" + std::to_string(config::instance()->get_gdal_num_threads_per_worker())).c_str());
     psWarpOptions->papszWarpOptions = wo;
+    if (config::instance()->get_warp_memory_per_worker() > 0) {
+        psWarpOptions->dfWarpMemoryLimit = (double)config::instance()->get_warp_memory_per_worker();
+    }
 
     // Initialize and execute the warp operation.
     GDALWarpOperation oOperation;
@@ -244,11 +269,91 @@ GDALDataset *gdalwarp_client::warp(GDALDataset *in, std::string s_srs, std::stri
     CPLFree(wkt_out);
 
     if (in) {
-        GDALClose(in);
+        in->ReleaseRef();
     }
     return out;
 }
 
+static std::string gather_map_key(GDALDataset *in, GDALDataset *out, const std::string &s_srs, const std::string &t_srs, gather_map::method m) {
+    double src_gt[6] = {0, 1, 0, 0, 0, 1};
+    double dst_gt[6] = {0, 1, 0, 0, 0, 1};
+    in->GetGeoTransform(src_gt);
+    out->GetGeoTransform(dst_gt);
+    std::string key = s_srs + "\n" + t_srs + "\n" + (m == gather_map::method::NEAR ? "near" : "bilinear");
+    char buf[64];
+    for (uint16_t i = 0; i < 6; ++i) {
+        std::snprintf(buf, sizeof(buf), " %a", src_gt[i]);
+        key += buf;
+    }
+    for (uint16_t i = 0; i < 6; ++i) {
+        std::snprintf(buf, sizeof(buf), " %a", dst_gt[i]);
+        key += buf;
+    }
+    key += " " + std::to_string(in->GetRasterXSize()) + "x" + std::to_string(in->GetRasterYSize());
+    key += " " + std::to_string(out->GetRasterXSize()) + "x" + std::to_string(out->GetRasterYSize());
+    return key;
+}
+
+bool gdalwarp_client::warp_gather(GDALDataset *in, GDALDataset *out, std::string s_srs, std::string t_srs, void *transform_arg,
+                                  gather_map::method m, const std::vector<double> &srcnodata) {
+    int nb = in->GetRasterCount();
+    if (nb == 0) return false;
+
+    // GDAL applies mask bands (per-dataset masks, alpha bands, no data values of the source file), which gather maps
+    // ignore; masks from no data values are equivalent to srcnodata if given
+    for (int b = 1; b <= nb; ++b) {
+        int flags = in->GetRasterBand(b)->GetMaskFlags();
+        if (flags != GMF_ALL_VALID && !(flags == GMF_NODATA && !srcnodata.empty())) {
+            return false;
+        }
+    }
+
+    std::string key = gather_map_key(in, out, s_srs, t_srs, m);
+    std::shared_ptr<gather_map> map;
+    if (!gather_map_cache::instance()->get(key, map)) {
+        map = gather_map::create([transform_arg](uint32_t n, double *x, double *y, int *success) {
+            transform(transform_arg, TRUE, int(n), x, y, nullptr, success);
+        },
+                                 in->GetRasterXSize(), in->GetRasterYSize(), out->GetRasterXSize(), out->GetRasterYSize(), m);
+        gather_map_cache::instance()->put(key, map);
+    }
+    if (!map) return false;
+
+    uint32_t ts_x = out->GetRasterXSize();
+    uint32_t ts_y = out->GetRasterYSize();
+    std::vector<double> dst(uint64_t(ts_x) * uint64_t(ts_y));
+
+    uint64_t win_size = uint64_t(map->win_nx()) * uint64_t(map->win_ny());
+    uint64_t mem_limit = config::instance()->get_warp_memory_per_worker();
+    if (mem_limit == 0) mem_limit = 256 * 1024 * 1024;
+    if (win_size * nb * sizeof(double) > mem_limit) {
+        return false;  // GDAL processes large source windows in smaller parts
+    }
+
+    std::vector<double> src(win_size * nb);
+    if (!map->empty()) {
+        if (in->RasterIO(GF_Read, map->win_xoff(), map->win_yoff(), map->win_nx(), map->win_ny(), src.data(),
+                         map->win_nx(), map->win_ny(), GDT_Float64, nb, nullptr, 0, 0, 0, NULL) != CE_None) {
+            return false;
+        }
+    }
+
+    for (int b = 0; b < nb; ++b) {
+        double *src_b = src.data() + uint64_t(b) * win_size;
+        if (srcnodata.size() == 1 || srcnodata.size() == (size_t)nb) {
+            double nodata = srcnodata.size() == 1 ? srcnodata[0] : srcnodata[b];
+            for (uint64_t i = 0; i < win_size; ++i) {
+                if (src_b[i] == nodata) src_b[i] = NAN;
+            }
+        }
+        map->apply(src_b, dst.data());
+        if (out->GetRasterBand(b + 1)->RasterIO(GF_Write, 0, 0, ts_x, ts_y, dst.data(), ts_x, ts_y, GDT_Float64, 0, 0, NULL) != CE_None) {
+            GCBS_WARN("RasterIO (write) failed for in-memory warp result");
+        }
+    }
+    return true;
+}
+
 /*
      * Source code of this function has been adapted from original GDAL code starting at
      * https://github.com/OSGeo/gdal/blob/0bfd1bcb38b3fe321fd15f3c485cfb91537faf0e/gdal/alg/gdaltransformer.cpp#L1355
@@ -30,6 +30,7 @@
 #include <map>
 
 #include "coord_types.h"
+#include "resample.h"
 
 namespace gdalcubes {
 
@@ -81,7 +82,7 @@ class gdalwarp_client {
    public:
     /**
      * Warp source GDAL dataset to a target grid
-     * @param in source GDAL dataset, will be closed at the end of this function
+     * @param in source GDAL dataset, one reference is released at the end of this function, i.e. the dataset is closed unless the caller holds another reference (see GDALDataset::Reference())
      * @param s_srs spatial reference system of source image, given as string understandable for OGRSpatialReference::SetFromUserInput()
      * @param t_srs target spatial reference system, given as string understandable for OGRSpatialReference::SetFromUserInput()
      * @param te_left left (minimum x) coordinate of the target grid, given in the target SRS
@@ -96,6 +97,13 @@ class gdalwarp_client {
      */
     static GDALDataset *warp(GDALDataset *in, std::string s_srs, std::string t_srs, double te_left, double te_right, double te_top, double te_bottom, uint32_t ts_x, uint32_t ts_y, std::string resampling, std::vector<double> srcnodata);
 
+    /**
+     * Resample all bands of a source GDAL dataset to the grid of an in-memory dataset using a cached gather map
+     * @return false if the resampling cannot be done with a gather map, in which case out is unchanged
+     */
+    static bool warp_gather(GDALDataset *in, GDALDataset *out, std::string s_srs, std::string t_srs, void *transform_arg,
+                            gather_map::method m, const std::vector<double> &srcnodata);
+
     static gdalcubes_transform_info *create_transform(GDALDataset *in, GDALDataset *out, std::string srs_in_str, std::string srs_out_str);
     static void destroy_transform(gdalcubes_transform_info *transform);
 
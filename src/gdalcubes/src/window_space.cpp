@@ -0,0 +1,539 @@
+/*
+    MIT License
+
+    Copyright (c) 2023 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#include "window_space.h"
+
+#include <algorithm>
+#include <future>
+#include <list>
+#include <map>
+#include <mutex>
+
+namespace gdalcubes {
+
+// upper limit for the size of input chunks kept in the halo cache
+static const uint64_t HALO_CACHE_MAX_BYTES = 256 * 1024 * 1024;
+
+struct window_space_cube::halo_cache {
+    struct entry {
+        std::shared_future<std::shared_ptr<chunk_data>> chunk;
+        uint32_t remaining;  // number of output chunks that still need the chunk
+        uint64_t bytes;
+        std::list<chunkid_t>::iterator pos;
+    };
+    std::map<chunkid_t, entry> entries;
+    std::list<chunkid_t> order;  // oldest first
+    uint64_t bytes = 0;
+    uint32_t max_entries = 0;
+    std::mutex mutex;
+
+    void erase(std::map<chunkid_t, entry>::iterator it) {
+        bytes -= it->second.bytes;
+        order.erase(it->second.pos);
+        entries.erase(it);
+    }
+
+    void shrink() {
+        while (!order.empty() && (entries.size() > max_entries || bytes > HALO_CACHE_MAX_BYTES)) {
+            erase(entries.find(order.front()));
+        }
+    }
+};
+
+window_space_cube::window_space_cube(std::shared_ptr<cube> in, std::vector<std::pair<std::string, std::string>> reducer_bands,
+                                     uint16_t win_size_y, uint16_t win_size_x, std::string pad, double pad_fill)
+    : cube(in->st_reference()->copy()), _in_cube(in), _reducer_bands(reducer_bands), _kernel(), _win_size_y(win_size_y), _win_size_x(win_size_x), _pad(pad), _pad_fill(pad_fill), _band_idx_in(), _kernel_col(), _kernel_row(), _halo(std::make_shared<halo_cache>()) {  // it is important to duplicate st reference here, otherwise changes will affect input cube as well
+    _chunk_size[0] = _in_cube->chunk_size()[0];
+    _chunk_size[1] = _in_cube->chunk_size()[1];
+    _chunk_size[2] = _in_cube->chunk_size()[2];
+    check();
+
+    for (uint16_t i = 0; i < reducer_bands.size(); ++i) {
+        std::string reducerstr = reducer_bands[i].first;
+        std::string bandstr = reducer_bands[i].second;
+        if (reducerstr != "sum" && reducerstr != "mean" && reducerstr != "count" && reducerstr != "var" && reducerstr != "sd" &&
+            reducerstr != "min" && reducerstr != "max" && reducerstr != "prod" && reducerstr != "median") {
+            GCBS_ERROR("Unknown reducer '" + reducerstr + "'");
+            throw std::string("ERROR in window_space_cube::window_space_cube(): Unknown reducer '" + reducerstr + "'");
+        }
+        if (!in->bands().has(bandstr)) {
+            GCBS_ERROR("Input data cube has no band '" + bandstr + "'");
+            throw std::string("ERROR in window_space_cube::window_space_cube(): Input data cube has no band '" + bandstr + "'");
+        }
+
+        band b = in->bands().get(bandstr);
+        b.name = b.name + "_" + reducerstr;
+        _bands.add(b);
+
+        _band_idx_in.push_back(in->bands().get_index(bandstr));
+    }
+}
+
+window_space_cube::window_space_cube(std::shared_ptr<cube> in, std::vector<double> kernel, uint16_t win_size_y, uint16_t win_size_x,
+                                     std::string pad, double pad_fill)
+    : cube(in->st_reference()->copy()), _in_cube(in), _reducer_bands(), _kernel(kernel), _win_size_y(win_size_y), _win_size_x(win_size_x), _pad(pad), _pad_fill(pad_fill), _band_idx_in(), _kernel_col(), _kernel_row(), _halo(std::make_shared<halo_cache>()) {  // it is important to duplicate st reference here, otherwise changes will affect input cube as well
+    _chunk_size[0] = _in_cube->chunk_size()[0];
+    _chunk_size[1] = _in_cube->chunk_size()[1];
+    _chunk_size[2] = _in_cube->chunk_size()[2];
+    check();
+
+    if ((uint32_t)win_size_y * (uint32_t)win_size_x != kernel.size()) {
+        GCBS_ERROR("Kernel size does not match window size");
+        throw std::string("ERROR in window_space_cube::window_space_cube(): Kernel size does not match window size");
+    }
+
+    for (uint16_t i = 0; i < in->bands().count(); ++i) {
+        _bands.add(in->bands().get(i));
+        _band_idx_in.push_back(i);
+    }
+
+    // check whether the kernel is the outer product of a column and a row vector, using the largest element as pivot
+    uint32_t pivot = 0;
+    for (uint32_t i = 1; i < kernel.size(); ++i) {
+        if (std::fabs(kernel[i]) > std::fabs(kernel[pivot])) pivot = i;
+    }
+    double kmax = std::fabs(kernel[pivot]);
+    if (kmax > 0) {
+        uint16_t py = pivot / win_size_x;
+        uint16_t px = pivot % win_size_x;
+        std::vector<double> col(win_size_y);
+        std::vector<double> row(win_size_x);
+        for (uint16_t iy = 0; iy < win_size_y; ++iy) {
+            col[iy] = kernel[iy * win_size_x + px];
+        }
+        for (uint16_t ix = 0; ix < win_size_x; ++ix) {
+            row[ix] = kernel[py * win_size_x + ix] / kernel[pivot];
+        }
+        bool separable = true;
+        for (uint16_t iy = 0; iy < win_size_y && separable; ++iy) {
+            for (uint16_t ix = 0; ix < win_size_x && separable; ++ix) {
+                if (std::fabs(col[iy] * row[ix] - kernel[iy * win_size_x + ix]) > 1e-12 * kmax) {
+                    separable = false;
+                }
+            }
+        }
+        if (separable && win_size_y > 1 && win_size_x > 1) {
+            _kernel_col = col;
+            _kernel_row = row;
+        }
+    }
+}
+
+void window_space_cube::check() {
+    if (_win_size_y % 2 == 0 || _win_size_x % 2 == 0) {
+        GCBS_ERROR("Window size must be odd");
+        throw std::string("ERROR in window_space_cube::window_space_cube(): Window size must be odd");
+    }
+    if (_pad != "NA" && _pad != "constant" && _pad != "replicate" && _pad != "reflect") {
+        GCBS_ERROR("Invalid padding method '" + _pad + "'");
+        throw std::string("ERROR in window_space_cube::window_space_cube(): Invalid padding method '" + _pad + "', expected one of 'NA', 'constant', 'replicate', 'reflect'");
+    }
+
+    // keep about two rows of chunks (plus halos) in the cache, which is sufficient if chunks are processed in order
+    uint32_t ky = (uint32_t)std::ceil((double)(_win_size_y / 2) / (double)_chunk_size[1]);
+    uint32_t kx = (uint32_t)std::ceil((double)(_win_size_x / 2) / (double)_chunk_size[2]);
+    _halo->max_entries = (2 * ky + 2) * count_chunks_x() + 2 * kx + 16;
+}
+
+uint32_t window_space_cube::count_dependent_chunks(chunkid_t id) {
+    chunk_coordinate_tyx c = chunk_coords_from_id(id);
+    int64_t ky = (int64_t)std::ceil((double)(_win_size_y / 2) / (double)_chunk_size[1]);
+    int64_t kx = (int64_t)std::ceil((double)(_win_size_x / 2) / (double)_chunk_size[2]);
+    int64_t rows = std::min(int64_t(c[1]) + ky, int64_t(count_chunks_y()) - 1) - std::max(int64_t(c[1]) - ky, int64_t(0)) + 1;
+    int64_t cols = std::min(int64_t(c[2]) + kx, int64_t(count_chunks_x()) - 1) - std::max(int64_t(c[2]) - kx, int64_t(0)) + 1;
+    return uint32_t(rows * cols);
+}
+
+std::shared_ptr<chunk_data> window_space_cube::read_input_chunk(chunkid_t id) {
+    std::unique_lock<std::mutex> lock(_halo->mutex);
+    auto it = _halo->entries.find(id);
+    if (it != _halo->entries.end()) {
+        std::shared_future<std::shared_ptr<chunk_data>> f = it->second.chunk;
+        if (--(it->second.remaining) == 0) {
+            _halo->erase(it);
+        }
+        lock.unlock();
+        return f.get();
+    }
+
+    uint32_t n = count_dependent_chunks(id);
+    if (n <= 1) {
+        lock.unlock();
+        return _in_cube->read_chunk(id);
+    }
+
+    // other output chunks will wait for this thread to read the chunk
+    std::promise<std::shared_ptr<chunk_data>> p;
+    halo_cache::entry e;
+    e.chunk = p.get_future().share();
+    e.remaining = n - 1;
+    e.bytes = 0;
+    e.pos = _halo->order.insert(_halo->order.end(), id);
+    _halo->entries[id] = e;
+    _halo->shrink();
+    lock.unlock();
+
+    std::shared_ptr<chunk_data> c;
+    try {
+        c = _in_cube->read_chunk(id);
+    } catch (...) {
+        p.set_exception(std::current_exception());
+        throw;
+    }
+    p.set_value(c);
+
+    lock.lock();
+    it = _halo->entries.find(id);
+    if (it != _halo->entries.end()) {
+        it->second.bytes = c->total_size_bytes();
+        _halo->bytes += it->second.bytes;
+        _halo->shrink();
+    }
+    return c;
+}
+
+void window_space_cube::fill_padding(double *buf, uint32_t pny, uint32_t pnx, int64_t y0, int64_t x0) {
+    if (_pad == "NA") return;  // buffer is initialized with NAN
+    int64_t ny = size_y();
+    int64_t nx = size_x();
+
+    if (_pad == "constant") {
+        for (uint32_t iy = 0; iy < pny; ++iy) {
+            int64_t gy = y0 + iy;
+            for (uint32_t ix = 0; ix < pnx; ++ix) {
+                int64_t gx = x0 + ix;
+                if (gy < 0 || gy >= ny || gx < 0 || gx >= nx) {
+                    buf[iy * pnx + ix] = _pad_fill;
+                }
+            }
+        }
+        return;
+    }
+
+    bool reflect = _pad == "reflect";
+    auto source = [reflect](int64_t g, int64_t n) -> int64_t {
+        if (reflect) {
+            if (g < 0) g = -g - 1;
+            if (g >= n) g = 2 * n - g - 1;
+        }
+        return std::min(std::max(g, int64_t(0)), n - 1);
+    };
+
+    // columns of rows inside the cube first, then complete rows outside of the cube
+    for (uint32_t iy = 0; iy < pny; ++iy) {
+        int64_t gy = y0 + iy;
+        if (gy < 0 || gy >= ny) continue;
+        for (uint32_t ix = 0; ix < pnx; ++ix) {
+            int64_t gx = x0 + ix;
+            if (gx >= 0 && gx < nx) continue;
+            int64_t sx = source(gx, nx) - x0;
+            buf[iy * pnx + ix] = (sx >= 0 && sx < pnx) ? buf[iy * pnx + sx] : NAN;
+        }
+    }
+    for (uint32_t iy = 0; iy < pny; ++iy) {
+        int64_t gy = y0 + iy;
+        if (gy >= 0 && gy < ny) continue;
+        int64_t sy = source(gy, ny) - y0;
+        if (sy >= 0 && sy < pny) {
+            std::copy(buf + sy * pnx, buf + (sy + 1) * pnx, buf + iy * pnx);
+        } else {
+            std::fill(buf + iy * pnx, buf + (iy + 1) * pnx, NAN);
+        }
+    }
+}
+
+/*
+ * Reducers over windows of a padded plane with pny rows and pnx columns, the result has
+ * pny - wy + 1 rows and pnx - wx + 1 columns. NAN values are ignored, the result is NAN if a window has no values.
+ */
+static void window_reduce_separable(const double *p, uint32_t pny, uint32_t pnx, uint16_t wy, uint16_t wx, const std::string &reducer, double *out) {
+    uint32_t ny = pny - wy + 1;
+    uint32_t nx = pnx - wx + 1;
+
+    if (reducer == "min" || reducer == "max") {
+        bool is_min = reducer == "min";
+        std::vector<double> h(uint64_t(pny) * nx);
+        for (uint32_t iy = 0; iy < pny; ++iy) {
+            for (uint32_t ix = 0; ix < nx; ++ix) {
+                double m = NAN;
+                for (uint16_t k = 0; k < wx; ++k) {
+                    double v = p[uint64_t(iy) * pnx + ix + k];
+                    if (std::isnan(v)) continue;
+                    if (std::isnan(m) || (is_min ? v < m : v > m)) m = v;
+                }
+                h[uint64_t(iy) * nx + ix] = m;
+            }
+        }
+        for (uint32_t iy = 0; iy < ny; ++iy) {
+            for (uint32_t ix = 0; ix < nx; ++ix) {
+                double m = NAN;
+                for (uint16_t k = 0; k < wy; ++k) {
+                    double v = h[uint64_t(iy + k) * nx + ix];
+                    if (std::isnan(v)) continue;
+                    if (std::isnan(m) || (is_min ? v < m : v > m)) m = v;
+                }
+                out[uint64_t(iy) * nx + ix] = m;
+            }
+        }
+        return;
+    }
+
+    bool is_prod = reducer == "prod";
+    bool need_sq = reducer == "var" || reducer == "sd";
+
+    // values are shifted for numerically more stable variances
+    double shift = 0;
+    if (need_sq) {
+        for (uint64_t i = 0; i < uint64_t(pny) * pnx; ++i) {
+            if (!std::isnan(p[i])) {
+                shift = p[i];
+                break;
+            }
+        }
+    }
+
+    std::vector<double> hs(uint64_t(pny) * nx);
+    std::vector<double> hq(need_sq ? uint64_t(pny) * nx : 0);
+    std::vector<uint32_t> hn(uint64_t(pny) * nx);
+    for (uint32_t iy = 0; iy < pny; ++iy) {
+        for (uint32_t ix = 0; ix < nx; ++ix) {
+            double s = is_prod ? 1 : 0, q = 0;
+            uint32_t n = 0;
+            for (uint16_t k = 0; k < wx; ++k) {
+                double v = p[uint64_t(iy) * pnx + ix + k];
+                if (std::isnan(v)) continue;
+                if (is_prod) {
+                    s *= v;
+                } else {
+                    v -= shift;
+                    s += v;
+                    q += v * v;
+                }
+                ++n;
+            }
+            hs[uint64_t(iy) * nx + ix] = s;
+            if (need_sq) hq[uint64_t(iy) * nx + ix] = q;
+            hn[uint64_t(iy) * nx + ix] = n;
+        }
+    }
+    for (uint32_t iy = 0; iy < ny; ++iy) {
+        for (uint32_t ix = 0; ix < nx; ++ix) {
+            double s = is_prod ? 1 : 0, q = 0;
+            uint32_t n = 0;
+            for (uint16_t k = 0; k < wy; ++k) {
+                uint64_t i = uint64_t(iy + k) * nx + ix;
+                if (is_prod) {
+                    s *= hs[i];
+                } else {
+                    s += hs[i];
+                }
+                if (need_sq) q += hq[i];
+                n += hn[i];
+            }
+            double &o = out[uint64_t(iy) * nx + ix];
+            if (reducer == "count") {
+                o = n;
+            } else if (n == 0) {
+                o = NAN;
+            } else if (reducer == "sum" || is_prod) {
+                o = s;
+            } else if (reducer == "mean") {
+                o = s / double(n);
+            } else {
+                // var / sd
+                double var = n > 1 ? std::max((q - s * s / double(n)) / double(n - 1), 0.0) : NAN;
+                o = reducer == "sd" ? std::sqrt(var) : var;
+            }
+        }
+    }
+}
+
+static void window_median(const double *p, uint32_t pny, uint32_t pnx, uint16_t wy, uint16_t wx, double *out) {
+    uint32_t ny = pny - wy + 1;
+    uint32_t nx = pnx - wx + 1;
+    std::vector<double> val;
+    val.reserve(uint32_t(wy) * wx);
+    for (uint32_t iy = 0; iy < ny; ++iy) {
+        for (uint32_t ix = 0; ix < nx; ++ix) {
+            val.clear();
+            for (uint16_t ky = 0; ky < wy; ++ky) {
+                for (uint16_t kx = 0; kx < wx; ++kx) {
+                    double v = p[uint64_t(iy + ky) * pnx + ix + kx];
+                    if (!std::isnan(v)) val.push_back(v);
+                }
+            }
+            double &o = out[uint64_t(iy) * nx + ix];
+            if (val.empty()) {
+                o = NAN;
+                continue;
+            }
+            std::size_t m = val.size() / 2;
+            std::nth_element(val.begin(), val.begin() + m, val.end());
+            o = val[m];
+            if (val.size() % 2 == 0) {
+                o = (o + *std::max_element(val.begin(), val.begin() + m)) / 2.0;
+            }
+        }
+    }
+}
+
+/*
+ * Kernel convolution (without flipping the kernel, as in window_time_cube), the result is NAN if any value of the window is NAN
+ */
+static void window_kernel(const double *p, uint32_t pny, uint32_t pnx, uint16_t wy, uint16_t wx, const std::vector<double> &kernel,
+                          const std::vector<double> &kernel_col, const std::vector<double> &kernel_row, double *out) {
+    uint32_t ny = pny - wy + 1;
+    uint32_t nx = pnx - wx + 1;
+    if (!kernel_col.empty()) {
+        // NAN propagates through both passes
+        std::vector<double> h(uint64_t(pny) * nx);
+        for (uint32_t iy = 0; iy < pny; ++iy) {
+            for (uint32_t ix = 0; ix < nx; ++ix) {
+                double s = 0;
+                for (uint16_t k = 0; k < wx; ++k) {
+                    s += kernel_row[k] * p[uint64_t(iy) * pnx + ix + k];
+                }
+                h[uint64_t(iy) * nx + ix] = s;
+            }
+        }
+        for (uint32_t iy = 0; iy < ny; ++iy) {
+            for (uint32_t ix = 0; ix < nx; ++ix) {
+                double s = 0;
+                for (uint16_t k = 0; k < wy; ++k) {
+                    s += kernel_col[k] * h[uint64_t(iy + k) * nx + ix];
+                }
+                out[uint64_t(iy) * nx + ix] = s;
+            }
+        }
+        return;
+    }
+    for (uint32_t iy = 0; iy < ny; ++iy) {
+        for (uint32_t ix = 0; ix < nx; ++ix) {
+            double s = 0;
+            for (uint16_t ky = 0; ky < wy; ++ky) {
+                for (uint16_t kx = 0; kx < wx; ++kx) {
+                    s += kernel[ky * wx + kx] * p[uint64_t(iy + ky) * pnx + ix + kx];
+                }
+            }
+            out[uint64_t(iy) * nx + ix] = s;
+        }
+    }
+}
+
+std::shared_ptr<chunk_data> window_space_cube::read_chunk(chunkid_t id) {
+    GCBS_TRACE("window_space_cube::read_chunk(" + std::to_string(id) + ")");
+    std::shared_ptr<chunk_data> out = std::make_shared<chunk_data>();
+    if (id >= count_chunks())
+        return out;  // chunk is outside of the view, we don't need to read anything.
+
+    chunk_coordinate_tyx c = chunk_coords_from_id(id);
+    bounds_nd<uint32_t, 3> limits = chunk_limits(id);
+    coords_nd<uint32_t, 3> size_tyx = chunk_size(id);
+
+    uint16_t hy = _win_size_y / 2;
+    uint16_t hx = _win_size_x / 2;
+    int64_t ky = (int64_t)std::ceil((double)hy / (double)_chunk_size[1]);
+    int64_t kx = (int64_t)std::ceil((double)hx / (double)_chunk_size[2]);
+
+    // read this chunk and its neighbors
+    std::vector<std::shared_ptr<chunk_data>> in_chunks;
+    std::vector<bounds_nd<uint32_t, 3>> in_limits;
+    bool empty = true;
+    for (int64_t cy = int64_t(c[1]) - ky; cy <= int64_t(c[1]) + ky; ++cy) {
+        if (cy < 0 || cy >= int64_t(count_chunks_y())) continue;
+        for (int64_t cx = int64_t(c[2]) - kx; cx <= int64_t(c[2]) + kx; ++cx) {
+            if (cx < 0 || cx >= int64_t(count_chunks_x())) continue;
+            chunk_coordinate_tyx cc = {c[0], uint32_t(cy), uint32_t(cx)};
+            chunkid_t cid = chunk_id_from_coords(cc);
+            std::shared_ptr<chunk_data> x = read_input_chunk(cid);
+            if (!x->empty()) {
+                in_chunks.push_back(x);
+                in_limits.push_back(chunk_limits(cc));
+                empty = false;
+            }
+        }
+    }
+    if (empty) {
+        return out;
+    }
+
+    coords_nd<uint32_t, 4> size_btyx = {uint32_t(_bands.count()), size_tyx[0], size_tyx[1], size_tyx[2]};
+    out->size(size_btyx);
+    out->buf(std::calloc(size_btyx[0] * size_btyx[1] * size_btyx[2] * size_btyx[3], sizeof(double)));
+    double *begin = (double *)out->buf();
+    double *end = ((double *)out->buf()) + size_btyx[0] * size_btyx[1] * size_btyx[2] * size_btyx[3];
+    std::fill(begin, end, NAN);
+
+    // padded plane of one band and time slice, including halos
+    uint32_t pny = size_tyx[1] + 2 * hy;
+    uint32_t pnx = size_tyx[2] + 2 * hx;
+    int64_t y0 = int64_t(limits.low[1]) - hy;
+    int64_t x0 = int64_t(limits.low[2]) - hx;
+    std::vector<double> plane(uint64_t(pny) * pnx);
+
+    std::vector<uint16_t> bands_in(_band_idx_in);
+    std::sort(bands_in.begin(), bands_in.end());
+    bands_in.erase(std::unique(bands_in.begin(), bands_in.end()), bands_in.end());
+
+    for (uint16_t ib_in : bands_in) {
+        for (uint32_t it = 0; it < size_tyx[0]; ++it) {
+            std::fill(plane.begin(), plane.end(), NAN);
+            for (uint32_t i = 0; i < in_chunks.size(); ++i) {
+                const coords_nd<uint32_t, 4> &s = in_chunks[i]->size();
+                const double *buf = (const double *)in_chunks[i]->buf();
+                int64_t gy_from = std::max(int64_t(in_limits[i].low[1]), y0);
+                int64_t gy_to = std::min(int64_t(in_limits[i].high[1]), y0 + int64_t(pny) - 1);
+                int64_t gx_from = std::max(int64_t(in_limits[i].low[2]), x0);
+                int64_t gx_to = std::min(int64_t(in_limits[i].high[2]), x0 + int64_t(pnx) - 1);
+                if (gy_from > gy_to || gx_from > gx_to) continue;
+                for (int64_t gy = gy_from; gy <= gy_to; ++gy) {
+                    const double *src = buf + ((uint64_t(ib_in) * s[1] + it) * s[2] + (gy - in_limits[i].low[1])) * s[3] + (gx_from - in_limits[i].low[2]);
+                    std::copy(src, src + (gx_to - gx_from + 1), plane.data() + (gy - y0) * pnx + (gx_from - x0));
+                }
+            }
+            fill_padding(plane.data(), pny, pnx, y0, x0);
+
+            for (uint16_t ib = 0; ib < _bands.count(); ++ib) {
+                if (_band_idx_in[ib] != ib_in) continue;
+                double *res = ((double *)out->buf()) + (uint64_t(ib) * size_tyx[0] + it) * size_tyx[1] * size_tyx[2];
+                if (!_kernel.empty()) {
+                    window_kernel(plane.data(), pny, pnx, _win_size_y, _win_size_x, _kernel, _kernel_col, _kernel_row, res);
+                } else if (_reducer_bands[ib].first == "median") {
+                    window_median(plane.data(), pny, pnx, _win_size_y, _win_size_x, res);
+                } else {
+                    window_reduce_separable(plane.data(), pny, pnx, _win_size_y, _win_size_x, _reducer_bands[ib].first, res);
+                }
+            }
+        }
+    }
+
+    // check if chunk is completely NAN and if yes, return empty chunk
+    if (out->all_nan()) {
+        out = std::make_shared<chunk_data>();
+    }
+    return out;
+}
+
+}  // namespace gdalcubes
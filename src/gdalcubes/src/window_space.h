@@ -0,0 +1,151 @@
+/*
+    MIT License
+
+    Copyright (c) 2023 Marius Appel <marius.appel@uni-muenster.de>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#ifndef WINDOW_SPACE_H
+#define WINDOW_SPACE_H
+
+#include "cube.h"
+
+namespace gdalcubes {
+
+/**
+ * @brief A data cube that applies reducer functions or a convolution kernel over moving spatial windows
+ *
+ * The cube has the same shape and chunking as the input cube. Windows that cross chunk boundaries read
+ * pixels from adjacent chunks (halos). Since an input chunk is needed by up to nine output chunks (more if windows
+ * are larger than chunks), input chunks are cached until all output chunks that depend on them have been computed.
+ *
+ * Pixels of windows outside of the cube extent are NAN by default, or can be filled with a constant value,
+ * by replicating the closest pixel at the boundary ("replicate"), or by mirroring pixels at the boundary ("reflect").
+ *
+ * Reducers "sum", "mean", "count", "var", "sd", "min", "max", and "prod" are computed separably (first over rows, then
+ * over columns), "median" is computed directly. Kernels that are outer products of a column and a row vector
+ * (e.g. Gaussian, Sobel, box filters) are convolved separably, too.
+ */
+class window_space_cube : public cube {
+   public:
+    /**
+     * @brief Create a data cube that applies reducer functions over moving spatial windows
+     * @note This static creation method should preferably be used instead of the constructors as
+     * the constructors will not set connections between cubes properly.
+     * @param in input data cube
+     * @param reducer_bands pairs of reducer name and input band name, one output band for each pair
+     * @param win_size_y number of rows of the window (odd)
+     * @param win_size_x number of columns of the window (odd)
+     * @param pad padding method, one of "NA" (default), "constant", "replicate", or "reflect"
+     * @param pad_fill constant value used if pad is "constant"
+     * @return a shared pointer to the created data cube instance
+     */
+    static std::shared_ptr<window_space_cube>
+    create(std::shared_ptr<cube> in, std::vector<std::pair<std::string, std::string>> reducer_bands,
+           uint16_t win_size_y, uint16_t win_size_x, std::string pad = "NA", double pad_fill = 0.0) {
+        std::shared_ptr<window_space_cube> out = std::make_shared<window_space_cube>(in, reducer_bands, win_size_y, win_size_x, pad, pad_fill);
+        in->add_child_cube(out);
+        out->add_parent_cube(in);
+        return out;
+    }
+
+    /**
+     * @brief Create a data cube that applies a convolution kernel over moving spatial windows on all bands
+     * @note This static creation method should preferably be used instead of the constructors as
+     * the constructors will not set connections between cubes properly.
+     * @param in input data cube
+     * @param kernel kernel weights in row-major order (first row is the top row of the window)
+     * @param win_size_y number of rows of the kernel (odd)
+     * @param win_size_x number of columns of the kernel (odd)
+     * @param pad padding method, one of "NA" (default), "constant", "replicate", or "reflect"
+     * @param pad_fill constant value used if pad is "constant"
+     * @return a shared pointer to the created data cube instance
+     */
+    static std::shared_ptr<window_space_cube>
+    create(std::shared_ptr<cube> in, std::vector<double> kernel, uint16_t win_size_y, uint16_t win_size_x,
+           std::string pad = "NA", double pad_fill = 0.0) {
+        std::shared_ptr<window_space_cube> out = std::make_shared<window_space_cube>(in, kernel, win_size_y, win_size_x, pad, pad_fill);
+        in->add_child_cube(out);
+        out->add_parent_cube(in);
+        return out;
+    }
+
+   public:
+    window_space_cube(std::shared_ptr<cube> in, std::vector<std::pair<std::string, std::string>> reducer_bands,
+                      uint16_t win_size_y, uint16_t win_size_x, std::string pad, double pad_fill);
+
+    window_space_cube(std::shared_ptr<cube> in, std::vector<double> kernel, uint16_t win_size_y, uint16_t win_size_x,
+                      std::string pad, double pad_fill);
+
+   public:
+    ~window_space_cube() {}
+
+    std::shared_ptr<chunk_data> read_chunk(chunkid_t id) override;
+
+    json11::Json make_constructible_json() override {
+        json11::Json::object out;
+        out["cube_type"] = "window_space";
+        if (!_kernel.empty()) {
+            out["kernel"] = _kernel;
+        } else {
+            json11::Json::array rb;
+            for (uint16_t i = 0; i < _reducer_bands.size(); ++i) {
+                rb.push_back(json11::Json::array({_reducer_bands[i].first, _reducer_bands[i].second}));
+            }
+            out["reducer_bands"] = rb;
+        }
+        out["win_size_y"] = _win_size_y;
+        out["win_size_x"] = _win_size_x;
+        out["pad"] = _pad;
+        out["pad_fill"] = _pad_fill;
+        out["in_cube"] = _in_cube->make_constructible_json();
+        return out;
+    }
+
+   private:
+    std::shared_ptr<cube> _in_cube;
+    std::vector<std::pair<std::string, std::string>> _reducer_bands;
+    std::vector<double> _kernel;
+    uint16_t _win_size_y;
+    uint16_t _win_size_x;
+    std::string _pad;
+    double _pad_fill;
+
+    // input band of each output band
+    std::vector<uint16_t> _band_idx_in;
+
+    // kernel = column vector x row vector, empty if the kernel is not separable
+    std::vector<double> _kernel_col;
+    std::vector<double> _kernel_row;
+
+    // cache of input chunks that are needed to compute several output chunks
+    struct halo_cache;
+    std::shared_ptr<halo_cache> _halo;
+
+    void check();
+    std::shared_ptr<chunk_data> read_input_chunk(chunkid_t id);
+    uint32_t count_dependent_chunks(chunkid_t id);
+    void fill_padding(double *buf, uint32_t pny, uint32_t pnx, int64_t y0, int64_t x0);
+};
+
+}  // namespace gdalcubes
+
+#endif  // WINDOW_SPACE_H
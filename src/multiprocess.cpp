@@ -1,15 +1,33 @@
 
 #include "multiprocess.h"
 #include "gdalcubes/src/cube_factory.h"
+#include "gdalcubes/src/image_collection_cube.h"
+#include "gdalcubes/src/prefetch.h"
 #include "gdalcubes/src/external/tiny-process-library/process.hpp"
 #include "error.h"
 
 // [[Rcpp::plugins("cpp11")]]
 #include <Rcpp.h>
+#include <algorithm>
 #include <fstream>
 
 namespace gdalcubes {
 
+// Find all image collection cubes a data cube depends on
+static void find_image_collection_cubes(std::shared_ptr<cube> c, std::vector<std::shared_ptr<image_collection_cube>>& out) {
+  std::shared_ptr<image_collection_cube> x = std::dynamic_pointer_cast<image_collection_cube>(c);
+  if (x) {
+    if (std::find(out.begin(), out.end(), x) == out.end()) {
+      out.push_back(x);
+    }
+    return;
+  }
+  std::vector<std::shared_ptr<cube>> parents = c->parent_cubes();
+  for (uint16_t i = 0; i < parents.size(); ++i) {
+    find_image_collection_cubes(parents[i], out);
+  }
+}
+
 void chunk_processor_multiprocess::apply(std::shared_ptr<cube> c,
                                          std::function<void(chunkid_t, std::shared_ptr<chunk_data>, std::mutex &)> f) {
   
@@ -26,10 +44,36 @@ void chunk_processor_multiprocess::apply(std::shared_ptr<cube> c,
   filesystem::mkdir(work_dir);
   GCBS_DEBUG("Using '" + work_dir + "' as working directory for child processes");
 
+  // Workers read images from compact snapshots of the needed part of image collections instead of opening
+  // (possibly large or temporary) collection databases
+  std::vector<std::shared_ptr<image_collection_cube>> ic_cubes;
+  find_image_collection_cubes(c, ic_cubes);
+  std::vector<std::string> snapshot_files;
+  for (uint16_t i = 0; i < ic_cubes.size(); ++i) {
+    std::string snapshot_file = filesystem::join(work_dir, "collection_" + std::to_string(i) + ".snapshot");
+    try {
+      ic_cubes[i]->write_snapshot(snapshot_file);
+      snapshot_files.push_back(snapshot_file);
+    }
+    catch (std::string s) {
+      GCBS_DEBUG("Failed to create image collection snapshot, workers will open the image collection file: " + s);
+      ic_cubes[i]->clear_snapshot();
+    }
+  }
+  
   std::string json_path =filesystem::join(work_dir,"cube.json");
   std::ofstream jsonfile(json_path);
-  jsonfile << c->make_constructible_json().dump();
+  try {
+    jsonfile << c->make_constructible_json().dump();
+  }
+  catch (...) {
+    for (uint16_t i = 0; i < ic_cubes.size(); ++i) ic_cubes[i]->clear_snapshot();
+    throw;
+  }
   jsonfile.close();  
+  for (uint16_t i = 0; i < ic_cubes.size(); ++i) {
+    ic_cubes[i]->clear_snapshot();
+  }
   
   uint16_t nworker = _nworker;
   
@@ -58,7 +102,13 @@ void chunk_processor_multiprocess::apply(std::shared_ptr<cube> c,
         {"log_file", filesystem::join(work_dir, "worker_" + std::to_string(pid) + ".log")},
         {"ncdf_compression_level", _ncdf_compression_level}, 
         {"streaming_dir", work_dir},
-        {"use_overview_images", _use_overviews}
+        {"use_overview_images", _use_overviews},
+        {"prefetch_depth", (int)config::instance()->get_prefetch_depth()},
+        {"prefetch_memory", (double)config::instance()->get_prefetch_memory_max() / (1024.0 * 1024.0)},
+        {"thread_budget", (config::instance()->get_thread_budget() == 0) ? 0 : std::max(1, config::instance()->get_thread_budget() / nworker)},
+        {"memory_budget", (double)config::instance()->get_memory_budget() / (1024.0 * 1024.0) / nworker},
+        {"remote_cache_dir", config::instance()->get_remote_cache_dir()},
+        {"remote_cache_size", (double)config::instance()->get_remote_cache_max() / (1024.0 * 1024.0)}
       }},
       {"gdal_options",j_gdal_options}
     }; 
@@ -216,6 +266,9 @@ void chunk_processor_multiprocess::apply(std::shared_ptr<cube> c,
     }
   }
   
+  for (uint16_t i = 0; i < snapshot_files.size(); ++i) {
+    filesystem::remove(snapshot_files[i]);
+  }
   filesystem::remove(work_dir);
   r_stderr_buf::print(); // make sure that deferred output is printed
   
@@ -244,7 +297,8 @@ void chunk_processor_multiprocess::exec(std::string json_path, uint16_t pid, uin
     }
     // TODO: error handling / exceptions
   }
-  
+  // stop background prefetching of chunks beyond the end of this worker's sequence before the process exits
+  prefetch_queue::instance()->clear();
 }
 
 }
\ No newline at end of file